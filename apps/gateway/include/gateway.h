@@ -0,0 +1,117 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "magna/irbis.h"
+
+/*=========================================================*/
+
+/* Предельный размер заголовка HTTP-запроса */
+#define HTTP_HEADER_LIMIT 8192
+
+/* Параметры по умолчанию */
+#define GATEWAY_BIND        "127.0.0.1"
+#define GATEWAY_PORT        8080
+#define GATEWAY_WORKERS     64
+#define GATEWAY_CONNECTIONS 8
+#define GATEWAY_CACHE_SIZE  (16ul * 1024ul * 1024ul)
+#define GATEWAY_CACHE_TTL   60000u
+#define GATEWAY_TIMEOUT     30000u
+
+/* Пауза после неудачного приема подключения, мс */
+#define GATEWAY_ACCEPT_PAUSE 100
+
+/* Разобранный HTTP-запрос */
+typedef struct
+{
+    Buffer header;  /* Заголовок запроса целиком. */
+    Span method;    /* Метод (GET и т. д.). */
+    Span path;      /* Путь без параметров. */
+    Span query;     /* Параметры (после '?'), без раскодирования. */
+    am_bool expired; /* Клиент не успел передать заголовок. */
+
+} HttpRequest;
+
+/* Ответ, сформированный обработчиком */
+typedef struct
+{
+    Buffer body;    /* Тело ответа (JSON). */
+    int status;     /* Код состояния HTTP. */
+
+} HttpAnswer;
+
+/* Запрос, выполняющийся в данный момент (для объединения одинаковых) */
+typedef struct
+{
+    Buffer key;         /* Путь и параметры запроса. */
+    HttpAnswer answer;  /* Результат выполнения. */
+    size_t references;  /* Потоки, ждущие результата, плюс исполнитель. */
+    am_bool done;       /* Результат готов. */
+
+} GatewayFlight;
+
+typedef struct GatewayServer Gateway;
+
+typedef am_bool (*GatewayHandler) (Gateway *gateway, Connection *connection, const HttpRequest *request, HttpAnswer *answer);
+
+#define ROUTE_CACHEABLE 1 /* Ответ можно кэшировать */
+#define ROUTE_LOCAL     2 /* Обращение к серверу ИРБИС64 не требуется */
+
+/* Маршрут: путь и его обработчик */
+typedef struct
+{
+    const char *path;        /* Путь, например "/record". */
+    GatewayHandler handler;  /* Обработчик. */
+    int flags;               /* ROUTE_CACHEABLE и т. д. */
+
+} GatewayRoute;
+
+struct GatewayServer
+{
+    ConnectionPool pool;    /* Долгоживущие зарегистрированные подключения. */
+    LruCache answers;       /* Кэш готовых ответов. */
+    Vector flights;         /* Выполняющиеся запросы (GatewayFlight*). */
+    Mutex mutex;            /* Защищает кэш, выполняющиеся запросы и статистику. */
+    Condition landed;       /* Сигнализирует о завершении запроса. */
+    am_int32 listener;      /* Слушающий сокет (-1 = не создан). */
+    Tcp4Address address;    /* Адрес, на котором слушает шлюз. */
+    am_uint32 timeout;      /* Предельное время ожидания клиента и чужого результата в мс. */
+    size_t workers;         /* Количество рабочих потоков. */
+    volatile am_bool stopping; /* Шлюз останавливается. */
+    am_uint64 requests;     /* Всего запросов. */
+    am_uint64 coalesced;    /* Запросов, дождавшихся чужого результата. */
+    am_uint64 failures;     /* Запросов, завершившихся ошибкой. */
+
+};
+
+/* gateway.c */
+
+am_bool gateway_create  (Gateway *gateway, const Connection *settings, size_t connections, size_t cacheSize, am_uint32 cacheTtl);
+void    gateway_destroy (Gateway *gateway);
+am_bool gateway_fetch   (Gateway *gateway, const GatewayRoute *route, const HttpRequest *request, HttpAnswer *answer);
+am_bool gateway_listen  (Gateway *gateway, const am_byte *host, am_uint16 port);
+void    gateway_run     (Gateway *gateway, size_t workers);
+void    gateway_stop    (Gateway *gateway);
+
+/* handler.c */
+
+const GatewayRoute* gateway_route (Span path);
+
+/* http.c */
+
+void    http_answer_destroy  (HttpAnswer *answer);
+void    http_answer_init     (HttpAnswer *answer);
+am_bool http_error           (HttpAnswer *answer, int status, const char *message);
+am_bool http_get_parameter   (const HttpRequest *request, const char *name, Buffer *value);
+void    http_request_destroy (HttpRequest *request);
+void    http_request_init    (HttpRequest *request);
+am_bool http_request_read    (HttpRequest *request, am_int32 handle, am_uint32 timeout);
+am_bool http_send_answer     (am_int32 handle, const HttpAnswer *answer);
+am_bool http_url_decode      (Buffer *output, Span value);
+am_bool json_put_string      (Buffer *output, Span value);
+
+/*=========================================================*/
+
+#endif
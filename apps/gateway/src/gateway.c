@@ -0,0 +1,494 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "gateway.h"
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/*
+ * Шлюз: прием HTTP-запросов и их выполнение
+ * через пул долгоживущих подключений к серверу ИРБИС64.
+ *
+ * Готовые ответы на кэшируемые запросы хранятся
+ * в LRU-кэше ограниченного объема с ограниченным временем
+ * жизни. Одинаковые запросы (с совпадающими путем
+ * и параметрами), пришедшие, пока первый из них еще
+ * выполняется, на сервер не отправляются: они ждут
+ * и получают копию результата первого запроса,
+ * но не дольше `timeout` миллисекунд (после чего
+ * отвечают клиенту кодом 504).
+ */
+
+/*=========================================================*/
+
+static void gateway_free_body
+    (
+        void *value
+    )
+{
+    Buffer *buffer = (Buffer*) value;
+
+    buffer_destroy (buffer);
+    mem_free (buffer);
+}
+
+/* Освобождение выполнявшегося запроса последним из его пользователей.
+ * Вызывается под мьютексом. */
+static void gateway_flight_release
+    (
+        GatewayFlight *flight
+    )
+{
+    if (--flight->references == 0) {
+        buffer_destroy (&flight->key);
+        http_answer_destroy (&flight->answer);
+        mem_free (flight);
+    }
+}
+
+/* Копирование готового ответа. */
+static am_bool gateway_copy_answer
+    (
+        HttpAnswer *target,
+        const HttpAnswer *source
+    )
+{
+    target->status = source->status;
+
+    return buffer_copy (&target->body, &source->body);
+}
+
+/*=========================================================*/
+
+/**
+ * Инициализация шлюза.
+ *
+ * @param gateway Указатель на неинициализированную структуру.
+ * @param settings Настройки подключений к серверу ИРБИС64.
+ * @param connections Предельное количество подключений.
+ * @param cacheSize Предельный объем кэша ответов в байтах.
+ * @param cacheTtl Время жизни ответа в кэше в миллисекундах.
+ * @return Признак успешного завершения операции.
+ */
+am_bool gateway_create
+    (
+        Gateway *gateway,
+        const Connection *settings,
+        size_t connections,
+        size_t cacheSize,
+        am_uint32 cacheTtl
+    )
+{
+    assert (gateway != NULL);
+    assert (settings != NULL);
+
+    mem_clear (gateway, sizeof (*gateway));
+    gateway->listener = -1;
+    gateway->timeout = GATEWAY_TIMEOUT;
+
+    if (!pool_create (&gateway->pool, settings, connections)) {
+        return AM_FALSE;
+    }
+
+    if (!lru_create (&gateway->answers, cacheSize, 0, gateway_free_body)) {
+        pool_destroy (&gateway->pool);
+        return AM_FALSE;
+    }
+
+    gateway->answers.ttl = cacheTtl;
+    if (!vector_create (&gateway->flights, 16)
+        || !mutex_init (&gateway->mutex)
+        || !condition_init (&gateway->landed)) {
+        gateway_destroy (gateway);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых шлюзом.
+ * Подключения к серверу ИРБИС64 снимаются с регистрации.
+ *
+ * @param gateway Шлюз.
+ */
+void gateway_destroy
+    (
+        Gateway *gateway
+    )
+{
+    assert (gateway != NULL);
+
+    if (gateway->listener >= 0) {
+        tcp4_disconnect (gateway->listener);
+    }
+
+    pool_destroy (&gateway->pool);
+    lru_destroy (&gateway->answers);
+    vector_destroy (&gateway->flights, NULL);
+    condition_destroy (&gateway->landed);
+    mutex_destroy (&gateway->mutex);
+    mem_clear (gateway, sizeof (*gateway));
+}
+
+/*=========================================================*/
+
+/* Выполнение запроса на одном из подключений пула. */
+static void gateway_execute
+    (
+        Gateway *gateway,
+        const GatewayRoute *route,
+        const HttpRequest *request,
+        HttpAnswer *answer
+    )
+{
+    Connection *connection;
+
+    connection = pool_acquire (&gateway->pool);
+    if (connection == NULL) {
+        http_error (answer, 503, "IRBIS64 server is unavailable");
+        return;
+    }
+
+    if (!route->handler (gateway, connection, request, answer)
+        && answer->status == 200) {
+        http_error (answer, 502, irbis_describe_error (connection->lastError));
+    }
+
+    pool_release (&gateway->pool, connection);
+}
+
+/**
+ * Получение ответа на запрос: из кэша, от уже выполняющегося
+ * такого же запроса либо непосредственно от сервера ИРБИС64.
+ *
+ * @param gateway Шлюз.
+ * @param route Маршрут запроса.
+ * @param request Разобранный запрос.
+ * @param answer Ответ, подлежащий заполнению.
+ * @return Признак успешного завершения операции.
+ */
+am_bool gateway_fetch
+    (
+        Gateway *gateway,
+        const GatewayRoute *route,
+        const HttpRequest *request,
+        HttpAnswer *answer
+    )
+{
+    Buffer key = BUFFER_INIT;
+    const Buffer *cached;
+    Buffer *copy;
+    GatewayFlight *flight;
+    am_bool result = AM_FALSE;
+    am_uint64 deadline, now;
+    size_t index;
+
+    assert (gateway != NULL);
+    assert (route != NULL);
+    assert (request != NULL);
+    assert (answer != NULL);
+
+    if (route->flags & ROUTE_LOCAL) {
+        return route->handler (gateway, NULL, request, answer);
+    }
+
+    if (!buffer_write_span (&key, request->path)
+        || !buffer_putc (&key, '?')
+        || !buffer_write_span (&key, request->query)) {
+        buffer_destroy (&key);
+        return AM_FALSE;
+    }
+
+    mutex_lock (&gateway->mutex);
+
+    if (route->flags & ROUTE_CACHEABLE) {
+        cached = (const Buffer*) lru_get (&gateway->answers, buffer_to_span (&key));
+        if (cached != NULL) {
+            answer->status = 200;
+            result = buffer_copy (&answer->body, cached);
+            mutex_unlock (&gateway->mutex);
+            goto DONE;
+        }
+    }
+
+    /* Такой же запрос уже выполняется -- ждем его результата */
+    for (index = 0; index < gateway->flights.len; ++index) {
+        flight = (GatewayFlight*) vector_get (&gateway->flights, index);
+        if (buffer_compare (&flight->key, &key) == 0) {
+            ++flight->references;
+            ++gateway->coalesced;
+            deadline = magna_ticks () + gateway->timeout;
+            while (!flight->done) {
+                now = magna_ticks ();
+                if (now >= deadline) {
+                    break;
+                }
+
+                condition_wait_for
+                    (
+                        &gateway->landed,
+                        &gateway->mutex,
+                        (am_int32) (deadline - now)
+                    );
+            }
+
+            result = flight->done
+                ? gateway_copy_answer (answer, &flight->answer)
+                : http_error (answer, 504, "IRBIS64 server is too slow");
+            gateway_flight_release (flight);
+            mutex_unlock (&gateway->mutex);
+            goto DONE;
+        }
+    }
+
+    flight = (GatewayFlight*) mem_alloc (sizeof (GatewayFlight));
+    if (flight == NULL) {
+        mutex_unlock (&gateway->mutex);
+        goto DONE;
+    }
+
+    mem_clear (flight, sizeof (*flight));
+    http_answer_init (&flight->answer);
+    flight->key = key;
+    flight->references = 1;
+    buffer_init (&key);
+    if (!vector_push_back (&gateway->flights, flight)) {
+        gateway_flight_release (flight);
+        mutex_unlock (&gateway->mutex);
+        goto DONE;
+    }
+
+    mutex_unlock (&gateway->mutex);
+
+    gateway_execute (gateway, route, request, &flight->answer);
+
+    mutex_lock (&gateway->mutex);
+
+    if ((route->flags & ROUTE_CACHEABLE) && flight->answer.status == 200) {
+        copy = (Buffer*) mem_alloc (sizeof (Buffer));
+        if (copy != NULL) {
+            buffer_init (copy);
+            if (!buffer_copy (copy, &flight->answer.body)
+                || !lru_put
+                    (
+                        &gateway->answers,
+                        buffer_to_span (&flight->key),
+                        copy,
+                        buffer_length (copy)
+                    )) {
+                gateway_free_body (copy);
+            }
+        }
+    }
+
+    /* Запрос покидает таблицу, ждущие получают результат */
+    for (index = 0; index < gateway->flights.len; ++index) {
+        if (vector_get (&gateway->flights, index) == flight) {
+            vector_set
+                (
+                    &gateway->flights,
+                    index,
+                    vector_get (&gateway->flights, gateway->flights.len - 1),
+                    NULL
+                );
+            vector_truncate (&gateway->flights, gateway->flights.len - 1, NULL);
+            break;
+        }
+    }
+
+    flight->done = AM_TRUE;
+    condition_broadcast (&gateway->landed);
+    result = gateway_copy_answer (answer, &flight->answer);
+    gateway_flight_release (flight);
+    mutex_unlock (&gateway->mutex);
+
+    DONE:
+    buffer_destroy (&key);
+
+    return result;
+}
+
+/*=========================================================*/
+
+/* Обслуживание одного HTTP-клиента. */
+static void gateway_serve
+    (
+        Gateway *gateway,
+        am_int32 handle
+    )
+{
+    HttpRequest request;
+    HttpAnswer answer;
+    const GatewayRoute *route;
+
+    http_request_init (&request);
+    http_answer_init (&answer);
+
+    tcp4_set_send_timeout (handle, gateway->timeout);
+    if (!http_request_read (&request, handle, gateway->timeout)) {
+        if (request.expired) {
+            http_error (&answer, 408, "request header is too slow");
+        }
+        else {
+            http_error (&answer, 400, "malformed request");
+        }
+    }
+    else if (span_compare (request.method, TEXT_SPAN ("GET")) != 0) {
+        http_error (&answer, 405, "only GET is supported");
+    }
+    else if ((route = gateway_route (request.path)) == NULL) {
+        http_error (&answer, 404, "unknown path");
+    }
+    else if (!gateway_fetch (gateway, route, &request, &answer)) {
+        http_error (&answer, 500, "out of memory");
+    }
+
+    mutex_lock (&gateway->mutex);
+    ++gateway->requests;
+    if (answer.status != 200) {
+        ++gateway->failures;
+    }
+
+    mutex_unlock (&gateway->mutex);
+
+    http_send_answer (handle, &answer);
+    http_answer_destroy (&answer);
+    http_request_destroy (&request);
+}
+
+/* Рабочий поток: прием и обслуживание клиентов.
+ * Ошибки приема (клиент отключился, не дождавшись,
+ * исчерпаны дескрипторы) преходящи: поток выжидает
+ * и продолжает работу до остановки шлюза. */
+static void MAGNA_CALL gateway_worker
+    (
+        void *data
+    )
+{
+    Gateway *gateway = (Gateway*) data;
+    am_int32 handle;
+
+    while (!gateway->stopping) {
+        handle = tcp4_accept (gateway->listener);
+        if (handle < 0) {
+            if (!gateway->stopping) {
+                magna_sleep (GATEWAY_ACCEPT_PAUSE);
+            }
+
+            continue;
+        }
+
+        if (gateway->stopping) {
+            tcp4_disconnect (handle);
+            break;
+        }
+
+        gateway_serve (gateway, handle);
+        tcp4_disconnect (handle);
+    }
+}
+
+/**
+ * Создание слушающего сокета.
+ *
+ * @param gateway Шлюз.
+ * @param host Адрес интерфейса, например "127.0.0.1"
+ * (`GATEWAY_BIND`) либо "0.0.0.0" для всех интерфейсов.
+ * @param port Номер порта (0 = любой свободный).
+ * @return Признак успешного завершения операции.
+ */
+am_bool gateway_listen
+    (
+        Gateway *gateway,
+        const am_byte *host,
+        am_uint16 port
+    )
+{
+    assert (gateway != NULL);
+    assert (host != NULL);
+
+    if (!tcp4_resolve (host, port, &gateway->address)) {
+        return AM_FALSE;
+    }
+
+    gateway->listener = tcp4_listen (&gateway->address, 128);
+
+    return gateway->listener >= 0;
+}
+
+/**
+ * Обслуживание клиентов. Возвращает управление
+ * после остановки шлюза (см. `gateway_stop`).
+ *
+ * @param gateway Шлюз с созданным слушающим сокетом.
+ * @param workers Количество потоков (включая текущий).
+ */
+void gateway_run
+    (
+        Gateway *gateway,
+        size_t workers
+    )
+{
+    am_handle *threads;
+    size_t index, started = 0;
+
+    assert (gateway != NULL);
+    assert (gateway->listener >= 0);
+
+    gateway->workers = workers;
+    threads = (am_handle*) mem_alloc ((workers + 1) * sizeof (am_handle));
+    if (threads != NULL) {
+        /* Текущий поток тоже работает */
+        for (index = 1; index < workers; ++index) {
+            threads [started] = thread_start (gateway_worker, gateway);
+            if (handle_is_good (threads [started])) {
+                ++started;
+            }
+        }
+    }
+
+    gateway_worker (gateway);
+    for (index = 0; index < started; ++index) {
+        thread_wait (threads [index]);
+    }
+
+    mem_free (threads);
+}
+
+/**
+ * Остановка шлюза из другого потока: `gateway_run`
+ * возвращает управление, дообслужив текущих клиентов.
+ *
+ * @param gateway Работающий шлюз.
+ */
+void gateway_stop
+    (
+        Gateway *gateway
+    )
+{
+    Tcp4Address address;
+    am_int32 handle;
+    size_t index;
+
+    assert (gateway != NULL);
+    assert (gateway->listener >= 0);
+
+    /* Каждый поток, приняв подключение, увидит признак остановки */
+    gateway->stopping = AM_TRUE;
+    address = gateway->address;
+    address.port = tcp4_local_port (gateway->listener);
+    if (address.address == 0
+        && !tcp4_resolve (CBTEXT ("127.0.0.1"), address.port, &address)) {
+        return;
+    }
+
+    for (index = 0; index < gateway->workers; ++index) {
+        handle = tcp4_connect_address (&address);
+        if (handle >= 0) {
+            tcp4_disconnect (handle);
+        }
+    }
+}
@@ -0,0 +1,441 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "gateway.h"
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/*
+ * Обработчики запросов к шлюзу.
+ *
+ * GET /search?q=выражение[&format=формат][&first=N][&limit=N][&db=база]
+ * GET /record?mfn=N[&db=база]
+ * GET /format?mfn=N&format=формат[&db=база]
+ * GET /terms?start=термин[&limit=N][&db=база]
+ * GET /stats
+ *
+ * Ответы -- объекты JSON в кодировке UTF-8.
+ */
+
+/*=========================================================*/
+
+/* Предельное количество элементов в одном ответе */
+#define HANDLER_MAX_LIMIT 1000
+
+/* Выбор базы данных: из параметра `db` либо по умолчанию. */
+static am_bool handler_database
+    (
+        Gateway *gateway,
+        Connection *connection,
+        const HttpRequest *request
+    )
+{
+    Buffer database = BUFFER_INIT;
+    am_bool result;
+
+    if (http_get_parameter (request, "db", &database) && !buffer_is_empty (&database)) {
+        result = connection_set_database (connection, B2B (&database));
+    }
+    else {
+        result = buffer_copy (&connection->database, &gateway->pool.settings.database);
+    }
+
+    buffer_destroy (&database);
+
+    return result;
+}
+
+/* Числовой параметр. */
+static am_uint32 handler_number
+    (
+        const HttpRequest *request,
+        const char *name,
+        am_uint32 defaultValue
+    )
+{
+    Buffer value = BUFFER_INIT;
+    am_uint32 result = defaultValue;
+
+    if (http_get_parameter (request, name, &value) && !buffer_is_empty (&value)) {
+        result = span_to_uint32 (buffer_to_span (&value));
+    }
+
+    buffer_destroy (&value);
+
+    return result;
+}
+
+/* Количество элементов в ответе с ограничением сверху. */
+static am_uint32 handler_limit
+    (
+        const HttpRequest *request,
+        am_uint32 defaultValue
+    )
+{
+    am_uint32 result = handler_number (request, "limit", defaultValue);
+
+    if (result > HANDLER_MAX_LIMIT) {
+        result = HANDLER_MAX_LIMIT;
+    }
+
+    return result;
+}
+
+/* MFN из параметра `mfn` (0 = не задан). */
+static am_mfn handler_mfn
+    (
+        const HttpRequest *request
+    )
+{
+    Buffer value = BUFFER_INIT;
+    am_mfn result = 0;
+
+    if (http_get_parameter (request, "mfn", &value)) {
+        result = span_to_uint32 (buffer_to_span (&value));
+    }
+
+    buffer_destroy (&value);
+
+    return result;
+}
+
+/* Запись пары "имя":число. */
+static am_bool handler_put_number
+    (
+        Buffer *output,
+        const char *name,
+        am_uint64 value
+    )
+{
+    return buffer_putc (output, '"')
+        && buffer_puts (output, CBTEXT (name))
+        && buffer_puts (output, CBTEXT ("\":"))
+        && buffer_put_uint64 (output, value);
+}
+
+/*=========================================================*/
+
+static am_bool MAGNA_CALL handler_found_to_json
+    (
+        const FoundLine *found,
+        void *data
+    )
+{
+    Buffer *output = (Buffer*) data;
+
+    /* Перед первым элементом массива запятая не нужна */
+    if (output->current[-1] != '[' && !buffer_putc (output, ',')) {
+        return AM_FALSE;
+    }
+
+    return buffer_putc (output, '{')
+        && handler_put_number (output, "mfn", found->mfn)
+        && buffer_puts (output, CBTEXT (",\"text\":"))
+        && json_put_string (output, buffer_to_span (&found->description))
+        && buffer_putc (output, '}');
+}
+
+static am_bool handler_search
+    (
+        Gateway *gateway,
+        Connection *connection,
+        const HttpRequest *request,
+        HttpAnswer *answer
+    )
+{
+    SearchParameters parameters;
+    Response response;
+    am_int32 count;
+    am_bool result = AM_FALSE;
+
+    search_parameters_init (&parameters);
+    response_init (&response);
+    if (!http_get_parameter (request, "q", &parameters.expression)
+        || buffer_is_empty (&parameters.expression)) {
+        result = http_error (answer, 400, "parameter 'q' is required");
+        goto DONE;
+    }
+
+    http_get_parameter (request, "format", &parameters.format);
+    parameters.firstRecord = handler_number (request, "first", 1);
+    parameters.number = handler_limit (request, 100);
+    if (parameters.firstRecord == 0) {
+        parameters.firstRecord = 1;
+    }
+
+    if (!handler_database (gateway, connection, request)
+        || !connection_search_ex (connection, &parameters, &response)) {
+        goto DONE;
+    }
+
+    count = response_read_int32 (&response);
+    result = buffer_putc (&answer->body, '{')
+        && handler_put_number (&answer->body, "count", (am_uint64) count)
+        && buffer_puts (&answer->body, CBTEXT (",\"found\":["))
+        && found_decode_stream (&response, handler_found_to_json, &answer->body)
+        && buffer_puts (&answer->body, CBTEXT ("]}"));
+
+    DONE:
+    response_destroy (&response);
+    search_parameters_destroy (&parameters);
+
+    return result;
+}
+
+/*=========================================================*/
+
+static am_bool handler_field_to_json
+    (
+        Buffer *output,
+        const MarcField *field
+    )
+{
+    const SubField *subfield;
+    size_t index;
+
+    if (!buffer_putc (output, '{')
+        || !handler_put_number (output, "tag", field->tag)
+        || !buffer_puts (output, CBTEXT (",\"value\":"))
+        || !json_put_string (output, buffer_to_span (&field->value))
+        || !buffer_puts (output, CBTEXT (",\"subfields\":["))) {
+        return AM_FALSE;
+    }
+
+    for (index = 0; index < field->subfields.len; ++index) {
+        subfield = (const SubField*) array_get (&field->subfields, index);
+        if ((index != 0 && !buffer_putc (output, ','))
+            || !buffer_puts (output, CBTEXT ("{\"code\":"))
+            || !json_put_string (output, span_init (&subfield->code, 1))
+            || !buffer_puts (output, CBTEXT (",\"value\":"))
+            || !json_put_string (output, buffer_to_span (&subfield->value))
+            || !buffer_putc (output, '}')) {
+            return AM_FALSE;
+        }
+    }
+
+    return buffer_puts (output, CBTEXT ("]}"));
+}
+
+static am_bool handler_record
+    (
+        Gateway *gateway,
+        Connection *connection,
+        const HttpRequest *request,
+        HttpAnswer *answer
+    )
+{
+    MarcRecord record;
+    Buffer *output = &answer->body;
+    am_mfn mfn;
+    size_t index;
+    am_bool result = AM_FALSE;
+
+    mfn = handler_mfn (request);
+    if (mfn == 0) {
+        return http_error (answer, 400, "parameter 'mfn' is required");
+    }
+
+    record_init (&record);
+    if (!handler_database (gateway, connection, request)
+        || !connection_read_record (connection, mfn, &record)) {
+        goto DONE;
+    }
+
+    if (!buffer_putc (output, '{')
+        || !handler_put_number (output, "mfn", record.mfn)
+        || !buffer_puts (output, CBTEXT (",\"database\":"))
+        || !json_put_string (output, buffer_to_span (&connection->database))
+        || !buffer_putc (output, ',')
+        || !handler_put_number (output, "status", record.status)
+        || !buffer_putc (output, ',')
+        || !handler_put_number (output, "version", record.version)
+        || !buffer_puts (output, CBTEXT (",\"fields\":["))) {
+        goto DONE;
+    }
+
+    for (index = 0; index < record.fields.len; ++index) {
+        if ((index != 0 && !buffer_putc (output, ','))
+            || !handler_field_to_json (output, (const MarcField*) array_get (&record.fields, index))) {
+            goto DONE;
+        }
+    }
+
+    result = buffer_puts (output, CBTEXT ("]}"));
+
+    DONE:
+    record_destroy (&record);
+
+    return result;
+}
+
+/*=========================================================*/
+
+static am_bool handler_format
+    (
+        Gateway *gateway,
+        Connection *connection,
+        const HttpRequest *request,
+        HttpAnswer *answer
+    )
+{
+    Buffer format = BUFFER_INIT, text = BUFFER_INIT;
+    am_mfn mfn;
+    am_bool result = AM_FALSE;
+
+    mfn = handler_mfn (request);
+    if (mfn == 0
+        || !http_get_parameter (request, "format", &format)
+        || buffer_is_empty (&format)) {
+        result = http_error (answer, 400, "parameters 'mfn' and 'format' are required");
+        goto DONE;
+    }
+
+    if (!handler_database (gateway, connection, request)
+        || !connection_format_mfn (connection, B2B (&format), mfn, &text)) {
+        goto DONE;
+    }
+
+    result = buffer_putc (&answer->body, '{')
+        && handler_put_number (&answer->body, "mfn", mfn)
+        && buffer_puts (&answer->body, CBTEXT (",\"text\":"))
+        && json_put_string (&answer->body, buffer_to_span (&text))
+        && buffer_putc (&answer->body, '}');
+
+    DONE:
+    buffer_destroy (&text);
+    buffer_destroy (&format);
+
+    return result;
+}
+
+/*=========================================================*/
+
+static am_bool handler_terms
+    (
+        Gateway *gateway,
+        Connection *connection,
+        const HttpRequest *request,
+        HttpAnswer *answer
+    )
+{
+    TermParameters parameters;
+    Array terms;
+    const Term *term;
+    Buffer *output = &answer->body;
+    size_t index;
+    am_bool result = AM_FALSE;
+
+    term_parameters_init (&parameters);
+    term_array_init (&terms);
+    if (!http_get_parameter (request, "start", &parameters.startTerm)
+        || buffer_is_empty (&parameters.startTerm)) {
+        result = http_error (answer, 400, "parameter 'start' is required");
+        goto DONE;
+    }
+
+    parameters.number = handler_limit (request, 20);
+    if (!handler_database (gateway, connection, request)
+        || !connection_read_terms (connection, &parameters, &terms)
+        || !buffer_puts (output, CBTEXT ("{\"terms\":["))) {
+        goto DONE;
+    }
+
+    for (index = 0; index < terms.len; ++index) {
+        term = (const Term*) array_get (&terms, index);
+        if ((index != 0 && !buffer_putc (output, ','))
+            || !buffer_putc (output, '{')
+            || !handler_put_number (output, "count", term->count)
+            || !buffer_puts (output, CBTEXT (",\"text\":"))
+            || !json_put_string (output, buffer_to_span (&term->text))
+            || !buffer_putc (output, '}')) {
+            goto DONE;
+        }
+    }
+
+    result = buffer_puts (output, CBTEXT ("]}"));
+
+    DONE:
+    term_array_destroy (&terms);
+    term_parameters_destroy (&parameters);
+
+    return result;
+}
+
+/*=========================================================*/
+
+static am_bool handler_stats
+    (
+        Gateway *gateway,
+        Connection *connection,
+        const HttpRequest *request,
+        HttpAnswer *answer
+    )
+{
+    Buffer *output = &answer->body;
+    size_t created;
+    am_bool result;
+
+    (void) connection;
+    (void) request;
+
+    mutex_lock (&gateway->pool.mutex);
+    created = gateway->pool.created;
+    mutex_unlock (&gateway->pool.mutex);
+
+    mutex_lock (&gateway->mutex);
+    result = buffer_putc (output, '{')
+        && handler_put_number (output, "requests", gateway->requests)
+        && buffer_putc (output, ',')
+        && handler_put_number (output, "coalesced", gateway->coalesced)
+        && buffer_putc (output, ',')
+        && handler_put_number (output, "failures", gateway->failures)
+        && buffer_putc (output, ',')
+        && handler_put_number (output, "connections", created)
+        && buffer_puts (output, CBTEXT (",\"cache\":{"))
+        && handler_put_number (output, "hits", gateway->answers.hits)
+        && buffer_putc (output, ',')
+        && handler_put_number (output, "misses", gateway->answers.misses)
+        && buffer_putc (output, ',')
+        && handler_put_number (output, "entries", gateway->answers.count)
+        && buffer_putc (output, ',')
+        && handler_put_number (output, "size", gateway->answers.size)
+        && buffer_puts (output, CBTEXT ("}}"));
+    mutex_unlock (&gateway->mutex);
+
+    return result;
+}
+
+/*=========================================================*/
+
+static const GatewayRoute routes[] =
+{
+    { "/search", handler_search, 0 },
+    { "/record", handler_record, ROUTE_CACHEABLE },
+    { "/format", handler_format, ROUTE_CACHEABLE },
+    { "/terms",  handler_terms,  0 },
+    { "/stats",  handler_stats,  ROUTE_LOCAL }
+};
+
+/**
+ * Поиск маршрута по пути запроса.
+ *
+ * @param path Путь (без параметров).
+ * @return Маршрут либо NULL.
+ */
+const GatewayRoute* gateway_route
+    (
+        Span path
+    )
+{
+    size_t index;
+
+    for (index = 0; index < sizeof (routes) / sizeof (routes[0]); ++index) {
+        if (span_compare (path, TEXT_SPAN (routes[index].path)) == 0) {
+            return &routes[index];
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,392 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "gateway.h"
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/*
+ * Минимальная поддержка HTTP/1.0: разбор строки запроса,
+ * извлечение параметров и отсылка ответа в формате JSON.
+ * Тело запроса не поддерживается (только GET),
+ * соединение закрывается после каждого ответа.
+ */
+
+/*=========================================================*/
+
+void http_request_init
+    (
+        HttpRequest *request
+    )
+{
+    assert (request != NULL);
+
+    mem_clear (request, sizeof (*request));
+}
+
+void http_request_destroy
+    (
+        HttpRequest *request
+    )
+{
+    assert (request != NULL);
+
+    buffer_destroy (&request->header);
+    mem_clear (request, sizeof (*request));
+}
+
+/* Поиск конца заголовка. */
+static am_bool http_header_complete
+    (
+        const Buffer *header
+    )
+{
+    const am_byte *ptr;
+
+    for (ptr = header->start; ptr + 3 < header->current; ++ptr) {
+        if (ptr[0] == '\r' && ptr[1] == '\n' && ptr[2] == '\r' && ptr[3] == '\n') {
+            return AM_TRUE;
+        }
+    }
+
+    return AM_FALSE;
+}
+
+/**
+ * Прием и разбор заголовка HTTP-запроса.
+ * Клиент, не успевший передать заголовок целиком
+ * за отведенное время, получает отказ (`expired`),
+ * чтобы медленные клиенты не занимали рабочие потоки.
+ *
+ * @param request Инициализированный запрос.
+ * @param handle Сокет клиента.
+ * @param timeout Предельное время приема заголовка в мс.
+ * @return Признак успешного разбора.
+ */
+am_bool http_request_read
+    (
+        HttpRequest *request,
+        am_int32 handle,
+        am_uint32 timeout
+    )
+{
+    Navigator navigator;
+    Tcp4Poll item;
+    Span target;
+    ssize_t received, position;
+    am_uint64 deadline, now;
+
+    assert (request != NULL);
+
+    deadline = magna_ticks () + timeout;
+    while (!http_header_complete (&request->header)) {
+        if (buffer_length (&request->header) >= HTTP_HEADER_LIMIT) {
+            return AM_FALSE;
+        }
+
+        now = magna_ticks ();
+        item.handle = handle;
+        item.events = TCP4_READ;
+        item.ready = 0;
+        if (now >= deadline
+            || tcp4_poll (&item, 1, (am_int32) (deadline - now)) <= 0) {
+            request->expired = AM_TRUE;
+            return AM_FALSE;
+        }
+
+        received = tcp4_receive_with_limit
+            (
+                handle,
+                &request->header,
+                (ssize_t) (HTTP_HEADER_LIMIT - buffer_length (&request->header))
+            );
+        if (received <= 0) {
+            return AM_FALSE;
+        }
+    }
+
+    /* GET /path?query HTTP/1.1 */
+    nav_from_buffer (&navigator, &request->header);
+    request->method = nav_read_to (&navigator, ' ');
+    target = nav_read_to (&navigator, ' ');
+    if (span_is_empty (request->method) || span_is_empty (target)) {
+        return AM_FALSE;
+    }
+
+    position = span_index_of (target, '?');
+    if (position < 0) {
+        request->path = target;
+        request->query = span_slice (target, (ssize_t) span_length (target), 0);
+    }
+    else {
+        request->path = span_slice (target, 0, position);
+        request->query = span_slice (target, position + 1, -1);
+    }
+
+    return AM_TRUE;
+}
+
+/* Значение шестнадцатеричной цифры либо -1. */
+static int http_hex
+    (
+        am_byte c
+    )
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/**
+ * Раскодирование фрагмента URL (%XX и '+').
+ * Неправильные последовательности копируются как есть.
+ *
+ * @param output Буфер для вывода.
+ * @param value Закодированный фрагмент.
+ * @return Признак успешного завершения операции.
+ */
+am_bool http_url_decode
+    (
+        Buffer *output,
+        Span value
+    )
+{
+    const am_byte *ptr;
+    int high, low;
+
+    for (ptr = value.start; ptr < value.end; ++ptr) {
+        if (*ptr == '+') {
+            if (!buffer_putc (output, ' ')) {
+                return AM_FALSE;
+            }
+        }
+        else if (*ptr == '%' && ptr + 2 < value.end
+            && (high = http_hex (ptr[1])) >= 0
+            && (low = http_hex (ptr[2])) >= 0) {
+            if (!buffer_putc (output, (am_byte) (high * 16 + low))) {
+                return AM_FALSE;
+            }
+
+            ptr += 2;
+        }
+        else if (!buffer_putc (output, *ptr)) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Получение раскодированного значения параметра запроса.
+ *
+ * @param request Разобранный запрос.
+ * @param name Имя параметра.
+ * @param value Буфер, принимающий значение (очищается).
+ * @return `AM_TRUE`, если параметр присутствует.
+ */
+am_bool http_get_parameter
+    (
+        const HttpRequest *request,
+        const char *name,
+        Buffer *value
+    )
+{
+    Navigator navigator;
+    Span item;
+    ssize_t position;
+
+    assert (request != NULL);
+    assert (name != NULL);
+    assert (value != NULL);
+
+    buffer_clear (value);
+    nav_from_span (&navigator, request->query);
+    while (!nav_eot (&navigator)) {
+        /* Пустое значение ("db=") -- параметр все же задан */
+        item = nav_read_to (&navigator, '&');
+        position = span_index_of (item, '=');
+        if (position < 0) {
+            continue;
+        }
+
+        if (span_compare (span_slice (item, 0, position), TEXT_SPAN (name)) == 0) {
+            return http_url_decode (value, span_slice (item, position + 1, -1));
+        }
+    }
+
+    return AM_FALSE;
+}
+
+/*=========================================================*/
+
+void http_answer_init
+    (
+        HttpAnswer *answer
+    )
+{
+    assert (answer != NULL);
+
+    buffer_init (&answer->body);
+    answer->status = 200;
+}
+
+void http_answer_destroy
+    (
+        HttpAnswer *answer
+    )
+{
+    assert (answer != NULL);
+
+    buffer_destroy (&answer->body);
+}
+
+/**
+ * Запись строки в формате JSON (в кавычках, с экранированием).
+ * Байты с кодами выше 0x7F копируются как есть (текст в UTF-8).
+ *
+ * @param output Буфер для вывода.
+ * @param value Строка.
+ * @return Признак успешного завершения операции.
+ */
+am_bool json_put_string
+    (
+        Buffer *output,
+        Span value
+    )
+{
+    static const char digits[] = "0123456789abcdef";
+    const am_byte *ptr;
+    am_bool result = buffer_putc (output, '"');
+
+    for (ptr = value.start; result && ptr < value.end; ++ptr) {
+        switch (*ptr) {
+            case '"':
+                result = buffer_puts (output, CBTEXT ("\\\""));
+                break;
+
+            case '\\':
+                result = buffer_puts (output, CBTEXT ("\\\\"));
+                break;
+
+            case '\n':
+                result = buffer_puts (output, CBTEXT ("\\n"));
+                break;
+
+            case '\r':
+                result = buffer_puts (output, CBTEXT ("\\r"));
+                break;
+
+            case '\t':
+                result = buffer_puts (output, CBTEXT ("\\t"));
+                break;
+
+            default:
+                if (*ptr < 0x20) {
+                    result = buffer_puts (output, CBTEXT ("\\u00"))
+                        && buffer_putc (output, (am_byte) digits[*ptr >> 4])
+                        && buffer_putc (output, (am_byte) digits[*ptr & 15]);
+                }
+                else {
+                    result = buffer_putc (output, *ptr);
+                }
+                break;
+        }
+    }
+
+    return result && buffer_putc (output, '"');
+}
+
+/**
+ * Формирование ответа с сообщением об ошибке.
+ *
+ * @param answer Ответ.
+ * @param status Код состояния HTTP.
+ * @param message Текст сообщения.
+ * @return Признак успешного завершения операции.
+ */
+am_bool http_error
+    (
+        HttpAnswer *answer,
+        int status,
+        const char *message
+    )
+{
+    assert (answer != NULL);
+    assert (message != NULL);
+
+    answer->status = status;
+    buffer_clear (&answer->body);
+
+    return buffer_puts (&answer->body, CBTEXT ("{\"error\":"))
+        && json_put_string (&answer->body, TEXT_SPAN (message))
+        && buffer_putc (&answer->body, '}');
+}
+
+/* Текстовое описание кода состояния. */
+static const char* http_reason
+    (
+        int status
+    )
+{
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default:  return "Internal Server Error";
+    }
+}
+
+/**
+ * Отсылка ответа клиенту: заголовок и тело одним вызовом.
+ *
+ * @param handle Сокет клиента.
+ * @param answer Ответ.
+ * @return Признак успешного завершения операции.
+ */
+am_bool http_send_answer
+    (
+        am_int32 handle,
+        const HttpAnswer *answer
+    )
+{
+    char header[256];
+    Span spans[2];
+
+    assert (answer != NULL);
+
+    sprintf
+        (
+            header,
+            "HTTP/1.0 %d %s\r\n"
+            "Content-Type: application/json; charset=utf-8\r\n"
+            "Content-Length: %lu\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            answer->status,
+            http_reason (answer->status),
+            (unsigned long) buffer_length (&answer->body)
+        );
+
+    spans[0] = TEXT_SPAN (header);
+    spans[1] = buffer_to_span (&answer->body);
+
+    return tcp4_send_spans (handle, spans, 2);
+}
@@ -0,0 +1,133 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "gateway.h"
+
+#include <stdlib.h>
+
+#ifdef MAGNA_UNIX
+#include <signal.h>
+#endif
+
+/*=========================================================*/
+
+/*
+ * HTTP/JSON-шлюз к серверу ИРБИС64.
+ *
+ * Веб-приложения обращаются к шлюзу по HTTP, а шлюз выполняет
+ * их запросы через ограниченный набор долгоживущих подключений,
+ * зарегистрированных на сервере один раз. Кэш готовых ответов
+ * и объединение одинаковых одновременных запросов снимают
+ * с сервера повторяющуюся нагрузку.
+ *
+ * По умолчанию шлюз доступен только с локальной машины
+ * (127.0.0.1); ключ -bind 0.0.0.0 открывает его для сети.
+ *
+ * gateway "host=localhost;port=6666;user=librarian;password=secret;db=IBIS"
+ *     [-bind адрес] [-port N] [-workers N] [-connections N]
+ *     [-cache МБайт] [-ttl секунд] [-timeout секунд]
+ */
+
+static void usage (void)
+{
+    fputs
+        (
+            "Usage: gateway <connection string> [-bind address] [-port N]\n"
+            "       [-workers N] [-connections N] [-cache megabytes]\n"
+            "       [-ttl seconds] [-timeout seconds]\n",
+            stderr
+        );
+}
+
+int main (int argc, char **argv)
+{
+    Gateway gateway;
+    Connection settings;
+    const char *host = GATEWAY_BIND;
+    unsigned long port = GATEWAY_PORT;
+    unsigned long workers = GATEWAY_WORKERS;
+    unsigned long connections = GATEWAY_CONNECTIONS;
+    unsigned long cacheSize = GATEWAY_CACHE_SIZE;
+    unsigned long cacheTtl = GATEWAY_CACHE_TTL;
+    unsigned long timeout = GATEWAY_TIMEOUT;
+    unsigned long value;
+    int index;
+
+    if (argc < 2) {
+        usage ();
+        return 1;
+    }
+
+    for (index = 2; index + 1 < argc; index += 2) {
+        value = strtoul (argv[index + 1], NULL, 10);
+        if (strcmp (argv[index], "-bind") == 0) {
+            host = argv[index + 1];
+        }
+        else if (strcmp (argv[index], "-port") == 0) {
+            port = value;
+        }
+        else if (strcmp (argv[index], "-workers") == 0) {
+            workers = value;
+        }
+        else if (strcmp (argv[index], "-connections") == 0) {
+            connections = value;
+        }
+        else if (strcmp (argv[index], "-cache") == 0) {
+            cacheSize = value * 1024ul * 1024ul;
+        }
+        else if (strcmp (argv[index], "-ttl") == 0) {
+            cacheTtl = value * 1000ul;
+        }
+        else if (strcmp (argv[index], "-timeout") == 0) {
+            timeout = value * 1000ul;
+        }
+        else {
+            usage ();
+            return 1;
+        }
+    }
+
+    if (index != argc || workers == 0 || connections == 0 || timeout == 0) {
+        usage ();
+        return 1;
+    }
+
+#ifdef MAGNA_UNIX
+
+    /* Клиент может закрыть соединение, не дождавшись ответа */
+    signal (SIGPIPE, SIG_IGN);
+
+#endif
+
+    if (!connection_create (&settings)
+        || !connection_parse_string (&settings, TEXT_SPAN (argv[1]))) {
+        fputs ("Bad connection string\n", stderr);
+        return 1;
+    }
+
+    /* Команды серверу ИРБИС64 ограничены тем же временем */
+    settings.timeout = (am_uint32) timeout;
+
+    if (!gateway_create (&gateway, &settings, connections, cacheSize, (am_uint32) cacheTtl)) {
+        fputs ("Can't create gateway\n", stderr);
+        connection_destroy (&settings);
+        return 1;
+    }
+
+    connection_destroy (&settings);
+    gateway.timeout = (am_uint32) timeout;
+
+    if (!gateway_listen (&gateway, CBTEXT (host), (am_uint16) port)) {
+        fprintf (stderr, "Can't listen on %s:%lu\n", host, port);
+        gateway_destroy (&gateway);
+        return 1;
+    }
+
+    printf ("Listening on %s:%u\n", host, (unsigned) tcp4_local_port (gateway.listener));
+    fflush (stdout);
+
+    gateway_run (&gateway, workers);
+    gateway_destroy (&gateway);
+
+    return 0;
+}
@@ -0,0 +1,482 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAGNA_UNIX
+#include <signal.h>
+#endif
+
+/*=========================================================*/
+
+/*
+ * Замер пропускной способности и задержек клиентских
+ * операций на имитации сервера ИРБИС64 (см. `MockServer`).
+ *
+ * Сервер запускается в том же процессе на петлевом интерфейсе
+ * с синтетическими записями. Каждая операция выполняется
+ * заданным количеством потоков, у каждого потока свое
+ * подключение. Для каждой операции выводятся количество
+ * запросов и ошибок, общее время, запросов в секунду
+ * и 50-й и 99-й процентили времени одного запроса.
+ *
+ * mockbench [-threads N] [-requests N] [-records N]
+ *     [-workers N] [-latency мс] [-bandwidth байт/с]
+ */
+
+/* Одна замеряемая операция; `number` -- порядковый номер запроса */
+typedef am_bool (*BenchOperation) (Connection *connection, am_uint32 number);
+
+typedef struct
+{
+    const char *name;         /* Название для отчета. */
+    BenchOperation operation; /* Операция. */
+
+} BenchPath;
+
+/* Задание одному потоку */
+typedef struct
+{
+    const BenchPath *path;  /* Замеряемая операция. */
+    am_uint16 port;         /* Порт сервера. */
+    am_uint32 requests;     /* Количество запросов. */
+    am_uint32 seed;         /* Начальное значение номеров. */
+    am_uint32 *elapsed;     /* Время каждого запроса, мс. */
+    am_uint32 failures;     /* Неудачные запросы. */
+
+} BenchTask;
+
+static am_uint32 recordCount = 1000;
+
+static const char *words[] =
+{
+    "algebra", "geometry", "history", "physics", "chemistry",
+    "biology", "grammar", "poetry", "music", "economics"
+};
+
+#define WORD_COUNT (sizeof (words) / sizeof (words[0]))
+
+/* MFN существующей записи по номеру запроса. */
+static am_mfn bench_mfn
+    (
+        am_uint32 number
+    )
+{
+    return (am_mfn) ((number * 2654435761u) % recordCount + 1);
+}
+
+/*=========================================================*/
+
+static am_bool bench_nop
+    (
+        Connection *connection,
+        am_uint32 number
+    )
+{
+    (void) number;
+
+    return connection_no_operation (connection);
+}
+
+static am_bool bench_read_record
+    (
+        Connection *connection,
+        am_uint32 number
+    )
+{
+    MarcRecord record;
+    am_bool result;
+
+    record_init (&record);
+    result = connection_read_record (connection, bench_mfn (number), &record);
+    record_destroy (&record);
+
+    return result;
+}
+
+static am_bool bench_read_records
+    (
+        Connection *connection,
+        am_uint32 number
+    )
+{
+    Int32Array mfns = INT32_ARRAY_INIT;
+    Array records;
+    size_t index;
+    am_bool result = AM_TRUE;
+
+    array_init (&records, sizeof (MarcRecord));
+    for (index = 0; result && index < 10; ++index) {
+        result = int32_array_push_back (&mfns, (am_int32) bench_mfn (number + (am_uint32) index));
+    }
+
+    result = result && connection_read_records (connection, &mfns, &records);
+    for (index = 0; index < records.len; ++index) {
+        record_destroy ((MarcRecord*) array_get (&records, index));
+    }
+
+    array_destroy (&records, NULL);
+    int32_array_destroy (&mfns);
+
+    return result;
+}
+
+static am_bool bench_search
+    (
+        Connection *connection,
+        am_uint32 number
+    )
+{
+    char expression[32];
+
+    sprintf (expression, "K=%s", words[number % WORD_COUNT]);
+
+    return connection_search_count (connection, CBTEXT (expression)) >= 0;
+}
+
+static am_bool bench_format
+    (
+        Connection *connection,
+        am_uint32 number
+    )
+{
+    Buffer text = BUFFER_INIT;
+    am_bool result;
+
+    result = connection_format_mfn (connection, CBTEXT ("@brief"), bench_mfn (number), &text);
+    buffer_destroy (&text);
+
+    return result;
+}
+
+static am_bool bench_read_terms
+    (
+        Connection *connection,
+        am_uint32 number
+    )
+{
+    TermParameters parameters;
+    Array terms;
+    char start[32];
+    am_bool result;
+
+    sprintf (start, "K=%s", words[number % WORD_COUNT]);
+    term_array_init (&terms);
+    result = term_parameters_create (&parameters, CBTEXT (start));
+    if (result) {
+        parameters.number = 20;
+        result = connection_read_terms (connection, &parameters, &terms);
+        term_parameters_destroy (&parameters);
+    }
+
+    term_array_destroy (&terms);
+
+    return result;
+}
+
+static am_bool bench_read_postings
+    (
+        Connection *connection,
+        am_uint32 number
+    )
+{
+    PostingParameters parameters;
+    Array postings;
+    char term[32];
+    am_bool result;
+
+    sprintf (term, "K=%s", words[number % WORD_COUNT]);
+    posting_array_init (&postings);
+    result = posting_parameters_create (&parameters, CBTEXT (term));
+    if (result) {
+        parameters.number = 100;
+        result = connection_read_postings (connection, &parameters, &postings);
+        posting_parameters_destroy (&parameters);
+    }
+
+    posting_array_destroy (&postings);
+
+    return result;
+}
+
+static am_bool bench_read_file
+    (
+        Connection *connection,
+        am_uint32 number
+    )
+{
+    Specification spec;
+    Buffer text = BUFFER_INIT;
+    am_bool result;
+
+    (void) number;
+
+    result = spec_create (&spec, PATH_MASTER, CBTEXT ("IBIS"), CBTEXT ("brief.pft"))
+        && connection_read_text_file (connection, &spec, &text);
+    spec_destroy (&spec);
+    buffer_destroy (&text);
+
+    return result;
+}
+
+static const BenchPath paths[] =
+{
+    { "nop",      bench_nop },
+    { "read",     bench_read_record },
+    { "records",  bench_read_records },
+    { "search",   bench_search },
+    { "format",   bench_format },
+    { "terms",    bench_read_terms },
+    { "postings", bench_read_postings },
+    { "file",     bench_read_file }
+};
+
+/*=========================================================*/
+
+/* Синтетические записи: заглавие из слов словаря и номер. */
+static am_bool bench_fill
+    (
+        MockServer *server
+    )
+{
+    MarcRecord record;
+    char title[128];
+    am_uint32 index;
+    am_bool result = AM_TRUE;
+
+    record_init (&record);
+    for (index = 0; result && index < recordCount; ++index) {
+        sprintf
+            (
+                title,
+                "^a%s and %s, part %lu",
+                words[index % WORD_COUNT],
+                words[(index / WORD_COUNT) % WORD_COUNT],
+                (unsigned long) index + 1
+            );
+        record_clear (&record);
+        result = record_add (&record, 200, CBTEXT (title)) != NULL
+            && mock_server_add_record (server, &record) != 0;
+    }
+
+    record_destroy (&record);
+
+    return result && mock_server_add_file (server, CBTEXT ("brief.pft"), TEXT_SPAN ("v200^a"));
+}
+
+static void MAGNA_CALL bench_worker
+    (
+        void *data
+    )
+{
+    BenchTask *task = (BenchTask*) data;
+    Connection connection;
+    am_uint64 started;
+    am_uint32 index;
+
+    if (!connection_create (&connection)
+        || !connection_set_host (&connection, CBTEXT ("127.0.0.1"))
+        || !connection_set_username (&connection, CBTEXT ("librarian"))
+        || !connection_set_password (&connection, CBTEXT ("secret"))) {
+        task->failures = task->requests;
+        connection_destroy (&connection);
+        return;
+    }
+
+    connection.port = task->port;
+    if (!connection_connect (&connection)) {
+        task->failures = task->requests;
+        connection_destroy (&connection);
+        return;
+    }
+
+    for (index = 0; index < task->requests; ++index) {
+        started = magna_ticks ();
+        if (!task->path->operation (&connection, task->seed + index)) {
+            ++task->failures;
+        }
+
+        task->elapsed[index] = (am_uint32) (magna_ticks () - started);
+    }
+
+    connection_disconnect (&connection);
+    connection_destroy (&connection);
+}
+
+static int bench_compare
+    (
+        const void *one,
+        const void *two
+    )
+{
+    am_uint32 first = *(const am_uint32*) one, second = *(const am_uint32*) two;
+
+    return first < second ? -1 : first > second ? 1 : 0;
+}
+
+/* Замер одной операции. */
+static am_bool bench_run
+    (
+        const BenchPath *path,
+        am_uint16 port,
+        size_t threads,
+        am_uint32 requests
+    )
+{
+    BenchTask *tasks;
+    am_handle *handles;
+    am_uint32 *elapsed;
+    am_uint64 started, total;
+    unsigned long count, failures = 0;
+    size_t index;
+
+    count = (unsigned long) threads * requests;
+    tasks = (BenchTask*) mem_alloc (threads * sizeof (BenchTask));
+    handles = (am_handle*) mem_alloc (threads * sizeof (am_handle));
+    elapsed = (am_uint32*) mem_alloc (count * sizeof (am_uint32));
+    if (tasks == NULL || handles == NULL || elapsed == NULL) {
+        mem_free (elapsed);
+        mem_free (handles);
+        mem_free (tasks);
+        return AM_FALSE;
+    }
+
+    started = magna_ticks ();
+    for (index = 0; index < threads; ++index) {
+        tasks[index].path = path;
+        tasks[index].port = port;
+        tasks[index].requests = requests;
+        tasks[index].seed = (am_uint32) index * requests;
+        tasks[index].elapsed = elapsed + index * requests;
+        tasks[index].failures = 0;
+        handles[index] = thread_start (bench_worker, &tasks[index]);
+    }
+
+    for (index = 0; index < threads; ++index) {
+        if (handle_is_good (handles[index])) {
+            thread_wait (handles[index]);
+        }
+        else {
+            tasks[index].failures = requests;
+            mem_clear (tasks[index].elapsed, requests * sizeof (am_uint32));
+        }
+
+        failures += tasks[index].failures;
+    }
+
+    total = magna_ticks () - started;
+    qsort (elapsed, count, sizeof (am_uint32), bench_compare);
+    printf
+        (
+            "%-9s %8lu %8lu %8lu %10.0f %6lu %6lu\n",
+            path->name,
+            count,
+            failures,
+            (unsigned long) total,
+            total == 0 ? 0.0 : count * 1000.0 / (double) total,
+            (unsigned long) elapsed[(count - 1) / 2],
+            (unsigned long) elapsed[(count - 1) * 99 / 100]
+        );
+    fflush (stdout);
+
+    mem_free (elapsed);
+    mem_free (handles);
+    mem_free (tasks);
+
+    return AM_TRUE;
+}
+
+static void usage (void)
+{
+    fputs
+        (
+            "Usage: mockbench [-threads N] [-requests N] [-records N]\n"
+            "       [-workers N] [-latency ms] [-bandwidth bytes/s]\n",
+            stderr
+        );
+}
+
+int main (int argc, char **argv)
+{
+    MockServer server;
+    unsigned long threads = 8;
+    unsigned long requests = 1000;
+    unsigned long workers = MOCK_WORKERS;
+    unsigned long value;
+    size_t index;
+    int arg;
+
+    if (!mock_server_create (&server)) {
+        fputs ("Out of memory\n", stderr);
+        return 1;
+    }
+
+    for (arg = 1; arg + 1 < argc; arg += 2) {
+        value = strtoul (argv[arg + 1], NULL, 10);
+        if (strcmp (argv[arg], "-threads") == 0) {
+            threads = value;
+        }
+        else if (strcmp (argv[arg], "-requests") == 0) {
+            requests = value;
+        }
+        else if (strcmp (argv[arg], "-records") == 0) {
+            recordCount = (am_uint32) value;
+        }
+        else if (strcmp (argv[arg], "-workers") == 0) {
+            workers = value;
+        }
+        else if (strcmp (argv[arg], "-latency") == 0) {
+            server.latency = (am_uint32) value;
+        }
+        else if (strcmp (argv[arg], "-bandwidth") == 0) {
+            server.bandwidth = (am_uint32) value;
+        }
+        else {
+            break;
+        }
+    }
+
+    if (arg != argc || threads == 0 || requests == 0
+        || recordCount == 0 || workers == 0) {
+        usage ();
+        mock_server_destroy (&server);
+        return 1;
+    }
+
+#ifdef MAGNA_UNIX
+
+    /* Клиент может закрыть соединение, не дождавшись ответа */
+    signal (SIGPIPE, SIG_IGN);
+
+#endif
+
+    if (!bench_fill (&server)
+        || !mock_server_start (&server, 0, workers)) {
+        fputs ("Can't start mock server\n", stderr);
+        mock_server_destroy (&server);
+        return 1;
+    }
+
+    printf
+        (
+            "%lu threads x %lu requests, %lu records, %lu server threads\n",
+            threads,
+            requests,
+            (unsigned long) recordCount,
+            workers
+        );
+    printf ("%-9s %8s %8s %8s %10s %6s %6s\n", "path", "requests", "failures", "ms", "req/s", "p50", "p99");
+    for (index = 0; index < sizeof (paths) / sizeof (paths[0]); ++index) {
+        if (!bench_run (&paths[index], mock_server_port (&server), threads, (am_uint32) requests)) {
+            fputs ("Out of memory\n", stderr);
+            break;
+        }
+    }
+
+    mock_server_destroy (&server);
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAGNA_UNIX
+#include <signal.h>
+#endif
+
+/*=========================================================*/
+
+/*
+ * Имитация сервера ИРБИС64 для тестов и замеров.
+ *
+ * Записи загружаются из текстового файла ("метка#значение",
+ * записи разделяются строкой "*****"), текстовые файлы --
+ * с диска под своими именами. Задержка, ограничение
+ * пропускной способности, ошибки и обрывы соединения
+ * задаются ключами командной строки.
+ *
+ * mocksrv records.txt [-port N] [-workers N] [-latency мс]
+ *     [-bandwidth байт/с] [-error N] [-code C] [-drop N]
+ *     [-terms N] [-file путь]
+ */
+
+static void usage (void)
+{
+    fputs
+        (
+            "Usage: mocksrv <records file> [-port N] [-workers N]\n"
+            "       [-latency ms] [-bandwidth bytes/s] [-error N]\n"
+            "       [-code C] [-drop N] [-terms N] [-file path]...\n",
+            stderr
+        );
+}
+
+/* Добавление текстового файла под его собственным именем (без пути). */
+static am_bool add_file
+    (
+        MockServer *server,
+        const char *path
+    )
+{
+    Buffer content = BUFFER_INIT;
+    const char *name, *slash;
+    am_bool result;
+
+    name = path;
+    for (slash = path; *slash != '\0'; ++slash) {
+        if (*slash == '/' || *slash == '\\') {
+            name = slash + 1;
+        }
+    }
+
+    result = file_read_all (path, &content)
+        && mock_server_add_file
+            (
+                server,
+                (const am_byte*) name,
+                buffer_to_span (&content)
+            );
+    buffer_destroy (&content);
+
+    return result;
+}
+
+int main (int argc, char **argv)
+{
+    MockServer server;
+    unsigned long port = 6666;
+    unsigned long workers = MOCK_WORKERS;
+    int index;
+
+    if (argc < 2) {
+        usage ();
+        return 1;
+    }
+
+    if (!mock_server_create (&server)) {
+        fputs ("Out of memory\n", stderr);
+        return 1;
+    }
+
+    if (!mock_server_load (&server, argv[1])) {
+        fprintf (stderr, "Can't load records from %s\n", argv[1]);
+        mock_server_destroy (&server);
+        return 1;
+    }
+
+    for (index = 2; index + 1 < argc; index += 2) {
+        if (strcmp (argv[index], "-port") == 0) {
+            port = strtoul (argv[index + 1], NULL, 10);
+        }
+        else if (strcmp (argv[index], "-workers") == 0) {
+            workers = strtoul (argv[index + 1], NULL, 10);
+        }
+        else if (strcmp (argv[index], "-latency") == 0) {
+            server.latency = (am_uint32) strtoul (argv[index + 1], NULL, 10);
+        }
+        else if (strcmp (argv[index], "-bandwidth") == 0) {
+            server.bandwidth = (am_uint32) strtoul (argv[index + 1], NULL, 10);
+        }
+        else if (strcmp (argv[index], "-error") == 0) {
+            server.errorEvery = (am_uint32) strtoul (argv[index + 1], NULL, 10);
+        }
+        else if (strcmp (argv[index], "-code") == 0) {
+            server.errorCode = (am_int32) strtol (argv[index + 1], NULL, 10);
+        }
+        else if (strcmp (argv[index], "-drop") == 0) {
+            server.dropEvery = (am_uint32) strtoul (argv[index + 1], NULL, 10);
+        }
+        else if (strcmp (argv[index], "-terms") == 0) {
+            server.termLimit = (am_uint32) strtoul (argv[index + 1], NULL, 10);
+        }
+        else if (strcmp (argv[index], "-file") == 0) {
+            if (!add_file (&server, argv[index + 1])) {
+                fprintf (stderr, "Can't read %s\n", argv[index + 1]);
+                mock_server_destroy (&server);
+                return 1;
+            }
+        }
+        else {
+            break;
+        }
+    }
+
+    if (index != argc || workers == 0) {
+        usage ();
+        mock_server_destroy (&server);
+        return 1;
+    }
+
+#ifdef MAGNA_UNIX
+
+    /* Клиент может закрыть соединение, не дождавшись ответа */
+    signal (SIGPIPE, SIG_IGN);
+
+#endif
+
+    if (!mock_server_start (&server, (am_uint16) port, workers)) {
+        fprintf (stderr, "Can't listen on port %lu\n", port);
+        mock_server_destroy (&server);
+        return 1;
+    }
+
+    printf
+        (
+            "Listening on port %u, %lu records\n",
+            (unsigned) mock_server_port (&server),
+            (unsigned long) server.records.len
+        );
+    fflush (stdout);
+
+    /* Сервер работает, пока процесс не будет снят */
+    for (;;) {
+        magna_sleep (1000);
+    }
+}
@@ -933,6 +933,50 @@ MAGNA_API am_bool MAGNA_CALL map_walk    (const Map *map, MapWalker walker, void
 
 /*=========================================================*/
 
+/* Кэш с вытеснением давно не использованных элементов (LRU) */
+
+typedef struct MagnaLruEntry LruEntry;
+
+struct MagnaLruEntry
+{
+    LruEntry *newer;     /* Более свежий элемент. */
+    LruEntry *older;     /* Более старый элемент. */
+    LruEntry *chain;     /* Следующий элемент в корзине. */
+    void *value;         /* Значение. */
+    size_t hash;         /* Хэш ключа. */
+    size_t size;         /* Учетный размер элемента. */
+    am_uint64 expires;   /* Момент устаревания (0 = никогда). */
+    size_t keyLength;    /* Длина ключа. */
+    am_byte key [1];     /* Ключ (продолжается за пределы структуры). */
+};
+
+typedef struct
+{
+    LruEntry **buckets;  /* Хэш-таблица. */
+    LruEntry *newest;    /* Самый свежий элемент. */
+    LruEntry *oldest;    /* Самый старый элемент. */
+    Liberator liberator; /* Освободитель значений (опционально). */
+    size_t bucketCount;  /* Количество корзин. */
+    size_t count;        /* Количество элементов. */
+    size_t size;         /* Суммарный учетный размер элементов. */
+    size_t capacity;     /* Предельный суммарный размер. */
+    am_uint32 ttl;       /* Время жизни элемента в мс (0 = бессрочно). */
+    am_uint64 hits;      /* Количество попаданий. */
+    am_uint64 misses;    /* Количество промахов. */
+    am_uint64 evictions; /* Количество вытесненных элементов. */
+
+} LruCache;
+
+MAGNA_API void    MAGNA_CALL lru_clear   (LruCache *cache);
+MAGNA_API am_bool MAGNA_CALL lru_create  (LruCache *cache, size_t capacity, size_t bucketCount, Liberator liberator);
+MAGNA_API void    MAGNA_CALL lru_destroy (LruCache *cache);
+MAGNA_API void*   MAGNA_CALL lru_get     (LruCache *cache, Span key);
+MAGNA_API void*   MAGNA_CALL lru_peek    (LruCache *cache, Span key);
+MAGNA_API am_bool MAGNA_CALL lru_put     (LruCache *cache, Span key, void *value, size_t size);
+MAGNA_API am_bool MAGNA_CALL lru_remove  (LruCache *cache, Span key);
+
+/*=========================================================*/
+
 /* Буфер - замена строки */
 
 struct MagnaBuffer
@@ -978,6 +1022,7 @@ extern MAGNA_API              am_bool        MAGNA_CALL buffer_putc
 extern MAGNA_API              am_bool        MAGNA_CALL buffer_puts                      (Buffer *buffer, const am_byte *str);
 extern MAGNA_API              void           MAGNA_CALL buffer_remove_at                 (Buffer *buffer, size_t index, size_t size);
 extern MAGNA_API              am_bool        MAGNA_CALL buffer_replace_text              (Buffer *buffer, const am_byte *from, const am_byte *to);
+extern MAGNA_API              am_bool        MAGNA_CALL buffer_reserve                   (Buffer *buffer, size_t newSize);
 extern MAGNA_API MAGNA_INLINE size_t         MAGNA_CALL buffer_size                      (const Buffer *buffer);
 extern MAGNA_API              void           MAGNA_CALL buffer_static                    (Buffer *buffer, const am_byte *data, size_t length);
 extern MAGNA_API              Buffer*        MAGNA_CALL buffer_swap                      (Buffer *first, Buffer *second);
@@ -1399,13 +1444,52 @@ MAGNA_API am_bool MAGNA_CALL format_generic (void *output, OutputFunction handle
 
 /* Работа с сетью */
 
-MAGNA_API am_int32   MAGNA_CALL tcp4_connect            (const am_byte *hostname, am_uint16 port);
-MAGNA_API am_bool    MAGNA_CALL tcp4_disconnect         (am_int32 handle);
-MAGNA_API am_bool               tcp4_initialize         (void);
-MAGNA_API ssize_t    MAGNA_CALL tcp4_receive_all        (am_int32 handle, Buffer *buffer);
-MAGNA_API ssize_t    MAGNA_CALL tcp4_receive_with_limit (am_int32 handle, Buffer *buffer, ssize_t limit);
-MAGNA_API ssize_t    MAGNA_CALL tcp4_send               (am_int32 handle, const am_byte *data, ssize_t dataLength);
-MAGNA_API am_bool    MAGNA_CALL tcp4_send_buffer        (am_int32 handle, const Buffer *buffer);
+/* Адрес узла в сети TCP/IP v4 */
+typedef struct
+{
+    am_uint32 address; /* IPv4-адрес в сетевом порядке байтов. */
+    am_uint16 port;    /* Номер порта в порядке байтов хоста. */
+
+} Tcp4Address;
+
+/* Элемент набора сокетов, опрашиваемых `tcp4_poll` */
+typedef struct
+{
+    am_int32 handle; /* Дескриптор сокета. */
+    am_int16 events; /* Ожидаемые события: TCP4_READ, TCP4_WRITE. */
+    am_int16 ready;  /* Наступившие события (заполняется `tcp4_poll`). */
+
+} Tcp4Poll;
+
+#define TCP4_READ  1 /* Можно читать (или соединение закрыто) */
+#define TCP4_WRITE 2 /* Можно писать (или соединение установлено) */
+#define TCP4_ERROR 4 /* Ошибка на сокете */
+
+/* Минимальный размер блока при чтении из сокета */
+#define TCP4_RECEIVE_BLOCK 65536
+
+MAGNA_API am_int32   MAGNA_CALL tcp4_accept              (am_int32 handle);
+MAGNA_API am_int32   MAGNA_CALL tcp4_connect             (const am_byte *hostname, am_uint16 port);
+MAGNA_API am_int32   MAGNA_CALL tcp4_connect_address     (const Tcp4Address *address);
+MAGNA_API am_int32   MAGNA_CALL tcp4_connect_error       (am_int32 handle);
+MAGNA_API am_int32   MAGNA_CALL tcp4_connect_fast        (const Tcp4Address *address);
+MAGNA_API am_int32   MAGNA_CALL tcp4_connect_nonblocking (const Tcp4Address *address, am_bool *inProgress);
+MAGNA_API am_int32   MAGNA_CALL tcp4_connect_timeout     (const Tcp4Address *address, am_int32 timeout);
+MAGNA_API am_bool    MAGNA_CALL tcp4_disconnect          (am_int32 handle);
+MAGNA_API am_bool               tcp4_initialize          (void);
+MAGNA_API am_int32   MAGNA_CALL tcp4_listen              (const Tcp4Address *address, int backlog);
+MAGNA_API am_uint16  MAGNA_CALL tcp4_local_port          (am_int32 handle);
+MAGNA_API int        MAGNA_CALL tcp4_poll                (Tcp4Poll *items, size_t count, am_int32 timeout);
+MAGNA_API ssize_t    MAGNA_CALL tcp4_receive_all         (am_int32 handle, Buffer *buffer);
+MAGNA_API ssize_t    MAGNA_CALL tcp4_receive_block       (am_int32 handle, Buffer *buffer, size_t block);
+MAGNA_API ssize_t    MAGNA_CALL tcp4_receive_with_limit  (am_int32 handle, Buffer *buffer, ssize_t limit);
+MAGNA_API am_bool    MAGNA_CALL tcp4_resolve             (const am_byte *hostname, am_uint16 port, Tcp4Address *address);
+MAGNA_API ssize_t    MAGNA_CALL tcp4_send                (am_int32 handle, const am_byte *data, ssize_t dataLength);
+MAGNA_API am_bool    MAGNA_CALL tcp4_send_buffer         (am_int32 handle, const Buffer *buffer);
+MAGNA_API am_bool    MAGNA_CALL tcp4_send_spans          (am_int32 handle, const Span *spans, size_t count);
+MAGNA_API am_bool    MAGNA_CALL tcp4_set_nonblocking     (am_int32 handle, am_bool nonblocking);
+MAGNA_API am_bool    MAGNA_CALL tcp4_set_send_timeout    (am_int32 handle, am_uint32 timeout);
+MAGNA_API am_bool               tcp4_would_block         (void);
 
 /*=========================================================*/
 
@@ -1442,8 +1526,46 @@ MAGNA_API void* MAGNA_CALL retry_action (RetryManager *manager, Action action, v
 
 /* Работа с потоками */
 
+typedef void (MAGNA_CALL *ThreadRoutine) (void *data);
+
 MAGNA_API am_handle MAGNA_CALL thread_create (void *start);
 MAGNA_API am_bool   MAGNA_CALL thread_join   (am_handle handle, am_int32 timeout);
+MAGNA_API am_handle MAGNA_CALL thread_start  (ThreadRoutine routine, void *data);
+MAGNA_API am_bool   MAGNA_CALL thread_wait   (am_handle handle);
+
+/* Мьютекс */
+
+typedef struct
+{
+    void *impl;
+
+} Mutex;
+
+MAGNA_API am_bool MAGNA_CALL mutex_init    (Mutex *mutex);
+MAGNA_API void    MAGNA_CALL mutex_destroy (Mutex *mutex);
+MAGNA_API void    MAGNA_CALL mutex_lock    (Mutex *mutex);
+MAGNA_API void    MAGNA_CALL mutex_unlock  (Mutex *mutex);
+
+/* Условная переменная */
+
+typedef struct
+{
+    void *impl;
+
+} Condition;
+
+MAGNA_API am_bool MAGNA_CALL condition_init      (Condition *condition);
+MAGNA_API void    MAGNA_CALL condition_destroy   (Condition *condition);
+MAGNA_API void    MAGNA_CALL condition_wait      (Condition *condition, Mutex *mutex);
+MAGNA_API am_bool MAGNA_CALL condition_wait_for  (Condition *condition, Mutex *mutex, am_int32 timeout);
+MAGNA_API void    MAGNA_CALL condition_signal    (Condition *condition);
+MAGNA_API void    MAGNA_CALL condition_broadcast (Condition *condition);
+
+/* Атомарные операции */
+
+MAGNA_API am_int32 MAGNA_CALL atomic_add_int32       (volatile am_int32 *value, am_int32 delta);
+MAGNA_API am_int32 MAGNA_CALL atomic_increment_int32 (volatile am_int32 *value);
+MAGNA_API am_int32 MAGNA_CALL atomic_decrement_int32 (volatile am_int32 *value);
 
 /*=========================================================*/
 
@@ -1451,6 +1573,7 @@ MAGNA_API am_bool   MAGNA_CALL thread_join   (am_handle handle, am_int32 timeout
 
 MAGNA_API void beep (void);
 MAGNA_API void MAGNA_CALL magna_sleep (unsigned interval);
+MAGNA_API am_uint64 magna_ticks (void);
 
 #ifdef MAGNA_WINDOWS
 
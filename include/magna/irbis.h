@@ -187,6 +187,25 @@
 #define SHORT_DELIMITER "\x1E"
 #define ALT_DELIMITER   "\x1F"
 
+/* Формат, выдающий запись целиком (для пакетного чтения) */
+
+#define ALL_FORMAT "&uf('+0')"
+
+/* Количество записей, запрашиваемых за одно обращение к серверу */
+
+#define READ_RECORDS_BATCH 100
+
+/* Время жизни разрешенного адреса сервера по умолчанию (мс) */
+
+#define ADDRESS_TTL (5ul * 60ul * 1000ul)
+
+/* Наибольшая емкость буфера, сохраняемого подключением
+   для повторного использования (в байтах). Прием ответа
+   сразу резервирует TCP4_RECEIVE_BLOCK, так что буфер
+   даже короткого ответа занимает 128 Кб */
+
+#define SCRATCH_LIMIT (4ul * TCP4_RECEIVE_BLOCK)
+
 /* Разделитель строк в MS-DOS */
 
 #define MSDOS_DELIMITER "\r\n"
@@ -212,7 +231,8 @@ typedef struct IrbisResponse Response;
 
 /* Работа с ошибками */
 
-MAGNA_API const char* MAGNA_CALL irbis_describe_error (am_int32 code);
+MAGNA_API const char* MAGNA_CALL irbis_describe_error   (am_int32 code);
+MAGNA_API am_bool     MAGNA_CALL irbis_is_network_error (am_int32 code);
 
 /*=========================================================*/
 
@@ -288,20 +308,22 @@ typedef struct
 
 } MarcRecord;
 
-MAGNA_API MarcField*  MAGNA_CALL record_add          (MarcRecord *record, am_uint32 tag, const am_byte *value);
-MAGNA_API void        MAGNA_CALL record_clear        (MarcRecord *record);
-MAGNA_API MarcRecord* MAGNA_CALL record_clone        (MarcRecord *target, const MarcRecord *source);
-MAGNA_API void        MAGNA_CALL record_destroy      (MarcRecord *record);
-MAGNA_API am_bool     MAGNA_CALL record_decode_lines (MarcRecord *record, Vector *lines);
-MAGNA_API am_bool     MAGNA_CALL record_encode       (const MarcRecord *record, const char *delimiter, Buffer *buffer);
-MAGNA_API Span        MAGNA_CALL record_fm           (const MarcRecord *record, am_uint32 tag, am_byte code);
-MAGNA_API am_bool     MAGNA_CALL record_fma          (const MarcRecord *record, Vector *array, am_uint32 tag, am_byte code);
-MAGNA_API MarcField*  MAGNA_CALL record_get          (const MarcRecord *record, size_t index);
-MAGNA_API MarcField*  MAGNA_CALL record_get_field    (const MarcRecord *record, am_uint32 tag, size_t occurrence);
-MAGNA_API void        MAGNA_CALL record_init         (MarcRecord *record);
-MAGNA_API am_bool     MAGNA_CALL record_parse_single (MarcRecord *record, Response *response);
-MAGNA_API am_bool     MAGNA_CALL record_set_field    (MarcRecord *record, am_uint32 tag, Span value);
-MAGNA_API void        MAGNA_CALL record_to_console   (const MarcRecord *record);
+MAGNA_API MarcField*  MAGNA_CALL record_add              (MarcRecord *record, am_uint32 tag, const am_byte *value);
+MAGNA_API void        MAGNA_CALL record_clear            (MarcRecord *record);
+MAGNA_API MarcRecord* MAGNA_CALL record_clone            (MarcRecord *target, const MarcRecord *source);
+MAGNA_API void        MAGNA_CALL record_destroy          (MarcRecord *record);
+MAGNA_API am_bool     MAGNA_CALL record_decode_lines     (MarcRecord *record, Vector *lines);
+MAGNA_API am_bool     MAGNA_CALL record_decode_text      (MarcRecord *record, Span text);
+MAGNA_API am_bool     MAGNA_CALL record_encode           (const MarcRecord *record, const char *delimiter, Buffer *buffer);
+MAGNA_API Span        MAGNA_CALL record_fm               (const MarcRecord *record, am_uint32 tag, am_byte code);
+MAGNA_API am_bool     MAGNA_CALL record_fma              (const MarcRecord *record, Vector *array, am_uint32 tag, am_byte code);
+MAGNA_API MarcField*  MAGNA_CALL record_get              (const MarcRecord *record, size_t index);
+MAGNA_API MarcField*  MAGNA_CALL record_get_field        (const MarcRecord *record, am_uint32 tag, size_t occurrence);
+MAGNA_API void        MAGNA_CALL record_init             (MarcRecord *record);
+MAGNA_API am_bool     MAGNA_CALL record_parse_all_format (MarcRecord *record, Span line);
+MAGNA_API am_bool     MAGNA_CALL record_parse_single     (MarcRecord *record, Response *response);
+MAGNA_API am_bool     MAGNA_CALL record_set_field        (MarcRecord *record, am_uint32 tag, Span value);
+MAGNA_API void        MAGNA_CALL record_to_console       (const MarcRecord *record);
 
 /*=========================================================*/
 
@@ -382,6 +404,39 @@ MAGNA_API am_bool MAGNA_CALL spec_parse     (Specification *spec, const Buffer *
 MAGNA_API am_bool MAGNA_CALL spec_to_string (const Specification *spec, Buffer *buffer);
 MAGNA_API am_bool MAGNA_CALL spec_verify    (const Specification *spec);
 
+/* Кэш текстовых файлов сервера */
+
+typedef struct
+{
+    LruCache cache; /* Содержимое файлов, счетчики попаданий и промахов. */
+    Mutex mutex;    /* Защищает кэш. */
+
+} TextCache;
+
+MAGNA_API void    MAGNA_CALL text_cache_clear      (TextCache *cache);
+MAGNA_API am_bool MAGNA_CALL text_cache_create     (TextCache *cache, size_t capacity, am_uint32 ttl);
+MAGNA_API void    MAGNA_CALL text_cache_destroy    (TextCache *cache);
+MAGNA_API am_bool MAGNA_CALL text_cache_get        (TextCache *cache, const Specification *specification, Buffer *output);
+MAGNA_API void    MAGNA_CALL text_cache_invalidate (TextCache *cache, const Specification *specification);
+MAGNA_API am_bool MAGNA_CALL text_cache_put        (TextCache *cache, const Specification *specification, Span content);
+
+/* Кэш записей */
+
+typedef struct
+{
+    LruCache cache; /* Копии записей, счетчики попаданий, промахов и занятой памяти. */
+    Mutex mutex;    /* Защищает кэш. */
+
+} RecordCache;
+
+MAGNA_API void    MAGNA_CALL record_cache_clear      (RecordCache *cache);
+MAGNA_API am_bool MAGNA_CALL record_cache_create     (RecordCache *cache, size_t capacity);
+MAGNA_API void    MAGNA_CALL record_cache_destroy    (RecordCache *cache);
+MAGNA_API am_bool MAGNA_CALL record_cache_get        (RecordCache *cache, const Buffer *database, am_mfn mfn, MarcRecord *record);
+MAGNA_API void    MAGNA_CALL record_cache_invalidate (RecordCache *cache, const Buffer *database, am_mfn mfn);
+MAGNA_API am_bool MAGNA_CALL record_cache_put        (RecordCache *cache, const Buffer *database, const MarcRecord *record);
+MAGNA_API am_bool MAGNA_CALL record_cache_validate   (RecordCache *cache, const Buffer *database, am_mfn mfn, am_uint32 version);
+
 /*=========================================================*/
 
 /* Определение таблицы для метода `connection_print_table` */
@@ -409,15 +464,31 @@ MAGNA_API void    MAGNA_CALL table_definition_init    (TableDefinition *table);
 
 /* Клиентский запрос */
 
+/* Фрагменты короче этого копируются в буфер запроса */
+
+#define QUERY_COPY_LIMIT 256u
+
+/* Фрагмент запроса, передаваемый без копирования */
+typedef struct
+{
+    Span data;     /* Данные (не владеет). */
+    size_t offset; /* Позиция в буфере запроса, перед которой следуют данные. */
+
+} QueryPart;
+
 struct IrbisQuery
 {
-    Buffer buffer; /* Буфер для накопления данных запроса. */
+    Buffer buffer;          /* Буфер для накопления данных запроса. */
+    Array parts;            /* Фрагменты, передаваемые без копирования (QueryPart). */
+    Connection *connection; /* Подключение, которому возвращается буфер (не владеет). */
 };
 
 MAGNA_API am_bool MAGNA_CALL query_add_ansi          (Query *query, const am_byte *text);
 MAGNA_API am_bool MAGNA_CALL query_add_ansi_buffer   (Query *query, const Buffer *text);
 MAGNA_API am_bool MAGNA_CALL query_add_format        (Query *query, const am_byte *text);
 MAGNA_API am_bool MAGNA_CALL query_add_int32         (Query *query, am_int32 value);
+MAGNA_API am_bool MAGNA_CALL query_add_record        (Query *query, const MarcRecord *record);
+MAGNA_API am_bool MAGNA_CALL query_add_span          (Query *query, Span data);
 MAGNA_API am_bool MAGNA_CALL query_add_specification (Query *query, const Specification *specification);
 MAGNA_API am_bool MAGNA_CALL query_add_uint32        (Query *query, am_uint32 value);
 MAGNA_API am_bool MAGNA_CALL query_add_utf           (Query *query, const am_byte *text);
@@ -425,7 +496,14 @@ MAGNA_API am_bool MAGNA_CALL query_add_utf_buffer    (Query *query, const Buffer
 MAGNA_API am_bool MAGNA_CALL query_create            (Query *query, Connection *connection, const am_byte *command);
 MAGNA_API void    MAGNA_CALL query_destroy           (Query *query);
 MAGNA_API am_bool MAGNA_CALL query_encode            (const Query *query, Buffer *prefix);
+MAGNA_API Span    MAGNA_CALL query_get_line          (const Query *query, size_t number);
+MAGNA_API void    MAGNA_CALL query_init              (Query *query);
+MAGNA_API am_bool MAGNA_CALL query_is_read_only      (const Query *query);
+MAGNA_API size_t  MAGNA_CALL query_length            (const Query *query);
 MAGNA_API am_bool MAGNA_CALL query_new_line          (Query *query);
+MAGNA_API am_int32 MAGNA_CALL query_next_id          (Connection *connection);
+MAGNA_API am_bool MAGNA_CALL query_rebind            (const Query *query, Connection *connection, Query *target);
+MAGNA_API am_bool MAGNA_CALL query_to_buffer         (const Query *query, Buffer *output);
 
 /*=========================================================*/
 
@@ -442,18 +520,28 @@ struct IrbisResponse
     Span serverVersion;      /* Интервал автоматического подтверждения в минутах. */
     Connection *connection;  /* Указатель на подключение */
     Navigator navigator; /* Навигатор для считывания строк */
+    size_t pinned;           /* Длина заголовка, не подлежащего вытеснению (потоковый режим). */
+    am_int32 socket;         /* Сокет, из которого подкачиваются данные (потоковый режим). */
+    am_bool streaming;       /* Ответ принимается в потоковом режиме. */
+    am_bool broken;          /* Прием ответа прерван из-за сбоя сети. */
+    am_uint64 deadline;      /* Срок приема ответа (0 = не ограничен). */
 
 };
 
 MAGNA_API am_bool             response_check                 (Response *response, ...);
 MAGNA_API void     MAGNA_CALL response_destroy               (Response *response);
-MAGNA_API am_bool  MAGNA_CALL response_eot                   (const Response *response);
+MAGNA_API am_bool  MAGNA_CALL response_eot                   (Response *response);
 MAGNA_API Span     MAGNA_CALL response_get_line              (Response *response);
 MAGNA_API am_int32 MAGNA_CALL response_get_return_code       (Response *response);
 MAGNA_API void     MAGNA_CALL response_init                  (Response *response);
+MAGNA_API void     MAGNA_CALL response_parse_answer          (Response *response);
+MAGNA_API am_bool  MAGNA_CALL response_parse_header          (Response *response);
+MAGNA_API am_bool  MAGNA_CALL response_presize               (Response *response);
 MAGNA_API Span     MAGNA_CALL response_read_ansi             (Response *response);
 MAGNA_API am_int32 MAGNA_CALL response_read_int32            (Response *response);
 MAGNA_API Span     MAGNA_CALL response_read_utf              (Response *response);
+MAGNA_API am_bool  MAGNA_CALL response_receive               (Response *response, am_int32 handle);
+MAGNA_API am_bool  MAGNA_CALL response_stream                (Response *response, am_int32 handle);
 MAGNA_API am_bool  MAGNA_CALL response_remaining_ansi_lines  (Response *response, SpanArray *array);
 MAGNA_API Span     MAGNA_CALL response_remaining_ansi_text   (Response *response);
 MAGNA_API am_bool  MAGNA_CALL response_remaining_utf_lines   (Response *response, SpanArray *array);
@@ -502,6 +590,21 @@ MAGNA_API am_bool MAGNA_CALL version_to_string      (const ServerVersion *versio
 
 /*=========================================================*/
 
+/* Статистика работы сервера */
+
+typedef struct
+{
+    am_int32 totalCommandCount; /* Общее количество выполненных команд. */
+    am_int32 clientCount;       /* Количество подключенных клиентов. */
+    am_int32 linesPerClient;    /* Количество строк с информацией об одном клиенте. */
+
+} ServerStat;
+
+MAGNA_API void    MAGNA_CALL server_stat_init           (ServerStat *stat);
+MAGNA_API am_bool MAGNA_CALL server_stat_parse_response (ServerStat *stat, Response *response);
+
+/*=========================================================*/
+
 /* Меню */
 
 /* Пара строк в MNU-файле. */
@@ -590,6 +693,8 @@ typedef struct
 
 } Term;
 
+typedef am_bool (MAGNA_CALL *TermHandler) (const Term *term, void *data);
+
 MAGNA_API void    MAGNA_CALL term_array_destroy    (Array *terms);
 MAGNA_API void    MAGNA_CALL term_array_init       (Array *terms);
 MAGNA_API void    MAGNA_CALL term_array_to_console (const Array *terms, const am_byte *separator);
@@ -599,6 +704,7 @@ MAGNA_API void    MAGNA_CALL term_init             (Term *term);
 MAGNA_API void    MAGNA_CALL term_init_array       (Array *terms);
 MAGNA_API am_bool MAGNA_CALL term_parse_line       (Term *term, Span line);
 MAGNA_API am_bool MAGNA_CALL term_parse_response   (Array *terms, Response *response);
+MAGNA_API am_bool MAGNA_CALL term_parse_stream     (Response *response, TermHandler handler, void *data);
 MAGNA_API void    MAGNA_CALL term_to_console       (const Term *term);
 MAGNA_API am_bool MAGNA_CALL term_to_string        (const Term *term, Buffer *output);
 
@@ -640,6 +746,33 @@ MAGNA_API am_bool MAGNA_CALL posting_parse_response   (Array *postings, Response
 MAGNA_API void    MAGNA_CALL posting_to_console       (const Posting *posting);
 MAGNA_API am_bool MAGNA_CALL posting_to_string        (const Posting *posting, Buffer *output);
 
+/* Компактный список постингов */
+typedef struct
+{
+    Buffer data;       /* Упакованные постинги. */
+    size_t count;      /* Количество постингов. */
+    am_uint32 lastMfn; /* MFN последнего добавленного постинга. */
+    am_bool withText;  /* Хранить текст постингов? */
+
+} PostingList;
+
+/* Последовательное чтение компактного списка */
+typedef struct
+{
+    const PostingList *list; /* Читаемый список. */
+    const am_byte *current;  /* Текущая позиция в упакованных данных. */
+    size_t index;            /* Номер очередного постинга. */
+    am_uint32 mfn;           /* MFN предыдущего постинга. */
+
+} PostingReader;
+
+MAGNA_API am_bool MAGNA_CALL posting_list_append         (PostingList *list, const Posting *posting);
+MAGNA_API void    MAGNA_CALL posting_list_destroy        (PostingList *list);
+MAGNA_API void    MAGNA_CALL posting_list_init           (PostingList *list, am_bool withText);
+MAGNA_API am_bool MAGNA_CALL posting_list_parse_response (PostingList *list, Response *response);
+MAGNA_API void    MAGNA_CALL posting_reader_init         (PostingReader *reader, const PostingList *list);
+MAGNA_API am_bool MAGNA_CALL posting_reader_next         (PostingReader *reader, Posting *posting);
+
 /* Параметры для запроса постингов с сервера. */
 typedef struct
 {
@@ -723,14 +856,38 @@ typedef struct
 
 } FoundLine;
 
+typedef am_bool (MAGNA_CALL *FoundHandler) (const FoundLine *found, void *data);
+
 MAGNA_API void    MAGNA_CALL found_array_init          (Array *array);
 MAGNA_API void    MAGNA_CALL found_array_destroy       (Array *array);
 MAGNA_API am_bool MAGNA_CALL found_decode_line         (FoundLine *found, Span line);
 MAGNA_API am_bool MAGNA_CALL found_decode_response     (Array *array, Response *response);
 MAGNA_API am_bool MAGNA_CALL found_decode_response_mfn (Int32Array *array, Response *response);
+MAGNA_API am_bool MAGNA_CALL found_decode_stream       (Response *response, FoundHandler handler, void *data);
 MAGNA_API void    MAGNA_CALL found_destroy             (FoundLine *found);
 MAGNA_API void    MAGNA_CALL found_init                (FoundLine *found);
 
+/* Параметры полнотекстового поиска */
+typedef struct
+{
+    Buffer text;        /* Полнотекстовый запрос. */
+    Buffer expression;  /* Выражение для поиска по словарю (опционально). */
+    Buffer database;    /* Имя базы данных (опционально). */
+    Buffer format;      /* Формат для найденных записей (опционально). */
+    am_mfn firstRecord; /* Индекс первой из возвращаемых записей (по умолчанию 1). */
+    am_mfn minMfn;      /* Минимальный MFN (опционально). */
+    am_mfn maxMfn;      /* Максимальный MFN (опционально). */
+    am_mfn number;      /* Количество возвращаемых записей (0 = все). */
+
+} FullTextParameters;
+
+MAGNA_API am_bool  MAGNA_CALL fulltext_parameters_create  (FullTextParameters *parameters, const am_byte *text);
+MAGNA_API void     MAGNA_CALL fulltext_parameters_destroy (FullTextParameters *parameters);
+MAGNA_API am_bool  MAGNA_CALL fulltext_parameters_encode  (const FullTextParameters *parameters, const Connection *connection, Query *query);
+MAGNA_API void     MAGNA_CALL fulltext_parameters_init    (FullTextParameters *parameters);
+MAGNA_API am_bool  MAGNA_CALL fulltext_parameters_verify  (const FullTextParameters *parameters);
+MAGNA_API am_int32 MAGNA_CALL connection_search_fulltext  (Connection *connection, const FullTextParameters *parameters, FoundHandler handler, void *data);
+
 /*=========================================================*/
 
 /* Работа с FST-файлами (ТВП). */
@@ -810,6 +967,7 @@ typedef struct
     Array parameters;        /* Массив параметров. */
     am_bool actualize;       /* Актуализировать записи? */
     am_bool autoin;          /* Запускать AUTOIN.GBL? */
+    am_bool formalControl;   /* Выполнять формально-логический контроль? */
     am_mfn firstRecord;      /* Нижняя граница MFN для поиска обрабатываемых записей. */
     am_mfn maxMfn;           /* Максимальный MFN. 0 означает "все записи в базе". */
     am_mfn minMfn;           /* Минимальный MFN. 0 означает "все записи в базе". */
@@ -826,33 +984,142 @@ MAGNA_API am_bool MAGNA_CALL gbl_settings_verify     (const GblSettings *setting
 /* Результат глобальной корректировки */
 typedef struct
 {
-    /* TODO: implement */
-    int unused;
+    Int32Array failedMfns;   /* MFN записей, обработанных с ошибкой. */
+    am_uint32 processed;     /* Количество обработанных записей. */
+    am_uint32 failed;        /* Количество записей, обработанных с ошибкой. */
+    am_uint64 elapsed;       /* Время выполнения в мс. */
 
 } GblResult;
 
 MAGNA_API am_bool MAGNA_CALL gbl_result_decode  (GblResult *result, Response *response);
 MAGNA_API void    MAGNA_CALL gbl_result_destroy (GblResult *result);
 MAGNA_API void    MAGNA_CALL gbl_result_init    (GblResult *result);
+MAGNA_API am_bool MAGNA_CALL gbl_result_merge   (GblResult *target, const GblResult *source);
+
+/*=========================================================*/
+
+/* Запас заранее установленных соединений с сервером */
+
+#define SOCKET_RESERVE_MAX 16
+#define SOCKET_RESERVE_AGE 30000ul
+
+typedef struct
+{
+    Tcp4Address address;                    /* Адрес сервера. */
+    am_int32 sockets[SOCKET_RESERVE_MAX];   /* Установленные соединения. */
+    am_uint64 born[SOCKET_RESERVE_MAX];     /* Моменты установки соединений. */
+    Mutex mutex;                            /* Защищает все поля. */
+    Condition condition;                    /* Будит фоновый поток. */
+    am_handle thread;                       /* Поток, пополняющий запас. */
+    size_t count;                           /* Количество готовых соединений. */
+    size_t capacity;                        /* Желаемое количество соединений. */
+    am_uint64 taken;                        /* Выдано готовых соединений. */
+    am_uint64 missed;                       /* Запас был пуст. */
+    am_uint32 maxAge;                       /* Предельный возраст соединения в мс (0 = неограничен). */
+    am_bool fastOpen;                       /* При пустом запасе подключаться с TCP Fast Open. */
+    am_bool stop;                           /* Требование остановить фоновый поток. */
+
+} SocketReserve;
+
+MAGNA_API am_bool  MAGNA_CALL socket_reserve_create      (SocketReserve *reserve, Connection *connection, size_t capacity);
+MAGNA_API void     MAGNA_CALL socket_reserve_destroy     (SocketReserve *reserve);
+MAGNA_API void     MAGNA_CALL socket_reserve_set_address (SocketReserve *reserve, const Tcp4Address *address);
+MAGNA_API am_int32 MAGNA_CALL socket_reserve_take        (SocketReserve *reserve, am_int32 timeout);
+
+/*=========================================================*/
+
+/* Дублирование медленных запросов */
+
+#define HEDGE_SAMPLES 32
+
+typedef struct
+{
+    am_uint32 delay;                    /* Минимальная задержка дубликата в мс (0 = не дублировать). */
+    am_uint32 percentile;               /* Процентиль времени ответа, после которого посылается дубликат. */
+    am_uint32 samples[HEDGE_SAMPLES];   /* Недавние времена ответа в мс. */
+    am_uint32 count;                    /* Количество накопленных замеров. */
+    am_uint32 next;                     /* Позиция для следующего замера. */
+    am_uint32 issued;                   /* Послано дубликатов. */
+    am_uint32 won;                      /* Дубликат ответил первым. */
+
+} HedgePolicy;
+
+/*=========================================================*/
+
+/* Адаптивное ограничение одновременных команд */
+
+typedef struct
+{
+    Mutex mutex;            /* Защищает все поля. */
+    Condition condition;    /* Будит потоки, ждущие места. */
+    double limit;           /* Текущий предел (дробный, для плавного роста). */
+    double baseline;        /* Наименьшая наблюдавшаяся задержка в мс (меньше 0 = замеров нет). */
+    double latency;         /* Скользящее среднее задержки в мс. */
+    double tolerance;       /* Допустимое отношение задержки к наименьшей. По умолчанию 2. */
+    double backoff;         /* Множитель уменьшения предела. По умолчанию 0,7. */
+    am_uint64 quietUntil;   /* До этого момента предел повторно не уменьшается. */
+    am_uint32 minimum;      /* Нижняя граница предела. */
+    am_uint32 maximum;      /* Верхняя граница предела. */
+    am_uint32 inFlight;     /* Выполняющиеся команды. */
+    am_uint32 clientLimit;  /* Клиентов на сервере, при превышении которого предел уменьшается (0 = не учитывать). */
+    am_uint32 increases;    /* Количество увеличений предела. */
+    am_uint32 decreases;    /* Количество уменьшений предела. */
+
+} ConcurrencyLimiter;
+
+MAGNA_API am_bool   MAGNA_CALL irbis_is_overload    (am_int32 code);
+MAGNA_API am_uint64 MAGNA_CALL limiter_acquire      (ConcurrencyLimiter *limiter);
+MAGNA_API am_bool   MAGNA_CALL limiter_acquire_for  (ConcurrencyLimiter *limiter, am_int32 timeout, am_uint64 *started);
+MAGNA_API am_bool   MAGNA_CALL limiter_create       (ConcurrencyLimiter *limiter, am_uint32 initial, am_uint32 minimum, am_uint32 maximum);
+MAGNA_API void      MAGNA_CALL limiter_destroy      (ConcurrencyLimiter *limiter);
+MAGNA_API am_uint32 MAGNA_CALL limiter_get_limit    (ConcurrencyLimiter *limiter);
+MAGNA_API void      MAGNA_CALL limiter_observe_stat (ConcurrencyLimiter *limiter, const ServerStat *stat);
+MAGNA_API void      MAGNA_CALL limiter_overload     (ConcurrencyLimiter *limiter);
+MAGNA_API void      MAGNA_CALL limiter_release      (ConcurrencyLimiter *limiter, am_uint64 started, am_bool success);
 
 /*=========================================================*/
 
 /* Подключение к серверу */
 
+typedef struct
+{
+    volatile am_int32 queryId;     /* Следующий номер запроса, общий для всех копий. */
+    volatile am_int32 references;  /* Количество подключений, разделяющих регистрацию. */
+    Mutex mutex;                   /* Защищает разрешенный адрес. */
+    Tcp4Address address;           /* Разрешенный адрес сервера, общий для всех копий. */
+    am_uint64 addressExpires;      /* Момент устаревания адреса, 0 = адрес не разрешен. */
+
+} ConnectionSession;
+
 struct IrbisConnection
 {
-    Buffer host;          /* Имя или адрес хоста с сервером ИРБИС64. */
-    Buffer username;      /* Имя пользователя системы ИРБИС64 (логин). */
-    Buffer password;      /* Пароль пользователя системы ИРБИС64. */
-    Buffer database;      /* Имя текущей базы данных. */
-    Buffer serverVersion; /* Версия сервера (присылается при входе в систему). */
-    am_int32 clientId;    /* Идентификатор клиента -- случайное целое число. */
-    am_int32 queryId;     /* Порядковый номер запроса к серверу (нумерация с 1). */
-    am_int32 lastError;   /* Код ошибки последней выпоненной операции. */
-    am_int32 interval;    /* Рекомендуемый интервал подтверждения активности в минутах. */
-    am_bool connected;    /* Признак активного подключени (устанавливается автоматически). */
-    am_int16 port;        /* Номер порта на сервере ИРБИС64. По умолчанию 6666. */
-    am_byte workstation;  /* Тип АРМ. По умолчанию 'C'. */
+    Buffer host;              /* Имя или адрес хоста с сервером ИРБИС64. */
+    Buffer username;          /* Имя пользователя системы ИРБИС64 (логин). */
+    Buffer password;          /* Пароль пользователя системы ИРБИС64. */
+    Buffer database;          /* Имя текущей базы данных. */
+    Buffer serverVersion;     /* Версия сервера (присылается при входе в систему). */
+    am_int32 clientId;        /* Идентификатор клиента -- случайное целое число. */
+    am_int32 queryId;         /* Порядковый номер запроса к серверу (нумерация с 1). */
+    am_int32 lastError;       /* Код ошибки последней выпоненной операции. */
+    am_int32 interval;        /* Рекомендуемый интервал подтверждения активности в минутах. */
+    am_bool connected;        /* Признак активного подключени (устанавливается автоматически). */
+    am_int16 port;            /* Номер порта на сервере ИРБИС64. По умолчанию 6666. */
+    Tcp4Address address;      /* Разрешенный адрес сервера (кэшируется). */
+    am_uint64 addressExpires; /* Момент устаревания адреса, 0 = адрес не разрешен. */
+    am_uint32 addressTtl;     /* Время жизни адреса в мс (0 = бессрочно). По умолчанию 5 минут. */
+    TextCache *textCache;     /* Кэш текстовых файлов (опционально, не владеет). */
+    RecordCache *recordCache; /* Кэш записей (опционально, не владеет). */
+    SocketReserve *reserve;   /* Запас готовых соединений (опционально, не владеет). */
+    ConcurrencyLimiter *limiter; /* Ограничитель одновременных команд (опционально, не владеет). */
+    am_uint32 timeout;        /* Предельное время выполнения команды в мс (0 = не ограничено). */
+    am_uint64 deadline;       /* Общий срок для последующих команд (0 = не задан). */
+    HedgePolicy hedge;        /* Дублирование медленных запросов (по умолчанию выключено). */
+    Buffer scratchQuery;      /* Буфер запроса для повторного использования. */
+    Buffer scratchAnswer;     /* Буфер ответа для повторного использования. */
+    Buffer credentials;       /* Закодированные пароль и логин для заголовка запроса (кэш). */
+    am_uint32 scratchLimit;   /* Наибольшая емкость сохраняемого буфера (0 = не сохранять). */
+    ConnectionSession *session; /* Регистрация, разделяемая с копиями (см. `connection_clone`). */
+    am_byte workstation;      /* Тип АРМ. По умолчанию 'C'. */
 
 };
 
@@ -860,8 +1127,10 @@ MAGNA_API void     MAGNA_CALL connection_abort_on_error     (const Connection *c
 MAGNA_API am_bool  MAGNA_CALL connection_actualize_database (Connection *connection, const am_byte *database);
 MAGNA_API am_bool  MAGNA_CALL connection_actualize_record   (Connection *connection, const am_byte *database, am_mfn mfn);
 MAGNA_API am_bool  MAGNA_CALL connection_check              (Connection *connection);
+MAGNA_API am_bool  MAGNA_CALL connection_clone              (Connection *target, Connection *source);
 MAGNA_API am_bool  MAGNA_CALL connection_create             (Connection *connection);
 MAGNA_API am_bool  MAGNA_CALL connection_connect            (Connection *connection);
+MAGNA_API am_bool  MAGNA_CALL connection_copy_settings      (Connection *target, const Connection *source);
 MAGNA_API am_bool  MAGNA_CALL connection_create_database    (Connection *connection, const am_byte *database, const am_byte *description, am_bool readerAccess);
 MAGNA_API am_bool  MAGNA_CALL connection_create_dictionary  (Connection *connection, const am_byte *database);
 MAGNA_API am_bool  MAGNA_CALL connection_delete_database    (Connection *connection, const am_byte *database);
@@ -869,27 +1138,37 @@ MAGNA_API am_bool  MAGNA_CALL connection_delete_file        (Connection *connect
 MAGNA_API am_bool  MAGNA_CALL connection_delete_record      (Connection *connection, am_mfn mfn);
 MAGNA_API am_bool  MAGNA_CALL connection_disconnect         (Connection *connection);
 MAGNA_API am_bool  MAGNA_CALL connection_execute            (Connection *connection, Query *query, Response *response);
+MAGNA_API am_bool  MAGNA_CALL connection_execute_stream     (Connection *connection, Query *query, Response *response);
 MAGNA_API am_bool             connection_execute_simple     (Connection *connection, Response *response, const am_byte *command, int argCount, ...);
 MAGNA_API void     MAGNA_CALL connection_destroy            (Connection *connection);
 MAGNA_API am_bool  MAGNA_CALL connection_format_mfn         (Connection *connection, const am_byte *format, am_mfn mfn, Buffer *output);
+MAGNA_API am_uint64 MAGNA_CALL connection_get_deadline      (const Connection *connection);
 MAGNA_API am_mfn   MAGNA_CALL connection_get_max_mfn        (Connection *connection, const am_byte *database);
+MAGNA_API am_bool  MAGNA_CALL connection_get_server_stat    (Connection *connection, ServerStat *stat);
 MAGNA_API am_bool  MAGNA_CALL connection_get_server_version (Connection *connection, ServerVersion *version);
+MAGNA_API am_bool  MAGNA_CALL connection_global_correction  (Connection *connection, const GblSettings *settings, GblResult *result);
 MAGNA_API am_bool  MAGNA_CALL connection_no_operation       (Connection *connection);
 MAGNA_API am_bool  MAGNA_CALL connection_parse_string       (Connection *connection, Span connectionString);
 MAGNA_API am_bool  MAGNA_CALL connection_print_table        (Connection *connection, TableDefinition *definition, Buffer *output);
 MAGNA_API am_bool  MAGNA_CALL connection_read_postings      (Connection *connection, const PostingParameters *parameters, Array *postings);
+MAGNA_API am_bool  MAGNA_CALL connection_read_posting_list  (Connection *connection, const PostingParameters *parameters, PostingList *list);
 MAGNA_API am_bool  MAGNA_CALL connection_read_raw_record    (Connection *connection, am_mfn mfn, RawRecord *record);
 MAGNA_API am_bool  MAGNA_CALL connection_read_record        (Connection *connection, am_mfn mfn, MarcRecord *record);
 MAGNA_API am_bool  MAGNA_CALL connection_read_record_text   (Connection *connection, am_mfn mfn, Buffer *buffer);
+MAGNA_API am_bool  MAGNA_CALL connection_read_records       (Connection *connection, const Int32Array *mfns, Array *records);
+MAGNA_API am_bool  MAGNA_CALL connection_read_records_ex    (Connection *connection, const Int32Array *mfns, Array *records, size_t batchSize);
 MAGNA_API am_bool  MAGNA_CALL connection_read_terms         (Connection *connection, const TermParameters *parameters, Array *terms);
 MAGNA_API am_bool  MAGNA_CALL connection_read_text_file     (Connection *connection, const Specification *specification, Buffer *buffer);
 MAGNA_API am_bool  MAGNA_CALL connection_reload_dictionary  (Connection *connection, const am_byte *database);
 MAGNA_API am_bool  MAGNA_CALL connection_reload_master_file (Connection *connection, const am_byte *database);
+MAGNA_API am_bool  MAGNA_CALL connection_resolve            (Connection *connection, am_bool refresh);
 MAGNA_API am_bool  MAGNA_CALL connection_restart_server     (Connection *connection);
 MAGNA_API am_int32 MAGNA_CALL connection_search_count       (Connection *connection, const am_byte *expression);
 MAGNA_API am_bool  MAGNA_CALL connection_search_ex          (Connection *connection, const SearchParameters *parameters, Response *response);
 MAGNA_API am_bool  MAGNA_CALL connection_search_simple      (Connection *connection,  Int32Array *array, const am_byte *expression);
 MAGNA_API am_bool  MAGNA_CALL connection_set_database       (Connection *connection, const am_byte *database);
+MAGNA_API void     MAGNA_CALL connection_set_deadline       (Connection *connection, am_uint32 timeout);
+MAGNA_API void     MAGNA_CALL connection_set_hedging        (Connection *connection, am_uint32 delay, am_uint32 percentile);
 MAGNA_API am_bool  MAGNA_CALL connection_set_host           (Connection *connection, const am_byte *host);
 MAGNA_API am_bool  MAGNA_CALL connection_set_password       (Connection *connection, const am_byte *password);
 MAGNA_API am_bool  MAGNA_CALL connection_set_username       (Connection *connection, const am_byte *username);
@@ -901,7 +1180,8 @@ MAGNA_API am_bool  MAGNA_CALL connection_unlock_records     (Connection *connect
 MAGNA_API am_bool  MAGNA_CALL connection_update_ini_file    (Connection *connection, const Array *lines);
 MAGNA_API am_bool  MAGNA_CALL connection_update_user_list   (Connection *connection, const Array *users);
 MAGNA_API am_bool  MAGNA_CALL connection_write_raw_record   (Connection *connection, RawRecord *record, am_bool reparse);
-MAGNA_API am_bool  MAGNA_CALL connection_write_record       (Connection *connection, MarcRecord *record, am_bool reparse);
+MAGNA_API am_int32 MAGNA_CALL connection_write_record       (Connection *connection, MarcRecord *record, am_bool reparse);
+MAGNA_API am_bool  MAGNA_CALL connection_write_records      (Connection *connection, Array *records);
 MAGNA_API am_bool  MAGNA_CALL connection_write_text_file    (Connection *connection, const Specification *specification);
 
 /* Синонимы */
@@ -909,6 +1189,352 @@ MAGNA_API am_bool  MAGNA_CALL connection_write_text_file    (Connection *connect
 MAGNA_API am_bool  MAGNA_CALL irbis_connect                 (Connection *connection);
 MAGNA_API am_bool  MAGNA_CALL irbis_disconnect              (Connection *connection);
 
+/*=========================================================*/
+
+/* Пул подключений */
+
+typedef am_bool (MAGNA_CALL *PoolAction) (Connection *connection, void *data);
+
+typedef struct
+{
+    Connection settings;  /* Образец настроек для новых подключений. */
+    Vector connections;   /* Все подключения, принадлежащие пулу. */
+    Vector idle;          /* Свободные подключения. */
+    Mutex mutex;          /* Защищает все поля, кроме `settings`. */
+    Condition condition;  /* Сигнализирует о возврате подключения. */
+    size_t capacity;      /* Максимальное количество подключений. */
+    size_t created;       /* Количество зарегистрированных подключений. */
+    am_int32 lastError;   /* Код ошибки последней неудачной регистрации. */
+    am_bool closed;       /* Пул закрыт, новые подключения не выдаются. */
+
+} ConnectionPool;
+
+MAGNA_API Connection* MAGNA_CALL pool_acquire     (ConnectionPool *pool);
+MAGNA_API void        MAGNA_CALL pool_close       (ConnectionPool *pool);
+MAGNA_API am_bool     MAGNA_CALL pool_create      (ConnectionPool *pool, const Connection *settings, size_t capacity);
+MAGNA_API void        MAGNA_CALL pool_destroy     (ConnectionPool *pool);
+MAGNA_API void        MAGNA_CALL pool_release     (ConnectionPool *pool, Connection *connection);
+MAGNA_API am_bool     MAGNA_CALL pool_run         (ConnectionPool *pool, PoolAction action, void *data);
+MAGNA_API Connection* MAGNA_CALL pool_try_acquire (ConnectionPool *pool);
+
+/*=========================================================*/
+
+/* Группа серверов с распределением запросов */
+
+/* Вес нового замера в скользящем среднем времени обслуживания */
+#define GROUP_EWMA_WEIGHT 0.2
+
+typedef struct
+{
+    ConnectionPool pool;  /* Подключения к данному серверу. */
+    double latency;       /* Скользящее среднее времени выполнения команды в мс (меньше 0 = замеров нет). */
+    am_uint64 retryAfter; /* Момент, до которого сервер исключен из ротации. */
+    am_uint32 errors;     /* Количество сбоев связи подряд. */
+    am_uint32 failures;   /* Общее количество сбоев связи. */
+    am_uint32 requests;   /* Общее количество обращений. */
+    am_bool primary;      /* Основной сервер (принимает запись). */
+
+} GroupEndpoint;
+
+typedef struct
+{
+    Vector endpoints;     /* Серверы группы (GroupEndpoint*). */
+    Array loans;          /* Выданные подключения. */
+    Mutex mutex;          /* Защищает статистику серверов и выданные подключения. */
+    am_uint32 errorLimit; /* Ошибок подряд до исключения сервера из ротации. По умолчанию 3. */
+    am_uint32 quarantine; /* Время исключения из ротации в мс. По умолчанию 10 секунд. */
+
+} ConnectionGroup;
+
+MAGNA_API Connection*    MAGNA_CALL group_acquire (ConnectionGroup *group, am_bool write);
+MAGNA_API am_bool        MAGNA_CALL group_add     (ConnectionGroup *group, const Connection *settings, size_t capacity, am_bool primary);
+MAGNA_API GroupEndpoint* MAGNA_CALL group_choose  (ConnectionGroup *group, am_bool write);
+MAGNA_API am_bool        MAGNA_CALL group_create  (ConnectionGroup *group);
+MAGNA_API void           MAGNA_CALL group_destroy (ConnectionGroup *group);
+MAGNA_API am_bool        MAGNA_CALL group_execute (ConnectionGroup *group, Query *query, Response *response);
+MAGNA_API void           MAGNA_CALL group_release (ConnectionGroup *group, Connection *connection);
+MAGNA_API am_bool        MAGNA_CALL group_run     (ConnectionGroup *group, am_bool write, PoolAction action, void *data);
+
+/*=========================================================*/
+
+/* Глобальная корректировка порциями */
+
+#define GBL_JOB_MAX_THREADS 32
+
+/* Порция записей */
+typedef struct
+{
+    GblResult result;   /* Результат обработки порции. */
+    am_mfn firstMfn;    /* Первый MFN порции. */
+    am_mfn lastMfn;     /* Последний MFN порции. */
+    size_t offset;      /* Смещение порции в списке MFN задания. */
+    size_t count;       /* Количество MFN из списка (0 = порция задана диапазоном). */
+    am_int32 error;     /* Код ошибки последней попытки (0 = успех). */
+    am_bool running;    /* Порция выполняется. */
+    am_bool done;       /* Порция успешно обработана. */
+
+} GblChunk;
+
+struct IrbisGblJob;
+typedef struct IrbisGblJob GblJob;
+
+typedef void (MAGNA_CALL *GblProgress) (GblJob *job, const GblChunk *chunk, void *data);
+
+struct IrbisGblJob
+{
+    const GblSettings *settings; /* Настройки корректировки (не владеет). */
+    Int32Array mfns;             /* Отобранные MFN (пусто, если отбор задан диапазоном). */
+    Array chunks;                /* Порции (GblChunk). */
+    GblResult total;             /* Сводный результат выполненных порций. */
+    Mutex mutex;                 /* Защищает порции, счетчики и сводный результат. */
+    Mutex progressMutex;         /* Упорядочивает вызовы функции progress. */
+    ConnectionPool *pool;        /* Пул подключений текущего запуска. */
+    GblProgress progress;        /* Вызывается по завершении каждой порции (опционально). */
+    void *progressData;          /* Данные для функции progress. */
+    size_t next;                 /* Следующая порция для выдачи. */
+    size_t completed;            /* Количество выполненных порций. */
+    size_t failed;               /* Количество неудачных попыток. */
+    am_bool stop;                /* Требование прекратить выдачу порций. */
+
+};
+
+MAGNA_API am_bool MAGNA_CALL gbl_job_create    (GblJob *job, Connection *connection, const GblSettings *settings, size_t chunkSize);
+MAGNA_API void    MAGNA_CALL gbl_job_destroy   (GblJob *job);
+MAGNA_API size_t  MAGNA_CALL gbl_job_remaining (GblJob *job);
+MAGNA_API am_bool MAGNA_CALL gbl_job_run       (GblJob *job, ConnectionPool *pool, size_t parallelism);
+MAGNA_API void    MAGNA_CALL gbl_job_stop      (GblJob *job);
+
+/*=========================================================*/
+
+/* Курсор по результатам поиска */
+
+#define SEARCH_CURSOR_PAGE 1000
+
+typedef struct
+{
+    Connection worker;           /* Копия подключения для упреждающего чтения (общая регистрация). */
+    SearchParameters parameters; /* Копия параметров поиска. */
+    Array current;               /* Текущая страница (FoundLine). */
+    Array next;                  /* Следующая страница, читаемая в фоне. */
+    am_handle thread;            /* Поток упреждающего чтения. */
+    size_t position;             /* Позиция в текущей странице. */
+    am_mfn total;                /* Общее количество найденных записей. */
+    am_mfn pageSize;             /* Размер страницы. */
+    am_mfn nextFirst;            /* Номер первой записи следующей страницы. */
+    am_int32 lastError;          /* Код ошибки. */
+    am_bool pending;             /* Идет упреждающее чтение. */
+    am_bool failed;              /* Упреждающее чтение завершилось ошибкой. */
+
+} SearchCursor;
+
+MAGNA_API am_bool          MAGNA_CALL search_cursor_create     (SearchCursor *cursor, Connection *connection, const SearchParameters *parameters);
+MAGNA_API void             MAGNA_CALL search_cursor_destroy    (SearchCursor *cursor);
+MAGNA_API void             MAGNA_CALL search_cursor_enumerator (SearchCursor *cursor, Enumerator *enumerator);
+MAGNA_API const FoundLine* MAGNA_CALL search_cursor_next       (SearchCursor *cursor);
+
+/* Курсор по поисковому словарю */
+
+#define TERM_CURSOR_BATCH 1024
+
+typedef struct
+{
+    Connection worker;           /* Копия подключения для упреждающего чтения (общая регистрация). */
+    TermParameters parameters;   /* Параметры, стартовый термин меняется по ходу обхода. */
+    Array current;               /* Текущая порция (Term). */
+    Array next;                  /* Следующая порция, читаемая в фоне. */
+    am_handle thread;            /* Поток упреждающего чтения. */
+    size_t position;             /* Позиция в текущей порции. */
+    am_int32 lastError;          /* Код ошибки. */
+    am_bool skipStart;           /* Пропускать повторно выданный стартовый термин. */
+    am_bool pending;             /* Идет упреждающее чтение. */
+    am_bool failed;              /* Упреждающее чтение завершилось ошибкой. */
+
+} TermCursor;
+
+MAGNA_API am_bool     MAGNA_CALL term_cursor_create     (TermCursor *cursor, Connection *connection, const TermParameters *parameters);
+MAGNA_API void        MAGNA_CALL term_cursor_destroy    (TermCursor *cursor);
+MAGNA_API void        MAGNA_CALL term_cursor_enumerator (TermCursor *cursor, Enumerator *enumerator);
+MAGNA_API const Term* MAGNA_CALL term_cursor_next       (TermCursor *cursor);
+
+/*=========================================================*/
+
+/* Асинхронное исполнение запросов */
+
+typedef void (MAGNA_CALL *AsyncCallback) (Response *response, am_bool success, void *data);
+
+#define ASYNC_CONNECTING 1 /* Устанавливается соединение */
+#define ASYNC_SENDING    2 /* Отсылается пакет с запросом */
+#define ASYNC_RECEIVING  3 /* Принимается ответ сервера */
+
+/* Одна незавершенная операция */
+typedef struct
+{
+    Connection *connection;  /* Подключение. */
+    Response *response;      /* Ответ, подлежащий заполнению. */
+    Buffer packet;           /* Пакет целиком: заголовок и запрос. */
+    size_t sent;             /* Количество уже отосланных байт. */
+    AsyncCallback callback;  /* Функция обратного вызова. */
+    void *data;              /* Данные для функции обратного вызова. */
+    am_int32 handle;         /* Сокет. */
+    am_int32 state;          /* Стадия: ASYNC_CONNECTING и т. д. */
+    am_bool presized;        /* Память под ответ уже зарезервирована. */
+    am_uint64 deadline;      /* Срок завершения (0 = не ограничен). */
+
+} AsyncOperation;
+
+typedef struct
+{
+    Vector operations;  /* Незавершенные операции. */
+    size_t completed;   /* Общее количество завершенных операций. */
+
+} AsyncEngine;
+
+MAGNA_API am_bool MAGNA_CALL async_engine_create      (AsyncEngine *engine);
+MAGNA_API void    MAGNA_CALL async_engine_destroy     (AsyncEngine *engine);
+MAGNA_API size_t  MAGNA_CALL async_engine_pending     (const AsyncEngine *engine);
+MAGNA_API am_bool MAGNA_CALL async_engine_run         (AsyncEngine *engine);
+MAGNA_API int     MAGNA_CALL async_engine_run_once    (AsyncEngine *engine, am_int32 timeout);
+MAGNA_API am_bool MAGNA_CALL connection_execute_async (Connection *connection, AsyncEngine *engine, const Query *query, Response *response, AsyncCallback callback, void *data);
+
+/*=========================================================*/
+
+/* Отложенные результаты команд */
+
+#define FUTURE_MAX_THREADS 32
+
+#define FUTURE_IDLE    0 /* Не поставлен в очередь */
+#define FUTURE_QUEUED  1 /* Ожидает свободного потока */
+#define FUTURE_RUNNING 2 /* Команда выполняется */
+#define FUTURE_READY   3 /* Результат получен, вызывается продолжение */
+#define FUTURE_DONE    4 /* Результат получен окончательно */
+
+struct IrbisFuture;
+typedef struct IrbisFuture Future;
+
+struct IrbisFutureExecutor;
+typedef struct IrbisFutureExecutor FutureExecutor;
+
+typedef am_bool (MAGNA_CALL *FutureAction)   (Connection *connection, Future *future);
+typedef void    (MAGNA_CALL *FutureCallback) (Future *future, void *data);
+
+struct IrbisFuture
+{
+    FutureExecutor *executor;  /* Исполнитель, которому передана команда. */
+    FutureAction action;       /* Выполняемая команда. */
+    FutureCallback callback;   /* Продолжение (опционально). */
+    void *callbackData;        /* Данные для продолжения. */
+    Future *next;              /* Следующая команда в очереди. */
+    Buffer argument;           /* Копия строкового аргумента команды. */
+    const void *input;         /* Прочие входные данные (не владеет). */
+    void *output;              /* Куда поместить результат (не владеет). */
+    am_int32 value;            /* Числовой результат команды. */
+    am_int32 error;            /* Код ошибки (0 = успех). */
+    am_mfn mfn;                /* MFN для команд, работающих с записью. */
+    am_int32 state;            /* Стадия: FUTURE_IDLE и т. д. */
+    am_bool success;           /* Признак успешного выполнения. */
+
+};
+
+typedef struct
+{
+    FutureExecutor *executor;  /* Исполнитель. */
+    Connection connection;     /* Собственная копия подключения. */
+    am_handle thread;          /* Поток. */
+
+} FutureWorker;
+
+struct IrbisFutureExecutor
+{
+    Mutex mutex;               /* Защищает очередь и стадии команд. */
+    Condition work;            /* Сигнализирует о новой команде в очереди. */
+    Condition done;            /* Сигнализирует о завершении команды. */
+    FutureWorker *workers;     /* Рабочие потоки. */
+    size_t workerCount;        /* Количество рабочих потоков. */
+    Future *head;              /* Начало очереди. */
+    Future *tail;              /* Конец очереди. */
+    am_bool closed;            /* Исполнитель закрыт, новые команды не принимаются. */
+
+};
+
+MAGNA_API am_bool MAGNA_CALL future_executor_create  (FutureExecutor *executor, Connection *connection, size_t threads);
+MAGNA_API void    MAGNA_CALL future_executor_destroy (FutureExecutor *executor);
+MAGNA_API void    MAGNA_CALL future_destroy          (Future *future);
+MAGNA_API am_bool MAGNA_CALL future_get_max_mfn      (FutureExecutor *executor, Future *future, const am_byte *database);
+MAGNA_API void    MAGNA_CALL future_init             (Future *future);
+MAGNA_API am_bool MAGNA_CALL future_is_done          (Future *future);
+MAGNA_API am_bool MAGNA_CALL future_read_record      (FutureExecutor *executor, Future *future, am_mfn mfn, MarcRecord *record);
+MAGNA_API am_bool MAGNA_CALL future_read_text_file   (FutureExecutor *executor, Future *future, const Specification *specification, Buffer *buffer);
+MAGNA_API am_bool MAGNA_CALL future_search_count     (FutureExecutor *executor, Future *future, const am_byte *expression);
+MAGNA_API am_bool MAGNA_CALL future_submit           (FutureExecutor *executor, Future *future, FutureAction action);
+MAGNA_API void    MAGNA_CALL future_then             (Future *future, FutureCallback callback, void *data);
+MAGNA_API am_bool MAGNA_CALL future_wait             (Future *future);
+MAGNA_API am_bool MAGNA_CALL future_wait_all         (Future **futures, size_t count);
+MAGNA_API size_t  MAGNA_CALL future_wait_any         (Future **futures, size_t count);
+
+/*=========================================================*/
+
+/* Федеративный поиск */
+
+/* Результат поиска в одной базе данных */
+typedef struct
+{
+    Buffer database;   /* Имя базы данных. */
+    Int32Array found;  /* Найденные MFN (первая порция). */
+    am_int32 count;    /* Общее количество найденных записей (-1 = поиск не удался). */
+    am_int32 error;    /* Код ошибки (0 = успех). */
+
+} FederatedResult;
+
+typedef struct
+{
+    Array results;     /* Результаты по базам данных (FederatedResult). */
+    am_int32 total;    /* Суммарное количество найденных записей. */
+    size_t failed;     /* Количество баз данных, поиск в которых не удался. */
+
+} FederatedSearch;
+
+MAGNA_API am_bool                MAGNA_CALL connection_search_federated (Connection *connection, const SpanArray *databases, const am_byte *expression, FederatedSearch *search);
+MAGNA_API am_bool                MAGNA_CALL federated_search_create     (FederatedSearch *search);
+MAGNA_API void                   MAGNA_CALL federated_search_destroy    (FederatedSearch *search);
+MAGNA_API const FederatedResult* MAGNA_CALL federated_search_get        (const FederatedSearch *search, size_t index);
+
+/*=========================================================*/
+
+/* Имитация сервера ИРБИС64 */
+
+#define MOCK_WORKERS       4
+#define MOCK_REQUEST_LIMIT (16ul * 1024ul * 1024ul)
+
+typedef struct
+{
+    Array records;               /* Записи (MarcRecord), MFN = индекс + 1. */
+    Array files;                 /* Текстовые файлы (MockFile). */
+    Array postings;              /* Словарь: упорядоченные ссылки (MockPosting). */
+    Mutex mutex;                 /* Защищает записи, файлы и словарь. */
+    am_handle *threads;          /* Рабочие потоки. */
+    size_t threadCount;          /* Количество рабочих потоков. */
+    am_int32 listener;           /* Слушающий сокет (-1 = не создан). */
+    am_uint32 latency;           /* Задержка перед ответом, мс. */
+    am_uint32 bandwidth;         /* Скорость передачи ответа, байт/с (0 = не ограничена). */
+    am_uint32 errorEvery;        /* Каждый N-й запрос завершается ошибкой (0 = никогда). */
+    am_int32 errorCode;          /* Код имитируемой ошибки. */
+    am_uint32 dropEvery;         /* Каждый N-й запрос остается без ответа (0 = никогда). */
+    am_uint32 termLimit;         /* Наибольшая порция терминов (0 = без ограничения). */
+    volatile am_int32 requests;  /* Количество принятых запросов. */
+    am_bool indexed;             /* Словарь соответствует записям. */
+    volatile am_bool stopping;   /* Сервер останавливается. */
+
+} MockServer;
+
+MAGNA_API am_bool   MAGNA_CALL mock_server_add_file   (MockServer *server, const am_byte *name, Span content);
+MAGNA_API am_mfn    MAGNA_CALL mock_server_add_record (MockServer *server, const MarcRecord *record);
+MAGNA_API am_bool   MAGNA_CALL mock_server_answer     (MockServer *server, Span request, Buffer *answer);
+MAGNA_API am_bool   MAGNA_CALL mock_server_create     (MockServer *server);
+MAGNA_API void      MAGNA_CALL mock_server_destroy    (MockServer *server);
+MAGNA_API am_bool   MAGNA_CALL mock_server_load       (MockServer *server, const char *fileName);
+MAGNA_API am_uint16 MAGNA_CALL mock_server_port       (const MockServer *server);
+MAGNA_API am_bool   MAGNA_CALL mock_server_start      (MockServer *server, am_uint16 port, size_t threads);
+MAGNA_API void      MAGNA_CALL mock_server_stop       (MockServer *server);
 
 /*=========================================================*/
 
@@ -5,21 +5,28 @@ library = irbis.lib
 
 objects = obj\address.obj  &
 	obj\alphatab.obj   &
+	obj\async.obj      &
 	obj\author.obj     &
 	obj\bookinfo.obj   &
 	obj\codes.obj      &
 	obj\collecti.obj   &
 	obj\connect.obj    &
+	obj\cursor.obj     &
 	obj\dbinfo.obj     &
 	obj\dll.obj        &
 	obj\ean.obj        &
 	obj\error.obj      &
 	obj\exemplar.obj   &
+	obj\federate.obj   &
 	obj\field.obj      &
 	obj\field203.obj   &
 	obj\format.obj     &
 	obj\fst.obj        &
+	obj\fulltext.obj   &
+	obj\future.obj     &
 	obj\gbl.obj        &
+	obj\gbljob.obj     &
+	obj\group.obj      &
 	obj\guard.obj      &
 	obj\ilf.obj        &
 	obj\impex.obj      &
@@ -28,18 +35,23 @@ objects = obj\address.obj  &
 	obj\isbn.obj       &
 	obj\isbninfo.obj   &
 	obj\iso2709.obj    &
+	obj\limiter.obj    &
 	obj\magazine.obj   &
 	obj\menu.obj       &
+	obj\mocksrv.obj    &
 	obj\mst.obj        &
 	obj\opt.obj        &
 	obj\par.obj        &
 	obj\phantom.obj    &
+	obj\pool.obj       &
 	obj\procinfo.obj   &
 	obj\query.obj      &
 	obj\rawrecor.obj   &
 	obj\reader.obj     &
+	obj\reccache.obj   &
 	obj\record.obj     &
 	obj\registr.obj    &
+	obj\reserve.obj    &
 	obj\resource.obj   &
 	obj\response.obj   &
 	obj\search.obj     &
@@ -53,6 +65,7 @@ objects = obj\address.obj  &
 	obj\term.obj       &
 	obj\title.obj      &
 	obj\tree.obj       &
+	obj\txtcache.obj   &
 	obj\upc.obj        &
 	obj\uppertab.obj   &
 	obj\userinfo.obj   &
@@ -69,6 +82,9 @@ obj\address.obj: src\address.c
 obj\alphatab.obj: src\alphatab.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\async.obj: src\async.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\author.obj: src\author.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
@@ -84,6 +100,9 @@ obj\collecti.obj: src\collecti.c
 obj\connect.obj: src\connect.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\cursor.obj: src\cursor.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\dbinfo.obj: src\dbinfo.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
@@ -99,6 +118,9 @@ obj\error.obj: src\error.c
 obj\exemplar.obj: src\exemplar.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\federate.obj: src\federate.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\field.obj: src\field.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
@@ -111,9 +133,21 @@ obj\format.obj: src\format.c
 obj\fst.obj: src\fst.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\fulltext.obj: src\fulltext.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
+obj\future.obj: src\future.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\gbl.obj: src\gbl.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\gbljob.obj: src\gbljob.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
+obj\group.obj: src\group.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\guard.obj: src\guard.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
@@ -138,12 +172,18 @@ obj\isbninfo.obj: src\isbninfo.c
 obj\iso2709.obj: src\iso2709.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\limiter.obj: src\limiter.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\magazine.obj: src\magazine.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
 obj\menu.obj: src\menu.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\mocksrv.obj: src\mocksrv.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\mst.obj: src\mst.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
@@ -156,6 +196,9 @@ obj\par.obj: src\par.c
 obj\phantom.obj: src\phantom.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\pool.obj: src\pool.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\procinfo.obj: src\procinfo.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
@@ -168,12 +211,18 @@ obj\rawrecor.obj: src\rawrecor.c
 obj\reader.obj: src\reader.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\reccache.obj: src\reccache.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\record.obj: src\record.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
 obj\registr.obj: src\registr.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\reserve.obj: src\reserve.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\resource.obj: src\resource.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
@@ -213,6 +262,9 @@ obj\title.obj: src\title.c
 obj\tree.obj: src\tree.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\txtcache.obj: src\txtcache.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\upc.obj: src\upc.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
@@ -0,0 +1,511 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file async.c
+ *
+ * Асинхронное (неблокирующее) исполнение запросов к серверу.
+ *
+ * \struct AsyncEngine
+ *      \brief Цикл обработки событий, позволяющий одному потоку
+ *      вести одновременно множество запросов к серверу.
+ *
+ * \details Каждый запрос, поставленный в очередь с помощью
+ * `connection_execute_async`, проходит три стадии:
+ * установка соединения, отсылка пакета и получение ответа.
+ * Все сокеты находятся в неблокирующем режиме и опрашиваются
+ * разом с помощью `tcp4_poll`, так что медленный сервер
+ * не задерживает обработку остальных запросов.
+ *
+ * Срок выполнения запроса определяется так же, как
+ * в `connection_execute`: по `connection-&gt;timeout`
+ * и `connection-&gt;deadline` в момент постановки в очередь.
+ * Запрос, не уложившийся в срок, завершается неудачей
+ * с кодом ошибки -100004. Если сервер закрыл соединение,
+ * не прислав заголовок ответа целиком, запрос также
+ * завершается неудачей (код ошибки -100002).
+ *
+ * По завершении запроса (успешном или нет) вызывается
+ * функция обратного вызова. В ней можно ставить в очередь
+ * новые запросы, в том числе через то же подключение.
+ *
+ * Обработка событий происходит только внутри
+ * `async_engine_run_once` и `async_engine_run`, поэтому
+ * функции обратного вызова исполняются в том потоке,
+ * который крутит цикл. Сам движок не потокобезопасен.
+ *
+ * \var AsyncEngine::operations
+ *      \brief Незавершенные операции (указатели на `AsyncOperation`).
+ *
+ * \var AsyncEngine::completed
+ *      \brief Общее количество завершенных операций.
+ *
+ * \code
+ * static void MAGNA_CALL on_count (Response *response, am_bool success, void *data)
+ * {
+ *     if (success && response_check (response, 0)) {
+ *         printf ("Found: %d\n", response->returnCode);
+ *     }
+ * }
+ *
+ * AsyncEngine engine;
+ *
+ * async_engine_create (&engine);
+ * for (i = 0; i < 100; ++i) {
+ *     // query и responses[i] подготовлены заранее
+ *     connection_execute_async (&connection, &engine, &query, &responses[i], on_count, NULL);
+ *     query_destroy (&query);
+ * }
+ *
+ * async_engine_run (&engine);
+ * async_engine_destroy (&engine);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+static void async_free_operation
+    (
+        AsyncOperation *operation
+    )
+{
+    if (operation->handle != -1) {
+        tcp4_disconnect (operation->handle);
+        operation->handle = -1;
+    }
+
+    buffer_destroy (&operation->packet);
+    mem_free (operation);
+}
+
+static void async_forget
+    (
+        AsyncEngine *engine,
+        AsyncOperation *operation
+    )
+{
+    size_t index;
+
+    for (index = 0; index < engine->operations.len; ++index) {
+        if (engine->operations.ptr [index] == operation) {
+            engine->operations.ptr [index]
+                = engine->operations.ptr [engine->operations.len - 1];
+            --engine->operations.len;
+            break;
+        }
+    }
+}
+
+/* Завершение операции: разбор ответа и вызов функции обратного вызова */
+static void async_complete
+    (
+        AsyncEngine *engine,
+        AsyncOperation *operation,
+        am_bool success
+    )
+{
+    AsyncCallback callback = operation->callback;
+    Response *response = operation->response;
+    void *data = operation->data;
+
+    async_forget (engine, operation);
+    async_free_operation (operation);
+    ++engine->completed;
+
+    if (success) {
+        response_parse_answer (response);
+    }
+
+    if (callback != NULL) {
+        callback (response, success, data);
+    }
+}
+
+/* Отсылка очередной порции пакета. Возвращает AM_FALSE при ошибке. */
+static am_bool async_send
+    (
+        AsyncOperation *operation
+    )
+{
+    ssize_t rc;
+    size_t total = buffer_length (&operation->packet);
+
+    while (operation->sent < total) {
+        rc = tcp4_send
+            (
+                operation->handle,
+                operation->packet.start + operation->sent,
+                (ssize_t) (total - operation->sent)
+            );
+        if (rc < 0) {
+            return tcp4_would_block ();
+        }
+
+        operation->sent += (size_t) rc;
+    }
+
+    operation->state = ASYNC_RECEIVING;
+
+    return AM_TRUE;
+}
+
+/* Прием очередной порции ответа. */
+static am_bool async_receive
+    (
+        AsyncOperation *operation,
+        am_bool *finished
+    )
+{
+    ssize_t rc;
+
+    *finished = AM_FALSE;
+    for (;;) {
+        rc = tcp4_receive_block
+            (
+                operation->handle,
+                &operation->response->answer,
+                TCP4_RECEIVE_BLOCK
+            );
+        if (rc == 0) {
+            /* Сервер мог закрыть соединение, не ответив */
+            if (!operation->presized) {
+                operation->presized = response_presize (operation->response);
+            }
+
+            *finished = AM_TRUE;
+            return operation->presized;
+        }
+
+        if (rc < 0) {
+            return tcp4_would_block ();
+        }
+
+        if (!operation->presized) {
+            operation->presized = response_presize (operation->response);
+        }
+    }
+}
+
+/* Обработка событий на сокете одной операции */
+static void async_handle
+    (
+        AsyncEngine *engine,
+        AsyncOperation *operation,
+        am_int16 ready
+    )
+{
+    am_bool finished;
+
+    if (operation->state == ASYNC_CONNECTING) {
+        if (!(ready & (TCP4_WRITE | TCP4_ERROR))) {
+            return;
+        }
+
+        if (tcp4_connect_error (operation->handle) != 0) {
+            operation->connection->lastError = -100002;
+            async_complete (engine, operation, AM_FALSE);
+            return;
+        }
+
+        operation->state = ASYNC_SENDING;
+    }
+
+    if (operation->state == ASYNC_SENDING) {
+        if (!async_send (operation)) {
+            operation->connection->lastError = -100002;
+            async_complete (engine, operation, AM_FALSE);
+        }
+
+        return;
+    }
+
+    if (ready & (TCP4_READ | TCP4_ERROR)) {
+        if (!async_receive (operation, &finished)) {
+            operation->connection->lastError = -100002;
+            async_complete (engine, operation, AM_FALSE);
+        }
+        else if (finished) {
+            async_complete (engine, operation, AM_TRUE);
+        }
+    }
+}
+
+/*=========================================================*/
+
+/**
+ * Инициализация движка.
+ *
+ * @param engine Указатель на неинициализированную структуру.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL async_engine_create
+    (
+        AsyncEngine *engine
+    )
+{
+    assert (engine != NULL);
+
+    mem_clear (engine, sizeof (*engine));
+
+    return vector_create (&engine->operations, 16);
+}
+
+/**
+ * Освобождение ресурсов, занятых движком.
+ * Незавершенные операции прерываются, для каждой из них
+ * вызывается функция обратного вызова с признаком неудачи.
+ *
+ * @param engine Движок.
+ */
+MAGNA_API void MAGNA_CALL async_engine_destroy
+    (
+        AsyncEngine *engine
+    )
+{
+    assert (engine != NULL);
+
+    while (engine->operations.len != 0) {
+        async_complete
+            (
+                engine,
+                (AsyncOperation*) engine->operations.ptr [engine->operations.len - 1],
+                AM_FALSE
+            );
+    }
+
+    vector_destroy (&engine->operations, NULL);
+    mem_clear (engine, sizeof (*engine));
+}
+
+/**
+ * Количество незавершенных операций.
+ *
+ * @param engine Движок.
+ * @return Количество операций.
+ */
+MAGNA_API size_t MAGNA_CALL async_engine_pending
+    (
+        const AsyncEngine *engine
+    )
+{
+    assert (engine != NULL);
+
+    return engine->operations.len;
+}
+
+/**
+ * Однократное ожидание событий и их обработка.
+ *
+ * @param engine Движок.
+ * @param timeout Предельное время ожидания событий в миллисекундах,
+ * отрицательное значение означает бесконечное ожидание.
+ * @return Количество операций, завершенных за этот вызов,
+ * либо -1 в случае ошибки.
+ */
+MAGNA_API int MAGNA_CALL async_engine_run_once
+    (
+        AsyncEngine *engine,
+        am_int32 timeout
+    )
+{
+    Tcp4Poll *items;
+    AsyncOperation **snapshot, *operation;
+    size_t index, count;
+    size_t before;
+    am_uint64 now;
+    int rc;
+
+    assert (engine != NULL);
+
+    count = engine->operations.len;
+    if (count == 0) {
+        return 0;
+    }
+
+    /* Функции обратного вызова могут менять список операций,
+     * поэтому работаем с его копией. */
+    items = (Tcp4Poll*) mem_alloc (count * (sizeof (Tcp4Poll) + sizeof (AsyncOperation*)));
+    if (items == NULL) {
+        return -1;
+    }
+
+    /* Ждем не дольше, чем до ближайшего срока */
+    now = magna_ticks ();
+    snapshot = (AsyncOperation**) (items + count);
+    for (index = 0; index < count; ++index) {
+        operation = (AsyncOperation*) engine->operations.ptr [index];
+        snapshot [index] = operation;
+        items [index].handle = operation->handle;
+        items [index].events = operation->state == ASYNC_RECEIVING
+            ? TCP4_READ : TCP4_WRITE;
+        if (operation->deadline != 0) {
+            if (operation->deadline <= now) {
+                timeout = 0;
+            }
+            else if (timeout < 0 || operation->deadline - now < (am_uint64) timeout) {
+                timeout = (am_int32) (operation->deadline - now);
+            }
+        }
+    }
+
+    rc = tcp4_poll (items, count, timeout);
+    if (rc < 0) {
+        mem_free (items);
+        return -1;
+    }
+
+    before = engine->completed;
+    for (index = 0; rc > 0 && index < count; ++index) {
+        if (items [index].ready != 0) {
+            async_handle (engine, snapshot [index], items [index].ready);
+        }
+    }
+
+    mem_free (items);
+
+    /* Просроченные операции завершаются неудачей.
+     * Завершенная операция заменяется в списке последней,
+     * поэтому индекс при этом не увеличивается. */
+    now = magna_ticks ();
+    for (index = 0; index < engine->operations.len; ) {
+        operation = (AsyncOperation*) engine->operations.ptr [index];
+        if (operation->deadline != 0 && operation->deadline <= now) {
+            operation->connection->lastError = -100004;
+            async_complete (engine, operation, AM_FALSE);
+        }
+        else {
+            ++index;
+        }
+    }
+
+    return (int) (engine->completed - before);
+}
+
+/**
+ * Обработка событий до тех пор, пока не будут завершены
+ * все операции (включая поставленные в очередь
+ * функциями обратного вызова).
+ *
+ * @param engine Движок.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL async_engine_run
+    (
+        AsyncEngine *engine
+    )
+{
+    assert (engine != NULL);
+
+    while (engine->operations.len != 0) {
+        if (async_engine_run_once (engine, -1) < 0) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/*=========================================================*/
+
+/**
+ * Постановка запроса в очередь на асинхронное исполнение.
+ * Соединение с сервером начинает устанавливаться немедленно,
+ * дальнейший обмен происходит в `async_engine_run_once`.
+ *
+ * @param connection Подключение.
+ * @param engine Движок.
+ * @param query Клиентский запрос. Пакет копируется,
+ * так что после вызова запрос можно уничтожить.
+ * @param response Ответ сервера. Должен оставаться
+ * в живых до вызова функции обратного вызова.
+ * @param callback Функция обратного вызова (может быть `NULL`).
+ * @param data Произвольные данные для функции обратного вызова.
+ * @return Признак успешной постановки в очередь.
+ * В случае неудачи функция обратного вызова не вызывается.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_execute_async
+    (
+        Connection *connection,
+        AsyncEngine *engine,
+        const Query *query,
+        Response *response,
+        AsyncCallback callback,
+        void *data
+    )
+{
+    AsyncOperation *operation;  /* новая операция */
+    am_bool inProgress;         /* подключение еще не завершено */
+
+    assert (connection != NULL);
+    assert (engine != NULL);
+    assert (query != NULL);
+    assert (response != NULL);
+
+    response_init (response);
+    response->connection = connection;
+    if (connection->deadline != 0 && connection->deadline <= magna_ticks ()) {
+        connection->lastError = -100004;
+        return AM_FALSE;
+    }
+
+    if (!connection_resolve (connection, AM_FALSE)) {
+        return AM_FALSE;
+    }
+
+    operation = (AsyncOperation*) mem_alloc (sizeof (AsyncOperation));
+    if (operation == NULL) {
+        return AM_FALSE;
+    }
+
+    mem_clear (operation, sizeof (*operation));
+    operation->connection = connection;
+    operation->response = response;
+    operation->callback = callback;
+    operation->data = data;
+    operation->handle = -1;
+    operation->deadline = connection_get_deadline (connection);
+
+    if (!query_encode (query, &operation->packet)
+        || !query_to_buffer (query, &operation->packet)) {
+        async_free_operation (operation);
+        return AM_FALSE;
+    }
+
+    operation->handle = tcp4_connect_nonblocking (&connection->address, &inProgress);
+    if (operation->handle == -1) {
+        async_free_operation (operation);
+        return AM_FALSE;
+    }
+
+    operation->state = inProgress ? ASYNC_CONNECTING : ASYNC_SENDING;
+    if (!vector_push_back (&engine->operations, operation)) {
+        async_free_operation (operation);
+        return AM_FALSE;
+    }
+
+    connection->lastError = 0;
+
+    return AM_TRUE;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
@@ -89,6 +89,97 @@
  * \var Connection::connected
  *      \brief Признак активного подключения (устанавливается автоматически).
  *
+ * \var Connection::address
+ *      \brief Разрешенный адрес сервера.
+ *      \details Имя хоста разрешается один раз, после чего
+ *      адрес используется для всех последующих запросов
+ *      (каждый запрос к серверу ИРБИС64 идет по новому сокету).
+ *      См. `connection_resolve`.
+ *
+ * \var Connection::timeout
+ *      \brief Предельное время выполнения одной команды
+ *      (подключение, отсылка запроса и прием ответа) в миллисекундах.
+ *      \details По истечении команда прерывается с кодом ошибки -100004.
+ *      0 означает "не ограничено" (по умолчанию).
+ *
+ * \var Connection::deadline
+ *      \brief Общий срок для последующих команд.
+ *      См. `connection_set_deadline`.
+ *
+ * \var Connection::hedge
+ *      \brief Настройки и статистика дублирования медленных запросов.
+ *      См. `connection_set_hedging`.
+ *
+ * \var Connection::addressTtl
+ *      \brief Время жизни разрешенного адреса в миллисекундах.
+ *      \details По истечении адрес разрешается заново.
+ *      0 означает "бессрочно". По умолчанию `ADDRESS_TTL` (5 минут).
+ *
+ * \var Connection::scratchQuery
+ *      \brief Буфер последнего запроса, сохраненный
+ *      для следующего запроса (см. `query_create`).
+ *
+ * \var Connection::scratchAnswer
+ *      \brief Буфер последнего ответа, сохраненный
+ *      для следующего ответа (см. `response_destroy`).
+ *
+ * \var Connection::credentials
+ *      \brief Пароль и логин, закодированные для заголовка
+ *      запроса. Кодируются при первом запросе сеанса.
+ *
+ * \var Connection::scratchLimit
+ *      \brief Буферы большей емкости не сохраняются для повторного
+ *      использования, чтобы одна большая команда не удерживала
+ *      память надолго. 0 отключает повторное использование.
+ *      По умолчанию `SCRATCH_LIMIT`.
+ *
+ * \var Connection::session
+ *      \brief Регистрация на сервере, разделяемая с копиями
+ *      подключения (см. `connection_clone`).
+ *      \details NULL, пока копии не создавались.
+ *
+ * \struct ConnectionSession
+ *      \brief Общее состояние копий одного подключения.
+ *      \details Размещается в куче при первом вызове
+ *      `connection_clone`, освобождается при отключении
+ *      последней из копий.
+ *
+ * \var ConnectionSession::queryId
+ *      \brief Следующий номер запроса. Увеличивается атомарно,
+ *      поэтому копии, работающие в разных потоках,
+ *      никогда не посылают серверу одинаковых номеров.
+ *
+ * \var ConnectionSession::references
+ *      \brief Количество подключений, использующих регистрацию.
+ *
+ * \var ConnectionSession::mutex
+ *      \brief Защищает разрешенный адрес.
+ *
+ * \var ConnectionSession::address
+ *      \brief Разрешенный адрес сервера, общий для всех копий.
+ *      \details Копия, разрешившая имя (в том числе заново,
+ *      после переезда сервера), делится адресом с остальными,
+ *      поэтому копии в разных потоках не разрешают имя
+ *      каждая сама по себе. См. `connection_resolve`.
+ *
+ * \var ConnectionSession::addressExpires
+ *      \brief Момент устаревания общего адреса,
+ *      0 означает "адрес не разрешен".
+ *
+ * \details Многопоточность. Одну структуру `Connection`
+ * нельзя использовать из нескольких потоков одновременно:
+ * буферы для повторного использования и `lastError`
+ * принадлежат ей одной. Вместо этого каждый поток получает
+ * собственную копию с помощью `connection_clone`. Копия
+ * не регистрируется на сервере заново: она разделяет
+ * с образцом идентификатор клиента и счетчик запросов,
+ * так что команды из разных потоков идут параллельно.
+ * Код ошибки каждой команды остается в `lastError`
+ * той копии, через которую она выполнялась.
+ * Кэши, запас соединений и ограничитель, подключенные
+ * к образцу, также разделяются копиями (они защищены
+ * собственными мьютексами).
+ *
  * \code
  * Connection connection;
  *
@@ -141,6 +232,9 @@ MAGNA_API am_bool MAGNA_CALL connection_create
     mem_clear (connection, sizeof (Connection));
     connection->port = 6666;
     connection->workstation = CATALOGER;
+    connection->addressTtl = ADDRESS_TTL;
+    connection->hedge.percentile = 95;
+    connection->scratchLimit = SCRATCH_LIMIT;
 
     return buffer_assign_text (&connection->host, CBTEXT ("127.0.0.1"))
         && buffer_assign_text (&connection->database, CBTEXT ("IBIS"));
@@ -170,6 +264,9 @@ MAGNA_API void MAGNA_CALL connection_destroy
     buffer_destroy (&connection->password);
     buffer_destroy (&connection->database);
     buffer_destroy (&connection->serverVersion);
+    buffer_destroy (&connection->scratchQuery);
+    buffer_destroy (&connection->scratchAnswer);
+    buffer_destroy (&connection->credentials);
     mem_clear (connection, sizeof (*connection));
 
     /* В принципе, после этого подключение
@@ -177,6 +274,112 @@ MAGNA_API void MAGNA_CALL connection_destroy
      */
 }
 
+/**
+ * Копирование настроек подключения: хоста, порта, логина,
+ * пароля, базы данных и типа АРМ. Состояние (регистрация
+ * на сервере, идентификатор клиента и т. д.) не копируется.
+ *
+ * @param target Инициализированное неактивное подключение.
+ * @param source Подключение-образец.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_copy_settings
+    (
+        Connection *target,
+        const Connection *source
+    )
+{
+    assert (target != NULL);
+    assert (source != NULL);
+    assert (!target->connected);
+
+    target->port = source->port;
+    target->workstation = source->workstation;
+    target->textCache = source->textCache;
+    target->recordCache = source->recordCache;
+    target->reserve = source->reserve;
+    target->limiter = source->limiter;
+    target->timeout = source->timeout;
+    target->hedge.delay = source->hedge.delay;
+    target->hedge.percentile = source->hedge.percentile;
+    target->scratchLimit = source->scratchLimit;
+    buffer_clear (&target->credentials);
+
+    /* Уже разрешенный адрес тоже пригодится */
+    target->address = source->address;
+    target->addressExpires = source->addressExpires;
+    target->addressTtl = source->addressTtl;
+
+    return buffer_copy (&target->host, &source->host)
+        && buffer_copy (&target->username, &source->username)
+        && buffer_copy (&target->password, &source->password)
+        && buffer_copy (&target->database, &source->database);
+}
+
+/**
+ * Создание копии активного подключения для другого потока.
+ * Копия получает настройки образца и разделяет с ним
+ * регистрацию на сервере (идентификатор клиента и счетчик
+ * запросов), поэтому повторная регистрация не требуется.
+ * Сервер снимается с регистрации, когда отключается
+ * последняя из копий (включая образец).
+ *
+ * @param target Инициализированное неактивное подключение.
+ * @param source Активное подключение-образец. Не должно
+ * одновременно использоваться другим потоком.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_clone
+    (
+        Connection *target,
+        Connection *source
+    )
+{
+    ConnectionSession *session;
+
+    assert (target != NULL);
+    assert (source != NULL);
+    assert (target != source);
+
+    if (!connection_check (source)) {
+        target->lastError = source->lastError;
+        return AM_FALSE;
+    }
+
+    if (!connection_copy_settings (target, source)
+        || !buffer_copy (&target->serverVersion, &source->serverVersion)) {
+        return AM_FALSE;
+    }
+
+    session = source->session;
+    if (session == NULL) {
+        session = (ConnectionSession*) mem_alloc (sizeof (ConnectionSession));
+        if (session == NULL) {
+            return AM_FALSE;
+        }
+
+        if (!mutex_init (&session->mutex)) {
+            mem_free (session);
+            return AM_FALSE;
+        }
+
+        session->queryId = source->queryId;
+        session->references = 1;
+        session->address = source->address;
+        session->addressExpires = source->addressExpires;
+        source->session = session;
+    }
+
+    atomic_increment_int32 (&session->references);
+    target->session = session;
+    target->clientId = source->clientId;
+    target->queryId = source->queryId;
+    target->interval = source->interval;
+    target->connected = AM_TRUE;
+
+    return AM_TRUE;
+}
+
 /*=========================================================*/
 
 /**
@@ -197,6 +400,8 @@ MAGNA_API am_bool MAGNA_CALL connection_set_host
     assert (host != NULL);
     assert (!connection->connected);
 
+    connection->addressExpires = 0;
+
     return buffer_assign_text (&connection->host, host);
 }
 
@@ -262,6 +467,88 @@ MAGNA_API am_bool MAGNA_CALL connection_set_database
     return buffer_assign_text (&connection->database, database);
 }
 
+/**
+ * Срок выполнения очередной команды: более ранний
+ * из `timeout` (отсчитывается от текущего момента)
+ * и `deadline`. Используется всеми способами выполнения
+ * команд: синхронным, асинхронным и федеративным.
+ *
+ * @param connection Подключение.
+ * @return Момент по `magna_ticks` либо 0, если срок не ограничен.
+ */
+MAGNA_API am_uint64 MAGNA_CALL connection_get_deadline
+    (
+        const Connection *connection
+    )
+{
+    am_uint64 result = 0;
+
+    assert (connection != NULL);
+
+    if (connection->timeout != 0) {
+        result = magna_ticks () + connection->timeout;
+    }
+
+    if (connection->deadline != 0
+        && (result == 0 || connection->deadline < result)) {
+        result = connection->deadline;
+    }
+
+    return result;
+}
+
+/**
+ * Установка общего срока для всех последующих команд.
+ * Удобно для составных операций (например, пакетного чтения
+ * записей), состоящих из нескольких обращений к серверу:
+ * команда, не уложившаяся в срок, прерывается с кодом
+ * ошибки -100004. Срок действует совместно с `timeout`
+ * (из двух сроков выбирается более ранний).
+ *
+ * @param connection Подключение.
+ * @param timeout Время от текущего момента в миллисекундах.
+ * 0 означает "снять ограничение".
+ */
+MAGNA_API void MAGNA_CALL connection_set_deadline
+    (
+        Connection *connection,
+        am_uint32 timeout
+    )
+{
+    assert (connection != NULL);
+
+    connection->deadline = timeout == 0 ? 0 : magna_ticks () + timeout;
+}
+
+/**
+ * Включение дублирования медленных запросов.
+ * Если сервер не начал отвечать на идемпотентную команду
+ * (чтение и форматирование записей, поиск, чтение словаря)
+ * за время, превышающее заданный процентиль недавних времен
+ * ответа (но не меньшее `delay`), на сервер посылается
+ * дубликат запроса по новому соединению, и используется
+ * ответ, пришедший первым.
+ *
+ * @param connection Подключение.
+ * @param delay Минимальная задержка перед дубликатом в мс
+ * (0 = выключить дублирование).
+ * @param percentile Процентиль (например, 95).
+ */
+MAGNA_API void MAGNA_CALL connection_set_hedging
+    (
+        Connection *connection,
+        am_uint32 delay,
+        am_uint32 percentile
+    )
+{
+    assert (connection != NULL);
+    assert (percentile <= 100);
+
+    mem_clear (&connection->hedge, sizeof (connection->hedge));
+    connection->hedge.delay = delay;
+    connection->hedge.percentile = percentile;
+}
+
 /*=========================================================*/
 
 /**
@@ -416,6 +703,9 @@ MAGNA_API am_bool MAGNA_CALL connection_connect
         return AM_TRUE;
     }
 
+    /* Логин и пароль могли измениться с прошлого сеанса */
+    buffer_clear (&connection->credentials);
+
     AGAIN:
     connection->clientId = 100000 + (random_get() % 900000);
     connection->queryId = 1;
@@ -593,6 +883,63 @@ MAGNA_API am_bool MAGNA_CALL connection_delete_file
     return AM_FALSE;
 }
 
+/* Имя базы данных, в которой хранится запись. */
+static const Buffer* connection_record_database
+    (
+        const Connection *connection,
+        const MarcRecord *record
+    )
+{
+    return buffer_is_empty (&record->database)
+        ? &connection->database
+        : &record->database;
+}
+
+/* Установка либо снятие признака логического удаления записи. */
+static am_bool connection_mark_record
+    (
+        Connection *connection,
+        am_mfn mfn,
+        am_bool deleted
+    )
+{
+    MarcRecord record;
+    am_bool result = AM_FALSE;
+
+    if (!connection_check (connection)) {
+        return AM_FALSE;
+    }
+
+    /* Статус записи должен быть свежим, а не взятым из кэша */
+    if (connection->recordCache != NULL) {
+        record_cache_invalidate (connection->recordCache, &connection->database, mfn);
+    }
+
+    record_init (&record);
+    if (!connection_read_record (connection, mfn, &record)) {
+        goto DONE;
+    }
+
+    if (((record.status & LOGICALLY_DELETED) != 0) == deleted) {
+        result = AM_TRUE;
+        goto DONE;
+    }
+
+    if (deleted) {
+        record.status |= LOGICALLY_DELETED;
+    }
+    else {
+        record.status &= ~LOGICALLY_DELETED;
+    }
+
+    result = connection_write_record (connection, &record, AM_FALSE) >= 0;
+
+    DONE:
+    record_destroy (&record);
+
+    return result;
+}
+
 /**
  * Удаление записи по её MFN (в текущей базе данных).
  *
@@ -606,13 +953,10 @@ MAGNA_API am_bool MAGNA_CALL connection_delete_record
         am_mfn mfn
     )
 {
+    assert (connection != NULL);
     assert (mfn > 0);
 
-    if (!connection_check (connection)) {
-        return AM_FALSE;
-    }
-
-    return AM_FALSE;
+    return connection_mark_record (connection, mfn, AM_TRUE);
 }
 
 /**
@@ -636,6 +980,9 @@ MAGNA_API am_bool MAGNA_CALL irbis_disconnect
  * Если при отключении был увеличен счетчик
  * использования лицензий, он соответственно
  * уменьшается.
+ * Если регистрация разделяется с копиями
+ * (см. `connection_clone`), сервер снимает ее
+ * только при отключении последней из копий.
  *
  * @param connection Активное подключение.
  * @return Признак успешного завершения операции.
@@ -645,8 +992,9 @@ MAGNA_API am_bool MAGNA_CALL connection_disconnect
         Connection *connection
     )
 {
-    am_bool result;    /* признак успеха */
-    Response response; /* ответ сервера */
+    am_bool result;              /* признак успеха */
+    Response response;           /* ответ сервера */
+    ConnectionSession *session;  /* разделяемая регистрация */
 
     LOG_ENTER;
     assert (connection != NULL);
@@ -655,6 +1003,21 @@ MAGNA_API am_bool MAGNA_CALL connection_disconnect
         return AM_TRUE;
     }
 
+    session = connection->session;
+    if (session != NULL) {
+        connection->session = NULL;
+        if (atomic_decrement_int32 (&session->references) != 0) {
+            /* Регистрацией еще пользуются другие копии */
+            connection->connected = AM_FALSE;
+            LOG_LEAVE;
+            return AM_TRUE;
+        }
+
+        connection->queryId = session->queryId;
+        mutex_destroy (&session->mutex);
+        mem_free (session);
+    }
+
     result = connection_execute_simple
         (
             connection,
@@ -707,6 +1070,362 @@ MAGNA_API am_mfn MAGNA_CALL connection_get_max_mfn
     return result;
 }
 
+/* Оставшееся до срока время в мс (срок должен быть задан). */
+static am_int32 connection_remaining
+    (
+        am_uint64 deadline
+    )
+{
+    am_uint64 now = magna_ticks ();
+
+    if (now >= deadline) {
+        return 0;
+    }
+
+    return deadline - now > 0x7FFFFFFFu
+        ? 0x7FFFFFFF
+        : (am_int32) (deadline - now);
+}
+
+/* Открытие сокета, подключенного к серверу. */
+static am_int32 connection_open_socket
+    (
+        Connection *connection,
+        am_uint64 deadline,
+        am_bool useReserve
+    )
+{
+    if (connection->reserve != NULL) {
+        /* Имя хоста могло разрешиться заново, а порт -- смениться */
+        socket_reserve_set_address (connection->reserve, &connection->address);
+        if (useReserve) {
+            return socket_reserve_take
+                (
+                    connection->reserve,
+                    deadline != 0 ? connection_remaining (deadline) : -1
+                );
+        }
+    }
+
+    if (deadline != 0) {
+        return tcp4_connect_timeout
+            (
+                &connection->address,
+                connection_remaining (deadline)
+            );
+    }
+
+    return tcp4_connect_address (&connection->address);
+}
+
+/* Сколько фрагментов пакета размещается на стеке */
+#define PACKET_SPANS 8
+
+/*
+ * Отсылка пакета с запросом в уже подключенный сокет.
+ * Заголовок, буфер запроса и фрагменты, не скопированные
+ * в буфер, уходят в сокет одним вызовом.
+ */
+static am_bool connection_send_packet
+    (
+        const Query *query,
+        am_int32 sockfd,
+        am_uint64 deadline
+    )
+{
+    am_byte temp[16];             /* длина пакета в байтах */
+    Span local[PACKET_SPANS];     /* фрагменты пакета (обычно хватает) */
+    Span *spans = local;          /* фрагменты пакета */
+    const QueryPart *part;        /* фрагмент, не скопированный в буфер */
+    const am_byte *data;          /* данные буфера запроса */
+    size_t count, index, offset;
+    am_bool result;
+
+    if (deadline != 0) {
+        if (connection_remaining (deadline) == 0) {
+            return AM_FALSE;
+        }
+
+        tcp4_set_send_timeout (sockfd, (am_uint32) connection_remaining (deadline));
+    }
+
+    /* Заголовок, затем куски буфера вперемежку с фрагментами */
+    count = 2 * query->parts.len + 2;
+    if (count > PACKET_SPANS) {
+        spans = (Span*) mem_alloc (count * sizeof (Span));
+        if (spans == NULL) {
+            return AM_FALSE;
+        }
+    }
+
+    sprintf ((char*) temp, "%u\n", (unsigned int) query_length (query));
+    spans[0] = span_init (temp, strlen ((const char*) temp));
+    data = query->buffer.start;
+    count = 1;
+    offset = 0;
+    for (index = 0; index < query->parts.len; ++index) {
+        part = (const QueryPart*) array_get (&query->parts, index);
+        spans[count++] = span_init (data + offset, part->offset - offset);
+        spans[count++] = part->data;
+        offset = part->offset;
+    }
+
+    spans[count++] = span_init (data + offset, buffer_length (&query->buffer) - offset);
+    result = tcp4_send_spans (sockfd, spans, count);
+
+    if (spans != local) {
+        mem_free (spans);
+    }
+
+    return result;
+}
+
+/* Допускает ли команда безопасное повторение? */
+static am_bool query_is_idempotent
+    (
+        const Query *query
+    )
+{
+    const Buffer *buffer = &query->buffer;
+    Span lock;
+
+    if (buffer_length (buffer) < 2 || buffer->start[1] != '\n') {
+        return AM_FALSE;
+    }
+
+    switch (buffer->start[0]) {
+        case 'C': /* READ_RECORD, но не с блокировкой записи */
+            lock = query_get_line (query, 12);
+            return query->parts.len == 0
+                && (span_is_empty (lock) || span_to_uint32 (lock) == 0);
+
+        case 'G': /* FORMAT_RECORD */
+        case 'H': /* READ_TERMS */
+        case 'I': /* READ_POSTINGS */
+        case 'K': /* SEARCH */
+        case 'P': /* READ_TERMS_REVERSE */
+            return AM_TRUE;
+
+        default:
+            return AM_FALSE;
+    }
+}
+
+/* Запоминание очередного времени ответа. */
+static void hedge_record
+    (
+        HedgePolicy *hedge,
+        am_uint64 elapsed
+    )
+{
+    hedge->samples[hedge->next] = elapsed > 0xFFFFFFFFu
+        ? 0xFFFFFFFFu
+        : (am_uint32) elapsed;
+    hedge->next = (hedge->next + 1) % HEDGE_SAMPLES;
+    if (hedge->count < HEDGE_SAMPLES) {
+        ++hedge->count;
+    }
+}
+
+/* Задержка перед посылкой дубликата: процентиль недавних времен ответа. */
+static am_uint32 hedge_get_delay
+    (
+        const HedgePolicy *hedge
+    )
+{
+    am_uint32 sorted[HEDGE_SAMPLES];
+    am_uint32 value, index, inner, percentile;
+
+    /* Пока замеров мало, полагаемся на заданную задержку */
+    if (hedge->count < HEDGE_SAMPLES / 4) {
+        return hedge->delay;
+    }
+
+    /* Сортировка вставками: замеров немного */
+    for (index = 0; index < hedge->count; ++index) {
+        value = hedge->samples[index];
+        for (inner = index; inner != 0 && sorted[inner - 1] > value; --inner) {
+            sorted[inner] = sorted[inner - 1];
+        }
+
+        sorted[inner] = value;
+    }
+
+    percentile = hedge->percentile > 100 ? 100 : hedge->percentile;
+    value = sorted[(hedge->count - 1) * percentile / 100];
+
+    return value > hedge->delay ? value : hedge->delay;
+}
+
+/*
+ * Дублирование запроса, если сервер не начал отвечать
+ * в течение обычного для него времени. Возвращает сокет,
+ * по которому ответ пришел первым (второй закрывается).
+ */
+static am_int32 connection_hedge
+    (
+        Connection *connection,
+        const Query *query,
+        am_int32 first,
+        am_uint64 deadline
+    )
+{
+    Tcp4Poll items[2];
+    Query duplicate;
+    am_uint64 started;
+    am_int32 second, delay;
+    am_bool sent;
+    int rc;
+
+    started = magna_ticks ();
+    delay = (am_int32) hedge_get_delay (&connection->hedge);
+    if (deadline != 0 && connection_remaining (deadline) <= delay) {
+        return first;
+    }
+
+    items[0].handle = first;
+    items[0].events = TCP4_READ;
+    rc = tcp4_poll (items, 1, delay);
+    if (rc != 0) {
+        if (rc > 0) {
+            hedge_record (&connection->hedge, magna_ticks () - started);
+        }
+
+        return first;
+    }
+
+    second = connection_open_socket (connection, deadline, AM_TRUE);
+    if (second == -1) {
+        return first;
+    }
+
+    sent = query_rebind (query, connection, &duplicate)
+        && connection_send_packet (&duplicate, second, deadline);
+    query_destroy (&duplicate);
+    if (!sent) {
+        tcp4_disconnect (second);
+        return first;
+    }
+
+    ++connection->hedge.issued;
+    items[1].handle = second;
+    items[1].events = TCP4_READ;
+    rc = tcp4_poll (items, 2, deadline == 0 ? -1 : connection_remaining (deadline));
+    if (rc <= 0) {
+        /* Дальнейшее -- забота `response_receive` */
+        tcp4_disconnect (second);
+        return first;
+    }
+
+    hedge_record (&connection->hedge, magna_ticks () - started);
+    if (items[0].ready != 0) {
+        tcp4_disconnect (second);
+        return first;
+    }
+
+    ++connection->hedge.won;
+    tcp4_disconnect (first);
+
+    return second;
+}
+
+/*
+ * Занятие места у ограничителя, но не дольше срока команды.
+ * При неудаче ответ инициализируется (его можно уничтожить).
+ */
+static am_bool connection_take_slot
+    (
+        Connection *connection,
+        Response *response,
+        am_uint64 deadline,
+        am_uint64 *started
+    )
+{
+    if (limiter_acquire_for
+        (
+            connection->limiter,
+            deadline == 0 ? -1 : connection_remaining (deadline),
+            started
+        )) {
+        return AM_TRUE;
+    }
+
+    response_init (response);
+    response->connection = connection;
+    connection->lastError = -100004;
+
+    return AM_FALSE;
+}
+
+/*
+ * Установка соединения с сервером и отсылка запроса.
+ * Возвращает дескриптор сокета либо -1.
+ */
+static am_int32 connection_send_query
+    (
+        Connection *connection,
+        const Query *query,
+        Response *response,
+        am_uint64 deadline
+    )
+{
+    am_bool cached;               /* адрес был взят из кэша */
+    am_int32 sockfd;              /* сокет */
+
+    response_init (response);
+    response->connection = connection;
+    if (buffer_capacity (&connection->scratchAnswer) != 0) {
+        response->answer = connection->scratchAnswer;
+        buffer_init (&connection->scratchAnswer);
+        buffer_clear (&response->answer);
+    }
+
+    if (deadline != 0 && connection_remaining (deadline) == 0) {
+        connection->lastError = -100004;
+        return -1;
+    }
+
+    response->deadline = deadline;
+    cached = connection->addressExpires != 0;
+    if (!connection_resolve (connection, AM_FALSE)) {
+        return -1;
+    }
+
+    sockfd = connection_open_socket (connection, deadline, AM_TRUE);
+    if (sockfd == -1 && cached) {
+        /* Возможно, сервер переехал: разрешаем имя заново */
+        if (!connection_resolve (connection, AM_TRUE)) {
+            return -1;
+        }
+
+        sockfd = connection_open_socket (connection, deadline, AM_FALSE);
+    }
+
+    if (sockfd == -1) {
+        if (deadline != 0 && connection_remaining (deadline) == 0) {
+            connection->lastError = -100004;
+        }
+
+        return -1;
+    }
+
+    connection->lastError = 0;
+    if (!connection_send_packet (query, sockfd, deadline)) {
+        tcp4_disconnect (sockfd);
+        if (deadline != 0 && connection_remaining (deadline) == 0) {
+            connection->lastError = -100004;
+        }
+
+        return -1;
+    }
+
+    if (connection->hedge.delay != 0 && query_is_idempotent (query)) {
+        sockfd = connection_hedge (connection, query, sockfd, deadline);
+    }
+
+    return sockfd;
+}
+
 /**
  * Отправка клиентского запроса на сервер ИРБИС64
  * и получение ответа от него.
@@ -724,65 +1443,81 @@ MAGNA_API am_bool MAGNA_CALL connection_execute
     )
 {
     am_bool result = AM_FALSE;    /* признак успеха */
-    Buffer header = BUFFER_INIT;  /* заголовок пакета с запросом (длина пакета в байтах) */
-    const am_byte *hostname;      /* имя хоста */
-    am_int32 sockfd = -1;         /* сокет */
+    am_uint64 started = 0;        /* начало команды (для ограничителя) */
+    am_uint64 deadline;           /* срок выполнения команды */
+    am_int32 sockfd;              /* сокет */
 
     assert (connection != NULL);
     assert (query != NULL);
     assert (response != NULL);
 
-    response_init (response);
-    response->connection = connection;
-    hostname = buffer_to_text (&connection->host);
-    if (hostname == NULL) {
-        /* TODO: document the error code */
-        connection->lastError = 100501;
-        goto DONE;
+    deadline = connection_get_deadline (connection);
+    if (connection->limiter != NULL
+        && !connection_take_slot (connection, response, deadline, &started)) {
+        return AM_FALSE;
     }
 
-    sockfd = tcp4_connect (hostname, connection->port);
-    if (sockfd == -1) {
-        goto DONE;
-    }
+    sockfd = connection_send_query (connection, query, response, deadline);
+    if (sockfd != -1) {
+        if (response_receive (response, sockfd)) {
+            response_parse_answer (response);
+            result = AM_TRUE;
+        }
 
-    connection->lastError = 0;
-    if (!query_encode (query, &header)) {
-        goto DONE;
+        tcp4_disconnect (sockfd);
     }
 
-    if (!tcp4_send_buffer (sockfd, &header)
-        || !tcp4_send_buffer (sockfd, &query->buffer)) {
-        goto DONE;
+    if (connection->limiter != NULL) {
+        limiter_release (connection->limiter, started, result);
     }
 
-    if (!tcp4_receive_all (sockfd, &response->answer)) {
-        goto DONE;
-    }
+    return result;
+}
 
-    tcp4_disconnect (sockfd);
-    sockfd = -1;
-    nav_from_buffer (&response->navigator, &response->answer);
+/**
+ * Отправка клиентского запроса на сервер ИРБИС64
+ * и получение ответа от него в потоковом режиме:
+ * функция возвращается, как только получен заголовок ответа,
+ * остальные данные подкачиваются по мере чтения из ответа
+ * (см. `response_stream`). Сокет закрывается в `response_destroy`.
+ *
+ * @param connection Активное подключение.
+ * @param query Клиентский запрос.
+ * @param response Ответ сервера.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_execute_stream
+    (
+        Connection *connection,
+        Query *query,
+        Response *response
+    )
+{
+    am_bool result = AM_FALSE;    /* признак успеха */
+    am_uint64 started = 0;        /* начало команды (для ограничителя) */
+    am_uint64 deadline;           /* срок выполнения команды */
+    am_int32 sockfd;              /* сокет */
 
-    response->command = response_read_ansi (response);
-    response->clientId = response_read_int32 (response);
-    response->queryId = response_read_int32 (response);
-    response->answerSize = response_read_int32 (response);
-    response->serverVersion = response_read_ansi(response);
-    response_get_line (response);
-    response_get_line (response);
-    response_get_line (response);
-    response_get_line (response);
-    response_get_line (response);
+    assert (connection != NULL);
+    assert (query != NULL);
+    assert (response != NULL);
 
-    result = AM_TRUE;
+    deadline = connection_get_deadline (connection);
+    if (connection->limiter != NULL
+        && !connection_take_slot (connection, response, deadline, &started)) {
+        return AM_FALSE;
+    }
 
-    DONE:
+    sockfd = connection_send_query (connection, query, response, deadline);
     if (sockfd != -1) {
-        tcp4_disconnect (sockfd);
+        /* С этого момента сокетом владеет ответ */
+        result = response_stream (response, sockfd);
     }
 
-    buffer_destroy (&header);
+    /* Место освобождается по получении заголовка ответа */
+    if (connection->limiter != NULL) {
+        limiter_release (connection->limiter, started, result);
+    }
 
     return result;
 }
@@ -814,6 +1549,8 @@ MAGNA_API am_bool connection_execute_simple
     assert (response != NULL);
     assert (command != NULL);
 
+    /* Вызывающий уничтожает ответ и тогда, когда команда не выполнялась */
+    response_init (response);
     if (!connection_check (connection)
         || !query_create (&query, connection, command)) {
         return AM_FALSE;
@@ -918,11 +1655,110 @@ MAGNA_API am_bool MAGNA_CALL connection_format_mfn
 }
 
 /**
- * Пустая операция (используется для периодического
- * подтверждения подключения клиента).
+ * Получение статистики работы сервера.
+ * Требует прав администратора.
  *
  * @param connection Активное подключение.
- * @return Признак успешного заврешения операции.
+ * @param stat Структура для результата.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_get_server_stat
+    (
+        Connection *connection,
+        ServerStat *stat
+    )
+{
+    am_bool result;    /* признак успеха */
+    Response response; /* ответ сервера */
+
+    assert (connection != NULL);
+    assert (stat != NULL);
+
+    server_stat_init (stat);
+    response_init (&response);
+    result = connection_execute_simple
+        (
+            connection,
+            &response,
+            CBTEXT (GET_SERVER_STAT),
+            0
+        )
+
+        && server_stat_parse_response (stat, &response);
+
+    response_destroy (&response);
+
+    if (result && connection->limiter != NULL) {
+        limiter_observe_stat (connection->limiter, stat);
+    }
+
+    return result;
+}
+
+/**
+ * Глобальная корректировка записей одной командой.
+ * Для больших баз данных см. `GblJob`.
+ *
+ * @param connection Активное подключение.
+ * @param settings Настройки корректировки (если база данных
+ * не указана, используется текущая).
+ * @param result Инициализированная структура, к которой
+ * добавляется результат.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_global_correction
+    (
+        Connection *connection,
+        const GblSettings *settings,
+        GblResult *result
+    )
+{
+    am_bool ok = AM_FALSE; /* признак успеха */
+    GblSettings copy;      /* настройки с подставленной базой данных */
+    am_uint64 started;     /* момент начала */
+    Response response;     /* ответ сервера */
+    Query query;           /* клиентский запрос */
+
+    assert (connection != NULL);
+    assert (settings != NULL);
+    assert (result != NULL);
+
+    if (!connection_check (connection)
+        || !gbl_settings_verify (settings)
+        || !query_create (&query, connection, CBTEXT (GLOBAL_CORRECTION))) {
+        return AM_FALSE;
+    }
+
+    /* Поверхностная копия: буферы не дублируются и не освобождаются */
+    copy = *settings;
+    if (buffer_is_empty (&copy.database)) {
+        copy.database = connection->database;
+    }
+
+    started = magna_ticks ();
+    response_init (&response);
+    if (!gbl_settings_encode (&copy, &query)
+        || !connection_execute (connection, &query, &response)
+        || response_get_return_code (&response) < 0) {
+        goto DONE;
+    }
+
+    ok = gbl_result_decode (result, &response);
+    result->elapsed += magna_ticks () - started;
+
+    DONE:
+    response_destroy (&response);
+    query_destroy (&query);
+
+    return ok;
+}
+
+/**
+ * Получение информации о версии сервера.
+ *
+ * @param connection Активное подключение.
+ * @param version Структура для результата.
+ * @return Признак успешного завершения операции.
  */
 MAGNA_API am_bool MAGNA_CALL connection_get_server_version
     (
@@ -1028,6 +1864,8 @@ MAGNA_API am_bool MAGNA_CALL connection_parse_string
             if (!buffer_assign_span (&connection->host, value)) {
                 return AM_FALSE;
             }
+
+            connection->addressExpires = 0;
         }
         else if (span_compare_ignore_case (key, TEXT_SPAN ("port")) == 0) {
             connection->port = (am_int16) span_to_int32 (value);
@@ -1063,22 +1901,70 @@ MAGNA_API am_bool MAGNA_CALL connection_parse_string
         }
     }
 
-    return AM_TRUE;
+    return AM_TRUE;
+}
+
+/**
+ * Расформатирование таблицы в RTF.
+ *
+ * @param connection Активное подключение.
+ * @param definition Определение таблицы.
+ * @param output Буфер для размещения результата
+ * @return Признак успешного заверешния операции.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_print_table
+    (
+        Connection *connection,
+        TableDefinition *definition,
+        Buffer *output
+    )
+{
+    Query query;
+    Response response;
+    am_bool result = AM_FALSE;
+
+    assert (connection != NULL);
+    assert (definition != NULL);
+
+    if (!connection_check (connection)) {
+        return AM_FALSE;
+    }
+
+    response_init (&response);
+    if (!query_create (&query, connection, CBTEXT (PRINT))) {
+        return AM_FALSE;
+    }
+
+    if (!table_definition_encode (definition, connection, &query)) {
+        goto DONE;
+    }
+
+    if (!connection_execute (connection, &query, &response)) {
+        goto DONE;
+    }
+
+    result = table_definition_decode (definition, &response, output);
+
+    DONE:
+    query_destroy (&query);
+    response_destroy (&response);
+
+    return result;
 }
 
 /**
- * Расформатирование таблицы в RTF.
+ * Чтение постингов для указанных терминов из поискового словаря.
  *
  * @param connection Активное подключение.
- * @param definition Определение таблицы.
- * @param output Буфер для размещения результата
- * @return Признак успешного заверешния операции.
+ * @param parameters Параметры постингов.
+ * @param postings Массив для заполнения прочитанными постингами.
+ * @return Признак успешного завершения операции.
  */
-MAGNA_API am_bool MAGNA_CALL connection_print_table
+MAGNA_API am_bool MAGNA_CALL connection_read_postings
     (
         Connection *connection,
-        TableDefinition *definition,
-        Buffer *output
+        const PostingParameters *parameters,
+        Array *postings
     )
 {
     Query query;
@@ -1086,18 +1972,19 @@ MAGNA_API am_bool MAGNA_CALL connection_print_table
     am_bool result = AM_FALSE;
 
     assert (connection != NULL);
-    assert (definition != NULL);
+    assert (parameters != NULL);
+    assert (postings != NULL);
 
     if (!connection_check (connection)) {
         return AM_FALSE;
     }
 
     response_init (&response);
-    if (!query_create (&query, connection, CBTEXT (PRINT))) {
+    if (!query_create (&query, connection, CBTEXT (READ_POSTINGS))) {
         return AM_FALSE;
     }
 
-    if (!table_definition_encode (definition, connection, &query)) {
+    if (!posting_parameters_encode (parameters, connection, &query)) {
         goto DONE;
     }
 
@@ -1105,7 +1992,11 @@ MAGNA_API am_bool MAGNA_CALL connection_print_table
         goto DONE;
     }
 
-    result = table_definition_decode (definition, &response, output);
+    if (!response_check (&response, -202, -203, -204, 0)) {
+        goto DONE;
+    }
+
+    result = posting_parse_response (postings, &response);
 
     DONE:
     query_destroy (&query);
@@ -1115,18 +2006,19 @@ MAGNA_API am_bool MAGNA_CALL connection_print_table
 }
 
 /**
- * Чтение постингов для указанных терминов из поискового словаря.
+ * Чтение постингов сразу в компактный список.
+ * Ответ сервера разбирается по мере поступления.
  *
  * @param connection Активное подключение.
  * @param parameters Параметры постингов.
- * @param postings Массив для заполнения прочитанными постингами.
+ * @param list Инициализированный список, подлежащий пополнению.
  * @return Признак успешного завершения операции.
  */
-MAGNA_API am_bool MAGNA_CALL connection_read_postings
+MAGNA_API am_bool MAGNA_CALL connection_read_posting_list
     (
         Connection *connection,
         const PostingParameters *parameters,
-        Array *postings
+        PostingList *list
     )
 {
     Query query;
@@ -1135,7 +2027,7 @@ MAGNA_API am_bool MAGNA_CALL connection_read_postings
 
     assert (connection != NULL);
     assert (parameters != NULL);
-    assert (postings != NULL);
+    assert (list != NULL);
 
     if (!connection_check (connection)) {
         return AM_FALSE;
@@ -1150,7 +2042,7 @@ MAGNA_API am_bool MAGNA_CALL connection_read_postings
         goto DONE;
     }
 
-    if (!connection_execute (connection, &query, &response)) {
+    if (!connection_execute_stream (connection, &query, &response)) {
         goto DONE;
     }
 
@@ -1158,7 +2050,7 @@ MAGNA_API am_bool MAGNA_CALL connection_read_postings
         goto DONE;
     }
 
-    result = posting_parse_response (postings, &response);
+    result = posting_list_parse_response (list, &response);
 
     DONE:
     query_destroy (&query);
@@ -1248,10 +2140,16 @@ MAGNA_API am_bool MAGNA_CALL connection_read_record
     assert (connection != NULL);
     assert (mfn > 0);
 
+    /* Кэш не должен скрывать отсутствие подключения */
     if (!connection_check (connection)) {
         return AM_FALSE;
     }
 
+    if (connection->recordCache != NULL
+        && record_cache_get (connection->recordCache, &connection->database, mfn, record)) {
+        return buffer_copy (&record->database, &connection->database);
+    }
+
     response_init (&response);
     if (!query_create (&query, connection, CBTEXT (READ_RECORD))) {
         return AM_FALSE;
@@ -1270,10 +2168,15 @@ MAGNA_API am_bool MAGNA_CALL connection_read_record
         goto DONE;
     }
 
-    if (!record_parse_single (record, &response)) {
+    if (!record_parse_single (record, &response)
+        || !buffer_copy (&record->database, &connection->database)) {
         goto DONE;
     }
 
+    if (connection->recordCache != NULL) {
+        record_cache_put (connection->recordCache, &connection->database, record);
+    }
+
     result = AM_TRUE;
 
     DONE:
@@ -1283,6 +2186,171 @@ MAGNA_API am_bool MAGNA_CALL connection_read_record
     return result;
 }
 
+/**
+ * Чтение одной пачки записей: все MFN пачки уходят на сервер
+ * одним запросом FORMAT_RECORD, ответ разбирается по мере поступления.
+ *
+ * @param connection Активное подключение.
+ * @param mfns Массив MFN.
+ * @param offset Индекс первого MFN пачки.
+ * @param count Количество MFN в пачке.
+ * @param records Массив для размещения прочитанных записей.
+ * @return Признак успешного завершения операции.
+ */
+static am_bool connection_read_batch
+    (
+        Connection *connection,
+        const Int32Array *mfns,
+        size_t offset,
+        size_t count,
+        Array *records
+    )
+{
+    Query query;
+    Response response;
+    MarcRecord *record;
+    Span line;
+    size_t index;
+    am_bool result = AM_FALSE;
+
+    response_init (&response);
+    if (!query_create (&query, connection, CBTEXT (FORMAT_RECORD))) {
+        return AM_FALSE;
+    }
+
+    if (!query_add_ansi_buffer (&query, &connection->database)
+        || !query_add_format (&query, CBTEXT (ALL_FORMAT))
+        || !query_add_uint32 (&query, (am_uint32) count)) {
+        goto DONE;
+    }
+
+    for (index = 0; index < count; ++index) {
+        if (!query_add_int32 (&query, mfns->ptr[offset + index])) {
+            goto DONE;
+        }
+    }
+
+    if (!connection_execute_stream (connection, &query, &response)) {
+        goto DONE;
+    }
+
+    if (response_get_return_code (&response) < 0) {
+        goto DONE;
+    }
+
+    while (!response_eot (&response)) {
+        line = response_get_line (&response);
+        if (span_is_empty (line)) {
+            continue;
+        }
+
+        record = (MarcRecord*) array_emplace_back (records);
+        if (record == NULL) {
+            goto DONE;
+        }
+
+        record_init (record);
+        if (!record_parse_all_format (record, line)
+            || record->mfn == 0) {
+            /* Отсутствующие или нераспознанные записи пропускаем */
+            record_destroy (record);
+            array_truncate (records, records->len - 1);
+            continue;
+        }
+
+        if (!buffer_copy (&record->database, &connection->database)) {
+            goto DONE;
+        }
+
+        if (connection->recordCache != NULL) {
+            record_cache_put (connection->recordCache, &connection->database, record);
+        }
+    }
+
+    result = !response.broken;
+
+    DONE:
+    query_destroy (&query);
+    response_destroy (&response);
+
+    return result;
+}
+
+/**
+ * Пакетное чтение записей с сервера.
+ * Вместо отдельного обращения на каждую запись MFN группируются
+ * в пачки по READ_RECORDS_BATCH штук.
+ *
+ * @param connection Активное подключение.
+ * @param mfns Массив MFN записей.
+ * @param records Проинициализированный массив MarcRecord,
+ * в конец которого помещаются прочитанные записи.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_read_records
+    (
+        Connection *connection,
+        const Int32Array *mfns,
+        Array *records
+    )
+{
+    return connection_read_records_ex
+        (
+            connection,
+            mfns,
+            records,
+            READ_RECORDS_BATCH
+        );
+}
+
+/**
+ * Пакетное чтение записей с сервера с заданным размером пачки.
+ *
+ * @param connection Активное подключение.
+ * @param mfns Массив MFN записей.
+ * @param records Проинициализированный массив MarcRecord,
+ * в конец которого помещаются прочитанные записи.
+ * @param batchSize Количество записей, запрашиваемых за одно
+ * обращение к серверу (0 означает READ_RECORDS_BATCH).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_read_records_ex
+    (
+        Connection *connection,
+        const Int32Array *mfns,
+        Array *records,
+        size_t batchSize
+    )
+{
+    size_t offset, count;
+
+    assert (connection != NULL);
+    assert (mfns != NULL);
+    assert (records != NULL);
+    assert (records->itemSize == sizeof (MarcRecord));
+
+    if (!connection_check (connection)) {
+        return AM_FALSE;
+    }
+
+    if (batchSize == 0) {
+        batchSize = READ_RECORDS_BATCH;
+    }
+
+    for (offset = 0; offset < mfns->len; offset += count) {
+        count = mfns->len - offset;
+        if (count > batchSize) {
+            count = batchSize;
+        }
+
+        if (!connection_read_batch (connection, mfns, offset, count, records)) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
 /**
  * Чтение записи с сервера. Запись никак не раскодируется и возвращается
  * в виде текста.
@@ -1386,7 +2454,7 @@ MAGNA_API am_bool MAGNA_CALL connection_read_terms
         goto DONE;
     }
 
-    if (!connection_execute (connection, &query, &response)) {
+    if (!connection_execute_stream (connection, &query, &response)) {
         goto DONE;
     }
 
@@ -1422,6 +2490,7 @@ MAGNA_API am_bool MAGNA_CALL connection_read_text_file
     Response response;
     am_bool result = AM_FALSE;
     Span line;
+    size_t start;
 
     assert (specification != NULL);
     assert (buffer != NULL);
@@ -1430,6 +2499,11 @@ MAGNA_API am_bool MAGNA_CALL connection_read_text_file
         return AM_FALSE;
     }
 
+    if (connection->textCache != NULL
+        && text_cache_get (connection->textCache, specification, buffer)) {
+        return AM_TRUE;
+    }
+
     response_init (&response);
     if (!query_create (&query, connection, CBTEXT (READ_DOCUMENT))) {
         return AM_FALSE;
@@ -1448,7 +2522,20 @@ MAGNA_API am_bool MAGNA_CALL connection_read_text_file
         goto DONE;
     }
 
-    if (!irbis_to_client (buffer, line)) {
+    if (connection->textCache != NULL) {
+        start = buffer_length (buffer);
+        if (!irbis_to_client (buffer, line)) {
+            goto DONE;
+        }
+
+        text_cache_put
+            (
+                connection->textCache,
+                specification,
+                span_init (buffer->start + start, buffer_length (buffer) - start)
+            );
+    }
+    else if (!irbis_to_client (buffer, line)) {
         goto DONE;
     }
 
@@ -1529,6 +2616,95 @@ MAGNA_API am_bool MAGNA_CALL connection_reload_master_file
     return result;
 }
 
+/**
+ * Разрешение имени хоста сервера в адрес.
+ * Разрешенный адрес запоминается в подключении и используется
+ * всеми последующими запросами, пока не истечет `addressTtl`
+ * либо не будет изменено имя хоста. Таким образом, имя
+ * не разрешается заново при каждом обращении к серверу.
+ * Копии подключения (см. `connection_clone`) разделяют адрес
+ * через общую регистрацию: устаревший адрес копия сначала
+ * ищет там, а разрешенный заново сохраняет туда под защитой
+ * мьютекса регистрации.
+ *
+ * Вызывать функцию явно обычно не требуется: это делает
+ * `connection_execute`. Явный вызов с `refresh = AM_TRUE`
+ * позволяет принудительно обновить адрес (например,
+ * после смены записи в DNS).
+ *
+ * @param connection Подключение (не обязательно активное).
+ * @param refresh Разрешить имя заново, даже если адрес не устарел.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_resolve
+    (
+        Connection *connection,
+        am_bool refresh
+    )
+{
+    ConnectionSession *session;
+    const am_byte *hostname;
+    am_uint64 now;
+    am_bool result = AM_FALSE;
+
+    assert (connection != NULL);
+
+    now = magna_ticks ();
+    if (!refresh
+        && connection->addressExpires != 0
+        && now < connection->addressExpires) {
+        /* Порт мог быть изменен напрямую */
+        connection->address.port = (am_uint16) connection->port;
+        return AM_TRUE;
+    }
+
+    session = connection->session;
+    if (session != NULL) {
+        /* Разрешение под мьютексом: копии не разрешают имя одновременно */
+        mutex_lock (&session->mutex);
+        if (session->addressExpires != 0
+            && now < session->addressExpires
+            && (!refresh
+                || session->address.address != connection->address.address)) {
+            /* Другая копия уже разрешила имя (возможно, заново) */
+            connection->address = session->address;
+            connection->address.port = (am_uint16) connection->port;
+            connection->addressExpires = session->addressExpires;
+            result = AM_TRUE;
+            goto DONE;
+        }
+    }
+
+    connection->addressExpires = 0;
+    hostname = buffer_to_text (&connection->host);
+    if (hostname == NULL) {
+        /* TODO: document the error code */
+        connection->lastError = 100501;
+        goto DONE;
+    }
+
+    if (!tcp4_resolve (hostname, (am_uint16) connection->port, &connection->address)) {
+        goto DONE;
+    }
+
+    connection->addressExpires = connection->addressTtl == 0
+        ? ~(am_uint64) 0
+        : now + connection->addressTtl;
+    if (session != NULL) {
+        session->address = connection->address;
+        session->addressExpires = connection->addressExpires;
+    }
+
+    result = AM_TRUE;
+
+    DONE:
+    if (session != NULL) {
+        mutex_unlock (&session->mutex);
+    }
+
+    return result;
+}
+
 /**
  * Реорганизация мастер-файла указанной базы данных.
  *
@@ -1584,6 +2760,8 @@ MAGNA_API am_int32 MAGNA_CALL connection_search_count
         response_destroy (&response);
     }
 
+    search_parameters_destroy (&parameters);
+
     return result;
 }
 
@@ -1617,7 +2795,7 @@ MAGNA_API am_bool MAGNA_CALL connection_search_ex
     }
 
     if (!search_parameters_encode (parameters, connection, &query)
-        || !connection_execute (connection, &query, response)) {
+        || !connection_execute_stream (connection, &query, response)) {
         goto DONE;
     }
 
@@ -1667,6 +2845,8 @@ MAGNA_API am_bool MAGNA_CALL connection_search_simple
         response_destroy (&response);
     }
 
+    search_parameters_destroy (&parameters);
+
     return result;
 }
 
@@ -1756,7 +2936,7 @@ MAGNA_API am_bool MAGNA_CALL connection_undelete_record
     assert (connection != NULL);
     assert (mfn > 0u);
 
-    return AM_FALSE;
+    return connection_mark_record (connection, mfn, AM_FALSE);
 }
 
 /**
@@ -1922,7 +3102,8 @@ MAGNA_API am_int32 MAGNA_CALL connection_write_record
     if (!query_add_ansi (&query, database)
         || !query_add_uint32 (&query, 0)
         || !query_add_uint32 (&query, 1)
-        || !record_encode (record, IRBIS_DELIMITER, &query.buffer)) {
+        || !query_add_record (&query, record)
+        || !query_new_line (&query)) {
         goto DONE;
     }
 
@@ -1938,14 +3119,158 @@ MAGNA_API am_int32 MAGNA_CALL connection_write_record
     result = response.returnCode;
 
     if (reparse) {
-        /* TODO: implement */
+        if (!record_decode_text (record, response_remaining_utf_text (&response))) {
+            result = -1;
+        }
+    }
+
+    if (connection->recordCache != NULL) {
+        record_cache_invalidate
+            (
+                connection->recordCache,
+                connection_record_database (connection, record),
+                record->mfn
+            );
+        if (reparse && result >= 0) {
+            record_cache_put
+                (
+                    connection->recordCache,
+                    connection_record_database (connection, record),
+                    record
+                );
+        }
     }
 
     DONE:
     query_destroy (&query);
     response_destroy (&response);
 
-    return AM_FALSE;
+    return result;
+}
+
+/**
+ * Пакетное сохранение записей на сервере одной командой
+ * SAVE_RECORD_GROUP. После сохранения MFN, статус и версия
+ * каждой записи обновляются согласно ответу сервера.
+ *
+ * Вместо записи сервер может вернуть отрицательный код
+ * ошибки для нее. Такая запись остается без изменений,
+ * код заносится в lastError, остальные записи обновляются
+ * как обычно, а функция возвращает AM_FALSE.
+ *
+ * @param connection Активное подключение.
+ * @param records Массив MarcRecord, подлежащих сохранению.
+ * @return Признак того, что сервер сохранил все записи.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_write_records
+    (
+        Connection *connection,
+        Array *records
+    )
+{
+    Query query;             /* клиентский запрос */
+    Response response;       /* ответ сервера */
+    MarcRecord *record;      /* текущая запись */
+    MarcRecord saved;        /* запись в том виде, как ее вернул сервер */
+    const am_byte *database; /* имя базы данных */
+    Span line;               /* строка ответа */
+    size_t index;            /* индекс цикла */
+    am_bool rejected;        /* сервер отверг хотя бы одну запись */
+    am_bool result = AM_FALSE;
+
+    assert (connection != NULL);
+    assert (records != NULL);
+    assert (records->itemSize == sizeof (MarcRecord));
+
+    if (records->len == 0) {
+        return AM_TRUE;
+    }
+
+    if (!connection_check (connection)) {
+        return AM_FALSE;
+    }
+
+    record_init (&saved);
+    response_init (&response);
+    if (!query_create (&query, connection, CBTEXT (SAVE_RECORD_GROUP))) {
+        return AM_FALSE;
+    }
+
+    /* Не блокировать записи, актуализировать словарь */
+    if (!query_add_uint32 (&query, 0)
+        || !query_add_uint32 (&query, 1)) {
+        goto DONE;
+    }
+
+    for (index = 0; index < records->len; ++index) {
+        record = (MarcRecord*) array_get (records, index);
+        database = choose_string
+            (
+                B2B (&record->database),
+                B2B (&connection->database),
+                NULL
+            );
+        if (database == NULL
+            || !buffer_puts (&query.buffer, database)
+            || !buffer_puts (&query.buffer, CBTEXT (IRBIS_DELIMITER))
+            || !query_add_record (&query, record)
+            || !query_new_line (&query)) {
+            goto DONE;
+        }
+    }
+
+    if (!connection_execute_stream (connection, &query, &response)) {
+        goto DONE;
+    }
+
+    if (!response_check (&response, 0)) {
+        goto DONE;
+    }
+
+    /* Строки ответа идут в том же порядке, что и записи */
+    rejected = AM_FALSE;
+    for (index = 0; index < records->len; ++index) {
+        if (response_eot (&response)) {
+            goto DONE;
+        }
+
+        /* Сохраненная запись начинается с MFN, ошибка -- с минуса */
+        line = response_get_line (&response);
+        if (!span_is_empty (line) && line.start[0] == '-') {
+            connection->lastError = span_to_int32 (line);
+            rejected = AM_TRUE;
+            continue;
+        }
+
+        if (!record_decode_text (&saved, line)) {
+            goto DONE;
+        }
+
+        record = (MarcRecord*) array_get (records, index);
+        record->mfn = saved.mfn;
+        record->status = saved.status;
+        record->version = saved.version;
+
+        /* Копия новой версии, уже попавшая в кэш, сохраняется */
+        if (connection->recordCache != NULL) {
+            record_cache_validate
+                (
+                    connection->recordCache,
+                    connection_record_database (connection, record),
+                    record->mfn,
+                    record->version
+                );
+        }
+    }
+
+    result = !response.broken && !rejected;
+
+    DONE:
+    query_destroy (&query);
+    response_destroy (&response);
+    record_destroy (&saved);
+
+    return result;
 }
 
 /**
@@ -1991,7 +3316,12 @@ MAGNA_API am_bool MAGNA_CALL connection_write_text_file
     query_destroy (&query);
     response_destroy (&response);
 
-    return AM_FALSE;
+    /* Содержимое файла на сервере могло измениться */
+    if (connection->textCache != NULL) {
+        text_cache_invalidate (connection->textCache, specification);
+    }
+
+    return result;
 }
 
 /*=========================================================*/
@@ -0,0 +1,600 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file cursor.c
+ *
+ * Курсоры для постраничного перебора данных на сервере.
+ *
+ * \struct SearchCursor
+ *      \brief Перебор всех найденных записей страница за страницей.
+ *
+ * \details Первая страница читается сразу, через подключение,
+ * переданное в `search_cursor_create`. Все последующие страницы
+ * читаются в фоновом потоке через копию этого подключения
+ * (см. `connection_clone`): пока вызывающий код обрабатывает
+ * страницу N, курсор уже получает с сервера страницу N+1.
+ * Таким образом, задержка сервера почти полностью скрывается.
+ * Копия разделяет с образцом регистрацию на сервере, так что
+ * второй клиент не регистрируется и лицензия не расходуется.
+ *
+ * Переданное подключение используется только при создании курсора,
+ * после чего его можно свободно использовать для других запросов
+ * (например, для чтения найденных записей) и даже отключить:
+ * регистрация снимается, когда отключится и копия курсора.
+ *
+ * \code
+ * SearchParameters parameters;
+ * SearchCursor cursor;
+ * const FoundLine *found;
+ *
+ * search_parameters_create (&parameters, CBTEXT ("K=ALG$"));
+ * if (search_cursor_create (&cursor, &connection, &parameters)) {
+ *     while ((found = search_cursor_next (&cursor)) != NULL) {
+ *         printf ("%u\n", found->mfn);
+ *     }
+ * }
+ *
+ * search_cursor_destroy (&cursor);
+ * search_parameters_destroy (&parameters);
+ * \endcode
+ *
+ * \struct TermCursor
+ *      \brief Обход поискового словаря порциями терминов.
+ *
+ * \details Курсор сам строит продолжение: следующая порция
+ * запрашивается начиная с последнего термина предыдущей,
+ * а повторно полученный стартовый термин пропускается.
+ * Обход заканчивается, когда сервер возвращает неполную порцию.
+ * Поддерживается и обратный порядок (`reverseOrder`,
+ * команда READ_TERMS_REVERSE).
+ *
+ * Как и в SearchCursor, первая порция читается через переданное
+ * подключение, а каждая следующая -- в фоне, через копию
+ * подключения с общей регистрацией, пока вызывающий код
+ * разбирает текущую.
+ */
+
+/*=========================================================*/
+
+/* Освобождение элементов массива без освобождения самого массива. */
+static void cursor_clear_array
+    (
+        Array *array,
+        Liberator liberator
+    )
+{
+    size_t index;
+
+    for (index = 0; index < array->len; ++index) {
+        liberator (array_get (array, index));
+    }
+
+    array_clear (array);
+}
+
+/* Копирование параметров поиска, чтобы курсор не зависел от вызывающего. */
+static am_bool cursor_copy_parameters
+    (
+        SearchParameters *target,
+        const SearchParameters *source
+    )
+{
+    target->firstRecord = source->firstRecord;
+    target->minMfn = source->minMfn;
+    target->maxMfn = source->maxMfn;
+    target->number = source->number;
+
+    return buffer_copy (&target->expression, &source->expression)
+        && buffer_copy (&target->database, &source->database)
+        && buffer_copy (&target->format, &source->format)
+        && buffer_copy (&target->sequential, &source->sequential)
+        && buffer_copy (&target->filter, &source->filter);
+}
+
+/* Чтение одной страницы найденных записей. */
+static am_bool search_cursor_fetch
+    (
+        Connection *connection,
+        const SearchParameters *parameters,
+        am_mfn first,
+        am_mfn count,
+        Array *page,
+        am_mfn *total
+    )
+{
+    SearchParameters local;
+    Response response;
+    am_bool result = AM_FALSE;
+
+    /* Буферы не изменяются, так что достаточно поверхностной копии */
+    local = *parameters;
+    local.firstRecord = first;
+    local.number = count;
+
+    if (!connection_search_ex (connection, &local, &response)) {
+        goto DONE;
+    }
+
+    *total = (am_mfn) response_read_int32 (&response);
+    result = found_decode_response (page, &response);
+
+    DONE:
+    response_destroy (&response);
+
+    return result;
+}
+
+/* Тело потока упреждающего чтения. */
+static void MAGNA_CALL search_cursor_prefetch
+    (
+        void *data
+    )
+{
+    SearchCursor *cursor = (SearchCursor*) data;
+    am_mfn total;
+
+    if (!search_cursor_fetch (&cursor->worker, &cursor->parameters,
+            cursor->nextFirst, cursor->pageSize, &cursor->next, &total)) {
+        cursor->lastError = cursor->worker.lastError;
+        cursor->failed = AM_TRUE;
+    }
+}
+
+/* Запуск упреждающего чтения следующей страницы, если она есть. */
+static void search_cursor_schedule
+    (
+        SearchCursor *cursor
+    )
+{
+    if (cursor->failed
+        || cursor->nextFirst == 0
+        || cursor->nextFirst > cursor->total) {
+        return;
+    }
+
+    cursor->thread = thread_start (search_cursor_prefetch, cursor);
+    if (handle_is_good (cursor->thread)) {
+        cursor->pending = AM_TRUE;
+    }
+    else {
+        /* Потоки недоступны: читаем страницу здесь же */
+        search_cursor_prefetch (cursor);
+        cursor->pending = !cursor->failed;
+    }
+}
+
+/*=========================================================*/
+
+/**
+ * Создание курсора и чтение первой страницы найденных записей.
+ *
+ * @param cursor Указатель на неинициализированную структуру.
+ * @param connection Активное подключение. Используется только
+ * для чтения первой страницы, а также как образец для копии,
+ * разделяющей с ним регистрацию.
+ * @param parameters Параметры поиска (копируются). Поле `number`
+ * задает размер страницы (0 означает SEARCH_CURSOR_PAGE).
+ * @return Признак успешного завершения операции.
+ * @warning Даже в случае неудачи курсор необходимо
+ * освободить с помощью `search_cursor_destroy`.
+ */
+MAGNA_API am_bool MAGNA_CALL search_cursor_create
+    (
+        SearchCursor *cursor,
+        Connection *connection,
+        const SearchParameters *parameters
+    )
+{
+    assert (cursor != NULL);
+    assert (connection != NULL);
+    assert (parameters != NULL);
+
+    mem_clear (cursor, sizeof (*cursor));
+    search_parameters_init (&cursor->parameters);
+    found_array_init (&cursor->current);
+    found_array_init (&cursor->next);
+    cursor->thread = handle_get_bad ();
+
+    if (!connection_create (&cursor->worker)
+        || !cursor_copy_parameters (&cursor->parameters, parameters)) {
+        cursor->failed = AM_TRUE;
+        return AM_FALSE;
+    }
+
+    if (!connection_clone (&cursor->worker, connection)) {
+        cursor->lastError = cursor->worker.lastError;
+        cursor->failed = AM_TRUE;
+        return AM_FALSE;
+    }
+
+    cursor->pageSize = parameters->number;
+    if (cursor->pageSize == 0) {
+        cursor->pageSize = SEARCH_CURSOR_PAGE;
+    }
+
+    if (cursor->parameters.firstRecord == 0) {
+        cursor->parameters.firstRecord = 1;
+    }
+
+    if (!search_cursor_fetch (connection, &cursor->parameters,
+            cursor->parameters.firstRecord, cursor->pageSize,
+            &cursor->current, &cursor->total)) {
+        cursor->lastError = connection->lastError;
+        cursor->failed = AM_TRUE;
+        return AM_FALSE;
+    }
+
+    if (cursor->current.len != 0) {
+        cursor->nextFirst = cursor->parameters.firstRecord
+            + (am_mfn) cursor->current.len;
+        search_cursor_schedule (cursor);
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых курсором.
+ * Дожидается окончания упреждающего чтения
+ * и отключает копию подключения.
+ *
+ * @param cursor Курсор.
+ */
+MAGNA_API void MAGNA_CALL search_cursor_destroy
+    (
+        SearchCursor *cursor
+    )
+{
+    assert (cursor != NULL);
+
+    if (cursor->pending && handle_is_good (cursor->thread)) {
+        thread_wait (cursor->thread);
+    }
+
+    found_array_destroy (&cursor->current);
+    found_array_destroy (&cursor->next);
+    search_parameters_destroy (&cursor->parameters);
+    connection_destroy (&cursor->worker);
+    mem_clear (cursor, sizeof (*cursor));
+}
+
+/**
+ * Переход к следующей найденной записи.
+ * При исчерпании текущей страницы подхватывает страницу,
+ * прочитанную в фоне, и запускает чтение следующей.
+ *
+ * @param cursor Курсор.
+ * @return Указатель на строку найденной записи (действителен
+ * до следующего вызова) либо `NULL`, если записи кончились
+ * или произошла ошибка (см. `failed` и `lastError`).
+ */
+MAGNA_API const FoundLine* MAGNA_CALL search_cursor_next
+    (
+        SearchCursor *cursor
+    )
+{
+    Array temp;
+
+    assert (cursor != NULL);
+
+    while (cursor->position >= cursor->current.len) {
+        if (!cursor->pending) {
+            return NULL;
+        }
+
+        if (handle_is_good (cursor->thread)) {
+            thread_wait (cursor->thread);
+            cursor->thread = handle_get_bad ();
+        }
+
+        cursor->pending = AM_FALSE;
+        if (cursor->failed) {
+            return NULL;
+        }
+
+        temp = cursor->current;
+        cursor->current = cursor->next;
+        cursor->next = temp;
+        cursor_clear_array (&cursor->next, (Liberator) found_destroy);
+        cursor->position = 0;
+
+        if (cursor->current.len == 0) {
+            return NULL;
+        }
+
+        cursor->nextFirst += (am_mfn) cursor->current.len;
+        search_cursor_schedule (cursor);
+    }
+
+    return (const FoundLine*) array_get (&cursor->current, cursor->position++);
+}
+
+static void* MAGNA_CALL search_cursor_enum_next
+    (
+        Enumerator *enumerator
+    )
+{
+    return (void*) search_cursor_next ((SearchCursor*) enumerator->data1.pointer);
+}
+
+/**
+ * Получение перечислителя для курсора.
+ * Элементы перечисления -- указатели на `FoundLine`.
+ *
+ * @param cursor Курсор (остается во владении вызывающего кода).
+ * @param enumerator Указатель на заполняемую структуру.
+ */
+MAGNA_API void MAGNA_CALL search_cursor_enumerator
+    (
+        SearchCursor *cursor,
+        Enumerator *enumerator
+    )
+{
+    assert (cursor != NULL);
+    assert (enumerator != NULL);
+
+    mem_clear (enumerator, sizeof (*enumerator));
+    enumerator->next = search_cursor_enum_next;
+    enumerator->data1.pointer = cursor;
+}
+
+/*=========================================================*/
+
+/* Копирование параметров обхода словаря. */
+static am_bool cursor_copy_term_parameters
+    (
+        TermParameters *target,
+        const TermParameters *source
+    )
+{
+    target->number = source->number;
+    target->reverseOrder = source->reverseOrder;
+
+    return buffer_copy (&target->database, &source->database)
+        && buffer_copy (&target->startTerm, &source->startTerm)
+        && buffer_copy (&target->format, &source->format);
+}
+
+/* Тело потока упреждающего чтения терминов. */
+static void MAGNA_CALL term_cursor_prefetch
+    (
+        void *data
+    )
+{
+    TermCursor *cursor = (TermCursor*) data;
+
+    if (!connection_read_terms (&cursor->worker, &cursor->parameters, &cursor->next)) {
+        cursor->lastError = cursor->worker.lastError;
+        cursor->failed = AM_TRUE;
+    }
+}
+
+/*
+ * Подготовка продолжения после получения очередной порции:
+ * если в порции есть новые термины, следующая начинается с ее
+ * последнего термина и запрашивается в фоне. Стартовый термин,
+ * повторно выданный сервером, пропускается. Короткая порция
+ * не означает конца словаря: сервер вправе урезать ее размер,
+ * поэтому обход заканчивается только на порции без новых терминов.
+ */
+static am_bool term_cursor_continue
+    (
+        TermCursor *cursor
+    )
+{
+    const Term *term;
+    size_t received = cursor->current.len;
+
+    cursor->position = 0;
+    if (received == 0) {
+        return AM_TRUE;
+    }
+
+    term = (const Term*) array_get (&cursor->current, 0);
+    if (cursor->skipStart
+        && buffer_compare (&term->text, &cursor->parameters.startTerm) == 0) {
+        cursor->position = 1;
+    }
+
+    if (received == cursor->position) {
+        /* Словарь исчерпан: в порции лишь повтор стартового термина */
+        return AM_TRUE;
+    }
+
+    term = (const Term*) array_get (&cursor->current, received - 1);
+    if (!buffer_copy (&cursor->parameters.startTerm, &term->text)) {
+        cursor->failed = AM_TRUE;
+        return AM_FALSE;
+    }
+
+    cursor->skipStart = AM_TRUE;
+    cursor->thread = thread_start (term_cursor_prefetch, cursor);
+    if (handle_is_good (cursor->thread)) {
+        cursor->pending = AM_TRUE;
+    }
+    else {
+        /* Потоки недоступны: читаем порцию здесь же */
+        term_cursor_prefetch (cursor);
+        cursor->pending = !cursor->failed;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Создание курсора и чтение первой порции терминов.
+ *
+ * @param cursor Указатель на неинициализированную структуру.
+ * @param connection Активное подключение. Используется только
+ * для чтения первой порции, а также как образец для копии,
+ * разделяющей с ним регистрацию.
+ * @param parameters Параметры (копируются): база данных,
+ * стартовый термин, порядок обхода. Поле `number` задает
+ * размер порции (0 означает TERM_CURSOR_BATCH).
+ * @return Признак успешного завершения операции.
+ * @warning Даже в случае неудачи курсор необходимо
+ * освободить с помощью `term_cursor_destroy`.
+ */
+MAGNA_API am_bool MAGNA_CALL term_cursor_create
+    (
+        TermCursor *cursor,
+        Connection *connection,
+        const TermParameters *parameters
+    )
+{
+    assert (cursor != NULL);
+    assert (connection != NULL);
+    assert (parameters != NULL);
+
+    mem_clear (cursor, sizeof (*cursor));
+    term_parameters_init (&cursor->parameters);
+    term_array_init (&cursor->current);
+    term_array_init (&cursor->next);
+    cursor->thread = handle_get_bad ();
+
+    if (!connection_create (&cursor->worker)
+        || !cursor_copy_term_parameters (&cursor->parameters, parameters)) {
+        cursor->failed = AM_TRUE;
+        return AM_FALSE;
+    }
+
+    if (!connection_clone (&cursor->worker, connection)) {
+        cursor->lastError = cursor->worker.lastError;
+        cursor->failed = AM_TRUE;
+        return AM_FALSE;
+    }
+
+    if (cursor->parameters.number == 0) {
+        cursor->parameters.number = TERM_CURSOR_BATCH;
+    }
+
+    if (!connection_read_terms (connection, &cursor->parameters, &cursor->current)) {
+        cursor->lastError = connection->lastError;
+        cursor->failed = AM_TRUE;
+        return AM_FALSE;
+    }
+
+    return term_cursor_continue (cursor);
+}
+
+/**
+ * Освобождение ресурсов, занятых курсором.
+ * Дожидается окончания упреждающего чтения
+ * и отключает копию подключения.
+ *
+ * @param cursor Курсор.
+ */
+MAGNA_API void MAGNA_CALL term_cursor_destroy
+    (
+        TermCursor *cursor
+    )
+{
+    assert (cursor != NULL);
+
+    if (cursor->pending && handle_is_good (cursor->thread)) {
+        thread_wait (cursor->thread);
+    }
+
+    term_array_destroy (&cursor->current);
+    term_array_destroy (&cursor->next);
+    term_parameters_destroy (&cursor->parameters);
+    connection_destroy (&cursor->worker);
+    mem_clear (cursor, sizeof (*cursor));
+}
+
+/**
+ * Переход к следующему термину словаря.
+ *
+ * @param cursor Курсор.
+ * @return Указатель на термин (действителен до следующего вызова)
+ * либо `NULL`, если словарь исчерпан или произошла ошибка
+ * (см. `failed` и `lastError`).
+ */
+MAGNA_API const Term* MAGNA_CALL term_cursor_next
+    (
+        TermCursor *cursor
+    )
+{
+    Array temp;
+
+    assert (cursor != NULL);
+
+    while (cursor->position >= cursor->current.len) {
+        if (!cursor->pending) {
+            return NULL;
+        }
+
+        if (handle_is_good (cursor->thread)) {
+            thread_wait (cursor->thread);
+            cursor->thread = handle_get_bad ();
+        }
+
+        cursor->pending = AM_FALSE;
+        if (cursor->failed) {
+            return NULL;
+        }
+
+        temp = cursor->current;
+        cursor->current = cursor->next;
+        cursor->next = temp;
+        cursor_clear_array (&cursor->next, (Liberator) term_destroy);
+
+        if (!term_cursor_continue (cursor)) {
+            return NULL;
+        }
+    }
+
+    return (const Term*) array_get (&cursor->current, cursor->position++);
+}
+
+static void* MAGNA_CALL term_cursor_enum_next
+    (
+        Enumerator *enumerator
+    )
+{
+    return (void*) term_cursor_next ((TermCursor*) enumerator->data1.pointer);
+}
+
+/**
+ * Получение перечислителя для курсора.
+ * Элементы перечисления -- указатели на `Term`.
+ *
+ * @param cursor Курсор (остается во владении вызывающего кода).
+ * @param enumerator Указатель на заполняемую структуру.
+ */
+MAGNA_API void MAGNA_CALL term_cursor_enumerator
+    (
+        TermCursor *cursor,
+        Enumerator *enumerator
+    )
+{
+    assert (cursor != NULL);
+    assert (enumerator != NULL);
+
+    mem_clear (enumerator, sizeof (*enumerator));
+    enumerator->next = term_cursor_enum_next;
+    enumerator->data1.pointer = cursor;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
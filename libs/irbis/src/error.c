@@ -172,10 +172,37 @@ MAGNA_API const char* MAGNA_CALL irbis_describe_error
         case -100003:
             return "Не подключен к серверу";
 
+        case -100004:
+            return "Истекло время ожидания ответа сервера";
+
         default: return "Неизвестная ошибка";
     }
 }
 
+/**
+ * Является ли код ошибки признаком сбоя связи с сервером
+ * (в отличие от ошибок, о которых сообщил сам сервер).
+ *
+ * @param code Код ошибки.
+ * @return Результат проверки.
+ */
+MAGNA_API am_bool MAGNA_CALL irbis_is_network_error
+    (
+        am_int32 code
+    )
+{
+    switch (code)
+    {
+        case -100001: /* ошибка создания сокета */
+        case -100002: /* сбой сети */
+        case -100004: /* истекло время ожидания */
+            return AM_TRUE;
+
+        default:
+            return AM_FALSE;
+    }
+}
+
 /*=========================================================*/
 
 #include "warnpop.h"
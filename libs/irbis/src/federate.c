@@ -0,0 +1,392 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file federate.c
+ *
+ * Федеративный поиск: одно поисковое выражение
+ * в нескольких базах данных одновременно.
+ *
+ * \struct FederatedSearch
+ *      \brief Результаты поиска по всем базам данных.
+ *
+ * \details Запросы ко всем базам данных отправляются разом,
+ * каждый через собственный сокет, и обслуживаются одним
+ * циклом `AsyncEngine`. Поэтому общее время поиска
+ * определяется самой медленной базой данных,
+ * а не суммой времен.
+ *
+ * Как и `connection_search_simple`, для каждой базы данных
+ * возвращается первая порция найденных MFN (сколько сервер
+ * поместит в один ответ) и общее количество найденных записей.
+ * Ошибка в одной базе данных не мешает получить
+ * результаты по остальным.
+ *
+ * Срок, заданный `connection_set_deadline`, распространяется
+ * на весь поиск целиком. База данных, сервер которой
+ * не ответил (оборвал соединение, не уложился в срок),
+ * считается неудачной, а не пустой.
+ *
+ * Если у подключения есть ограничитель одновременных
+ * команд (`connection-&gt;limiter`), каждый запрос занимает
+ * у него место. Пока места нет, продолжается обработка
+ * уже отправленных запросов, так что поиск не блокирует
+ * сам себя, даже если баз данных больше, чем мест.
+ *
+ * \code
+ * FederatedSearch search;
+ * SpanArray databases;
+ * const FederatedResult *result;
+ *
+ * span_array_create (&databases, 4);
+ * span_split_by_char (TEXT_SPAN ("IBIS,RDR,ISTU"), &databases, ',');
+ *
+ * federated_search_create (&search);
+ * if (connection_search_federated (&connection, &databases,
+ *     CBTEXT ("K=ALG$"), &search)) {
+ *     for (i = 0; i < search.results.len; ++i) {
+ *         result = federated_search_get (&search, i);
+ *         ...
+ *     }
+ * }
+ *
+ * federated_search_destroy (&search);
+ * span_array_destroy (&databases);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+/* Запрос по одной базе данных */
+typedef struct
+{
+    Response response;           /* Ответ сервера. */
+    FederatedResult *result;     /* Результат по базе данных. */
+    ConcurrencyLimiter *limiter; /* Занятый ограничитель (либо NULL). */
+    am_uint64 started;           /* Момент занятия места. */
+
+} FederatedCall;
+
+static void MAGNA_CALL federated_free_result
+    (
+        void *item
+    )
+{
+    FederatedResult *result = (FederatedResult*) item;
+
+    buffer_destroy (&result->database);
+    int32_array_destroy (&result->found);
+}
+
+/* Разбор ответа сервера по одной базе данных */
+static void MAGNA_CALL federated_on_response
+    (
+        Response *response,
+        am_bool success,
+        void *data
+    )
+{
+    FederatedCall *call = (FederatedCall*) data;
+    FederatedResult *result = call->result;
+
+    if (call->limiter != NULL) {
+        limiter_release (call->limiter, call->started, success);
+        call->limiter = NULL;
+    }
+
+    if (!success) {
+        result->error = response->connection->lastError == -100004
+            ? -100004
+            : -100002;
+        return;
+    }
+
+    if (response_get_return_code (response) < 0) {
+        result->error = response->returnCode;
+        return;
+    }
+
+    result->count = response_read_int32 (response);
+    if (!found_decode_response_mfn (&result->found, response)) {
+        result->count = -1;
+        result->error = -100002;
+    }
+}
+
+/* Запрос не удалось отправить: место у ограничителя освобождается */
+static void federated_fail
+    (
+        FederatedCall *call,
+        am_int32 error
+    )
+{
+    call->result->error = error;
+    if (call->limiter != NULL) {
+        limiter_release (call->limiter, call->started, AM_FALSE);
+        call->limiter = NULL;
+    }
+}
+
+/*
+ * Занятие места у ограничителя не дольше срока `deadline`.
+ * Пока места нет, обрабатываются уже отправленные запросы:
+ * завершаясь, они освобождают свои места.
+ */
+static am_bool federated_take_slot
+    (
+        ConcurrencyLimiter *limiter,
+        AsyncEngine *engine,
+        am_uint64 deadline,
+        am_uint64 *started
+    )
+{
+    am_uint64 now;
+    am_int32 timeout = -1;
+
+    while (!limiter_acquire_for (limiter, 0, started)) {
+        if (deadline != 0) {
+            now = magna_ticks ();
+            if (now >= deadline) {
+                return AM_FALSE;
+            }
+
+            timeout = deadline - now > 0x7FFFFFFFu
+                ? 0x7FFFFFFF
+                : (am_int32) (deadline - now);
+        }
+
+        /* Места занимают другие потоки: остается только ждать */
+        if (async_engine_pending (engine) == 0) {
+            return limiter_acquire_for (limiter, timeout, started);
+        }
+
+        if (async_engine_run_once (engine, timeout) < 0) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/*=========================================================*/
+
+/**
+ * Инициализация структуры для результатов.
+ *
+ * @param search Указатель на неинициализированную структуру.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL federated_search_create
+    (
+        FederatedSearch *search
+    )
+{
+    assert (search != NULL);
+
+    mem_clear (search, sizeof (*search));
+
+    return array_create (&search->results, sizeof (FederatedResult), 4);
+}
+
+/**
+ * Освобождение ресурсов, занятых результатами.
+ *
+ * @param search Результаты поиска.
+ */
+MAGNA_API void MAGNA_CALL federated_search_destroy
+    (
+        FederatedSearch *search
+    )
+{
+    assert (search != NULL);
+
+    array_destroy (&search->results, federated_free_result);
+    mem_clear (search, sizeof (*search));
+}
+
+/**
+ * Результат поиска по базе данных с указанным индексом
+ * (в порядке перечисления баз данных).
+ *
+ * @param search Результаты поиска.
+ * @param index Индекс базы данных.
+ * @return Указатель на результат.
+ */
+MAGNA_API const FederatedResult* MAGNA_CALL federated_search_get
+    (
+        const FederatedSearch *search,
+        size_t index
+    )
+{
+    assert (search != NULL);
+    assert (index < search->results.len);
+
+    return (const FederatedResult*) array_get (&search->results, index);
+}
+
+/**
+ * Поиск записей в нескольких базах данных одновременно.
+ *
+ * @param connection Активное подключение.
+ * @param databases Имена баз данных.
+ * @param expression Поисковое выражение.
+ * @param search Инициализированная структура для результатов
+ * (прежнее содержимое уничтожается).
+ * @return `AM_TRUE`, если поиск хотя бы в одной базе данных
+ * завершился успешно.
+ */
+MAGNA_API am_bool MAGNA_CALL connection_search_federated
+    (
+        Connection *connection,
+        const SpanArray *databases,
+        const am_byte *expression,
+        FederatedSearch *search
+    )
+{
+    am_bool result = AM_FALSE;   /* признак успеха */
+    SearchParameters parameters; /* параметры поиска */
+    FederatedResult *item;       /* результат по одной базе данных */
+    FederatedCall *calls;        /* запросы по базам данных */
+    AsyncEngine engine;          /* цикл обработки событий */
+    am_uint64 deadline = 0;      /* срок завершения поиска */
+    Query query;
+    size_t index;
+
+    assert (connection != NULL);
+    assert (databases != NULL);
+    assert (expression != NULL);
+    assert (search != NULL);
+
+    federated_search_destroy (search);
+    if (!federated_search_create (search)) {
+        return AM_FALSE;
+    }
+
+    for (index = 0; index < databases->len; ++index) {
+        item = (FederatedResult*) array_emplace_back (&search->results);
+        if (item == NULL) {
+            return AM_FALSE;
+        }
+
+        mem_clear (item, sizeof (*item));
+        item->count = -1;
+        if (!buffer_assign_span (&item->database, span_array_get (databases, index))) {
+            return AM_FALSE;
+        }
+    }
+
+    if (databases->len == 0 || !connection_check (connection)) {
+        return AM_FALSE;
+    }
+
+    calls = (FederatedCall*) mem_alloc (databases->len * sizeof (FederatedCall));
+    if (calls == NULL) {
+        return AM_FALSE;
+    }
+
+    for (index = 0; index < databases->len; ++index) {
+        response_init (&calls [index].response);
+        calls [index].result = (FederatedResult*) array_get (&search->results, index);
+        calls [index].limiter = NULL;
+    }
+
+    if (!search_parameters_create (&parameters, expression)) {
+        mem_free (calls);
+        return AM_FALSE;
+    }
+
+    if (!async_engine_create (&engine)) {
+        goto DONE;
+    }
+
+    deadline = connection_get_deadline (connection);
+
+    /* Все запросы отправляются разом (насколько позволяет ограничитель) */
+    for (index = 0; index < databases->len; ++index) {
+        item = calls [index].result;
+        if (connection->limiter != NULL) {
+            if (!federated_take_slot
+                (
+                    connection->limiter,
+                    &engine,
+                    deadline,
+                    &calls [index].started
+                )) {
+                item->error = -100004;
+                continue;
+            }
+
+            calls [index].limiter = connection->limiter;
+        }
+
+        if (!buffer_copy (&parameters.database, &item->database)
+            || !query_create (&query, connection, CBTEXT (SEARCH))) {
+            federated_fail (&calls [index], -100001);
+            continue;
+        }
+
+        if (!search_parameters_encode (&parameters, connection, &query)
+            || !connection_execute_async
+                (
+                    connection,
+                    &engine,
+                    &query,
+                    &calls [index].response,
+                    federated_on_response,
+                    &calls [index]
+                )) {
+            federated_fail (&calls [index], -100001);
+        }
+
+        query_destroy (&query);
+    }
+
+    /* Сроки отдельных запросов соблюдает сам движок */
+    async_engine_run (&engine);
+
+    /* Незавершенные запросы прерываются с ошибкой */
+    async_engine_destroy (&engine);
+
+    for (index = 0; index < databases->len; ++index) {
+        item = (FederatedResult*) array_get (&search->results, index);
+        if (item->error == 0 && item->count >= 0) {
+            search->total += item->count;
+            result = AM_TRUE;
+        }
+        else {
+            ++search->failed;
+        }
+    }
+
+    DONE:
+    for (index = 0; index < databases->len; ++index) {
+        response_destroy (&calls [index].response);
+    }
+
+    mem_free (calls);
+    search_parameters_destroy (&parameters);
+
+    return result;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
@@ -0,0 +1,277 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file fulltext.c
+ *
+ * Полнотекстовый поиск (команда `R`).
+ *
+ * \struct FullTextParameters
+ *      \brief Параметры полнотекстового поиска.
+ *      \details Повторяют `SearchParameters`, к которым
+ *      добавлен текст полнотекстового запроса.
+ *      Владеют собственной памятью, для освобождения
+ *      используйте `fulltext_parameters_destroy`.
+ *
+ * \var FullTextParameters::text
+ *      \brief Полнотекстовый запрос. Обязателен.
+ *
+ * \var FullTextParameters::expression
+ *      \brief Выражение для поиска по словарю, сужающее
+ *      область полнотекстового поиска (опционально).
+ *
+ * \var FullTextParameters::database
+ *      \brief Имя базы данных (опционально). Если не задано,
+ *      поиск производится по текущей базе данных.
+ *
+ * \var FullTextParameters::format
+ *      \brief Формат, применяемый к каждой найденной записи
+ *      (опционально). Результат расформатирования попадает
+ *      в `FoundLine::description`.
+ *
+ * \var FullTextParameters::firstRecord
+ *      \brief Индекс первой из возвращаемых записей. По умолчанию `1`.
+ *      `0` означает, что будет возвращено только количество
+ *      найденных записей.
+ *
+ * \var FullTextParameters::minMfn
+ *      \brief Минимальный MFN для поиска (опционально).
+ *
+ * \var FullTextParameters::maxMfn
+ *      \brief Максимальный MFN для поиска (опционально).
+ *
+ * \var FullTextParameters::number
+ *      \brief Количество возвращаемых записей (`0` означает "все").
+ *
+ * \details Найденных по полному тексту записей бывает много,
+ * а с форматированием ответ сервера становится очень объемным.
+ * Поэтому ответ принимается в потоковом режиме
+ * (см. `connection_execute_stream`), и каждая найденная
+ * запись передается обработчику сразу после разбора,
+ * не дожидаясь приема всего ответа.
+ *
+ * \code
+ * static am_bool MAGNA_CALL print_found (const FoundLine *found, void *data)
+ * {
+ *     printf ("%u %s\n", found->mfn, B2T (&found->description));
+ *     return AM_TRUE;
+ * }
+ *
+ * FullTextParameters parameters;
+ *
+ * fulltext_parameters_create (&parameters, CBTEXT ("электрическая дуга"));
+ * buffer_assign_text (&parameters.format, CBTEXT ("@brief"));
+ * count = connection_search_fulltext (&connection, &parameters, print_found, NULL);
+ * fulltext_parameters_destroy (&parameters);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+/**
+ * Простая инициализация параметров поиска.
+ * Не выделяет память в куче.
+ *
+ * @param parameters Параметры поиска, подлежащие инициализации.
+ */
+MAGNA_API void MAGNA_CALL fulltext_parameters_init
+    (
+        FullTextParameters *parameters
+    )
+{
+    assert (parameters != NULL);
+
+    mem_clear (parameters, sizeof (*parameters));
+    parameters->firstRecord = 1;
+}
+
+/**
+ * Инициализация параметров текстом полнотекстового запроса.
+ * Размещает в куче копию текста.
+ *
+ * @param parameters Указатель на неинициализированную структуру.
+ * @param text Полнотекстовый запрос.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL fulltext_parameters_create
+    (
+        FullTextParameters *parameters,
+        const am_byte *text
+    )
+{
+    assert (parameters != NULL);
+    assert (text != NULL);
+
+    fulltext_parameters_init (parameters);
+
+    return buffer_assign_text (&parameters->text, text);
+}
+
+/**
+ * Освобождение ресурсов, занятых параметрами поиска.
+ *
+ * @param parameters Структура, подлежащая освобождению.
+ */
+MAGNA_API void MAGNA_CALL fulltext_parameters_destroy
+    (
+        FullTextParameters *parameters
+    )
+{
+    assert (parameters != NULL);
+
+    buffer_destroy (&parameters->text);
+    buffer_destroy (&parameters->expression);
+    buffer_destroy (&parameters->database);
+    buffer_destroy (&parameters->format);
+    mem_clear (parameters, sizeof (*parameters));
+}
+
+/**
+ * Кодирование параметров поиска в клиентском запросе.
+ * Сначала следуют те же строки, что и для обычного поиска,
+ * затем полнотекстовый запрос.
+ *
+ * @param parameters Параметры поиска.
+ * @param connection Подключение (для имени текущей базы данных).
+ * @param query Клиентский запрос.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL fulltext_parameters_encode
+    (
+        const FullTextParameters *parameters,
+        const Connection *connection,
+        Query *query
+    )
+{
+    Buffer *database; /* имя базы данных */
+    Buffer format;    /* формат в виде C-строки */
+    am_bool result;
+
+    assert (parameters != NULL);
+    assert (connection != NULL);
+    assert (query != NULL);
+
+    /* Если база данных не указана явно, используем текущую. */
+    database = choose_buffer (&parameters->database, &connection->database, NULL);
+
+    if (!query_add_ansi_buffer (query, database)
+        || !query_add_utf_buffer (query, &parameters->expression)
+        || !query_add_uint32 (query, parameters->number)
+        || !query_add_uint32 (query, parameters->firstRecord)) {
+        return AM_FALSE;
+    }
+
+    if (buffer_is_empty (&parameters->format)) {
+        result = query_add_ansi (query, CBTEXT (""));
+    }
+    else {
+        buffer_init (&format);
+        result = buffer_copy (&format, &parameters->format)
+            && query_add_format (query, B2B (&format));
+        buffer_destroy (&format);
+    }
+
+    return result
+        && query_add_uint32 (query, parameters->minMfn)
+        && query_add_uint32 (query, parameters->maxMfn)
+        && query_add_ansi (query, CBTEXT (""))
+        && query_add_utf_buffer (query, &parameters->text);
+}
+
+/**
+ * Верификация параметров поиска.
+ *
+ * @param parameters Параметры поиска.
+ * @return Результат проверки.
+ */
+MAGNA_API am_bool MAGNA_CALL fulltext_parameters_verify
+    (
+        const FullTextParameters *parameters
+    )
+{
+    assert (parameters != NULL);
+
+    return !buffer_is_empty (&parameters->text)
+        && (parameters->maxMfn == 0 || parameters->minMfn <= parameters->maxMfn);
+}
+
+/*=========================================================*/
+
+/**
+ * Полнотекстовый поиск с потоковой передачей найденных записей.
+ *
+ * @param connection Активное подключение.
+ * @param parameters Параметры поиска.
+ * @param handler Обработчик, вызываемый для каждой найденной
+ * записи по мере разбора ответа. Возврат `AM_FALSE`
+ * прекращает перебор (это не считается ошибкой).
+ * @param data Произвольные данные для обработчика.
+ * @return Общее количество найденных записей
+ * либо отрицательное число при ошибке.
+ */
+MAGNA_API am_int32 MAGNA_CALL connection_search_fulltext
+    (
+        Connection *connection,
+        const FullTextParameters *parameters,
+        FoundHandler handler,
+        void *data
+    )
+{
+    am_int32 result = -1;
+    am_int32 count;
+    Response response;
+    Query query;
+
+    assert (connection != NULL);
+    assert (parameters != NULL);
+    assert (handler != NULL);
+
+    response_init (&response);
+    if (!connection_check (connection)
+        || !fulltext_parameters_verify (parameters)
+        || !query_create (&query, connection, CBTEXT (FULL_TEXT_SEARCH))) {
+        return -1;
+    }
+
+    if (!fulltext_parameters_encode (parameters, connection, &query)
+        || !connection_execute_stream (connection, &query, &response)
+        || response_get_return_code (&response) < 0) {
+        goto DONE;
+    }
+
+    count = response_read_int32 (&response);
+    if (found_decode_stream (&response, handler, data)) {
+        result = count;
+    }
+    else {
+        connection->lastError = -100002;
+    }
+
+    DONE:
+    query_destroy (&query);
+    response_destroy (&response);
+
+    return result;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
@@ -0,0 +1,736 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file future.c
+ *
+ * Отложенные результаты команд (futures).
+ *
+ * \struct Future
+ *      \brief Команда, переданная на выполнение в фоновом
+ *      потоке, и ее будущий результат.
+ *      \details Память под структуру выделяет вызывающий код
+ *      (например, на стеке). Структура должна оставаться
+ *      на месте, пока команда не завершится (см. `future_wait`).
+ *      Для освобождения используйте `future_destroy`.
+ *
+ * \var Future::executor
+ *      \brief Исполнитель, которому передана команда.
+ *
+ * \var Future::action
+ *      \brief Функция, выполняющая команду в рабочем потоке.
+ *      \details Получает собственное подключение рабочего потока.
+ *      Результат помещает в `value` или `output`.
+ *
+ * \var Future::callback
+ *      \brief Продолжение, вызываемое по получении результата
+ *      (см. `future_then`).
+ *
+ * \var Future::callbackData
+ *      \brief Данные для продолжения.
+ *
+ * \var Future::next
+ *      \brief Следующая команда в очереди исполнителя.
+ *
+ * \var Future::argument
+ *      \brief Копия строкового аргумента команды
+ *      (поискового выражения, имени базы данных).
+ *
+ * \var Future::input
+ *      \brief Прочие входные данные команды.
+ *      \details Не копируются, поэтому должны оставаться
+ *      неизменными до завершения команды.
+ *
+ * \var Future::output
+ *      \brief Структура, принимающая результат команды
+ *      (запись, текст файла).
+ *
+ * \var Future::value
+ *      \brief Числовой результат команды (количество найденных
+ *      записей, максимальный MFN).
+ *
+ * \var Future::error
+ *      \brief Код ошибки неудачно завершившейся команды.
+ *
+ * \var Future::mfn
+ *      \brief MFN для команд, работающих с отдельной записью.
+ *
+ * \var Future::state
+ *      \brief Стадия выполнения: `FUTURE_IDLE` и т. д.
+ *
+ * \var Future::success
+ *      \brief Признак успешного выполнения команды.
+ *
+ * \struct FutureExecutor
+ *      \brief Исполнитель: очередь команд и рабочие потоки.
+ *      \details Каждый рабочий поток получает собственную копию
+ *      подключения (см. `connection_clone`), поэтому повторная
+ *      регистрация на сервере не требуется, а команды
+ *      выполняются параллельно.
+ *
+ * \details Приложению часто нужно выполнить несколько
+ * независимых команд (например, для сборки страницы
+ * электронного каталога) и дождаться их всех. Если выполнять
+ * команды по очереди, время ожидания складывается
+ * из времени всех команд; с исполнителем оно определяется
+ * самой долгой из них.
+ *
+ * \code
+ * FutureExecutor executor;
+ * Future count, maxMfn, *all[2];
+ *
+ * future_executor_create (&executor, &connection, 4);
+ * future_init (&count);
+ * future_init (&maxMfn);
+ * future_search_count (&executor, &count, CBTEXT ("K=АЛГЕБРА$"));
+ * future_get_max_mfn (&executor, &maxMfn, NULL);
+ * all[0] = &count;
+ * all[1] = &maxMfn;
+ * if (future_wait_all (all, 2)) {
+ *     printf ("%d of %d\n", count.value, maxMfn.value - 1);
+ * }
+ *
+ * future_destroy (&count);
+ * future_destroy (&maxMfn);
+ * future_executor_destroy (&executor);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+/**
+ * Простая инициализация отложенного результата.
+ * Не выделяет памяти в куче.
+ *
+ * @param future Структура, подлежащая инициализации.
+ */
+MAGNA_API void MAGNA_CALL future_init
+    (
+        Future *future
+    )
+{
+    assert (future != NULL);
+
+    mem_clear (future, sizeof (*future));
+}
+
+/**
+ * Освобождение ресурсов, занятых отложенным результатом.
+ * Команда к этому моменту должна быть завершена.
+ *
+ * @param future Отложенный результат.
+ */
+MAGNA_API void MAGNA_CALL future_destroy
+    (
+        Future *future
+    )
+{
+    assert (future != NULL);
+    assert (future->state == FUTURE_IDLE || future->state == FUTURE_DONE);
+
+    buffer_destroy (&future->argument);
+    mem_clear (future, sizeof (*future));
+}
+
+/*=========================================================*/
+
+/* Окончательное завершение команды: продолжение и пробуждение ожидающих. */
+static void future_complete
+    (
+        Future *future
+    )
+{
+    FutureExecutor *executor = future->executor;
+    FutureCallback callback;
+
+    mutex_lock (&executor->mutex);
+    future->state = FUTURE_READY;
+    callback = future->callback;
+    mutex_unlock (&executor->mutex);
+
+    /* Продолжение вызывается вне мьютекса, но до того,
+     * как ожидающие потоки увидят результат. */
+    if (callback != NULL) {
+        callback (future, future->callbackData);
+    }
+
+    mutex_lock (&executor->mutex);
+    future->state = FUTURE_DONE;
+    condition_broadcast (&executor->done);
+    mutex_unlock (&executor->mutex);
+}
+
+/* Выборка очередной команды. NULL означает, что исполнитель закрыт. */
+static Future* future_next
+    (
+        FutureExecutor *executor
+    )
+{
+    Future *result;
+
+    mutex_lock (&executor->mutex);
+    while (executor->head == NULL && !executor->closed) {
+        condition_wait (&executor->work, &executor->mutex);
+    }
+
+    result = executor->head;
+    if (result != NULL) {
+        executor->head = result->next;
+        if (executor->head == NULL) {
+            executor->tail = NULL;
+        }
+
+        result->next = NULL;
+        result->state = FUTURE_RUNNING;
+    }
+
+    mutex_unlock (&executor->mutex);
+
+    return result;
+}
+
+/* Рабочий поток. */
+static void MAGNA_CALL future_worker
+    (
+        void *data
+    )
+{
+    FutureWorker *worker = (FutureWorker*) data;
+    Connection *connection = &worker->connection;
+    Future *future;
+
+    while ((future = future_next (worker->executor)) != NULL) {
+        connection->lastError = 0;
+        future->success = future->action (connection, future);
+        future->error = future->success ? 0 : connection->lastError;
+        if (!future->success && future->error == 0) {
+            future->error = -1;
+        }
+
+        future_complete (future);
+    }
+}
+
+/*=========================================================*/
+
+/**
+ * Создание исполнителя и запуск рабочих потоков.
+ *
+ * @param executor Указатель на неинициализированную структуру.
+ * @param connection Активное подключение-образец.
+ * Рабочие потоки получают его копии (см. `connection_clone`).
+ * @param threads Количество рабочих потоков
+ * (не более `FUTURE_MAX_THREADS`).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL future_executor_create
+    (
+        FutureExecutor *executor,
+        Connection *connection,
+        size_t threads
+    )
+{
+    FutureWorker *worker;
+    size_t index;
+
+    assert (executor != NULL);
+    assert (connection != NULL);
+
+    mem_clear (executor, sizeof (*executor));
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    if (threads > FUTURE_MAX_THREADS) {
+        threads = FUTURE_MAX_THREADS;
+    }
+
+    if (!mutex_init (&executor->mutex)) {
+        return AM_FALSE;
+    }
+
+    if (!condition_init (&executor->work)) {
+        mutex_destroy (&executor->mutex);
+        return AM_FALSE;
+    }
+
+    if (!condition_init (&executor->done)) {
+        condition_destroy (&executor->work);
+        mutex_destroy (&executor->mutex);
+        return AM_FALSE;
+    }
+
+    executor->workers = (FutureWorker*) mem_alloc (threads * sizeof (FutureWorker));
+    if (executor->workers == NULL) {
+        future_executor_destroy (executor);
+        return AM_FALSE;
+    }
+
+    for (index = 0; index < threads; ++index) {
+        worker = &executor->workers [index];
+        worker->executor = executor;
+        if (!connection_create (&worker->connection)) {
+            future_executor_destroy (executor);
+            return AM_FALSE;
+        }
+
+        /* Учитываем поток сразу, чтобы при ошибке освободить его копию */
+        ++executor->workerCount;
+        worker->thread = handle_get_bad ();
+        if (!connection_clone (&worker->connection, connection)) {
+            future_executor_destroy (executor);
+            return AM_FALSE;
+        }
+
+        worker->thread = thread_start (future_worker, worker);
+        if (!handle_is_good (worker->thread)) {
+            future_executor_destroy (executor);
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых исполнителем.
+ * Уже выполняющиеся команды дорабатываются, команды,
+ * оставшиеся в очереди, завершаются с ошибкой -100003.
+ *
+ * @param executor Исполнитель.
+ */
+MAGNA_API void MAGNA_CALL future_executor_destroy
+    (
+        FutureExecutor *executor
+    )
+{
+    FutureWorker *worker;
+    Future *future;
+    size_t index;
+
+    assert (executor != NULL);
+
+    mutex_lock (&executor->mutex);
+    executor->closed = AM_TRUE;
+    future = executor->head;
+    executor->head = NULL;
+    executor->tail = NULL;
+    condition_broadcast (&executor->work);
+    mutex_unlock (&executor->mutex);
+
+    while (future != NULL) {
+        Future *next = future->next;
+
+        future->next = NULL;
+        future->success = AM_FALSE;
+        future->error = -100003;
+        future_complete (future);
+        future = next;
+    }
+
+    for (index = 0; index < executor->workerCount; ++index) {
+        worker = &executor->workers [index];
+        if (handle_is_good (worker->thread)) {
+            thread_wait (worker->thread);
+        }
+
+        connection_destroy (&worker->connection);
+    }
+
+    mem_free (executor->workers);
+    condition_destroy (&executor->done);
+    condition_destroy (&executor->work);
+    mutex_destroy (&executor->mutex);
+    mem_clear (executor, sizeof (*executor));
+}
+
+/*=========================================================*/
+
+/**
+ * Постановка произвольной команды в очередь исполнителя.
+ *
+ * @param executor Исполнитель.
+ * @param future Проинициализированный отложенный результат,
+ * не находящийся в очереди.
+ * @param action Функция, выполняющая команду.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL future_submit
+    (
+        FutureExecutor *executor,
+        Future *future,
+        FutureAction action
+    )
+{
+    assert (executor != NULL);
+    assert (future != NULL);
+    assert (action != NULL);
+    assert (future->state == FUTURE_IDLE || future->state == FUTURE_DONE);
+
+    mutex_lock (&executor->mutex);
+    if (executor->closed) {
+        mutex_unlock (&executor->mutex);
+        return AM_FALSE;
+    }
+
+    future->executor = executor;
+    future->action = action;
+    future->callback = NULL;
+    future->callbackData = NULL;
+    future->next = NULL;
+    future->value = 0;
+    future->error = 0;
+    future->success = AM_FALSE;
+    future->state = FUTURE_QUEUED;
+    if (executor->tail == NULL) {
+        executor->head = future;
+    }
+    else {
+        executor->tail->next = future;
+    }
+
+    executor->tail = future;
+    condition_signal (&executor->work);
+    mutex_unlock (&executor->mutex);
+
+    return AM_TRUE;
+}
+
+/**
+ * Назначение продолжения -- функции, вызываемой
+ * по получении результата команды.
+ * Продолжение вызывается в рабочем потоке до того,
+ * как проснутся ожидающие результата потоки.
+ * Если результат уже получен, продолжение вызывается
+ * немедленно в текущем потоке.
+ *
+ * @param future Отложенный результат, поставленный в очередь.
+ * @param callback Продолжение.
+ * @param data Данные для продолжения.
+ */
+MAGNA_API void MAGNA_CALL future_then
+    (
+        Future *future,
+        FutureCallback callback,
+        void *data
+    )
+{
+    FutureExecutor *executor;
+    am_bool ready;
+
+    assert (future != NULL);
+    assert (future->executor != NULL);
+    assert (callback != NULL);
+
+    executor = future->executor;
+    mutex_lock (&executor->mutex);
+    ready = future->state >= FUTURE_READY;
+    if (!ready) {
+        future->callback = callback;
+        future->callbackData = data;
+    }
+
+    mutex_unlock (&executor->mutex);
+
+    if (ready) {
+        callback (future, data);
+    }
+}
+
+/**
+ * Проверка, завершена ли команда. Не блокирует поток.
+ *
+ * @param future Отложенный результат.
+ * @return Результат проверки.
+ */
+MAGNA_API am_bool MAGNA_CALL future_is_done
+    (
+        Future *future
+    )
+{
+    am_bool result;
+
+    assert (future != NULL);
+
+    if (future->executor == NULL) {
+        return AM_FALSE;
+    }
+
+    mutex_lock (&future->executor->mutex);
+    result = future->state == FUTURE_DONE;
+    mutex_unlock (&future->executor->mutex);
+
+    return result;
+}
+
+/**
+ * Ожидание завершения команды.
+ *
+ * @param future Отложенный результат, поставленный в очередь.
+ * @return Признак успешного выполнения команды.
+ */
+MAGNA_API am_bool MAGNA_CALL future_wait
+    (
+        Future *future
+    )
+{
+    return future_wait_all (&future, 1);
+}
+
+/**
+ * Ожидание завершения всех перечисленных команд.
+ * Все команды должны принадлежать одному исполнителю.
+ *
+ * @param futures Массив указателей на отложенные результаты.
+ * @param count Длина массива.
+ * @return Признак успешного выполнения всех команд.
+ */
+MAGNA_API am_bool MAGNA_CALL future_wait_all
+    (
+        Future **futures,
+        size_t count
+    )
+{
+    FutureExecutor *executor;
+    am_bool result = AM_TRUE;
+    size_t index;
+
+    assert (futures != NULL);
+
+    if (count == 0) {
+        return AM_TRUE;
+    }
+
+    executor = futures[0]->executor;
+    assert (executor != NULL);
+
+    mutex_lock (&executor->mutex);
+    for (index = 0; index < count; ++index) {
+        assert (futures[index]->executor == executor);
+        while (futures[index]->state != FUTURE_DONE) {
+            condition_wait (&executor->done, &executor->mutex);
+        }
+
+        result = result && futures[index]->success;
+    }
+
+    mutex_unlock (&executor->mutex);
+
+    return result;
+}
+
+/**
+ * Ожидание завершения хотя бы одной из перечисленных команд.
+ * Все команды должны принадлежать одному исполнителю.
+ *
+ * @param futures Массив указателей на отложенные результаты.
+ * @param count Длина массива (больше 0).
+ * @return Индекс завершенной команды в массиве.
+ */
+MAGNA_API size_t MAGNA_CALL future_wait_any
+    (
+        Future **futures,
+        size_t count
+    )
+{
+    FutureExecutor *executor;
+    size_t index;
+
+    assert (futures != NULL);
+    assert (count != 0);
+
+    executor = futures[0]->executor;
+    assert (executor != NULL);
+
+    mutex_lock (&executor->mutex);
+    for (;;) {
+        for (index = 0; index < count; ++index) {
+            assert (futures[index]->executor == executor);
+            if (futures[index]->state == FUTURE_DONE) {
+                mutex_unlock (&executor->mutex);
+                return index;
+            }
+        }
+
+        condition_wait (&executor->done, &executor->mutex);
+    }
+}
+
+/*=========================================================*/
+
+static am_bool MAGNA_CALL future_do_get_max_mfn
+    (
+        Connection *connection,
+        Future *future
+    )
+{
+    const am_byte *database = buffer_is_empty (&future->argument)
+        ? NULL : B2B (&future->argument);
+
+    future->value = (am_int32) connection_get_max_mfn (connection, database);
+
+    return future->value > 0;
+}
+
+static am_bool MAGNA_CALL future_do_search_count
+    (
+        Connection *connection,
+        Future *future
+    )
+{
+    future->value = connection_search_count (connection, B2B (&future->argument));
+
+    return future->value >= 0;
+}
+
+static am_bool MAGNA_CALL future_do_read_record
+    (
+        Connection *connection,
+        Future *future
+    )
+{
+    return connection_read_record (connection, future->mfn, (MarcRecord*) future->output);
+}
+
+static am_bool MAGNA_CALL future_do_read_text_file
+    (
+        Connection *connection,
+        Future *future
+    )
+{
+    return connection_read_text_file
+        (
+            connection,
+            (const Specification*) future->input,
+            (Buffer*) future->output
+        );
+}
+
+/**
+ * Получение максимального MFN в фоновом потоке.
+ * Результат (максимальный MFN + 1) попадает в `Future::value`.
+ *
+ * @param executor Исполнитель.
+ * @param future Проинициализированный отложенный результат.
+ * @param database Имя базы данных. NULL означает текущую базу данных.
+ * @return Признак успешной постановки в очередь.
+ */
+MAGNA_API am_bool MAGNA_CALL future_get_max_mfn
+    (
+        FutureExecutor *executor,
+        Future *future,
+        const am_byte *database
+    )
+{
+    assert (future != NULL);
+
+    buffer_clear (&future->argument);
+    if (database != NULL
+        && !buffer_assign_text (&future->argument, database)) {
+        return AM_FALSE;
+    }
+
+    return future_submit (executor, future, future_do_get_max_mfn);
+}
+
+/**
+ * Подсчет найденных записей в фоновом потоке.
+ * Результат попадает в `Future::value`.
+ *
+ * @param executor Исполнитель.
+ * @param future Проинициализированный отложенный результат.
+ * @param expression Поисковое выражение (копируется).
+ * @return Признак успешной постановки в очередь.
+ */
+MAGNA_API am_bool MAGNA_CALL future_search_count
+    (
+        FutureExecutor *executor,
+        Future *future,
+        const am_byte *expression
+    )
+{
+    assert (future != NULL);
+    assert (expression != NULL);
+
+    return buffer_assign_text (&future->argument, expression)
+        && future_submit (executor, future, future_do_search_count);
+}
+
+/**
+ * Чтение записи в фоновом потоке.
+ *
+ * @param executor Исполнитель.
+ * @param future Проинициализированный отложенный результат.
+ * @param mfn MFN записи.
+ * @param record Проинициализированная структура, принимающая
+ * запись. Не должна использоваться до завершения команды.
+ * @return Признак успешной постановки в очередь.
+ */
+MAGNA_API am_bool MAGNA_CALL future_read_record
+    (
+        FutureExecutor *executor,
+        Future *future,
+        am_mfn mfn,
+        MarcRecord *record
+    )
+{
+    assert (future != NULL);
+    assert (mfn > 0);
+    assert (record != NULL);
+
+    future->mfn = mfn;
+    future->output = record;
+
+    return future_submit (executor, future, future_do_read_record);
+}
+
+/**
+ * Чтение текстового файла в фоновом потоке.
+ *
+ * @param executor Исполнитель.
+ * @param future Проинициализированный отложенный результат.
+ * @param specification Спецификация файла. Не копируется,
+ * должна оставаться неизменной до завершения команды.
+ * @param buffer Буфер, принимающий текст файла.
+ * Не должен использоваться до завершения команды.
+ * @return Признак успешной постановки в очередь.
+ */
+MAGNA_API am_bool MAGNA_CALL future_read_text_file
+    (
+        FutureExecutor *executor,
+        Future *future,
+        const Specification *specification,
+        Buffer *buffer
+    )
+{
+    assert (future != NULL);
+    assert (specification != NULL);
+    assert (buffer != NULL);
+
+    future->input = specification;
+    future->output = buffer;
+
+    return future_submit (executor, future, future_do_read_text_file);
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
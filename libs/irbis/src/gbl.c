@@ -14,6 +14,7 @@
 /*=========================================================*/
 
 #include <assert.h>
+#include <string.h>
 
 /*=========================================================*/
 
@@ -276,7 +277,7 @@ MAGNA_API void MAGNA_CALL gbl_statement_array_init
 {
     assert (statements != NULL);
 
-    array_init (statements, sizeof (*statements));
+    array_init (statements, sizeof (GblStatement));
 }
 
 /**
@@ -346,6 +347,9 @@ MAGNA_API am_bool MAGNA_CALL gbl_statement_verify
  * \var GblSettings::autoin
  *      \brief Запускать `AUTOIN.GBL`?
  *
+ * \var GblSettings::formalControl
+ *      \brief Выполнять формально-логический контроль?
+ *
  * \var GblSettings::firstRecord
  *      \brief Нижняя граница MFN для поиска обрабатываемых записей.
  *
@@ -411,9 +415,8 @@ MAGNA_API am_bool MAGNA_CALL gbl_settings_verify
 {
     assert (settings != NULL);
 
-    /* TODO: implement */
-
-    return settings->statements.len != 0;
+    return settings->statements.len != 0
+        || !buffer_is_empty (&settings->fileName);
 }
 
 /**
@@ -429,10 +432,97 @@ MAGNA_API am_bool MAGNA_CALL gbl_settings_encode
         Query *query
     )
 {
+    const GblStatement *statement;
+    am_mfn first, mfn;
+    size_t index;
+
     assert (settings != NULL);
     assert (query != NULL);
 
-    return AM_FALSE;
+    if (!query_add_ansi_buffer (query, &settings->database)
+        || !query_add_uint32 (query, settings->actualize ? 1 : 0)) {
+        return AM_FALSE;
+    }
+
+    if (!buffer_is_empty (&settings->fileName)) {
+        /* Задание берется из файла на сервере */
+        if (!buffer_putc (&query->buffer, '@')
+            || !query_add_ansi_buffer (query, &settings->fileName)) {
+            return AM_FALSE;
+        }
+    }
+    else {
+        /* Операторы передаются непосредственно в запросе */
+        if (!buffer_puts (&query->buffer, CBTEXT ("!0" IRBIS_DELIMITER))) {
+            return AM_FALSE;
+        }
+
+        for (index = 0; index < settings->statements.len; ++index) {
+            statement = (const GblStatement*) array_get (&settings->statements, index);
+            if (!buffer_concat (&query->buffer, &statement->command)
+                || !buffer_puts (&query->buffer, CBTEXT (IRBIS_DELIMITER))
+                || !buffer_concat (&query->buffer, &statement->parameter1)
+                || !buffer_puts (&query->buffer, CBTEXT (IRBIS_DELIMITER))
+                || !buffer_concat (&query->buffer, &statement->parameter2)
+                || !buffer_puts (&query->buffer, CBTEXT (IRBIS_DELIMITER))
+                || !buffer_concat (&query->buffer, &statement->format1)
+                || !buffer_puts (&query->buffer, CBTEXT (IRBIS_DELIMITER))
+                || !buffer_concat (&query->buffer, &statement->format2)
+                || !buffer_puts (&query->buffer, CBTEXT (IRBIS_DELIMITER))) {
+                return AM_FALSE;
+            }
+        }
+
+        if (!query_add_utf (query, CBTEXT (IRBIS_DELIMITER))) {
+            return AM_FALSE;
+        }
+    }
+
+    if (!query_add_utf_buffer (query, &settings->searchExpression)
+        || !query_add_uint32 (query, settings->firstRecord)
+        || !query_add_uint32 (query, settings->numberOfRecords)
+        || !query_add_utf_buffer (query, &settings->sequentialSearch)) {
+        return AM_FALSE;
+    }
+
+    /* Явный список MFN либо диапазон */
+    if (settings->mfnList.len != 0) {
+        if (!query_add_uint32 (query, (am_uint32) settings->mfnList.len)) {
+            return AM_FALSE;
+        }
+
+        for (index = 0; index < settings->mfnList.len; ++index) {
+            if (!query_add_int32 (query, settings->mfnList.ptr [index])) {
+                return AM_FALSE;
+            }
+        }
+    }
+    else if (settings->maxMfn != 0) {
+        first = settings->minMfn == 0 ? 1 : settings->minMfn;
+        if (settings->maxMfn < first
+            || !query_add_uint32 (query, settings->maxMfn - first + 1)) {
+            return AM_FALSE;
+        }
+
+        for (mfn = first; mfn <= settings->maxMfn; ++mfn) {
+            if (!query_add_uint32 (query, mfn)) {
+                return AM_FALSE;
+            }
+        }
+    }
+    else if (!query_add_uint32 (query, 0)) {
+        return AM_FALSE;
+    }
+
+    if (!settings->formalControl && !query_add_ansi (query, CBTEXT ("*"))) {
+        return AM_FALSE;
+    }
+
+    if (!settings->autoin && !query_add_ansi (query, CBTEXT ("&"))) {
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
 }
 
 /**
@@ -464,8 +554,50 @@ MAGNA_API am_bool MAGNA_CALL gbl_settings_substitute
  *      \details Структура владеет собственной памятью,
  *      для освобождения ресурсов необходимо вызвать
  *      `gbl_result_destroy`.
+ *
+ * Сервер возвращает протокол: по строке на каждую
+ * обработанную запись вида `DBN=IBIS#MFN=123#...`.
+ * Запись считается обработанной с ошибкой, если в строке
+ * присутствует непустой элемент `ERR`.
  */
 
+/* Значение элемента `KEY=value` из строки протокола. */
+static Span gbl_protocol_value
+    (
+        Span line,
+        const char *key
+    )
+{
+    Span result = span_null ();
+    SpanArray parts;
+    Span part, name;
+    size_t index, length;
+
+    length = strlen (key);
+    if (!span_array_create (&parts, 8)) {
+        return result;
+    }
+
+    if (span_split_by_char (line, &parts, '#')) {
+        for (index = 0; index < parts.len; ++index) {
+            part = span_array_get (&parts, index);
+            if (span_length (part) > length && part.start [length] == '=') {
+                name.start = part.start;
+                name.end = part.start + length;
+                if (span_compare (name, TEXT_SPAN (key)) == 0) {
+                    result.start = part.start + length + 1;
+                    result.end = part.end;
+                    break;
+                }
+            }
+        }
+    }
+
+    span_array_destroy (&parts);
+
+    return result;
+}
+
 /**
  * Простая инициализация структуры.
  * Не выделяет память в куче.
@@ -479,8 +611,6 @@ MAGNA_API void MAGNA_CALL gbl_result_init
 {
     assert (result != NULL);
 
-    /* TODO: implement */
-
     mem_clear (result, sizeof (*result));
 }
 
@@ -496,8 +626,7 @@ MAGNA_API void MAGNA_CALL gbl_result_destroy
 {
     assert (result != NULL);
 
-    /* TODO: implement */
-
+    int32_array_destroy (&result->failedMfns);
     mem_clear (result, sizeof (*result));
 }
 
@@ -514,12 +643,73 @@ MAGNA_API am_bool MAGNA_CALL gbl_result_decode
         Response *response
     )
 {
+    am_bool ok = AM_FALSE;
+    SpanArray lines;
+    Span line, error;
+    size_t index;
+
     assert (result != NULL);
     assert (response != NULL);
 
-    /* TODO: implement */
+    if (!span_array_create (&lines, 16)) {
+        return AM_FALSE;
+    }
+
+    if (!response_remaining_utf_lines (response, &lines)) {
+        goto DONE;
+    }
+
+    for (index = 0; index < lines.len; ++index) {
+        line = span_trim (span_array_get (&lines, index));
+        if (span_is_empty (line)) {
+            continue;
+        }
+
+        ++result->processed;
+        error = gbl_protocol_value (line, "ERR");
+        if (!span_is_empty (error)) {
+            ++result->failed;
+            if (!int32_array_push_back
+                (
+                    &result->failedMfns,
+                    (am_int32) span_to_uint32 (gbl_protocol_value (line, "MFN"))
+                )) {
+                goto DONE;
+            }
+        }
+    }
+
+    ok = AM_TRUE;
+
+    DONE:
+    span_array_destroy (&lines);
+
+    return ok;
+}
 
-    return AM_FALSE;
+/**
+ * Добавление одного результата к другому
+ * (например, при обработке базы данных порциями).
+ *
+ * @param target Накапливающий результат.
+ * @param source Добавляемый результат.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL gbl_result_merge
+    (
+        GblResult *target,
+        const GblResult *source
+    )
+{
+    assert (target != NULL);
+    assert (source != NULL);
+
+    target->processed += source->processed;
+    target->failed += source->failed;
+    target->elapsed += source->elapsed;
+
+    return source->failedMfns.len == 0
+        || int32_array_concat (&target->failedMfns, &source->failedMfns);
 }
 
 /*=========================================================*/
@@ -0,0 +1,504 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file gbljob.c
+ *
+ * Глобальная корректировка большой базы данных порциями.
+ *
+ * \struct GblJob
+ *      \brief Задание на глобальную корректировку, разбитое
+ *      на порции по MFN.
+ *
+ * \details Одна команда `GLOBAL_CORRECTION` над всей базой
+ * данных выполняется сервером как одна длинная операция,
+ * которую нельзя ни распараллелить, ни прервать без потерь.
+ * `GblJob` разбивает отбор записей на порции по `chunkSize`
+ * MFN и выполняет их несколькими подключениями из пула
+ * одновременно, суммируя результаты в `total`.
+ *
+ * Отбор записей задается одним из способов (в порядке
+ * убывания приоритета):
+ *
+ * - явным списком `settings->mfnList`;
+ * - поисковым выражением `settings->searchExpression`
+ *   (с учетом `firstRecord` и `numberOfRecords`): поиск
+ *   выполняется один раз при создании задания, список
+ *   найденных MFN делится на порции;
+ * - диапазоном `minMfn`..`maxMfn` (по умолчанию вся база данных).
+ *
+ * После каждой порции вызывается функция `progress`
+ * (последовательно, из любого из рабочих потоков).
+ * Блокировка задания при этом не удерживается, так что
+ * медленная функция `progress` не останавливает выдачу
+ * порций другим потокам.
+ * Порции, завершившиеся ошибкой, остаются необработанными:
+ * повторный вызов `gbl_job_run` выполняет только их,
+ * так что прерванное задание можно продолжить.
+ *
+ * \code
+ * GblJob job;
+ *
+ * gbl_job_create (&job, &connection, &settings, 1000);
+ * job.progress = on_progress;
+ * while (!gbl_job_run (&job, &pool, 4) && attempts--) {
+ *     // повторяем неудавшиеся порции
+ * }
+ *
+ * printf ("%u records\n", job.total.processed);
+ * gbl_job_destroy (&job);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+static void MAGNA_CALL gbl_job_free_chunk
+    (
+        void *item
+    )
+{
+    GblChunk *chunk = (GblChunk*) item;
+
+    gbl_result_destroy (&chunk->result);
+}
+
+/* Добавление порции. */
+static am_bool gbl_job_add_chunk
+    (
+        GblJob *job,
+        am_mfn firstMfn,
+        am_mfn lastMfn,
+        size_t offset,
+        size_t count
+    )
+{
+    GblChunk *chunk;
+
+    chunk = (GblChunk*) array_emplace_back (&job->chunks);
+    if (chunk == NULL) {
+        return AM_FALSE;
+    }
+
+    mem_clear (chunk, sizeof (*chunk));
+    gbl_result_init (&chunk->result);
+    chunk->firstMfn = firstMfn;
+    chunk->lastMfn = lastMfn;
+    chunk->offset = offset;
+    chunk->count = count;
+
+    return AM_TRUE;
+}
+
+/* Сбор MFN записей, отобранных поисковым выражением. */
+static am_bool gbl_job_search
+    (
+        GblJob *job,
+        Connection *connection
+    )
+{
+    am_bool result = AM_FALSE;
+    SearchParameters parameters;
+    SearchCursor cursor;
+    const FoundLine *found;
+
+    search_parameters_init (&parameters);
+    if (!buffer_copy (&parameters.expression, &job->settings->searchExpression)
+        || !buffer_copy (&parameters.database, &job->settings->database)) {
+        search_parameters_destroy (&parameters);
+        return AM_FALSE;
+    }
+
+    parameters.firstRecord = job->settings->firstRecord;
+    if (search_cursor_create (&cursor, connection, &parameters)) {
+        result = AM_TRUE;
+        while ((found = search_cursor_next (&cursor)) != NULL) {
+            if (job->settings->numberOfRecords != 0
+                && job->mfns.len >= job->settings->numberOfRecords) {
+                break;
+            }
+
+            if (!int32_array_push_back (&job->mfns, (am_int32) found->mfn)) {
+                result = AM_FALSE;
+                break;
+            }
+        }
+
+        if (cursor.failed) {
+            result = AM_FALSE;
+        }
+    }
+
+    search_cursor_destroy (&cursor);
+    search_parameters_destroy (&parameters);
+
+    return result;
+}
+
+/* Выполнение одной порции. */
+static void gbl_job_execute
+    (
+        GblJob *job,
+        GblChunk *chunk,
+        ConnectionPool *pool
+    )
+{
+    GblSettings copy;       /* поверхностная копия настроек */
+    GblResult result;       /* результат порции */
+    Connection *connection; /* подключение из пула */
+    am_int32 error = 0;     /* код ошибки */
+    am_bool ok = AM_FALSE;  /* признак успеха */
+
+    gbl_result_init (&result);
+
+    /* Порция задается только своими MFN */
+    copy = *job->settings;
+    buffer_init (&copy.searchExpression);
+    copy.firstRecord = 0;
+    copy.numberOfRecords = 0;
+    if (chunk->count != 0) {
+        copy.mfnList.ptr = job->mfns.ptr + chunk->offset;
+        copy.mfnList.len = chunk->count;
+        copy.mfnList.capacity = chunk->count;
+    }
+    else {
+        copy.mfnList.ptr = NULL;
+        copy.mfnList.len = 0;
+        copy.mfnList.capacity = 0;
+        copy.minMfn = chunk->firstMfn;
+        copy.maxMfn = chunk->lastMfn;
+    }
+
+    connection = pool_acquire (pool);
+    if (connection == NULL) {
+        error = pool->lastError != 0 ? pool->lastError : -100003;
+    }
+    else {
+        ok = connection_global_correction (connection, &copy, &result);
+        if (!ok) {
+            error = connection->lastError != 0 ? connection->lastError : -8888;
+        }
+
+        pool_release (pool, connection);
+    }
+
+    mutex_lock (&job->mutex);
+    chunk->running = AM_FALSE;
+    chunk->error = error;
+    if (ok) {
+        gbl_result_destroy (&chunk->result);
+        chunk->result = result;
+        chunk->done = AM_TRUE;
+        ++job->completed;
+        (void) gbl_result_merge (&job->total, &chunk->result);
+    }
+    else {
+        gbl_result_destroy (&result);
+        ++job->failed;
+    }
+
+    mutex_unlock (&job->mutex);
+
+    /* Порция больше не выполняется, так что ее никто не тронет */
+    if (job->progress != NULL) {
+        mutex_lock (&job->progressMutex);
+        job->progress (job, chunk, job->progressData);
+        mutex_unlock (&job->progressMutex);
+    }
+}
+
+/* Очередная невыполненная порция либо NULL. */
+static GblChunk* gbl_job_next
+    (
+        GblJob *job
+    )
+{
+    GblChunk *result = NULL, *chunk;
+
+    mutex_lock (&job->mutex);
+    while (!job->stop && job->next < job->chunks.len) {
+        chunk = (GblChunk*) array_get (&job->chunks, job->next);
+        ++job->next;
+        if (!chunk->done && !chunk->running) {
+            chunk->running = AM_TRUE;
+            result = chunk;
+            break;
+        }
+    }
+
+    mutex_unlock (&job->mutex);
+
+    return result;
+}
+
+/* Рабочий поток. */
+static void MAGNA_CALL gbl_job_worker
+    (
+        void *data
+    )
+{
+    GblJob *job = (GblJob*) data;
+    GblChunk *chunk;
+
+    while ((chunk = gbl_job_next (job)) != NULL) {
+        gbl_job_execute (job, chunk, job->pool);
+    }
+}
+
+/*=========================================================*/
+
+/**
+ * Создание задания: отбор записей и разбиение его на порции.
+ *
+ * @param job Указатель на неинициализированную структуру.
+ * @param connection Активное подключение (для поиска
+ * и определения максимального MFN).
+ * @param settings Настройки корректировки. Должны оставаться
+ * неизменными, пока существует задание.
+ * @param chunkSize Количество записей в порции.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL gbl_job_create
+    (
+        GblJob *job,
+        Connection *connection,
+        const GblSettings *settings,
+        size_t chunkSize
+    )
+{
+    am_mfn first, last, mfn, end;
+    size_t offset, count;
+
+    assert (job != NULL);
+    assert (connection != NULL);
+    assert (settings != NULL);
+    assert (chunkSize != 0);
+
+    mem_clear (job, sizeof (*job));
+    job->settings = settings;
+    gbl_result_init (&job->total);
+    if (!gbl_settings_verify (settings)
+        || !array_create (&job->chunks, sizeof (GblChunk), 16)) {
+        return AM_FALSE;
+    }
+
+    if (!mutex_init (&job->mutex)) {
+        array_destroy (&job->chunks, NULL);
+        return AM_FALSE;
+    }
+
+    if (!mutex_init (&job->progressMutex)) {
+        mutex_destroy (&job->mutex);
+        array_destroy (&job->chunks, NULL);
+        return AM_FALSE;
+    }
+
+    if (settings->mfnList.len != 0) {
+        if (!int32_array_copy (&job->mfns, &settings->mfnList)) {
+            goto FAILED;
+        }
+    }
+    else if (!buffer_is_empty (&settings->searchExpression)) {
+        if (!gbl_job_search (job, connection)) {
+            goto FAILED;
+        }
+    }
+    else {
+        first = settings->minMfn == 0 ? 1 : settings->minMfn;
+        last = settings->maxMfn;
+        if (last == 0) {
+            /* Сервер возвращает максимальный MFN + 1 */
+            last = connection_get_max_mfn
+                (
+                    connection,
+                    buffer_is_empty (&settings->database)
+                        ? NULL
+                        : B2B ((Buffer*) &settings->database)
+                );
+            if (last == 0 || (am_int32) last < 0) {
+                goto FAILED;
+            }
+
+            --last;
+        }
+
+        for (mfn = first; mfn <= last; mfn = end + 1) {
+            end = last - mfn < (am_mfn) chunkSize
+                ? last
+                : mfn + (am_mfn) chunkSize - 1;
+            if (!gbl_job_add_chunk (job, mfn, end, 0, 0)) {
+                goto FAILED;
+            }
+
+            if (end == last) {
+                break;
+            }
+        }
+
+        return AM_TRUE;
+    }
+
+    for (offset = 0; offset < job->mfns.len; offset += count) {
+        count = job->mfns.len - offset < chunkSize
+            ? job->mfns.len - offset
+            : chunkSize;
+        if (!gbl_job_add_chunk
+            (
+                job,
+                (am_mfn) job->mfns.ptr [offset],
+                (am_mfn) job->mfns.ptr [offset + count - 1],
+                offset,
+                count
+            )) {
+            goto FAILED;
+        }
+    }
+
+    return AM_TRUE;
+
+    FAILED:
+    gbl_job_destroy (job);
+
+    return AM_FALSE;
+}
+
+/**
+ * Освобождение ресурсов, занятых заданием.
+ *
+ * @param job Задание.
+ */
+MAGNA_API void MAGNA_CALL gbl_job_destroy
+    (
+        GblJob *job
+    )
+{
+    assert (job != NULL);
+
+    array_destroy (&job->chunks, gbl_job_free_chunk);
+    int32_array_destroy (&job->mfns);
+    gbl_result_destroy (&job->total);
+    mutex_destroy (&job->progressMutex);
+    mutex_destroy (&job->mutex);
+    mem_clear (job, sizeof (*job));
+}
+
+/**
+ * Выполнение невыполненных порций задания.
+ *
+ * @param job Задание.
+ * @param pool Пул подключений к серверу.
+ * @param parallelism Количество одновременно выполняемых порций.
+ * @return `AM_TRUE`, если все порции задания выполнены.
+ */
+MAGNA_API am_bool MAGNA_CALL gbl_job_run
+    (
+        GblJob *job,
+        ConnectionPool *pool,
+        size_t parallelism
+    )
+{
+    am_handle threads[GBL_JOB_MAX_THREADS];
+    size_t index, started = 0;
+
+    assert (job != NULL);
+    assert (pool != NULL);
+
+    if (parallelism == 0) {
+        parallelism = 1;
+    }
+
+    if (parallelism > GBL_JOB_MAX_THREADS) {
+        parallelism = GBL_JOB_MAX_THREADS;
+    }
+
+    mutex_lock (&job->mutex);
+    job->pool = pool;
+    job->next = 0;
+    job->stop = AM_FALSE;
+    mutex_unlock (&job->mutex);
+
+    /* Текущий поток тоже работает */
+    for (index = 1; index < parallelism; ++index) {
+        threads [started] = thread_start (gbl_job_worker, job);
+        if (handle_is_good (threads [started])) {
+            ++started;
+        }
+    }
+
+    gbl_job_worker (job);
+    for (index = 0; index < started; ++index) {
+        thread_wait (threads [index]);
+    }
+
+    return gbl_job_remaining (job) == 0;
+}
+
+/**
+ * Прекращение выдачи порций: уже начатые порции
+ * дорабатываются, `gbl_job_run` возвращает управление.
+ * Может вызываться из функции `progress`.
+ *
+ * @param job Задание.
+ */
+MAGNA_API void MAGNA_CALL gbl_job_stop
+    (
+        GblJob *job
+    )
+{
+    assert (job != NULL);
+
+    /* Функция progress вызывается без блокировки задания */
+    mutex_lock (&job->mutex);
+    job->stop = AM_TRUE;
+    mutex_unlock (&job->mutex);
+}
+
+/**
+ * Количество невыполненных порций.
+ *
+ * @param job Задание.
+ * @return Количество порций.
+ */
+MAGNA_API size_t MAGNA_CALL gbl_job_remaining
+    (
+        GblJob *job
+    )
+{
+    const GblChunk *chunk;
+    size_t index, result = 0;
+
+    assert (job != NULL);
+
+    mutex_lock (&job->mutex);
+    for (index = 0; index < job->chunks.len; ++index) {
+        chunk = (const GblChunk*) array_get (&job->chunks, index);
+        if (!chunk->done) {
+            ++result;
+        }
+    }
+
+    mutex_unlock (&job->mutex);
+
+    return result;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
@@ -0,0 +1,573 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file group.c
+ *
+ * Группа серверов ИРБИС64 с одинаковыми базами данных.
+ *
+ * \struct ConnectionGroup
+ *      \brief Несколько серверов (основной и реплики),
+ *      между которыми распределяются запросы.
+ *
+ * \details Для каждого сервера группа держит собственный
+ * пул подключений (см. `ConnectionPool`) и следит за временем
+ * выполнения команд (скользящее экспоненциальное среднее)
+ * и сбоями связи.
+ *
+ * `group_execute` направляет команду по ее коду (см.
+ * `query_is_read_only`): чтение -- серверу, который в последнее
+ * время отвечал быстрее всех, изменение данных (в том числе
+ * чтение с блокировкой записи) -- основному серверу.
+ * Учитывается только время выполнения самой команды.
+ *
+ * Сервер, на котором `errorLimit` обращений подряд закончились
+ * сбоем связи, на `quarantine` миллисекунд исключается
+ * из ротации, после чего получает пробное обращение.
+ * Ошибки, о которых сообщил сам сервер (например, "запись
+ * не найдена"), на здоровье сервера не влияют.
+ *
+ * Подключение можно взять и целиком (`group_acquire`), тогда
+ * сервер выбирается по признаку записи, указанному вызывающей
+ * стороной, а время выполнения команд не замеряется.
+ *
+ * \code
+ * ConnectionGroup group;
+ *
+ * group_create (&group);
+ * group_add (&group, &primarySettings, 4, AM_TRUE);
+ * group_add (&group, &replicaSettings, 4, AM_FALSE);
+ *
+ * query_create (&query, &primarySettings, CBTEXT (SEARCH));
+ * query_add_ansi (&query, CBTEXT ("IBIS"));
+ * query_add_utf (&query, CBTEXT ("K=ALG$"));
+ * ...
+ * if (group_execute (&group, &query, &response)) {
+ *     ...
+ * }
+ *
+ * response_destroy (&response);
+ * query_destroy (&query);
+ * group_destroy (&group);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+/* Выданное подключение */
+typedef struct
+{
+    Connection *connection;
+    GroupEndpoint *endpoint;
+
+} GroupLoan;
+
+static void MAGNA_CALL group_free_endpoint
+    (
+        void *item
+    )
+{
+    GroupEndpoint *endpoint = (GroupEndpoint*) item;
+
+    pool_destroy (&endpoint->pool);
+    mem_free (endpoint);
+}
+
+/* Сервер доступен для чтения? */
+static am_bool group_is_healthy
+    (
+        const ConnectionGroup *group,
+        const GroupEndpoint *endpoint,
+        am_uint64 now
+    )
+{
+    return endpoint->errors < group->errorLimit
+        || now >= endpoint->retryAfter;
+}
+
+/* Учет результата обращения к серверу. Выполняется под блокировкой. */
+static void group_account
+    (
+        ConnectionGroup *group,
+        GroupEndpoint *endpoint,
+        am_bool success
+    )
+{
+    ++endpoint->requests;
+    if (success) {
+        endpoint->errors = 0;
+    }
+    else {
+        ++endpoint->failures;
+        ++endpoint->errors;
+        if (endpoint->errors >= group->errorLimit) {
+            endpoint->retryAfter = magna_ticks () + group->quarantine;
+        }
+    }
+}
+
+/* Учет времени выполнения команды. Выполняется под блокировкой. */
+static void group_measure
+    (
+        GroupEndpoint *endpoint,
+        am_uint64 elapsed
+    )
+{
+    if (endpoint->latency < 0.0) {
+        endpoint->latency = (double) elapsed;
+    }
+    else {
+        endpoint->latency += ((double) elapsed - endpoint->latency) * GROUP_EWMA_WEIGHT;
+    }
+}
+
+/*
+ * Получение подключения от выбранного сервера. Если
+ * зарегистрироваться не удалось, пробуются остальные серверы.
+ */
+static Connection* group_borrow
+    (
+        ConnectionGroup *group,
+        am_bool write,
+        GroupEndpoint **endpoint
+    )
+{
+    Connection *result;
+    size_t attempt;
+
+    for (attempt = 0; attempt < group->endpoints.len; ++attempt) {
+        *endpoint = group_choose (group, write);
+        if (*endpoint == NULL) {
+            break;
+        }
+
+        result = pool_acquire (&(*endpoint)->pool);
+        if (result != NULL) {
+            /* Ошибка от прежнего пользователя не должна учитываться */
+            result->lastError = 0;
+            return result;
+        }
+
+        mutex_lock (&group->mutex);
+        group_account (group, *endpoint, AM_FALSE);
+        mutex_unlock (&group->mutex);
+        if (write) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/*=========================================================*/
+
+/**
+ * Инициализация пустой группы.
+ *
+ * @param group Указатель на неинициализированную структуру.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL group_create
+    (
+        ConnectionGroup *group
+    )
+{
+    assert (group != NULL);
+
+    mem_clear (group, sizeof (*group));
+    group->errorLimit = 3;
+    group->quarantine = 10000;
+
+    if (!vector_create (&group->endpoints, 4)) {
+        return AM_FALSE;
+    }
+
+    if (!array_create (&group->loans, sizeof (GroupLoan), 8)) {
+        vector_destroy (&group->endpoints, NULL);
+        return AM_FALSE;
+    }
+
+    if (!mutex_init (&group->mutex)) {
+        array_destroy (&group->loans, NULL);
+        vector_destroy (&group->endpoints, NULL);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых группой.
+ * Все подключения отключаются от серверов.
+ *
+ * @param group Группа.
+ * @warning К моменту вызова все подключения
+ * должны быть возвращены в группу.
+ */
+MAGNA_API void MAGNA_CALL group_destroy
+    (
+        ConnectionGroup *group
+    )
+{
+    assert (group != NULL);
+    assert (group->loans.len == 0);
+
+    vector_destroy (&group->endpoints, group_free_endpoint);
+    array_destroy (&group->loans, NULL);
+    mutex_destroy (&group->mutex);
+    mem_clear (group, sizeof (*group));
+}
+
+/**
+ * Добавление сервера в группу.
+ * Должно выполняться до начала работы с группой.
+ *
+ * @param group Группа.
+ * @param settings Настройки подключения к серверу (копируются).
+ * @param capacity Максимальное количество подключений к серверу.
+ * @param primary Основной сервер (принимает запись)?
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL group_add
+    (
+        ConnectionGroup *group,
+        const Connection *settings,
+        size_t capacity,
+        am_bool primary
+    )
+{
+    GroupEndpoint *endpoint;
+
+    assert (group != NULL);
+    assert (settings != NULL);
+
+    endpoint = (GroupEndpoint*) mem_alloc (sizeof (GroupEndpoint));
+    if (endpoint == NULL) {
+        return AM_FALSE;
+    }
+
+    mem_clear (endpoint, sizeof (*endpoint));
+    endpoint->latency = -1.0;
+    endpoint->primary = primary;
+    if (!pool_create (&endpoint->pool, settings, capacity)) {
+        mem_free (endpoint);
+        return AM_FALSE;
+    }
+
+    if (!vector_push_back (&group->endpoints, endpoint)) {
+        group_free_endpoint (endpoint);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Выбор сервера для очередного обращения.
+ *
+ * @param group Группа.
+ * @param write Обращение на запись?
+ * @return Основной сервер (для записи либо если
+ * основной не задан -- первый добавленный), либо здоровый
+ * сервер с наименьшим количеством ошибок подряд
+ * и наименьшим временем обслуживания (для чтения).
+ * `NULL`, если группа пуста.
+ */
+MAGNA_API GroupEndpoint* MAGNA_CALL group_choose
+    (
+        ConnectionGroup *group,
+        am_bool write
+    )
+{
+    GroupEndpoint *result = NULL, *endpoint;
+    am_bool healthy, bestHealthy = AM_FALSE;
+    am_uint64 now;
+    size_t index;
+
+    assert (group != NULL);
+
+    if (group->endpoints.len == 0) {
+        return NULL;
+    }
+
+    if (write) {
+        for (index = 0; index < group->endpoints.len; ++index) {
+            endpoint = (GroupEndpoint*) vector_get (&group->endpoints, index);
+            if (endpoint->primary) {
+                return endpoint;
+            }
+        }
+
+        return (GroupEndpoint*) vector_get (&group->endpoints, 0);
+    }
+
+    now = magna_ticks ();
+    mutex_lock (&group->mutex);
+    for (index = 0; index < group->endpoints.len; ++index) {
+        endpoint = (GroupEndpoint*) vector_get (&group->endpoints, index);
+        healthy = group_is_healthy (group, endpoint, now);
+        if (result == NULL) {
+            result = endpoint;
+            bestHealthy = healthy;
+            continue;
+        }
+
+        if (healthy != bestHealthy) {
+            if (healthy) {
+                result = endpoint;
+                bestHealthy = AM_TRUE;
+            }
+
+            continue;
+        }
+
+        if (!healthy) {
+            /* Из больных выбираем того, кто раньше поправится */
+            if (endpoint->retryAfter < result->retryAfter) {
+                result = endpoint;
+            }
+
+            continue;
+        }
+
+        /* Недавно ошибавшийся сервер -- в последнюю очередь */
+        if (endpoint->errors != result->errors) {
+            if (endpoint->errors < result->errors) {
+                result = endpoint;
+            }
+
+            continue;
+        }
+
+        /* Сервер без замеров сначала пробуем */
+        if (result->latency < 0.0) {
+            continue;
+        }
+
+        if (endpoint->latency < result->latency) {
+            result = endpoint;
+        }
+    }
+
+    mutex_unlock (&group->mutex);
+
+    return result;
+}
+
+/**
+ * Получение подключения во временное пользование.
+ * Если зарегистрироваться на выбранном сервере не удалось,
+ * пробуются остальные серверы.
+ *
+ * @param group Группа.
+ * @param write Подключение нужно для записи?
+ * @return Подключение либо `NULL`.
+ */
+MAGNA_API Connection* MAGNA_CALL group_acquire
+    (
+        ConnectionGroup *group,
+        am_bool write
+    )
+{
+    GroupEndpoint *endpoint;
+    Connection *result;
+    GroupLoan *loan;
+
+    assert (group != NULL);
+
+    result = group_borrow (group, write, &endpoint);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    mutex_lock (&group->mutex);
+    loan = (GroupLoan*) array_emplace_back (&group->loans);
+    if (loan == NULL) {
+        mutex_unlock (&group->mutex);
+        pool_release (&endpoint->pool, result);
+        return NULL;
+    }
+
+    loan->connection = result;
+    loan->endpoint = endpoint;
+    mutex_unlock (&group->mutex);
+
+    return result;
+}
+
+/**
+ * Возврат подключения в группу. Сервер считается отказавшим,
+ * если последняя команда закончилась сбоем связи
+ * (см. `irbis_is_network_error`).
+ *
+ * @param group Группа.
+ * @param connection Подключение, полученное от `group_acquire`.
+ */
+MAGNA_API void MAGNA_CALL group_release
+    (
+        ConnectionGroup *group,
+        Connection *connection
+    )
+{
+    GroupEndpoint *endpoint = NULL;
+    GroupLoan *loan;
+    size_t index;
+
+    assert (group != NULL);
+    assert (connection != NULL);
+
+    mutex_lock (&group->mutex);
+    for (index = 0; index < group->loans.len; ++index) {
+        loan = (GroupLoan*) array_get (&group->loans, index);
+        if (loan->connection == connection) {
+            endpoint = loan->endpoint;
+            group_account
+                (
+                    group,
+                    endpoint,
+                    !irbis_is_network_error (connection->lastError)
+                );
+            mem_copy
+                (
+                    loan,
+                    array_get (&group->loans, group->loans.len - 1),
+                    sizeof (GroupLoan)
+                );
+            array_truncate (&group->loans, group->loans.len - 1);
+            break;
+        }
+    }
+
+    mutex_unlock (&group->mutex);
+
+    assert (endpoint != NULL);
+    if (endpoint != NULL) {
+        pool_release (&endpoint->pool, connection);
+    }
+}
+
+/**
+ * Выполнение команды на сервере, выбранном по коду команды:
+ * чтение -- на самом быстром здоровом сервере, изменение --
+ * на основном. Запрос может быть сформирован для любого
+ * подключения (например, для образца настроек): заголовок
+ * перестраивается для подключения, взятого из пула.
+ *
+ * @param group Группа.
+ * @param query Клиентский запрос.
+ * @param response Ответ сервера (инициализируется в любом случае).
+ * Ответ не связан с подключением: при сбое связи код ошибки
+ * помещается в `Response::returnCode`.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL group_execute
+    (
+        ConnectionGroup *group,
+        Query *query,
+        Response *response
+    )
+{
+    GroupEndpoint *endpoint;
+    Connection *connection;
+    Query bound;
+    am_uint64 started, elapsed;
+    am_bool result;
+
+    assert (group != NULL);
+    assert (query != NULL);
+    assert (response != NULL);
+
+    connection = group_borrow (group, !query_is_read_only (query), &endpoint);
+    if (connection == NULL) {
+        response_init (response);
+        response->returnCode = -100003;
+        return AM_FALSE;
+    }
+
+    if (!query_rebind (query, connection, &bound)) {
+        query_destroy (&bound);
+        pool_release (&endpoint->pool, connection);
+        response_init (response);
+        return AM_FALSE;
+    }
+
+    started = magna_ticks ();
+    result = connection_execute (connection, &bound, response);
+    elapsed = magna_ticks () - started;
+    query_destroy (&bound);
+
+    mutex_lock (&group->mutex);
+    group_account (group, endpoint, result);
+    if (result) {
+        group_measure (endpoint, elapsed);
+    }
+
+    mutex_unlock (&group->mutex);
+
+    if (!result) {
+        response->returnCode = connection->lastError;
+    }
+
+    /* Подключение уходит в пул, ответ не должен на него ссылаться */
+    response->connection = NULL;
+    pool_release (&endpoint->pool, connection);
+
+    return result;
+}
+
+/**
+ * Выполнение действия с подключением, взятым из группы.
+ *
+ * @param group Группа.
+ * @param write Действие изменяет данные на сервере?
+ * @param action Действие.
+ * @param data Произвольные данные, передаваемые действию.
+ * @return Результат действия либо `AM_FALSE`,
+ * если подключение получить не удалось.
+ */
+MAGNA_API am_bool MAGNA_CALL group_run
+    (
+        ConnectionGroup *group,
+        am_bool write,
+        PoolAction action,
+        void *data
+    )
+{
+    Connection *connection;
+    am_bool result;
+
+    assert (group != NULL);
+    assert (action != NULL);
+
+    connection = group_acquire (group, write);
+    if (connection == NULL) {
+        return AM_FALSE;
+    }
+
+    result = action (connection, data);
+    group_release (group, connection);
+
+    return result;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
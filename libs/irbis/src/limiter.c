@@ -0,0 +1,404 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file limiter.c
+ *
+ * Адаптивное ограничение количества одновременно
+ * выполняющихся команд.
+ *
+ * \struct ConcurrencyLimiter
+ *      \brief Предел одновременных команд, подстраивающийся
+ *      под нагрузку на сервер по схеме AIMD
+ *      (аддитивное увеличение, мультипликативное уменьшение).
+ *
+ * \details Массовые задания, работающие через много подключений,
+ * способны перегрузить сервер ИРБИС64, которым пользуются
+ * и другие клиенты. Ограничитель разделяется всеми подключениями
+ * задания (`connection->limiter = &limiter`), и каждая команда,
+ * исполняемая через `connection_execute`, предварительно занимает
+ * у него место. Если места нет, поток ждет, но не дольше
+ * срока выполнения команды (`connection-&gt;timeout`,
+ * `connection-&gt;deadline`); по истечении срока команда
+ * завершается неудачей с кодом ошибки -100004.
+ *
+ * Пока сервер отвечает быстро, предел растет примерно на единицу
+ * за каждые `limit` успешных команд. Признаки перегрузки --
+ * сетевые ошибки, истечение срока, коды ошибок вроде -6666
+ * "Сервер перегружен", рост задержки более чем в `tolerance` раз
+ * над наименьшей наблюдавшейся, а также (если задан `clientLimit`)
+ * слишком большое количество клиентов в статистике сервера --
+ * уменьшают предел в `backoff` раз. После уменьшения следующее
+ * возможно не раньше, чем через одно время обслуживания,
+ * чтобы одна волна ошибок не обрушила предел до минимума.
+ *
+ * Команды, завершившиеся "обычной" ошибкой (например,
+ * -140 "MFN вне пределов БД"), на предел не влияют.
+ *
+ * \code
+ * ConcurrencyLimiter limiter;
+ *
+ * limiter_create (&limiter, 4, 1, 64);
+ * // для каждого подключения задания
+ * connection->limiter = &limiter;
+ * ...
+ * limiter_destroy (&limiter);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+/* Вес нового замера в скользящем среднем задержки */
+#define LIMITER_WEIGHT 0.2
+
+/* Скорость, с которой "забывается" наименьшая задержка */
+#define LIMITER_DRIFT 0.01
+
+/* Уменьшение предела. Выполняется под блокировкой. */
+static void limiter_decrease
+    (
+        ConcurrencyLimiter *limiter,
+        am_uint64 now
+    )
+{
+    double quiet;
+
+    if (now < limiter->quietUntil) {
+        return;
+    }
+
+    limiter->limit *= limiter->backoff;
+    if (limiter->limit < (double) limiter->minimum) {
+        limiter->limit = (double) limiter->minimum;
+    }
+
+    quiet = limiter->latency > 0.0 ? limiter->latency : 100.0;
+    limiter->quietUntil = now + (am_uint64) quiet;
+    ++limiter->decreases;
+}
+
+/* Увеличение предела. Выполняется под блокировкой. */
+static void limiter_increase
+    (
+        ConcurrencyLimiter *limiter
+    )
+{
+    /* Растем, только если предел действительно был выбран */
+    if (limiter->inFlight + 1 < (am_uint32) limiter->limit) {
+        return;
+    }
+
+    limiter->limit += 1.0 / limiter->limit;
+    if (limiter->limit > (double) limiter->maximum) {
+        limiter->limit = (double) limiter->maximum;
+    }
+
+    ++limiter->increases;
+    condition_broadcast (&limiter->condition);
+}
+
+/*=========================================================*/
+
+/**
+ * Инициализация ограничителя.
+ *
+ * @param limiter Указатель на неинициализированную структуру.
+ * @param initial Начальный предел.
+ * @param minimum Нижняя граница предела (не меньше 1).
+ * @param maximum Верхняя граница предела.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL limiter_create
+    (
+        ConcurrencyLimiter *limiter,
+        am_uint32 initial,
+        am_uint32 minimum,
+        am_uint32 maximum
+    )
+{
+    assert (limiter != NULL);
+    assert (minimum != 0);
+    assert (minimum <= maximum);
+
+    mem_clear (limiter, sizeof (*limiter));
+    limiter->minimum = minimum;
+    limiter->maximum = maximum;
+    limiter->limit = (double) (initial < minimum
+        ? minimum
+        : initial > maximum ? maximum : initial);
+    limiter->baseline = -1.0;
+    limiter->tolerance = 2.0;
+    limiter->backoff = 0.7;
+
+    if (!mutex_init (&limiter->mutex)) {
+        return AM_FALSE;
+    }
+
+    if (!condition_init (&limiter->condition)) {
+        mutex_destroy (&limiter->mutex);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых ограничителем.
+ *
+ * @param limiter Ограничитель.
+ * @warning Ни одно подключение не должно ссылаться на ограничитель.
+ */
+MAGNA_API void MAGNA_CALL limiter_destroy
+    (
+        ConcurrencyLimiter *limiter
+    )
+{
+    assert (limiter != NULL);
+    assert (limiter->inFlight == 0);
+
+    condition_destroy (&limiter->condition);
+    mutex_destroy (&limiter->mutex);
+    mem_clear (limiter, sizeof (*limiter));
+}
+
+/**
+ * Занятие места под очередную команду с ограничением
+ * времени ожидания.
+ *
+ * @param limiter Ограничитель.
+ * @param timeout Предельное время ожидания места в миллисекундах,
+ * отрицательное значение означает бесконечное ожидание,
+ * 0 -- отказ без ожидания, если места нет.
+ * @param started Момент начала команды (передается в `limiter_release`).
+ * @return `AM_FALSE`, если место не освободилось за отведенное время.
+ */
+MAGNA_API am_bool MAGNA_CALL limiter_acquire_for
+    (
+        ConcurrencyLimiter *limiter,
+        am_int32 timeout,
+        am_uint64 *started
+    )
+{
+    am_uint64 deadline = 0, now;
+
+    assert (limiter != NULL);
+    assert (started != NULL);
+
+    if (timeout >= 0) {
+        deadline = magna_ticks () + (am_uint64) timeout;
+    }
+
+    mutex_lock (&limiter->mutex);
+    while ((double) limiter->inFlight + 1.0 > limiter->limit) {
+        if (timeout < 0) {
+            condition_wait (&limiter->condition, &limiter->mutex);
+            continue;
+        }
+
+        now = magna_ticks ();
+        if (now >= deadline) {
+            mutex_unlock (&limiter->mutex);
+            return AM_FALSE;
+        }
+
+        condition_wait_for
+            (
+                &limiter->condition,
+                &limiter->mutex,
+                (am_int32) (deadline - now)
+            );
+    }
+
+    ++limiter->inFlight;
+    mutex_unlock (&limiter->mutex);
+    *started = magna_ticks ();
+
+    return AM_TRUE;
+}
+
+/**
+ * Занятие места под очередную команду.
+ * Если предел исчерпан, ждет освобождения места
+ * сколь угодно долго.
+ *
+ * @param limiter Ограничитель.
+ * @return Момент начала команды (передается в `limiter_release`).
+ */
+MAGNA_API am_uint64 MAGNA_CALL limiter_acquire
+    (
+        ConcurrencyLimiter *limiter
+    )
+{
+    am_uint64 result = 0;
+
+    limiter_acquire_for (limiter, -1, &result);
+
+    return result;
+}
+
+/**
+ * Освобождение места по завершении команды
+ * и подстройка предела.
+ *
+ * @param limiter Ограничитель.
+ * @param started Значение, возвращенное `limiter_acquire`.
+ * @param success Команда выполнена (ответ сервера получен)?
+ * `AM_FALSE` означает сетевую ошибку или истечение срока
+ * и считается признаком перегрузки.
+ */
+MAGNA_API void MAGNA_CALL limiter_release
+    (
+        ConcurrencyLimiter *limiter,
+        am_uint64 started,
+        am_bool success
+    )
+{
+    am_uint64 now = magna_ticks ();
+    double sample = (double) (now - started);
+
+    assert (limiter != NULL);
+
+    mutex_lock (&limiter->mutex);
+    assert (limiter->inFlight != 0);
+    --limiter->inFlight;
+
+    if (!success) {
+        limiter_decrease (limiter, now);
+    }
+    else {
+        if (limiter->baseline < 0.0 || sample < limiter->baseline) {
+            limiter->baseline = sample;
+        }
+        else {
+            limiter->baseline += (sample - limiter->baseline) * LIMITER_DRIFT;
+        }
+
+        if (limiter->latency <= 0.0) {
+            limiter->latency = sample;
+        }
+        else {
+            limiter->latency += (sample - limiter->latency) * LIMITER_WEIGHT;
+        }
+
+        /* Запас в 1 мс не дает быстрым командам дергать предел */
+        if (limiter->latency > (limiter->baseline + 1.0) * limiter->tolerance) {
+            limiter_decrease (limiter, now);
+        }
+        else {
+            limiter_increase (limiter);
+        }
+    }
+
+    condition_signal (&limiter->condition);
+    mutex_unlock (&limiter->mutex);
+}
+
+/**
+ * Явный сигнал о перегрузке сервера (например,
+ * код ошибки -6666 в ответе сервера).
+ *
+ * @param limiter Ограничитель.
+ */
+MAGNA_API void MAGNA_CALL limiter_overload
+    (
+        ConcurrencyLimiter *limiter
+    )
+{
+    assert (limiter != NULL);
+
+    mutex_lock (&limiter->mutex);
+    limiter_decrease (limiter, magna_ticks ());
+    mutex_unlock (&limiter->mutex);
+}
+
+/**
+ * Учет статистики сервера: если на сервере больше
+ * `clientLimit` клиентов, предел уменьшается.
+ *
+ * @param limiter Ограничитель.
+ * @param stat Статистика, полученная `connection_get_server_stat`.
+ */
+MAGNA_API void MAGNA_CALL limiter_observe_stat
+    (
+        ConcurrencyLimiter *limiter,
+        const ServerStat *stat
+    )
+{
+    assert (limiter != NULL);
+    assert (stat != NULL);
+
+    if (limiter->clientLimit != 0
+        && stat->clientCount >= 0
+        && (am_uint32) stat->clientCount > limiter->clientLimit) {
+        limiter_overload (limiter);
+    }
+}
+
+/**
+ * Текущий предел одновременных команд.
+ *
+ * @param limiter Ограничитель.
+ * @return Целая часть предела.
+ */
+MAGNA_API am_uint32 MAGNA_CALL limiter_get_limit
+    (
+        ConcurrencyLimiter *limiter
+    )
+{
+    am_uint32 result;
+
+    assert (limiter != NULL);
+
+    mutex_lock (&limiter->mutex);
+    result = (am_uint32) limiter->limit;
+    mutex_unlock (&limiter->mutex);
+
+    return result;
+}
+
+/**
+ * Является ли код возврата признаком перегрузки сервера.
+ *
+ * @param code Код возврата.
+ * @return Результат проверки.
+ */
+MAGNA_API am_bool MAGNA_CALL irbis_is_overload
+    (
+        am_int32 code
+    )
+{
+    switch (code)
+    {
+        case -1111:   /* ошибка исполнения сервера */
+        case -6666:   /* достигнуто максимальное число потоков */
+        case -100001: /* ошибка создания сокета */
+        case -100002: /* сбой сети */
+        case -100004: /* истекло время ожидания */
+            return AM_TRUE;
+
+        default:
+            return AM_FALSE;
+    }
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
@@ -0,0 +1,1672 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+
+/*=========================================================*/
+
+/**
+ * \file mocksrv.c
+ *
+ * Имитация сервера ИРБИС64 на петлевом интерфейсе.
+ *
+ * \struct MockServer
+ *      \brief Сервер, отвечающий по протоколу ИРБИС64
+ *      на основные команды клиента.
+ *      \details Записи хранятся в памяти (см. `mock_server_add_record`
+ *      и `mock_server_load`). Поддерживаются команды
+ *      `REGISTER_CLIENT`, `UNREGISTER_CLIENT`, `READ_RECORD`,
+ *      `UPDATE_RECORD`, `SAVE_RECORD_GROUP`, `FORMAT_RECORD`,
+ *      `READ_TERMS`, `READ_POSTINGS`, `SEARCH`, `READ_DOCUMENT`,
+ *      `NOP` и `GET_MAX_MFN`. Имя базы данных в запросах не учитывается:
+ *      сервер обслуживает единственный набор записей.
+ *
+ * \var MockServer::records
+ *      \brief Записи, MFN записи на единицу больше ее индекса.
+ *
+ * \var MockServer::files
+ *      \brief Текстовые файлы, отдаваемые командой `READ_DOCUMENT`
+ *      (см. `mock_server_add_file`). Спецификация с текстом
+ *      ("имя&текст") сохраняет файл.
+ *
+ * \var MockServer::postings
+ *      \brief Словарь: ссылки на все слова записей,
+ *      упорядоченные по слову без учета регистра.
+ *      \details Строится заново при первом обращении
+ *      после изменения записей. Ссылки указывают
+ *      непосредственно в текст полей записей.
+ *
+ * \var MockServer::latency
+ *      \brief Задержка перед ответом на каждый запрос, мс.
+ *
+ * \var MockServer::bandwidth
+ *      \brief Скорость передачи ответа, байт в секунду.
+ *      \details Ответ отсылается порциями с паузами между ними.
+ *      0 означает "без ограничения".
+ *
+ * \var MockServer::errorEvery
+ *      \brief Каждый N-й запрос (по порядку поступления)
+ *      завершается ошибкой с кодом `errorCode`.
+ *
+ * \var MockServer::errorCode
+ *      \brief Код имитируемой ошибки. По умолчанию -6666
+ *      (сервер перегружен).
+ *
+ * \var MockServer::dropEvery
+ *      \brief На каждый N-й запрос сервер не отвечает,
+ *      а закрывает соединение (имитация сбоя сети).
+ *
+ * \var MockServer::termLimit
+ *      \brief Наибольшее количество терминов в ответе
+ *      на `READ_TERMS`, как у серверов, урезающих порции
+ *      словаря. 0 означает "без ограничения".
+ *
+ * \var MockServer::requests
+ *      \brief Количество принятых запросов.
+ *
+ * \details Сервер нужен, чтобы измерять пропускную способность
+ * и задержки клиентской библиотеки воспроизводимо, без настоящего
+ * сервера ИРБИС64: задержка, скорость передачи и частота ошибок
+ * задаются явно, а ошибки выпадают на заранее известные
+ * по номеру запросы. Поля настроек можно менять
+ * между вызовами `mock_server_start`.
+ *
+ * Словарь содержит термины вида "K=СЛОВО" для каждого слова
+ * в значениях полей и подполей (регистр латинских букв
+ * не различается). Поиск понимает выражения вида "K=СЛОВО"
+ * и "K=НАЧАЛО$" (возможно, в кавычках).
+ *
+ * На Unix процессу следует игнорировать сигнал SIGPIPE:
+ * клиент может закрыть соединение, не дочитав ответ.
+ *
+ * \code
+ * MockServer server;
+ * Connection connection;
+ *
+ * mock_server_create (&server);
+ * mock_server_load (&server, "records.txt");
+ * server.latency = 5;
+ * mock_server_start (&server, 0, 8);
+ * connection_create (&connection);
+ * connection_set_host (&connection, CBTEXT ("127.0.0.1"));
+ * connection.port = mock_server_port (&server);
+ * ...
+ * mock_server_destroy (&server);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+/* Префикс терминов словаря */
+#define MOCK_PREFIX "K="
+
+/* Разделитель записей в текстовом файле */
+#define MOCK_SEPARATOR "*****"
+
+/* Перевод строки в ответе сервера */
+#define MOCK_EOL "\r\n"
+
+/* Буква или цифра (байты старше 0x7F -- часть слова в UTF-8) */
+#define mock_is_word(__c) \
+    (((__c) >= '0' && (__c) <= '9') \
+    || ((__c) >= 'A' && (__c) <= 'Z') \
+    || ((__c) >= 'a' && (__c) <= 'z') \
+    || (__c) >= 0x80)
+
+/* Текстовый файл на сервере */
+typedef struct
+{
+    Buffer name;     /* Имя файла. */
+    Buffer content;  /* Содержимое, строки разделены IRBIS_DELIMITER. */
+
+} MockFile;
+
+/* Вхождение слова в запись */
+typedef struct
+{
+    Span word;             /* Слово (в тексте поля записи). */
+    am_mfn mfn;            /* MFN записи. */
+    am_uint32 tag;         /* Метка поля. */
+    am_uint32 occurrence;  /* Номер повторения поля. */
+    am_uint32 position;    /* Номер слова в поле. */
+
+} MockPosting;
+
+/*=========================================================*/
+
+static void MAGNA_CALL mock_free_record
+    (
+        void *item
+    )
+{
+    record_destroy ((MarcRecord*) item);
+}
+
+static void MAGNA_CALL mock_free_file
+    (
+        void *item
+    )
+{
+    MockFile *file = (MockFile*) item;
+
+    buffer_destroy (&file->name);
+    buffer_destroy (&file->content);
+}
+
+/**
+ * Инициализация сервера. Сервер пока не принимает подключений
+ * (см. `mock_server_start`).
+ *
+ * @param server Указатель на неинициализированную структуру.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL mock_server_create
+    (
+        MockServer *server
+    )
+{
+    assert (server != NULL);
+
+    mem_clear (server, sizeof (*server));
+    array_init (&server->records, sizeof (MarcRecord));
+    array_init (&server->files, sizeof (MockFile));
+    array_init (&server->postings, sizeof (MockPosting));
+    server->listener = -1;
+    server->errorCode = -6666;
+
+    return mutex_init (&server->mutex);
+}
+
+/**
+ * Остановка сервера и освобождение всех его ресурсов.
+ *
+ * @param server Сервер.
+ */
+MAGNA_API void MAGNA_CALL mock_server_destroy
+    (
+        MockServer *server
+    )
+{
+    assert (server != NULL);
+
+    mock_server_stop (server);
+    array_destroy (&server->records, mock_free_record);
+    array_destroy (&server->files, mock_free_file);
+    array_destroy (&server->postings, NULL);
+    mutex_destroy (&server->mutex);
+    mem_clear (server, sizeof (*server));
+}
+
+/**
+ * Добавление копии записи. Запись получает очередной MFN.
+ *
+ * @param server Сервер.
+ * @param record Запись.
+ * @return Присвоенный MFN либо 0 при нехватке памяти.
+ */
+MAGNA_API am_mfn MAGNA_CALL mock_server_add_record
+    (
+        MockServer *server,
+        const MarcRecord *record
+    )
+{
+    MarcRecord *copy;
+    am_mfn result = 0;
+
+    assert (server != NULL);
+    assert (record != NULL);
+
+    mutex_lock (&server->mutex);
+    copy = (MarcRecord*) array_emplace_back (&server->records);
+    if (copy != NULL) {
+        record_init (copy);
+        if (record_clone (copy, record) == NULL) {
+            record_destroy (copy);
+            array_truncate (&server->records, server->records.len - 1);
+        }
+        else {
+            result = copy->mfn = (am_mfn) server->records.len;
+            if (copy->version == 0) {
+                copy->version = 1;
+            }
+
+            server->indexed = AM_FALSE;
+        }
+    }
+
+    mutex_unlock (&server->mutex);
+
+    return result;
+}
+
+/**
+ * Добавление текстового файла, отдаваемого командой `READ_DOCUMENT`.
+ * Путь и база данных в спецификации файла не учитываются.
+ *
+ * @param server Сервер.
+ * @param name Имя файла (без учета регистра), например "brief.pft".
+ * @param content Содержимое, строки разделены LF или CR LF.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL mock_server_add_file
+    (
+        MockServer *server,
+        const am_byte *name,
+        Span content
+    )
+{
+    MockFile *file;
+    const am_byte *ptr;
+    am_bool result = AM_FALSE;
+
+    assert (server != NULL);
+    assert (name != NULL);
+
+    mutex_lock (&server->mutex);
+    file = (MockFile*) array_emplace_back (&server->files);
+    if (file == NULL) {
+        goto DONE;
+    }
+
+    buffer_init (&file->name);
+    buffer_init (&file->content);
+    result = buffer_assign_text (&file->name, name);
+    for (ptr = content.start; result && ptr < content.end; ++ptr) {
+        if (*ptr == '\n') {
+            result = buffer_puts (&file->content, CBTEXT (IRBIS_DELIMITER));
+        }
+        else if (*ptr != '\r') {
+            result = buffer_putc (&file->content, *ptr);
+        }
+    }
+
+    if (!result) {
+        mock_free_file (file);
+        array_truncate (&server->files, server->files.len - 1);
+    }
+
+    DONE:
+    mutex_unlock (&server->mutex);
+
+    return result;
+}
+
+/**
+ * Загрузка записей из текстового файла.
+ * Каждое поле записывается отдельной строкой вида
+ * "метка#значение" (подполя -- через '^'),
+ * записи отделяются друг от друга строкой "*****".
+ *
+ * @param server Сервер.
+ * @param fileName Имя файла.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL mock_server_load
+    (
+        MockServer *server,
+        const char *fileName
+    )
+{
+    Buffer text = BUFFER_INIT;
+    Navigator navigator;
+    MarcRecord record;
+    MarcField *field;
+    Span line;
+    am_bool result = AM_FALSE;
+
+    assert (server != NULL);
+    assert (fileName != NULL);
+
+    if (!file_read_all (fileName, &text)) {
+        return AM_FALSE;
+    }
+
+    record_init (&record);
+    nav_from_buffer (&navigator, &text);
+    while (!nav_eot (&navigator)) {
+        line = span_trim (nav_read_line (&navigator));
+        if (span_compare (line, TEXT_SPAN (MOCK_SEPARATOR)) == 0) {
+            if (record.fields.len != 0
+                && mock_server_add_record (server, &record) == 0) {
+                goto DONE;
+            }
+
+            record_clear (&record);
+            continue;
+        }
+
+        if (span_is_empty (line)) {
+            continue;
+        }
+
+        field = (MarcField*) array_emplace_back (&record.fields);
+        if (field == NULL) {
+            goto DONE;
+        }
+
+        field_create (field);
+        if (!field_decode (field, line)) {
+            goto DONE;
+        }
+    }
+
+    if (record.fields.len != 0
+        && mock_server_add_record (server, &record) == 0) {
+        goto DONE;
+    }
+
+    result = AM_TRUE;
+
+    DONE:
+    record_destroy (&record);
+    buffer_destroy (&text);
+
+    return result;
+}
+
+/*=========================================================*/
+
+/* Сравнение ссылок: по слову, затем по месту в записи. */
+static int mock_compare_postings
+    (
+        const void *first,
+        const void *second
+    )
+{
+    const MockPosting *one = (const MockPosting*) first;
+    const MockPosting *two = (const MockPosting*) second;
+    int result;
+
+    result = span_compare_ignore_case (one->word, two->word);
+    if (result != 0) {
+        return result;
+    }
+
+    if (one->mfn != two->mfn) {
+        return one->mfn < two->mfn ? -1 : 1;
+    }
+
+    if (one->tag != two->tag) {
+        return one->tag < two->tag ? -1 : 1;
+    }
+
+    if (one->occurrence != two->occurrence) {
+        return one->occurrence < two->occurrence ? -1 : 1;
+    }
+
+    if (one->position != two->position) {
+        return one->position < two->position ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/* Добавление в словарь всех слов фрагмента текста. */
+static am_bool mock_index_text
+    (
+        MockServer *server,
+        Span text,
+        const MockPosting *pattern,
+        am_uint32 *position
+    )
+{
+    MockPosting *posting;
+    am_byte *ptr = text.start, *start;
+
+    while (ptr < text.end) {
+        while (ptr < text.end && !mock_is_word (*ptr)) {
+            /* Неразобранное поле: разделитель вместе с кодом подполя */
+            if (*ptr++ == '^' && ptr < text.end) {
+                ++ptr;
+            }
+        }
+
+        start = ptr;
+        while (ptr < text.end && mock_is_word (*ptr)) {
+            ++ptr;
+        }
+
+        if (ptr != start) {
+            posting = (MockPosting*) array_emplace_back (&server->postings);
+            if (posting == NULL) {
+                return AM_FALSE;
+            }
+
+            *posting = *pattern;
+            posting->word.start = start;
+            posting->word.end = ptr;
+            posting->position = ++*position;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/* Построение словаря, если записи изменились. Вызывается под мьютексом. */
+static am_bool mock_index
+    (
+        MockServer *server
+    )
+{
+    const MarcRecord *record;
+    const MarcField *field, *other;
+    const SubField *subfield;
+    MockPosting pattern;
+    am_uint32 position;
+    size_t i, j, k;
+
+    if (server->indexed) {
+        return AM_TRUE;
+    }
+
+    array_clear (&server->postings);
+    for (i = 0; i < server->records.len; ++i) {
+        record = (const MarcRecord*) array_get (&server->records, i);
+        if (record->status & LOGICALLY_DELETED) {
+            continue;
+        }
+
+        pattern.mfn = record->mfn;
+        for (j = 0; j < record->fields.len; ++j) {
+            field = (const MarcField*) array_get (&record->fields, j);
+            pattern.tag = field->tag;
+            pattern.occurrence = 1;
+            for (k = 0; k < j; ++k) {
+                other = (const MarcField*) array_get (&record->fields, k);
+                if (other->tag == field->tag) {
+                    ++pattern.occurrence;
+                }
+            }
+
+            position = 0;
+            if (!mock_index_text (server, buffer_to_span (&field->value), &pattern, &position)) {
+                return AM_FALSE;
+            }
+
+            for (k = 0; k < field->subfields.len; ++k) {
+                subfield = field_get_subfield_by_index (field, k);
+                if (!mock_index_text (server, buffer_to_span (&subfield->value), &pattern, &position)) {
+                    return AM_FALSE;
+                }
+            }
+        }
+    }
+
+    /* array_sort берет опорным первый элемент и вырождается
+       на длинных сериях одинаковых слов, поэтому qsort */
+    if (server->postings.len > 1) {
+        qsort
+            (
+                array_get (&server->postings, 0),
+                server->postings.len,
+                sizeof (MockPosting),
+                mock_compare_postings
+            );
+    }
+
+    server->indexed = AM_TRUE;
+
+    return AM_TRUE;
+}
+
+/* Индекс первой ссылки, слово которой не меньше заданного. */
+static size_t mock_lower_bound
+    (
+        const MockServer *server,
+        Span word
+    )
+{
+    size_t low = 0, high = server->postings.len, middle;
+    const MockPosting *posting;
+
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        posting = (const MockPosting*) array_get (&server->postings, middle);
+        if (span_compare_ignore_case (posting->word, word) < 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/* Ссылка по индексу. */
+#define mock_posting(__server, __index) \
+    ((const MockPosting*) array_get (&(__server)->postings, (__index)))
+
+/* Слово из термина вида "K=СЛОВО". */
+static am_bool mock_term_word
+    (
+        Span term,
+        Span *word
+    )
+{
+    if (span_length (term) < 2
+        || toupper (term.start[0]) != 'K'
+        || term.start[1] != '=') {
+        return AM_FALSE;
+    }
+
+    *word = span_slice (term, 2, -1);
+
+    return AM_TRUE;
+}
+
+/* Начинается ли слово с заданного префикса (без учета регистра). */
+static am_bool mock_word_starts_with
+    (
+        Span word,
+        Span prefix
+    )
+{
+    return span_length (word) >= span_length (prefix)
+        && span_compare_ignore_case
+            (
+                span_slice (word, 0, (ssize_t) span_length (prefix)),
+                prefix
+            ) == 0;
+}
+
+/*=========================================================*/
+
+/* Строка запроса по номеру (пустая, если строк меньше). */
+static Span mock_line
+    (
+        const SpanArray *lines,
+        size_t index
+    )
+{
+    Span result = SPAN_INIT;
+
+    if (index < lines->len) {
+        result = lines->ptr[index];
+    }
+
+    return result;
+}
+
+static am_bool mock_put_line
+    (
+        Buffer *answer,
+        Span line
+    )
+{
+    return buffer_write_span (answer, line)
+        && buffer_puts (answer, CBTEXT (MOCK_EOL));
+}
+
+/* Код возврата (возможно, отрицательный) отдельной строкой. */
+static am_bool mock_put_code
+    (
+        Buffer *answer,
+        am_int32 code
+    )
+{
+    if (code < 0
+        && (!buffer_putc (answer, '-')
+            || !buffer_put_uint32 (answer, (am_uint32) 0 - (am_uint32) code))) {
+        return AM_FALSE;
+    }
+
+    if (code >= 0 && !buffer_put_uint32 (answer, (am_uint32) code)) {
+        return AM_FALSE;
+    }
+
+    return buffer_puts (answer, CBTEXT (MOCK_EOL));
+}
+
+/* Термин словаря: префикс и слово в верхнем регистре. */
+static am_bool mock_put_term
+    (
+        Buffer *answer,
+        Span word
+    )
+{
+    const am_byte *ptr;
+
+    if (!buffer_puts (answer, CBTEXT (MOCK_PREFIX))) {
+        return AM_FALSE;
+    }
+
+    for (ptr = word.start; ptr < word.end; ++ptr) {
+        if (!buffer_putc (answer, (am_byte) toupper (*ptr))) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/* Краткое описание записи: заглавие (200^a) либо первое поле. */
+static am_bool mock_put_brief
+    (
+        Buffer *answer,
+        const MarcRecord *record
+    )
+{
+    const MarcField *field;
+    const SubField *subfield;
+    const am_byte *ptr;
+    am_byte *end;
+    Span value;
+    size_t index;
+
+    for (index = 0; index < record->fields.len; ++index) {
+        field = (const MarcField*) array_get (&record->fields, index);
+        if (field->tag == 200) {
+            subfield = field_get_first_subfield (field, 'a');
+            if (subfield != NULL) {
+                return buffer_concat (answer, &subfield->value);
+            }
+
+            /* Неразобранное поле: "^aЗаглавие^e..." */
+            value = buffer_to_span (&field->value);
+            for (ptr = value.start; ptr + 1 < value.end; ++ptr) {
+                if (ptr[0] == '^' && (ptr[1] == 'a' || ptr[1] == 'A')) {
+                    value = span_slice (value, ptr + 2 - value.start, -1);
+                    end = span_find_byte (value, '^');
+                    if (end != NULL) {
+                        value.end = end;
+                    }
+
+                    return buffer_write_span (answer, value);
+                }
+            }
+        }
+    }
+
+    if (record->fields.len == 0) {
+        return buffer_put_uint32 (answer, record->mfn);
+    }
+
+    return field_to_string ((const MarcField*) array_get (&record->fields, 0), answer);
+}
+
+/* Запись по MFN либо NULL, если MFN вне пределов базы данных. */
+static MarcRecord* mock_get_record
+    (
+        MockServer *server,
+        am_mfn mfn
+    )
+{
+    if (mfn == 0 || mfn > server->records.len) {
+        return NULL;
+    }
+
+    return (MarcRecord*) array_get (&server->records, mfn - 1);
+}
+
+/*=========================================================*/
+
+/* READ_RECORD: база, MFN. */
+static am_bool mock_read_record
+    (
+        MockServer *server,
+        const SpanArray *lines,
+        Buffer *answer
+    )
+{
+    const MarcRecord *record;
+
+    record = mock_get_record (server, span_to_uint32 (mock_line (lines, 11)));
+    if (record == NULL) {
+        return mock_put_code (answer, -140);
+    }
+
+    return mock_put_code (answer, (record->status & LOGICALLY_DELETED) ? -603 : 0)
+        && record_encode (record, MOCK_EOL, answer);
+}
+
+/*
+ * Сохранение записи, присланной в текстовом виде: новая запись
+ * добавляется, существующая заменяется с увеличением версии.
+ * При неудаче возвращается NULL, а в `code` -- код ошибки
+ * для клиента (0 -- нехватка памяти).
+ */
+static MarcRecord* mock_store
+    (
+        MockServer *server,
+        Span text,
+        am_int32 *code
+    )
+{
+    MarcRecord incoming, *target = NULL;
+
+    record_init (&incoming);
+    *code = -2222;
+    if (span_is_empty (text) || !record_decode_text (&incoming, text)) {
+        goto DONE;
+    }
+
+    *code = 0;
+    if (incoming.mfn == 0) {
+        target = (MarcRecord*) array_emplace_back (&server->records);
+        if (target == NULL) {
+            goto DONE;
+        }
+
+        record_init (target);
+        incoming.mfn = (am_mfn) server->records.len;
+    }
+    else {
+        target = mock_get_record (server, incoming.mfn);
+        if (target == NULL) {
+            *code = -140;
+            goto DONE;
+        }
+    }
+
+    /* Новая версия записи занимает место прежней */
+    incoming.version = target->version + 1;
+    record_destroy (target);
+    *target = incoming;
+    record_init (&incoming);
+    server->indexed = AM_FALSE;
+
+    DONE:
+    record_destroy (&incoming);
+
+    return target;
+}
+
+/* UPDATE_RECORD: база, блокировка, актуализация, запись. */
+static am_bool mock_write_record
+    (
+        MockServer *server,
+        const SpanArray *lines,
+        Buffer *answer
+    )
+{
+    const MarcRecord *record;
+    am_int32 code;
+
+    record = mock_store (server, mock_line (lines, 13), &code);
+    if (record == NULL) {
+        return code != 0 && mock_put_code (answer, code);
+    }
+
+    return mock_put_code (answer, (am_int32) server->records.len + 1)
+        && record_encode (record, IRBIS_DELIMITER, answer)
+        && buffer_puts (answer, CBTEXT (MOCK_EOL));
+}
+
+/*
+ * SAVE_RECORD_GROUP: код возврата, затем по строке на каждую
+ * запись -- сохраненная запись либо код ошибки для нее.
+ * Строка запроса: имя базы данных, разделитель, текст записи.
+ */
+static am_bool mock_write_records
+    (
+        MockServer *server,
+        const SpanArray *lines,
+        Buffer *answer
+    )
+{
+    const MarcRecord *record;
+    Span line, text;
+    size_t index;
+    am_int32 code;
+    am_bool result;
+
+    if (!mock_put_code (answer, 0)) {
+        return AM_FALSE;
+    }
+
+    for (index = 12; index < lines->len; ++index) {
+        line = mock_line (lines, index);
+        if (span_is_empty (line)) {
+            continue;
+        }
+
+        text = span_null ();
+        for (; line.start + 1 < line.end; ++line.start) {
+            if (line.start[0] == IRBIS_DELIMITER[0]
+                && line.start[1] == IRBIS_DELIMITER[1]) {
+                text = span_init (line.start + 2, (size_t) (line.end - line.start - 2));
+                break;
+            }
+        }
+
+        record = mock_store (server, text, &code);
+        if (record == NULL) {
+            result = code != 0 && mock_put_code (answer, code);
+        }
+        else {
+            result = record_encode (record, IRBIS_DELIMITER, answer)
+                && buffer_puts (answer, CBTEXT (MOCK_EOL));
+        }
+
+        if (!result) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/* FORMAT_RECORD: база, формат, количество MFN, MFN... */
+static am_bool mock_format
+    (
+        MockServer *server,
+        const SpanArray *lines,
+        Buffer *answer
+    )
+{
+    const MarcRecord *record;
+    Span format;
+    am_uint32 count, index;
+    am_bool all;
+
+    format = mock_line (lines, 11);
+    if (!span_is_empty (format) && *format.start == '!') {
+        format = span_slice (format, 1, -1);
+    }
+
+    all = span_compare (format, TEXT_SPAN (ALL_FORMAT)) == 0;
+    count = span_to_uint32 (mock_line (lines, 12));
+
+    /* Одна запись: только результат форматирования */
+    if (count == 1 && !all) {
+        record = mock_get_record (server, span_to_uint32 (mock_line (lines, 13)));
+        if (record == NULL) {
+            return mock_put_code (answer, -140);
+        }
+
+        return mock_put_code (answer, 0)
+            && mock_put_brief (answer, record)
+            && buffer_puts (answer, CBTEXT (MOCK_EOL));
+    }
+
+    /* Несколько записей: строки вида "MFN#результат" */
+    if (!mock_put_code (answer, 0)) {
+        return AM_FALSE;
+    }
+
+    for (index = 0; index < count; ++index) {
+        record = mock_get_record (server, span_to_uint32 (mock_line (lines, 13 + index)));
+        if (record == NULL) {
+            continue;
+        }
+
+        if (!buffer_put_uint32 (answer, record->mfn)
+            || !buffer_putc (answer, '#')) {
+            return AM_FALSE;
+        }
+
+        if (all) {
+            if (!buffer_putc (answer, 0x1F)
+                || !record_encode (record, "\x1F", answer)) {
+                return AM_FALSE;
+            }
+        }
+        else if (!mock_put_brief (answer, record)) {
+            return AM_FALSE;
+        }
+
+        if (!buffer_puts (answer, CBTEXT (MOCK_EOL))) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/* READ_TERMS: база, начальный термин, количество, формат. */
+static am_bool mock_read_terms
+    (
+        MockServer *server,
+        const SpanArray *lines,
+        Buffer *answer
+    )
+{
+    const MockPosting *posting;
+    Span start, word;
+    am_uint32 number, count, listed = 0;
+    size_t index, next;
+    am_int32 code;
+
+    start = mock_line (lines, 11);
+    number = span_to_uint32 (mock_line (lines, 12));
+    if (server->termLimit != 0 && (number == 0 || number > server->termLimit)) {
+        number = server->termLimit;
+    }
+
+    if (mock_term_word (start, &word)) {
+        index = mock_lower_bound (server, word);
+    }
+    else {
+        /* Термины с другими префиксами в словаре отсутствуют */
+        index = span_compare_ignore_case (start, TEXT_SPAN (MOCK_PREFIX)) < 0
+            ? 0 : server->postings.len;
+        word = start;
+    }
+
+    if (index == server->postings.len) {
+        code = -203;
+    }
+    else if (span_compare_ignore_case (mock_posting (server, index)->word, word) == 0) {
+        code = 0;
+    }
+    else {
+        code = -202;
+    }
+
+    if (!mock_put_code (answer, code)) {
+        return AM_FALSE;
+    }
+
+    while (index < server->postings.len && (number == 0 || listed < number)) {
+        posting = mock_posting (server, index);
+        count = 0;
+        for (next = index; next < server->postings.len; ++next) {
+            if (span_compare_ignore_case (mock_posting (server, next)->word, posting->word) != 0) {
+                break;
+            }
+
+            ++count;
+        }
+
+        if (!buffer_put_uint32 (answer, count)
+            || !buffer_putc (answer, '#')
+            || !mock_put_term (answer, posting->word)
+            || !buffer_puts (answer, CBTEXT (MOCK_EOL))) {
+            return AM_FALSE;
+        }
+
+        index = next;
+        ++listed;
+    }
+
+    return AM_TRUE;
+}
+
+/* READ_POSTINGS: база, количество, первая ссылка, формат, термины... */
+static am_bool mock_read_postings
+    (
+        MockServer *server,
+        const SpanArray *lines,
+        Buffer *answer
+    )
+{
+    const MockPosting *posting;
+    Span format, word = SPAN_INIT;
+    am_uint32 number, first, skip, listed;
+    size_t line, index;
+
+    number = span_to_uint32 (mock_line (lines, 11));
+    first = span_to_uint32 (mock_line (lines, 12));
+    format = mock_line (lines, 13);
+
+    /* Каждый из терминов должен присутствовать в словаре */
+    for (line = 14; !span_is_empty (mock_line (lines, line)); ++line) {
+        index = server->postings.len;
+        if (mock_term_word (mock_line (lines, line), &word)) {
+            index = mock_lower_bound (server, word);
+        }
+
+        if (index == server->postings.len
+            || span_compare_ignore_case (mock_posting (server, index)->word, word) != 0) {
+            return mock_put_code (answer, -202);
+        }
+    }
+
+    if (!mock_put_code (answer, 0)) {
+        return AM_FALSE;
+    }
+
+    for (line = 14; !span_is_empty (mock_line (lines, line)); ++line) {
+        (void) mock_term_word (mock_line (lines, line), &word);
+        skip = first > 1 ? first - 1 : 0;
+        listed = 0;
+        for (index = mock_lower_bound (server, word); index < server->postings.len; ++index) {
+            posting = mock_posting (server, index);
+            if (span_compare_ignore_case (posting->word, word) != 0
+                || (number != 0 && listed == number)) {
+                break;
+            }
+
+            if (skip != 0) {
+                --skip;
+                continue;
+            }
+
+            if (!buffer_put_uint32 (answer, posting->mfn)
+                || !buffer_putc (answer, '#')
+                || !buffer_put_uint32 (answer, posting->tag)
+                || !buffer_putc (answer, '#')
+                || !buffer_put_uint32 (answer, posting->occurrence)
+                || !buffer_putc (answer, '#')
+                || !buffer_put_uint32 (answer, posting->position)) {
+                return AM_FALSE;
+            }
+
+            if (!span_is_empty (format)
+                && (!buffer_putc (answer, '#')
+                    || !mock_put_brief (answer, mock_get_record (server, posting->mfn)))) {
+                return AM_FALSE;
+            }
+
+            if (!buffer_puts (answer, CBTEXT (MOCK_EOL))) {
+                return AM_FALSE;
+            }
+
+            ++listed;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/* SEARCH: база, выражение, количество, первая запись, формат... */
+static am_bool mock_search
+    (
+        MockServer *server,
+        const SpanArray *lines,
+        Buffer *answer
+    )
+{
+    const MockPosting *posting;
+    Span expression, format, word;
+    am_byte *found;
+    am_uint32 number, first, count = 0, ordinal = 0, listed = 0;
+    size_t index;
+    am_bool prefix = AM_FALSE, result = AM_FALSE;
+
+    expression = span_trim (mock_line (lines, 11));
+    number = span_to_uint32 (mock_line (lines, 12));
+    first = span_to_uint32 (mock_line (lines, 13));
+    format = mock_line (lines, 14);
+
+    if (span_length (expression) >= 2
+        && expression.start[0] == '"'
+        && expression.end[-1] == '"') {
+        expression = span_slice (expression, 1, (ssize_t) span_length (expression) - 2);
+    }
+
+    if (!span_is_empty (expression) && expression.end[-1] == '$') {
+        prefix = AM_TRUE;
+        --expression.end;
+    }
+
+    /* Отметки найденных записей, чтобы выдать их по порядку MFN */
+    found = (am_byte*) mem_alloc (server->records.len + 1);
+    if (found == NULL) {
+        return AM_FALSE;
+    }
+
+    mem_clear (found, server->records.len + 1);
+    if (mock_term_word (expression, &word)) {
+        for (index = mock_lower_bound (server, word); index < server->postings.len; ++index) {
+            posting = mock_posting (server, index);
+            if (prefix
+                ? !mock_word_starts_with (posting->word, word)
+                : span_compare_ignore_case (posting->word, word) != 0) {
+                break;
+            }
+
+            if (!found[posting->mfn]) {
+                found[posting->mfn] = 1;
+                ++count;
+            }
+        }
+    }
+
+    if (!mock_put_code (answer, 0)
+        || !buffer_put_uint32 (answer, count)
+        || !buffer_puts (answer, CBTEXT (MOCK_EOL))) {
+        goto DONE;
+    }
+
+    for (index = 1; index <= server->records.len; ++index) {
+        if (!found[index] || ++ordinal < first) {
+            continue;
+        }
+
+        if (number != 0 && listed == number) {
+            break;
+        }
+
+        if (!buffer_put_uint32 (answer, (am_uint32) index)) {
+            goto DONE;
+        }
+
+        if (!span_is_empty (format)
+            && (!buffer_putc (answer, '#')
+                || !mock_put_brief (answer, mock_get_record (server, (am_mfn) index)))) {
+            goto DONE;
+        }
+
+        if (!buffer_puts (answer, CBTEXT (MOCK_EOL))) {
+            goto DONE;
+        }
+
+        ++listed;
+    }
+
+    result = AM_TRUE;
+
+    DONE:
+    mem_free (found);
+
+    return result;
+}
+
+/* READ_DOCUMENT: спецификации файлов "путь.база.имя" по одной в строке. */
+static am_bool mock_read_files
+    (
+        MockServer *server,
+        const SpanArray *lines,
+        Buffer *answer
+    )
+{
+    const MockFile *file;
+    Span parts[3], name;
+    size_t line, index;
+    ssize_t ampersand;
+
+    for (line = 10; line < lines->len; ++line) {
+        if (span_is_empty (mock_line (lines, line))) {
+            continue;
+        }
+
+        name = span_null ();
+        if (span_split_n_by_char (mock_line (lines, line), parts, 3, '.') == 3) {
+            name = parts[2];
+        }
+
+        if (!span_is_empty (name) && *name.start == '@') {
+            name = span_slice (name, 1, -1);
+        }
+
+        ampersand = span_index_of (name, '&');
+        if (ampersand >= 0) {
+            name = span_slice (name, 0, ampersand);
+        }
+
+        for (index = 0; index < server->files.len; ++index) {
+            file = (const MockFile*) array_get (&server->files, index);
+            if (span_compare_ignore_case (buffer_to_span (&file->name), name) == 0) {
+                if (!buffer_concat (answer, &file->content)) {
+                    return AM_FALSE;
+                }
+
+                break;
+            }
+        }
+
+        if (!buffer_puts (answer, CBTEXT (MOCK_EOL))) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/*
+ * READ_DOCUMENT со спецификациями "путь.база.имя&текст":
+ * сохранение файлов. Существующий файл заменяется.
+ */
+static am_bool mock_write_files
+    (
+        MockServer *server,
+        const SpanArray *lines,
+        Buffer *answer
+    )
+{
+    MockFile *file;
+    Span parts[3], name, content;
+    size_t line, index;
+    ssize_t ampersand;
+
+    for (line = 10; line < lines->len; ++line) {
+        if (span_split_n_by_char (mock_line (lines, line), parts, 3, '.') != 3) {
+            continue;
+        }
+
+        name = parts[2];
+        ampersand = span_index_of (name, '&');
+        if (ampersand < 0) {
+            continue;
+        }
+
+        content = span_slice (name, ampersand + 1, -1);
+        name = span_slice (name, 0, ampersand);
+        file = NULL;
+        for (index = 0; index < server->files.len; ++index) {
+            file = (MockFile*) array_get (&server->files, index);
+            if (span_compare_ignore_case (buffer_to_span (&file->name), name) == 0) {
+                break;
+            }
+
+            file = NULL;
+        }
+
+        if (file == NULL) {
+            file = (MockFile*) array_emplace_back (&server->files);
+            if (file == NULL) {
+                return AM_FALSE;
+            }
+
+            buffer_init (&file->name);
+            buffer_init (&file->content);
+            if (!buffer_assign_span (&file->name, name)) {
+                mock_free_file (file);
+                array_truncate (&server->files, server->files.len - 1);
+                return AM_FALSE;
+            }
+        }
+
+        if (!buffer_assign_span (&file->content, content)) {
+            return AM_FALSE;
+        }
+    }
+
+    return mock_put_code (answer, 0);
+}
+
+/*=========================================================*/
+
+/* Разбор запроса и формирование ответа, возможно, с имитацией ошибки. */
+static am_bool mock_respond
+    (
+        MockServer *server,
+        Span request,
+        Buffer *answer,
+        am_bool fail
+    )
+{
+    SpanArray lines = SPAN_ARRAY_INIT;
+    Navigator navigator;
+    Span command;
+    size_t index;
+    am_bool result = AM_FALSE;
+
+    /* Пустые строки значимы, поэтому не span_split_by_char */
+    nav_from_span (&navigator, request);
+    while (!nav_eot (&navigator)) {
+        if (!span_array_push_back (&lines, nav_read_to (&navigator, '\n'))) {
+            goto DONE;
+        }
+    }
+
+    /* Заголовок: команда, клиент, номер запроса, семь пустых строк */
+    command = mock_line (&lines, 0);
+    if (!mock_put_line (answer, command)
+        || !mock_put_line (answer, mock_line (&lines, 3))
+        || !mock_put_line (answer, mock_line (&lines, 4))) {
+        goto DONE;
+    }
+
+    for (index = 0; index < 7; ++index) {
+        if (!buffer_puts (answer, CBTEXT (MOCK_EOL))) {
+            goto DONE;
+        }
+    }
+
+    if (span_length (command) != 1) {
+        result = mock_put_code (answer, -2222);
+        goto DONE;
+    }
+
+    if (fail) {
+        /* В ответе на READ_DOCUMENT нет кода возврата */
+        result = *command.start == READ_DOCUMENT[0]
+            ? buffer_puts (answer, CBTEXT (MOCK_EOL))
+            : mock_put_code (answer, server->errorCode);
+        goto DONE;
+    }
+
+    mutex_lock (&server->mutex);
+
+    switch (*command.start) {
+        case 'A': /* REGISTER_CLIENT: код возврата, интервал подтверждения */
+            result = mock_put_code (answer, 0)
+                && buffer_puts (answer, CBTEXT ("30" MOCK_EOL));
+            break;
+
+        case 'B': /* UNREGISTER_CLIENT */
+        case 'N': /* NOP */
+            result = mock_put_code (answer, 0);
+            break;
+
+        case 'C':
+            result = mock_read_record (server, &lines, answer);
+            break;
+
+        case 'D':
+            result = mock_write_record (server, &lines, answer);
+            break;
+
+        case '6':
+            result = mock_write_records (server, &lines, answer);
+            break;
+
+        case 'G':
+            result = mock_format (server, &lines, answer);
+            break;
+
+        case 'H':
+            result = mock_index (server)
+                && mock_read_terms (server, &lines, answer);
+            break;
+
+        case 'I':
+            result = mock_index (server)
+                && mock_read_postings (server, &lines, answer);
+            break;
+
+        case 'K':
+            result = mock_index (server)
+                && mock_search (server, &lines, answer);
+            break;
+
+        case 'L': /* READ_DOCUMENT: чтение либо, с текстом, сохранение */
+            result = span_index_of (mock_line (&lines, 10), '&') >= 0
+                ? mock_write_files (server, &lines, answer)
+                : mock_read_files (server, &lines, answer);
+            break;
+
+        case 'O': /* GET_MAX_MFN: следующий свободный MFN */
+            result = mock_put_code (answer, (am_int32) server->records.len + 1);
+            break;
+
+        default:
+            result = mock_put_code (answer, -2222);
+            break;
+    }
+
+    mutex_unlock (&server->mutex);
+
+    DONE:
+    span_array_destroy (&lines);
+
+    return result;
+}
+
+/**
+ * Формирование ответа на клиентский запрос без обращения к сети.
+ *
+ * @param server Сервер.
+ * @param request Запрос (без первой строки с длиной).
+ * @param answer Буфер для ответа (дополняется).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL mock_server_answer
+    (
+        MockServer *server,
+        Span request,
+        Buffer *answer
+    )
+{
+    assert (server != NULL);
+    assert (answer != NULL);
+
+    return mock_respond (server, request, answer, AM_FALSE);
+}
+
+/* Отсылка ответа с ограничением скорости. */
+static am_bool mock_send
+    (
+        const MockServer *server,
+        am_int32 handle,
+        const Buffer *answer
+    )
+{
+    Span rest = buffer_to_span (answer), chunk;
+    size_t portion, sent = 0;
+    am_uint64 started, due, elapsed;
+
+    if (server->bandwidth == 0) {
+        return tcp4_send_spans (handle, &rest, 1);
+    }
+
+    /* Порции примерно по 10 мс передачи */
+    portion = server->bandwidth / 100;
+    if (portion < 256) {
+        portion = 256;
+    }
+
+    if (portion > 65536) {
+        portion = 65536;
+    }
+
+    started = magna_ticks ();
+    while (!span_is_empty (rest)) {
+        chunk = span_slice (rest, 0, (ssize_t) (span_length (rest) < portion ? span_length (rest) : portion));
+        if (!tcp4_send_spans (handle, &chunk, 1)) {
+            return AM_FALSE;
+        }
+
+        rest = span_slice (rest, (ssize_t) span_length (chunk), -1);
+        sent += span_length (chunk);
+        due = (am_uint64) sent * 1000u / server->bandwidth;
+        elapsed = magna_ticks () - started;
+        if (due > elapsed) {
+            magna_sleep ((unsigned) (due - elapsed));
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/* Обслуживание одного подключения: запрос и ответ. */
+static void mock_serve
+    (
+        MockServer *server,
+        am_int32 handle
+    )
+{
+    Buffer request = BUFFER_INIT, answer = BUFFER_INIT;
+    ssize_t newline;
+    size_t length;
+    am_uint32 number;
+    am_bool fail;
+
+    /* Первая строка -- длина запроса */
+    while ((newline = span_index_of (buffer_to_span (&request), '\n')) < 0) {
+        if (buffer_length (&request) > 32
+            || tcp4_receive_block (handle, &request, 4096) <= 0) {
+            goto DONE;
+        }
+    }
+
+    length = span_to_uint32 (span_slice (buffer_to_span (&request), 0, newline));
+    if (length > MOCK_REQUEST_LIMIT) {
+        goto DONE;
+    }
+
+    while (buffer_length (&request) < (size_t) newline + 1 + length) {
+        if (tcp4_receive_block (handle, &request, 65536) <= 0) {
+            goto DONE;
+        }
+    }
+
+    number = (am_uint32) atomic_increment_int32 (&server->requests);
+    if (server->dropEvery != 0 && number % server->dropEvery == 0) {
+        goto DONE;
+    }
+
+    if (server->latency != 0) {
+        magna_sleep (server->latency);
+    }
+
+    fail = server->errorEvery != 0 && number % server->errorEvery == 0;
+    if (mock_respond
+        (
+            server,
+            span_slice (buffer_to_span (&request), newline + 1, (ssize_t) length),
+            &answer,
+            fail
+        )) {
+        mock_send (server, handle, &answer);
+    }
+
+    DONE:
+    buffer_destroy (&answer);
+    buffer_destroy (&request);
+}
+
+/* Рабочий поток: прием и обслуживание подключений. */
+static void MAGNA_CALL mock_worker
+    (
+        void *data
+    )
+{
+    MockServer *server = (MockServer*) data;
+    am_int32 handle;
+
+    for (;;) {
+        handle = tcp4_accept (server->listener);
+        if (handle < 0) {
+            break;
+        }
+
+        if (server->stopping) {
+            tcp4_disconnect (handle);
+            break;
+        }
+
+        mock_serve (server, handle);
+        tcp4_disconnect (handle);
+    }
+}
+
+/**
+ * Запуск сервера на петлевом интерфейсе (127.0.0.1).
+ *
+ * @param server Сервер, еще не запущенный.
+ * @param port Номер порта (0 = любой свободный, см. `mock_server_port`).
+ * @param threads Количество рабочих потоков (0 = `MOCK_WORKERS`).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL mock_server_start
+    (
+        MockServer *server,
+        am_uint16 port,
+        size_t threads
+    )
+{
+    Tcp4Address address;
+    am_handle thread;
+
+    assert (server != NULL);
+    assert (server->listener < 0);
+
+    if (threads == 0) {
+        threads = MOCK_WORKERS;
+    }
+
+    if (!tcp4_resolve (CBTEXT ("127.0.0.1"), port, &address)) {
+        return AM_FALSE;
+    }
+
+    server->listener = tcp4_listen (&address, 128);
+    if (server->listener < 0) {
+        return AM_FALSE;
+    }
+
+    server->stopping = AM_FALSE;
+    server->threads = (am_handle*) mem_alloc (threads * sizeof (am_handle));
+    if (server->threads != NULL) {
+        while (server->threadCount < threads) {
+            thread = thread_start (mock_worker, server);
+            if (!handle_is_good (thread)) {
+                break;
+            }
+
+            server->threads [server->threadCount++] = thread;
+        }
+    }
+
+    if (server->threadCount == 0) {
+        mock_server_stop (server);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Номер порта, на котором работает сервер.
+ *
+ * @param server Сервер.
+ * @return Номер порта либо 0, если сервер не запущен.
+ */
+MAGNA_API am_uint16 MAGNA_CALL mock_server_port
+    (
+        const MockServer *server
+    )
+{
+    assert (server != NULL);
+
+    if (server->listener < 0) {
+        return 0;
+    }
+
+    return tcp4_local_port (server->listener);
+}
+
+/**
+ * Остановка сервера. Запросы, обрабатываемые в этот момент,
+ * завершаются. Записи сохраняются, сервер можно запустить снова.
+ *
+ * @param server Сервер.
+ */
+MAGNA_API void MAGNA_CALL mock_server_stop
+    (
+        MockServer *server
+    )
+{
+    am_int32 handle;
+    am_uint16 port;
+    size_t index;
+
+    assert (server != NULL);
+
+    if (server->listener < 0) {
+        return;
+    }
+
+    /* Каждый поток, приняв подключение, увидит признак остановки */
+    server->stopping = AM_TRUE;
+    port = tcp4_local_port (server->listener);
+    for (index = 0; index < server->threadCount; ++index) {
+        handle = tcp4_connect (CBTEXT ("127.0.0.1"), port);
+        if (handle >= 0) {
+            tcp4_disconnect (handle);
+        }
+    }
+
+    for (index = 0; index < server->threadCount; ++index) {
+        thread_wait (server->threads [index]);
+    }
+
+    mem_free (server->threads);
+    server->threads = NULL;
+    server->threadCount = 0;
+    tcp4_disconnect (server->listener);
+    server->listener = -1;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
@@ -0,0 +1,397 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file pool.c
+ *
+ * Пул подключений к серверу ИРБИС64.
+ *
+ * \struct ConnectionPool
+ *      \brief Ограниченный набор зарегистрированных на сервере
+ *      подключений, которые выдаются потокам во временное
+ *      пользование.
+ *
+ * \details Регистрация (`connection_connect`) -- относительно
+ * дорогая операция: она требует отдельного обмена с сервером
+ * и занимает лицензию. Пул регистрирует подключения лениво,
+ * по мере надобности, но не более `capacity` штук,
+ * и затем повторно использует их.
+ *
+ * Поток, которому понадобилось подключение, берет его
+ * с помощью `pool_acquire`, выполняет свои запросы
+ * и возвращает обратно с помощью `pool_release`.
+ * Если все подключения заняты, `pool_acquire` ждет,
+ * пока какое-нибудь из них не освободится.
+ *
+ * Подключение, потерявшее регистрацию (`connected == AM_FALSE`),
+ * при возврате в пул уничтожается, а на его место
+ * при необходимости регистрируется новое.
+ *
+ * \var ConnectionPool::settings
+ *      \brief Образец настроек для новых подключений.
+ *
+ * \var ConnectionPool::connections
+ *      \brief Все подключения, принадлежащие пулу.
+ *
+ * \var ConnectionPool::idle
+ *      \brief Свободные подключения.
+ *
+ * \var ConnectionPool::capacity
+ *      \brief Максимальное количество подключений.
+ *
+ * \var ConnectionPool::created
+ *      \brief Количество подключений, зарегистрированных
+ *      или регистрируемых в данный момент.
+ *
+ * \var ConnectionPool::lastError
+ *      \brief Код ошибки последней неудачной регистрации.
+ *
+ * \code
+ * ConnectionPool pool;
+ * Connection settings, *connection;
+ *
+ * connection_create (&settings);
+ * connection_set_host (&settings, CBTEXT ("myhost"));
+ * connection_set_username (&settings, CBTEXT ("librarian"));
+ * connection_set_password (&settings, CBTEXT ("secret"));
+ *
+ * pool_create (&pool, &settings, 4);
+ * connection_destroy (&settings);
+ *
+ * // В каждом из рабочих потоков
+ * connection = pool_acquire (&pool);
+ * if (connection != NULL) {
+ *     connection_search_count (connection, CBTEXT ("K=ALG$"));
+ *     pool_release (&pool, connection);
+ * }
+ *
+ * // По окончании работы
+ * pool_destroy (&pool);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+static void MAGNA_CALL pool_free_connection
+    (
+        void *item
+    )
+{
+    Connection *connection = (Connection*) item;
+
+    connection_destroy (connection);
+    mem_free (connection);
+}
+
+static void pool_forget
+    (
+        ConnectionPool *pool,
+        Connection *connection
+    )
+{
+    size_t index;
+
+    for (index = 0; index < pool->connections.len; ++index) {
+        if (pool->connections.ptr [index] == connection) {
+            pool->connections.ptr [index]
+                = pool->connections.ptr [pool->connections.len - 1];
+            --pool->connections.len;
+            break;
+        }
+    }
+
+    --pool->created;
+}
+
+/* Создание и регистрация нового подключения. Выполняется без блокировки. */
+static Connection* pool_register
+    (
+        const ConnectionPool *pool,
+        am_int32 *errorCode
+    )
+{
+    Connection *result;
+
+    result = (Connection*) mem_alloc (sizeof (Connection));
+    if (result == NULL) {
+        *errorCode = -100;
+        return NULL;
+    }
+
+    if (!connection_create (result)
+        || !connection_copy_settings (result, &pool->settings)) {
+        *errorCode = -100;
+        pool_free_connection (result);
+        return NULL;
+    }
+
+    if (!connection_connect (result)) {
+        *errorCode = result->lastError;
+        pool_free_connection (result);
+        return NULL;
+    }
+
+    return result;
+}
+
+/*=========================================================*/
+
+/**
+ * Инициализация пула.
+ * Подключения к серверу при этом не устанавливаются.
+ *
+ * @param pool Указатель на неинициализированную структуру.
+ * @param settings Образец настроек подключения (копируется).
+ * @param capacity Максимальное количество подключений (больше 0).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL pool_create
+    (
+        ConnectionPool *pool,
+        const Connection *settings,
+        size_t capacity
+    )
+{
+    assert (pool != NULL);
+    assert (settings != NULL);
+    assert (capacity != 0);
+
+    mem_clear (pool, sizeof (*pool));
+    pool->capacity = capacity;
+
+    if (!connection_create (&pool->settings)) {
+        return AM_FALSE;
+    }
+
+    if (!connection_copy_settings (&pool->settings, settings)
+        || !vector_create (&pool->connections, capacity)
+        || !vector_create (&pool->idle, capacity)
+        || !mutex_init (&pool->mutex)
+        || !condition_init (&pool->condition)) {
+        pool_destroy (pool);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых пулом.
+ * Все подключения отключаются от сервера.
+ *
+ * @param pool Пул.
+ * @warning К моменту вызова все подключения
+ * должны быть возвращены в пул.
+ */
+MAGNA_API void MAGNA_CALL pool_destroy
+    (
+        ConnectionPool *pool
+    )
+{
+    assert (pool != NULL);
+    assert (pool->idle.len == pool->connections.len);
+
+    vector_destroy (&pool->connections, pool_free_connection);
+    vector_destroy (&pool->idle, NULL);
+    condition_destroy (&pool->condition);
+    mutex_destroy (&pool->mutex);
+    connection_destroy (&pool->settings);
+    mem_clear (pool, sizeof (*pool));
+}
+
+/**
+ * Получение подключения из пула во временное пользование.
+ * Если свободных подключений нет и лимит исчерпан,
+ * ожидает возврата какого-нибудь из них.
+ *
+ * @param pool Пул.
+ * @return Зарегистрированное подключение
+ * либо `NULL`, если зарегистрироваться не удалось
+ * (код ошибки в `pool-&gt;lastError`) или пул закрыт.
+ */
+MAGNA_API Connection* MAGNA_CALL pool_acquire
+    (
+        ConnectionPool *pool
+    )
+{
+    Connection *result = NULL;
+    am_int32 errorCode = 0;
+
+    assert (pool != NULL);
+
+    mutex_lock (&pool->mutex);
+
+    for (;;) {
+        if (pool->closed) {
+            break;
+        }
+
+        if (pool->idle.len != 0) {
+            result = (Connection*) vector_pop_back (&pool->idle);
+            break;
+        }
+
+        if (pool->created < pool->capacity) {
+            /* Регистрируемся без блокировки, чтобы не задерживать остальных */
+            ++pool->created;
+            mutex_unlock (&pool->mutex);
+            result = pool_register (pool, &errorCode);
+            mutex_lock (&pool->mutex);
+
+            if (result == NULL || !vector_push_back (&pool->connections, result)) {
+                --pool->created;
+                pool->lastError = result == NULL ? errorCode : -100;
+                condition_signal (&pool->condition);
+                if (result != NULL) {
+                    mutex_unlock (&pool->mutex);
+                    pool_free_connection (result);
+                    return NULL;
+                }
+            }
+
+            break;
+        }
+
+        condition_wait (&pool->condition, &pool->mutex);
+    }
+
+    mutex_unlock (&pool->mutex);
+
+    return result;
+}
+
+/**
+ * Получение свободного подключения без ожидания.
+ * Новые подключения не регистрируются.
+ *
+ * @param pool Пул.
+ * @return Подключение либо `NULL`, если свободных нет.
+ */
+MAGNA_API Connection* MAGNA_CALL pool_try_acquire
+    (
+        ConnectionPool *pool
+    )
+{
+    Connection *result = NULL;
+
+    assert (pool != NULL);
+
+    mutex_lock (&pool->mutex);
+    if (!pool->closed && pool->idle.len != 0) {
+        result = (Connection*) vector_pop_back (&pool->idle);
+    }
+
+    mutex_unlock (&pool->mutex);
+
+    return result;
+}
+
+/**
+ * Возврат подключения в пул.
+ * Подключение, потерявшее регистрацию, уничтожается.
+ *
+ * @param pool Пул.
+ * @param connection Подключение, полученное от `pool_acquire`.
+ */
+MAGNA_API void MAGNA_CALL pool_release
+    (
+        ConnectionPool *pool,
+        Connection *connection
+    )
+{
+    am_bool discard;
+
+    assert (pool != NULL);
+    assert (connection != NULL);
+
+    mutex_lock (&pool->mutex);
+
+    discard = !connection->connected
+        || !vector_push_back (&pool->idle, connection);
+    if (discard) {
+        pool_forget (pool, connection);
+    }
+
+    condition_signal (&pool->condition);
+    mutex_unlock (&pool->mutex);
+
+    if (discard) {
+        pool_free_connection (connection);
+    }
+}
+
+/**
+ * Закрытие пула: ожидающие и последующие вызовы
+ * `pool_acquire` немедленно возвращают `NULL`.
+ * Уже выданные подключения следует вернуть как обычно.
+ *
+ * @param pool Пул.
+ */
+MAGNA_API void MAGNA_CALL pool_close
+    (
+        ConnectionPool *pool
+    )
+{
+    assert (pool != NULL);
+
+    mutex_lock (&pool->mutex);
+    pool->closed = AM_TRUE;
+    condition_broadcast (&pool->condition);
+    mutex_unlock (&pool->mutex);
+}
+
+/**
+ * Выполнение действия с подключением, взятым из пула.
+ * Подключение возвращается в пул по завершении действия.
+ *
+ * @param pool Пул.
+ * @param action Действие.
+ * @param data Произвольные данные, передаваемые действию.
+ * @return Результат действия либо `AM_FALSE`,
+ * если подключение получить не удалось.
+ */
+MAGNA_API am_bool MAGNA_CALL pool_run
+    (
+        ConnectionPool *pool,
+        PoolAction action,
+        void *data
+    )
+{
+    Connection *connection;
+    am_bool result;
+
+    assert (pool != NULL);
+    assert (action != NULL);
+
+    connection = pool_acquire (pool);
+    if (connection == NULL) {
+        return AM_FALSE;
+    }
+
+    result = action (connection, data);
+    pool_release (pool, connection);
+
+    return result;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
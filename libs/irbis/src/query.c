@@ -27,6 +27,45 @@
  *
  * \var Query::buffer
  *      \brief Буфер для накопления данных запроса.
+ *
+ * \var Query::parts
+ *      \brief Фрагменты данных, которые передаются на сервер
+ *      прямо из памяти вызывающего кода, без копирования
+ *      в буфер запроса (см. `query_add_span`).
+ *
+ * \var Query::connection
+ *      \brief Подключение, создавшее запрос. Буфер запроса
+ *      берется у него взаймы и возвращается в `query_destroy`.
+ *
+ * \struct QueryPart
+ *      \brief Фрагмент запроса, передаваемый без копирования.
+ *
+ * \var QueryPart::data
+ *      \brief Данные фрагмента. Запрос ими не владеет.
+ *
+ * \var QueryPart::offset
+ *      \brief Позиция в буфере запроса, на которой
+ *      фрагмент вклинивается в передаваемые данные.
+ *
+ * \details Большинство команд короткие, и без повторного
+ * использования памяти выделение и освобождение буферов
+ * занимало бы заметную долю времени клиента. Поэтому
+ * подключение хранит буфер последнего запроса (если его
+ * емкость не превышает `Connection::scratchLimit`)
+ * и отдает его следующему запросу. По той же причине
+ * постоянные строки заголовка (пароль и логин, которые
+ * приходится перекодировать в ANSI) кодируются один раз
+ * за сеанс и хранятся в `Connection::credentials`.
+ *
+ * Запрос должен быть уничтожен до подключения.
+ *
+ * Объемные данные, не требующие перекодирования (например,
+ * текст сохраняемой записи, который и так хранится в UTF-8),
+ * не копируются в буфер запроса: запрос лишь запоминает,
+ * где они лежат, а при отправке буфер и такие фрагменты
+ * передаются в сокет одним вызовом `tcp4_send_spans`.
+ * Память фрагментов должна оставаться неизменной
+ * до выполнения запроса.
  */
 
  /*=========================================================*/
@@ -69,17 +108,35 @@ MAGNA_API am_bool MAGNA_CALL query_add_format
         const am_byte *text
     )
 {
+    const am_byte *ptr;
+
     assert (query != NULL);
     assert (text != NULL);
 
-    /* TODO: implement */
+    /* Ссылка на файл формата передается в ANSI как есть */
+    if (*text == '@') {
+        return query_add_ansi (query, text);
+    }
 
-    if (!utf2ansi (&query->buffer, span_from_text (text))
-        || !buffer_putc (&query->buffer, 0x0A)) {
-        return AM_FALSE;
+    /* Непосредственный формат передается в UTF-8 с префиксом '!' */
+    if (*text != 0 && *text != '!') {
+        if (!buffer_putc (&query->buffer, '!')) {
+            return AM_FALSE;
+        }
     }
 
-    return AM_TRUE;
+    /* Переводы строк разрушили бы структуру запроса */
+    for (ptr = text; *ptr != 0; ++ptr) {
+        if (*ptr == '\r' || *ptr == '\n') {
+            continue;
+        }
+
+        if (!buffer_putc (&query->buffer, *ptr)) {
+            return AM_FALSE;
+        }
+    }
+
+    return buffer_putc (&query->buffer, 0x0A);
 }
 
 /**
@@ -167,6 +224,34 @@ MAGNA_API am_bool MAGNA_CALL query_new_line
     return buffer_putc (&query->buffer, 0x0A);
 }
 
+/**
+ * Выдача очередного номера запроса. Копии подключения
+ * из разных потоков берут номера из общего счетчика.
+ *
+ * @param connection Подключение.
+ * @return Номер запроса.
+ */
+MAGNA_API am_int32 MAGNA_CALL query_next_id
+    (
+        Connection *connection
+    )
+{
+    am_int32 result;
+
+    assert (connection != NULL);
+
+    if (connection->session != NULL) {
+        result = atomic_increment_int32 (&connection->session->queryId) - 1;
+    }
+    else {
+        result = connection->queryId;
+    }
+
+    connection->queryId = result + 1;
+
+    return result;
+}
+
 /**
  * Создание пользовательского запроса.
  *
@@ -181,32 +266,54 @@ MAGNA_API am_bool MAGNA_CALL query_create
         const am_byte *command
     )
 {
+    Buffer *credentials;
+    am_int32 queryId;
+
     assert (connection != NULL);
     assert (query != NULL);
     assert (strlen ((const char*) command) != 0);
 
-    if (!buffer_create (&query->buffer, NULL, 16)
-        || !query_add_ansi (query, command)
+    credentials = &connection->credentials;
+    query_init (query);
+    query->connection = connection;
+    if (buffer_capacity (&connection->scratchQuery) != 0) {
+        query->buffer = connection->scratchQuery;
+        buffer_init (&connection->scratchQuery);
+        buffer_clear (&query->buffer);
+    }
+    else if (!buffer_create (&query->buffer, NULL, 16)) {
+        return AM_FALSE;
+    }
+
+    /* Пароль и логин кодируются один раз за сеанс */
+    if (buffer_is_empty (credentials)) {
+        if (!buffer_utf8_to_ansi (credentials, &connection->password)
+            || !buffer_putc (credentials, 0x0A)
+            || !buffer_utf8_to_ansi (credentials, &connection->username)
+            || !buffer_puts (credentials, CBTEXT ("\n\n\n\n"))) {
+            buffer_clear (credentials);
+            return AM_FALSE;
+        }
+    }
+
+    queryId = query_next_id (connection);
+    if (!query_add_ansi (query, command)
         || !buffer_putc (&query->buffer, connection->workstation)
         || !query_new_line (query)
         || !query_add_ansi (query, command)
         || !query_add_int32(query, connection->clientId)
-        || !query_add_int32(query, connection->queryId)
-        || !query_add_ansi_buffer (query, &connection->password)
-        || !query_add_ansi_buffer (query, &connection->username)
-        || !query_new_line (query)
-        || !query_new_line (query)
-        || !query_new_line (query)) {
+        || !query_add_int32(query, queryId)
+        || !buffer_concat (&query->buffer, credentials)) {
         return AM_FALSE;
     }
 
-    ++connection->queryId;
-
     return AM_TRUE;
 }
 
 /**
  * Освобождение ресурсов, занятых клиентским запросом.
+ * Буфер, не превышающий `Connection::scratchLimit`,
+ * возвращается подключению для следующего запроса.
  *
  * @param query Клиентский запрос.
  */
@@ -215,9 +322,388 @@ MAGNA_API void MAGNA_CALL query_destroy
         Query *query
     )
 {
+    Connection *connection;
+
+    assert (query != NULL);
+
+    connection = query->connection;
+    if (connection != NULL
+        && buffer_capacity (&connection->scratchQuery) == 0
+        && buffer_capacity (&query->buffer) <= connection->scratchLimit) {
+        connection->scratchQuery = query->buffer;
+        buffer_init (&query->buffer);
+    }
+    else {
+        buffer_destroy (&query->buffer);
+    }
+
+    array_destroy (&query->parts, NULL);
+    query->connection = NULL;
+}
+
+/**
+ * Простая инициализация пустого запроса без заголовка.
+ * Не выделяет память в куче.
+ *
+ * @param query Указатель на неинициализированную структуру.
+ */
+MAGNA_API void MAGNA_CALL query_init
+    (
+        Query *query
+    )
+{
+    assert (query != NULL);
+
+    buffer_init (&query->buffer);
+    array_init (&query->parts, sizeof (QueryPart));
+    query->connection = NULL;
+}
+
+/**
+ * Добавление данных без перевода строки. Объемные данные
+ * не копируются, а передаются на сервер прямо из памяти
+ * вызывающего кода, поэтому она должна оставаться неизменной
+ * до выполнения запроса. Перекодирование не выполняется.
+ *
+ * @param query Клиентский запрос.
+ * @param data Добавляемые данные.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL query_add_span
+    (
+        Query *query,
+        Span data
+    )
+{
+    QueryPart *part;
+
     assert (query != NULL);
 
-    buffer_destroy(&query->buffer);
+    if (span_length (data) < QUERY_COPY_LIMIT) {
+        return buffer_write_span (&query->buffer, data);
+    }
+
+    part = (QueryPart*) array_emplace_back (&query->parts);
+    if (part == NULL) {
+        return AM_FALSE;
+    }
+
+    part->data = data;
+    part->offset = buffer_length (&query->buffer);
+
+    return AM_TRUE;
+}
+
+/**
+ * Добавление записи в формате, принятом для сохранения
+ * на сервере (без завершающего перевода строки).
+ * Значения полей и подполей не копируются
+ * (см. `query_add_span`), поэтому запись должна оставаться
+ * неизменной до выполнения запроса.
+ *
+ * @param query Клиентский запрос.
+ * @param record Запись.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL query_add_record
+    (
+        Query *query,
+        const MarcRecord *record
+    )
+{
+    Buffer *buffer;
+    const MarcField *field;
+    const SubField *subfield;
+    size_t i, j;
+
+    assert (query != NULL);
+    assert (record != NULL);
+
+    buffer = &query->buffer;
+
+    if (!buffer_put_uint32 (buffer, record->mfn)
+        || !buffer_putc (buffer, '#')
+        || !buffer_put_uint32 (buffer, record->status)
+        || !buffer_puts (buffer, CBTEXT (IRBIS_DELIMITER))
+        || !buffer_puts (buffer, CBTEXT ("0#"))
+        || !buffer_put_uint32 (buffer, record->version)
+        || !buffer_puts (buffer, CBTEXT (IRBIS_DELIMITER))) {
+        return AM_FALSE;
+    }
+
+    for (i = 0; i < record->fields.len; ++i) {
+        field = (const MarcField*) array_get (&record->fields, i);
+        if (!buffer_put_uint32 (buffer, field->tag)
+            || !buffer_putc (buffer, '#')
+            || !query_add_span (query, buffer_to_span (&field->value))) {
+            return AM_FALSE;
+        }
+
+        for (j = 0; j < field->subfields.len; ++j) {
+            subfield = field_get_subfield_by_index (field, j);
+            if (!buffer_putc (buffer, '^')
+                || !buffer_putc (buffer, subfield->code)
+                || !query_add_span (query, buffer_to_span (&subfield->value))) {
+                return AM_FALSE;
+            }
+        }
+
+        if (!buffer_puts (buffer, CBTEXT (IRBIS_DELIMITER))) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Полная длина запроса в байтах, включая фрагменты,
+ * передаваемые без копирования.
+ *
+ * @param query Клиентский запрос.
+ * @return Длина запроса.
+ */
+MAGNA_API size_t MAGNA_CALL query_length
+    (
+        const Query *query
+    )
+{
+    size_t result, index;
+    const QueryPart *part;
+
+    assert (query != NULL);
+
+    result = buffer_length (&query->buffer);
+    for (index = 0; index < query->parts.len; ++index) {
+        part = (const QueryPart*) array_get (&query->parts, index);
+        result += span_length (part->data);
+    }
+
+    return result;
+}
+
+/**
+ * Сборка всего запроса (включая фрагменты, передаваемые
+ * без копирования) в одном буфере. Нужна там, где запрос
+ * должен пережить данные, на которые ссылается.
+ *
+ * @param query Клиентский запрос.
+ * @param output Буфер, к которому дописывается запрос.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL query_to_buffer
+    (
+        const Query *query,
+        Buffer *output
+    )
+{
+    const QueryPart *part;
+    size_t index, offset = 0;
+
+    assert (query != NULL);
+    assert (output != NULL);
+
+    if (!buffer_grow (output, buffer_length (output) + query_length (query))) {
+        return AM_FALSE;
+    }
+
+    for (index = 0; index < query->parts.len; ++index) {
+        part = (const QueryPart*) array_get (&query->parts, index);
+        if (!buffer_write (output, query->buffer.start + offset, part->offset - offset)
+            || !buffer_write_span (output, part->data)) {
+            return AM_FALSE;
+        }
+
+        offset = part->offset;
+    }
+
+    return buffer_write
+        (
+            output,
+            query->buffer.start + offset,
+            buffer_length (&query->buffer) - offset
+        );
+}
+
+/**
+ * Строка запроса с указанным номером (нумерация с 0):
+ * 0 -- команда, 4 -- номер запроса, с 10 -- параметры команды.
+ * Фрагменты, передаваемые без копирования, не учитываются.
+ *
+ * @param query Клиентский запрос.
+ * @param number Номер строки.
+ * @return Строка без перевода строки либо `span_null ()`,
+ * если в запросе нет строки с таким номером.
+ */
+MAGNA_API Span MAGNA_CALL query_get_line
+    (
+        const Query *query,
+        size_t number
+    )
+{
+    Navigator navigator;
+    Span result = SPAN_INIT;
+
+    assert (query != NULL);
+
+    nav_from_buffer (&navigator, &query->buffer);
+    do {
+        if (nav_eot (&navigator)) {
+            return span_null ();
+        }
+
+        result = nav_read_to (&navigator, '\n');
+    } while (number-- != 0);
+
+    return result;
+}
+
+/*
+ * Есть ли среди параметров запроса спецификация файла
+ * с текстом ("путь.база.имя&текст"), т. е. сохранение файла.
+ */
+static am_bool query_has_content
+    (
+        const Query *query
+    )
+{
+    Span line;
+    size_t number;
+
+    for (number = 10; ; ++number) {
+        line = query_get_line (query, number);
+        if (line.start == NULL) {
+            return AM_FALSE;
+        }
+
+        if (span_index_of (line, '&') >= 0) {
+            return AM_TRUE;
+        }
+    }
+}
+
+/**
+ * Команда только читает данные на сервере?
+ * Неизвестные команды считаются изменяющими,
+ * как и READ_DOCUMENT, сохраняющий файл.
+ *
+ * @param query Клиентский запрос.
+ * @return Результат проверки.
+ */
+MAGNA_API am_bool MAGNA_CALL query_is_read_only
+    (
+        const Query *query
+    )
+{
+    Span command, lock;
+
+    assert (query != NULL);
+
+    command = query_get_line (query, 0);
+    if (span_length (command) == 2 && command.start[0] == '+') {
+        switch (command.start[1]) {
+            case '1': /* GET_SERVER_STAT */
+            case '3': /* GET_PROCESS_LIST */
+            case '9': /* GET_USER_LIST */
+                return AM_TRUE;
+
+            default:
+                return AM_FALSE;
+        }
+    }
+
+    if (span_length (command) != 1) {
+        return AM_FALSE;
+    }
+
+    switch (command.start[0]) {
+        case 'C': /* READ_RECORD, но блокировка записи -- изменение */
+            lock = query_get_line (query, 12);
+            return span_is_empty (lock) || span_to_uint32 (lock) == 0;
+
+        case 'L': /* READ_DOCUMENT, но с текстом -- сохранение */
+            return !query_has_content (query);
+
+        case '0': /* RECORD_LIST */
+        case '1': /* SERVER_INFO */
+        case '2': /* DATABASE_STAT */
+        case '7': /* PRINT */
+        case 'G': /* FORMAT_RECORD */
+        case 'H': /* READ_TERMS */
+        case 'I': /* READ_POSTINGS */
+        case 'K': /* SEARCH */
+        case 'N': /* NOP */
+        case 'O': /* GET_MAX_MFN */
+        case 'P': /* READ_TERMS_REVERSE */
+        case 'R': /* FULL_TEXT_SEARCH */
+        case 'V': /* GET_RECORD_POSTINGS */
+        case '!': /* LIST_FILES */
+            return AM_TRUE;
+
+        default:
+            return AM_FALSE;
+    }
+}
+
+/**
+ * Копия запроса для отсылки через другое подключение:
+ * заголовок (идентификатор клиента, номер запроса, логин
+ * и пароль) формируется заново, параметры команды копируются.
+ *
+ * @param query Исходный клиентский запрос.
+ * @param connection Подключение, через которое уйдет копия.
+ * @param target Неинициализированный запрос для копии.
+ * Уничтожается вызывающей стороной в любом случае.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL query_rebind
+    (
+        const Query *query,
+        Connection *connection,
+        Query *target
+    )
+{
+    Query flat;
+    Span command, last, body;
+    am_byte code[8];
+    am_bool result = AM_FALSE;
+
+    assert (query != NULL);
+    assert (connection != NULL);
+    assert (target != NULL);
+
+    query_init (&flat);
+    query_init (target);
+    if (!query_to_buffer (query, &flat.buffer)) {
+        goto DONE;
+    }
+
+    /* Заголовок запроса -- 10 строк */
+    command = query_get_line (&flat, 0);
+    last = query_get_line (&flat, 9);
+    if (command.start == NULL
+        || last.start == NULL
+        || span_is_empty (command)
+        || span_length (command) >= sizeof (code)) {
+        goto DONE;
+    }
+
+    mem_copy (code, command.start, span_length (command));
+    code[span_length (command)] = 0;
+    body = query_get_line (&flat, 10);
+    result = query_create (target, connection, code)
+        && (body.start == NULL
+            || buffer_write
+                (
+                    &target->buffer,
+                    body.start,
+                    (size_t) (flat.buffer.current - body.start)
+                ));
+
+    DONE:
+    query_destroy (&flat);
+
+    return result;
 }
 
 /**
@@ -238,7 +724,7 @@ MAGNA_API am_bool MAGNA_CALL query_encode
     assert (query != NULL);
     assert (prefix != NULL);
 
-    sprintf ((char*) temp, "%u\n", (unsigned int) buffer_length (&query->buffer));
+    sprintf ((char*) temp, "%u\n", (unsigned int) query_length (query));
 
     return buffer_puts (prefix, temp);
 }
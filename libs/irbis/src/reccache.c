@@ -0,0 +1,348 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file reccache.c
+ *
+ * Кэш раскодированных записей.
+ *
+ * \struct RecordCache
+ *      \brief Ограниченный по объему памяти кэш записей,
+ *      ключом которого служат имя базы данных и MFN.
+ *
+ * \details Кэш подключается к соединению явно:
+ * `connection->recordCache = &cache`. После этого
+ * `connection_read_record` отдает копию записи из кэша
+ * без обращения к серверу и без повторного разбора,
+ * а при промахе помещает прочитанную запись в кэш.
+ * Пакетное чтение (`connection_read_records`) обновляет кэш
+ * свежими версиями записей. `connection_write_record`,
+ * `connection_delete_record` и `connection_undelete_record`
+ * сбрасывают затронутые записи (а `connection_write_record`
+ * с `reparse` -- сразу кладет в кэш новую версию).
+ * `connection_write_records` сверяет кэш с версиями,
+ * которые прислал сервер (`record_cache_validate`): устаревшие
+ * копии сбрасываются, копия новой версии, уже помещенная в кэш
+ * другим подключением, остается.
+ *
+ * Если откуда-либо еще известна актуальная версия записи,
+ * устаревшую копию можно сбросить тем же `record_cache_validate`.
+ *
+ * При превышении объема вытесняются записи, к которым дольше
+ * всего не обращались. Счетчики попаданий, промахов и занятой
+ * памяти (`cache.hits`, `cache.misses`, `cache.size`)
+ * позволяют подобрать подходящий объем.
+ *
+ * Кэш защищен мьютексом и может разделяться несколькими
+ * подключениями (например, в пуле).
+ */
+
+/*=========================================================*/
+
+/* Построение ключа "база#MFN". */
+static am_bool record_cache_key
+    (
+        const Buffer *database,
+        am_mfn mfn,
+        Buffer *key
+    )
+{
+    if (!buffer_concat (key, database)
+        || !buffer_putc (key, '#')
+        || !buffer_put_uint32 (key, mfn)) {
+        return AM_FALSE;
+    }
+
+    span_toupper (buffer_to_span (key));
+
+    return AM_TRUE;
+}
+
+/* Приблизительный объем памяти, занимаемой записью. */
+static size_t record_cache_weight
+    (
+        const MarcRecord *record
+    )
+{
+    size_t result, index, subindex;
+    const MarcField *field;
+    const SubField *subfield;
+
+    result = sizeof (MarcRecord) + buffer_capacity (&record->database);
+    for (index = 0; index < record->fields.len; ++index) {
+        field = (const MarcField*) array_get (&record->fields, index);
+        result += sizeof (MarcField) + buffer_capacity (&field->value);
+        for (subindex = 0; subindex < field->subfields.len; ++subindex) {
+            subfield = (const SubField*) array_get (&field->subfields, subindex);
+            result += sizeof (SubField) + buffer_capacity (&subfield->value);
+        }
+    }
+
+    return result;
+}
+
+static void MAGNA_CALL record_cache_free_record
+    (
+        void *value
+    )
+{
+    MarcRecord *record = (MarcRecord*) value;
+
+    record_destroy (record);
+    mem_free (record);
+}
+
+/*=========================================================*/
+
+/**
+ * Инициализация кэша.
+ *
+ * @param cache Указатель на неинициализированную структуру.
+ * @param capacity Предельный объем памяти под записи в байтах.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL record_cache_create
+    (
+        RecordCache *cache,
+        size_t capacity
+    )
+{
+    assert (cache != NULL);
+
+    mem_clear (cache, sizeof (*cache));
+    if (!lru_create (&cache->cache, capacity, 1021, record_cache_free_record)) {
+        return AM_FALSE;
+    }
+
+    if (!mutex_init (&cache->mutex)) {
+        lru_destroy (&cache->cache);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых кэшем.
+ *
+ * @param cache Кэш.
+ * @warning Ни одно подключение не должно ссылаться на кэш.
+ */
+MAGNA_API void MAGNA_CALL record_cache_destroy
+    (
+        RecordCache *cache
+    )
+{
+    assert (cache != NULL);
+
+    lru_destroy (&cache->cache);
+    mutex_destroy (&cache->mutex);
+    mem_clear (cache, sizeof (*cache));
+}
+
+/**
+ * Получение копии записи из кэша.
+ *
+ * @param cache Кэш.
+ * @param database Имя базы данных.
+ * @param mfn MFN записи.
+ * @param record Инициализированная запись для результата
+ * (прежнее содержимое уничтожается только при попадании).
+ * @return `AM_TRUE`, если запись найдена в кэше.
+ */
+MAGNA_API am_bool MAGNA_CALL record_cache_get
+    (
+        RecordCache *cache,
+        const Buffer *database,
+        am_mfn mfn,
+        MarcRecord *record
+    )
+{
+    Buffer key = BUFFER_INIT;
+    const MarcRecord *cached;
+    am_bool result = AM_FALSE;
+
+    assert (cache != NULL);
+    assert (database != NULL);
+    assert (record != NULL);
+
+    if (!record_cache_key (database, mfn, &key)) {
+        buffer_destroy (&key);
+        return AM_FALSE;
+    }
+
+    mutex_lock (&cache->mutex);
+    cached = (const MarcRecord*) lru_get (&cache->cache, buffer_to_span (&key));
+    if (cached != NULL) {
+        record_clear (record);
+        buffer_destroy (&record->database);
+        result = record_clone (record, cached) != NULL;
+    }
+
+    mutex_unlock (&cache->mutex);
+    buffer_destroy (&key);
+
+    return result;
+}
+
+/**
+ * Помещение копии записи в кэш.
+ * Прежняя копия с тем же MFN заменяется.
+ *
+ * @param cache Кэш.
+ * @param database Имя базы данных.
+ * @param record Запись (копируется).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL record_cache_put
+    (
+        RecordCache *cache,
+        const Buffer *database,
+        const MarcRecord *record
+    )
+{
+    Buffer key = BUFFER_INIT;
+    MarcRecord *copy;
+    am_bool result = AM_FALSE;
+
+    assert (cache != NULL);
+    assert (database != NULL);
+    assert (record != NULL);
+
+    if (record->mfn == 0) {
+        return AM_FALSE;
+    }
+
+    copy = (MarcRecord*) mem_alloc (sizeof (MarcRecord));
+    if (copy == NULL) {
+        return AM_FALSE;
+    }
+
+    record_init (copy);
+    if (record_clone (copy, record) == NULL
+        || !record_cache_key (database, record->mfn, &key)) {
+        record_cache_free_record (copy);
+        goto DONE;
+    }
+
+    mutex_lock (&cache->mutex);
+    result = lru_put (&cache->cache, buffer_to_span (&key), copy, record_cache_weight (copy));
+    mutex_unlock (&cache->mutex);
+
+    DONE:
+    buffer_destroy (&key);
+
+    return result;
+}
+
+/**
+ * Удаление записи из кэша.
+ *
+ * @param cache Кэш.
+ * @param database Имя базы данных.
+ * @param mfn MFN записи.
+ */
+MAGNA_API void MAGNA_CALL record_cache_invalidate
+    (
+        RecordCache *cache,
+        const Buffer *database,
+        am_mfn mfn
+    )
+{
+    Buffer key = BUFFER_INIT;
+
+    assert (cache != NULL);
+    assert (database != NULL);
+
+    if (record_cache_key (database, mfn, &key)) {
+        mutex_lock (&cache->mutex);
+        lru_remove (&cache->cache, buffer_to_span (&key));
+        mutex_unlock (&cache->mutex);
+    }
+
+    buffer_destroy (&key);
+}
+
+/**
+ * Сверка версии записи в кэше с известной актуальной версией.
+ * Устаревшая копия удаляется.
+ *
+ * @param cache Кэш.
+ * @param database Имя базы данных.
+ * @param mfn MFN записи.
+ * @param version Актуальная версия записи.
+ * @return `AM_TRUE`, если в кэше была актуальная копия.
+ */
+MAGNA_API am_bool MAGNA_CALL record_cache_validate
+    (
+        RecordCache *cache,
+        const Buffer *database,
+        am_mfn mfn,
+        am_uint32 version
+    )
+{
+    Buffer key = BUFFER_INIT;
+    const MarcRecord *cached;
+    am_bool result = AM_FALSE;
+
+    assert (cache != NULL);
+    assert (database != NULL);
+
+    if (!record_cache_key (database, mfn, &key)) {
+        buffer_destroy (&key);
+        return AM_FALSE;
+    }
+
+    mutex_lock (&cache->mutex);
+    cached = (const MarcRecord*) lru_peek (&cache->cache, buffer_to_span (&key));
+    if (cached != NULL) {
+        result = cached->version == version;
+        if (!result) {
+            lru_remove (&cache->cache, buffer_to_span (&key));
+        }
+    }
+
+    mutex_unlock (&cache->mutex);
+    buffer_destroy (&key);
+
+    return result;
+}
+
+/**
+ * Удаление из кэша всех записей.
+ *
+ * @param cache Кэш.
+ */
+MAGNA_API void MAGNA_CALL record_cache_clear
+    (
+        RecordCache *cache
+    )
+{
+    assert (cache != NULL);
+
+    mutex_lock (&cache->mutex);
+    lru_clear (&cache->cache);
+    mutex_unlock (&cache->mutex);
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
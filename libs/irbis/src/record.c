@@ -57,6 +57,7 @@ MAGNA_API void MAGNA_CALL record_destroy
     assert (record != NULL);
 
     array_destroy (&record->fields, (Liberator) field_destroy);
+    buffer_destroy (&record->database);
 }
 
 /**
@@ -65,7 +66,7 @@ MAGNA_API void MAGNA_CALL record_destroy
  * @param record Запись.
  * @param tag Метка добавляемого поля.
  * @param value Значение поля до первого разделителя (может быть `NULL`).
- * @return Вновь созданное поле.
+ * @return Вновь созданное поле либо `NULL`.
  */
 MAGNA_API MarcField* MAGNA_CALL record_add
     (
@@ -78,10 +79,18 @@ MAGNA_API MarcField* MAGNA_CALL record_add
 
     assert (record != NULL);
 
-    field = calloc (1, sizeof (MarcField));
+    field = (MarcField*) array_emplace_back (&record->fields);
+    if (field == NULL) {
+        return NULL;
+    }
+
+    field_create (field);
     field->tag = tag;
-    buffer_from_text (&field->value, CBTEXT (value));
-    array_push_back (&record->fields, field);
+    if (value != NULL && !buffer_from_text (&field->value, value)) {
+        field_destroy (field);
+        --record->fields.len;
+        return NULL;
+    }
 
     return field;
 }
@@ -139,15 +148,14 @@ MAGNA_API MarcRecord* MAGNA_CALL record_clone
 
     for (index = 0; index < source->fields.len; ++index) {
         src = (const MarcField*) array_get(&source->fields, index);
-        dst = (MarcField*) calloc (1, sizeof (MarcField));
+        dst = (MarcField*) array_emplace_back (&target->fields);
         if (dst == NULL) {
             return NULL;
         }
 
-        field_create (dst);
-        dst->tag = src->tag;
-        field_clone (dst, src);
-        array_push_back (&target->fields, dst);
+        if (!field_clone (dst, src)) {
+            return NULL;
+        }
     }
 
     return target;
@@ -187,10 +195,35 @@ MAGNA_API am_bool MAGNA_CALL record_encode
         Buffer *buffer
     )
 {
+    size_t index;
+    const MarcField *field;
+
     assert (record != NULL);
     assert (buffer != NULL);
 
-    return AM_FALSE;
+    if (delimiter == NULL) {
+        delimiter = IRBIS_DELIMITER;
+    }
+
+    if (!buffer_put_uint32 (buffer, record->mfn)
+        || !buffer_putc (buffer, '#')
+        || !buffer_put_uint32 (buffer, record->status)
+        || !buffer_puts (buffer, CBTEXT (delimiter))
+        || !buffer_puts (buffer, CBTEXT ("0#"))
+        || !buffer_put_uint32 (buffer, record->version)
+        || !buffer_puts (buffer, CBTEXT (delimiter))) {
+        return AM_FALSE;
+    }
+
+    for (index = 0; index < record->fields.len; ++index) {
+        field = (const MarcField*) array_get (&record->fields, index);
+        if (!field_to_string (field, buffer)
+            || !buffer_puts (buffer, CBTEXT (delimiter))) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
 }
 
 /**
@@ -487,6 +520,134 @@ MAGNA_API am_bool MAGNA_CALL record_parse_single
     return AM_TRUE;
 }
 
+/**
+ * Является ли символ разделителем строк
+ * в текстовом представлении записи.
+ */
+#define record_is_delimiter(__c) \
+    ((__c) == 0x1F || (__c) == 0x1E || (__c) == '\r' || (__c) == '\n')
+
+/**
+ * Выделение очередной строки из текстового представления записи.
+ * Разделителями служат символы 0x1F, 0x1E, CR и LF,
+ * пустые строки пропускаются.
+ *
+ * @param line Указатель на остаток текста (сдвигается).
+ * @return Выделенный фрагмент (пустой, если текст исчерпан).
+ */
+static Span record_next_part
+    (
+        Span *line
+    )
+{
+    Span result;
+
+    while (line->start < line->end
+        && record_is_delimiter (*line->start)) {
+        ++line->start;
+    }
+
+    result.start = line->start;
+    while (line->start < line->end
+        && !record_is_delimiter (*line->start)) {
+        ++line->start;
+    }
+
+    result.end = line->start;
+
+    return result;
+}
+
+/**
+ * Разбор текстового представления записи вида
+ * "MFN#статус" D "0#версия" D "поле" D "поле"...,
+ * где D -- любая последовательность символов 0x1F, 0x1E, CR, LF
+ * (в частности, IRBIS_DELIMITER). Обратная операция к record_encode.
+ *
+ * @param record Запись, в которую помещается результат.
+ * @param text Текст для разбора.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL record_decode_text
+    (
+        MarcRecord *record,
+        Span text
+    )
+{
+    Span part;
+    Span parts[2];
+    size_t nparts;
+    MarcField *field;
+
+    assert (record != NULL);
+
+    record_clear (record);
+    record->mfn = 0;
+    record->status = 0;
+    record->version = 0;
+
+    part = record_next_part (&text);
+    nparts = span_split_n_by_char (part, parts, 2, '#');
+    if (nparts != 2) {
+        return AM_FALSE;
+    }
+
+    record->mfn = span_to_uint32 (parts[0]);
+    record->status = span_to_uint32 (parts[1]);
+
+    part = record_next_part (&text);
+    nparts = span_split_n_by_char (part, parts, 2, '#');
+    if (nparts == 2) {
+        record->version = span_to_uint32 (parts[1]);
+    }
+
+    while (AM_TRUE) {
+        part = record_next_part (&text);
+        if (span_is_empty (part)) {
+            break;
+        }
+
+        field = (MarcField*) array_emplace_back (&record->fields);
+        if (field == NULL) {
+            return AM_FALSE;
+        }
+
+        field_create (field);
+        if (!field_decode (field, part)) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Разбор строки, полученной при форматировании записи
+ * по ALL_FORMAT (см. connection_read_records).
+ * Строка имеет вид "MFN#" 0x1F "MFN#статус" 0x1F "0#версия"
+ * 0x1F "поле" 0x1F "поле"...
+ *
+ * @param record Запись, в которую помещается результат.
+ * @param line Строка для разбора.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL record_parse_all_format
+    (
+        MarcRecord *record,
+        Span line
+    )
+{
+    assert (record != NULL);
+
+    /* Первый фрагмент -- MFN, добавленный сервером */
+    if (span_is_empty (record_next_part (&line))) {
+        record_clear (record);
+        return AM_FALSE;
+    }
+
+    return record_decode_text (record, line);
+}
+
 /**
  * Верификация записи.
  *
@@ -0,0 +1,354 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file reserve.c
+ *
+ * Запас заранее установленных TCP-соединений с сервером.
+ *
+ * \struct SocketReserve
+ *      \brief Небольшой набор сокетов, подключенных к серверу
+ *      заранее, в фоновом потоке.
+ *
+ * \details Протокол ИРБИС64 требует нового TCP-соединения
+ * для каждой команды, поэтому каждый запрос платит за полный
+ * цикл установки соединения. На медленных каналах это основная
+ * часть времени выполнения коротких команд.
+ *
+ * Запас убирает эту задержку с критического пути: фоновый поток
+ * поддерживает `capacity` уже установленных соединений,
+ * а `connection_execute` просто берет готовое. Взятое соединение
+ * тут же восполняется в фоне.
+ *
+ * Соединения старше `maxAge` миллисекунд, а также закрытые
+ * сервером, отбрасываются. Если запас пуст, подключение
+ * выполняется обычным образом, в пределах срока выполнения
+ * команды (`timeout` и `deadline` подключения). Без срока,
+ * если установлен `fastOpen`, -- с TCP Fast Open.
+ *
+ * Запас подключается к соединению явно:
+ * `connection->reserve = &reserve`. Он защищен мьютексом
+ * и может разделяться несколькими подключениями к одному
+ * и тому же серверу.
+ *
+ * Перед каждым запросом подключение сообщает запасу свой
+ * текущий адрес сервера (`socket_reserve_set_address`).
+ * Если имя хоста разрешилось в другой адрес либо сменился
+ * порт, соединения со старым адресом закрываются, и запас
+ * пополняется уже новыми.
+ *
+ * \code
+ * SocketReserve reserve;
+ *
+ * socket_reserve_create (&reserve, &connection, 2);
+ * connection.reserve = &reserve;
+ * ...
+ * connection.reserve = NULL;
+ * socket_reserve_destroy (&reserve);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+/* Закрытие соединения, которое больше не пригодно. */
+static void socket_reserve_discard
+    (
+        SocketReserve *reserve,
+        size_t index
+    )
+{
+    tcp4_disconnect (reserve->sockets[index]);
+    --reserve->count;
+    reserve->sockets[index] = reserve->sockets[reserve->count];
+    reserve->born[index] = reserve->born[reserve->count];
+}
+
+/* Отбрасывание устаревших соединений. */
+static void socket_reserve_expire
+    (
+        SocketReserve *reserve,
+        am_uint64 now
+    )
+{
+    size_t index = 0;
+
+    while (index < reserve->count) {
+        if (reserve->maxAge != 0
+            && now - reserve->born[index] >= reserve->maxAge) {
+            socket_reserve_discard (reserve, index);
+        }
+        else {
+            ++index;
+        }
+    }
+}
+
+/* Совпадают ли адреса. */
+static am_bool socket_reserve_same
+    (
+        const Tcp4Address *first,
+        const Tcp4Address *second
+    )
+{
+    return first->address == second->address
+        && first->port == second->port;
+}
+
+/* Фоновый поток, пополняющий запас. */
+static void MAGNA_CALL socket_reserve_worker
+    (
+        void *data
+    )
+{
+    SocketReserve *reserve = (SocketReserve*) data;
+    Tcp4Address address;
+    am_int32 handle;
+    am_int32 timeout;
+
+    mutex_lock (&reserve->mutex);
+    while (!reserve->stop) {
+        socket_reserve_expire (reserve, magna_ticks ());
+        if (reserve->count < reserve->capacity) {
+            /* Подключаемся без блокировки, чтобы не задерживать потребителей */
+            address = reserve->address;
+            mutex_unlock (&reserve->mutex);
+            handle = tcp4_connect_address (&address);
+            mutex_lock (&reserve->mutex);
+
+            if (handle != -1) {
+                /* Пока подключались, адрес сервера мог смениться */
+                if (reserve->stop
+                    || reserve->count >= reserve->capacity
+                    || !socket_reserve_same (&address, &reserve->address)) {
+                    tcp4_disconnect (handle);
+                }
+                else {
+                    reserve->sockets[reserve->count] = handle;
+                    reserve->born[reserve->count] = magna_ticks ();
+                    ++reserve->count;
+                }
+
+                continue;
+            }
+
+            /* Сервер недоступен: не долбим его попусту */
+            timeout = 1000;
+        }
+        else {
+            timeout = reserve->maxAge == 0
+                ? 1000
+                : (am_int32) (reserve->maxAge / 2 + 1);
+        }
+
+        if (!reserve->stop) {
+            condition_wait_for (&reserve->condition, &reserve->mutex, timeout);
+        }
+    }
+
+    mutex_unlock (&reserve->mutex);
+}
+
+/*=========================================================*/
+
+/**
+ * Создание запаса соединений и запуск фонового потока,
+ * пополняющего его.
+ *
+ * @param reserve Указатель на неинициализированную структуру.
+ * @param connection Подключение, задающее адрес сервера
+ * (имя хоста разрешается здесь же).
+ * @param capacity Количество соединений в запасе
+ * (не более SOCKET_RESERVE_MAX).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL socket_reserve_create
+    (
+        SocketReserve *reserve,
+        Connection *connection,
+        size_t capacity
+    )
+{
+    assert (reserve != NULL);
+    assert (connection != NULL);
+    assert (capacity != 0);
+
+    mem_clear (reserve, sizeof (*reserve));
+    reserve->thread = handle_get_bad ();
+    reserve->capacity = capacity > SOCKET_RESERVE_MAX ? SOCKET_RESERVE_MAX : capacity;
+    reserve->maxAge = SOCKET_RESERVE_AGE;
+
+    if (!connection_resolve (connection, AM_FALSE)) {
+        return AM_FALSE;
+    }
+
+    reserve->address = connection->address;
+    if (!mutex_init (&reserve->mutex)) {
+        return AM_FALSE;
+    }
+
+    if (!condition_init (&reserve->condition)) {
+        mutex_destroy (&reserve->mutex);
+        return AM_FALSE;
+    }
+
+    reserve->thread = thread_start (socket_reserve_worker, reserve);
+    if (!handle_is_good (reserve->thread)) {
+        condition_destroy (&reserve->condition);
+        mutex_destroy (&reserve->mutex);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Остановка фонового потока и закрытие всех соединений.
+ *
+ * @param reserve Запас соединений.
+ * @warning Ни одно подключение не должно ссылаться на запас.
+ */
+MAGNA_API void MAGNA_CALL socket_reserve_destroy
+    (
+        SocketReserve *reserve
+    )
+{
+    assert (reserve != NULL);
+
+    if (handle_is_good (reserve->thread)) {
+        mutex_lock (&reserve->mutex);
+        reserve->stop = AM_TRUE;
+        condition_signal (&reserve->condition);
+        mutex_unlock (&reserve->mutex);
+        thread_wait (reserve->thread);
+
+        while (reserve->count != 0) {
+            socket_reserve_discard (reserve, reserve->count - 1);
+        }
+
+        condition_destroy (&reserve->condition);
+        mutex_destroy (&reserve->mutex);
+    }
+
+    mem_clear (reserve, sizeof (*reserve));
+    reserve->thread = handle_get_bad ();
+}
+
+/**
+ * Смена адреса сервера. Если адрес отличается от прежнего,
+ * соединения со старым адресом закрываются, а фоновый поток
+ * начинает подключаться по новому.
+ *
+ * @param reserve Запас соединений.
+ * @param address Текущий адрес сервера.
+ */
+MAGNA_API void MAGNA_CALL socket_reserve_set_address
+    (
+        SocketReserve *reserve,
+        const Tcp4Address *address
+    )
+{
+    assert (reserve != NULL);
+    assert (address != NULL);
+
+    mutex_lock (&reserve->mutex);
+    if (!socket_reserve_same (address, &reserve->address)) {
+        reserve->address = *address;
+        while (reserve->count != 0) {
+            socket_reserve_discard (reserve, reserve->count - 1);
+        }
+
+        condition_signal (&reserve->condition);
+    }
+
+    mutex_unlock (&reserve->mutex);
+}
+
+/**
+ * Получение установленного соединения с сервером.
+ * Если запас пуст, подключение выполняется немедленно.
+ *
+ * @param reserve Запас соединений.
+ * @param timeout Предельное время подключения в миллисекундах,
+ * если запас пуст; отрицательное значение означает
+ * "не ограничено" (тогда возможен TCP Fast Open).
+ * @return Дескриптор сокета (переходит во владение
+ * вызывающего) либо -1.
+ */
+MAGNA_API am_int32 MAGNA_CALL socket_reserve_take
+    (
+        SocketReserve *reserve,
+        am_int32 timeout
+    )
+{
+    Tcp4Poll probe;
+    Tcp4Address address;
+    am_int32 result = -1;
+    am_uint64 now;
+
+    assert (reserve != NULL);
+
+    now = magna_ticks ();
+    mutex_lock (&reserve->mutex);
+    address = reserve->address;
+    socket_reserve_expire (reserve, now);
+    while (reserve->count != 0) {
+        --reserve->count;
+        result = reserve->sockets[reserve->count];
+
+        /* Сокет, готовый к чтению до отсылки запроса,
+         * закрыт сервером (или сломан) */
+        probe.handle = result;
+        probe.events = TCP4_READ;
+        if (tcp4_poll (&probe, 1, 0) == 0) {
+            break;
+        }
+
+        tcp4_disconnect (result);
+        result = -1;
+    }
+
+    if (result != -1) {
+        ++reserve->taken;
+    }
+    else {
+        ++reserve->missed;
+    }
+
+    condition_signal (&reserve->condition);
+    mutex_unlock (&reserve->mutex);
+
+    if (result == -1) {
+        if (timeout >= 0) {
+            result = tcp4_connect_timeout (&address, timeout);
+        }
+        else {
+            result = reserve->fastOpen
+                ? tcp4_connect_fast (&address)
+                : tcp4_connect_address (&address);
+        }
+    }
+
+    return result;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
@@ -54,6 +54,39 @@
  * \var Response::navigator
  *      \brief Навигатор для считывания строк.
  *
+ * \var Response::pinned
+ *      \brief Длина заголовка ответа в байтах. В потоковом режиме
+ *      заголовок никогда не вытесняется из буфера.
+ *
+ * \var Response::socket
+ *      \brief Сокет, из которого подкачиваются данные
+ *      (только в потоковом режиме; -1 после закрытия).
+ *
+ * \var Response::streaming
+ *      \brief Признак потокового режима.
+ *
+ * \var Response::broken
+ *      \brief Прием ответа прерван из-за сбоя сети.
+ *
+ * \var Response::deadline
+ *      \brief Момент (по `magna_ticks`), к которому ответ
+ *      должен быть принят целиком. 0 означает "не ограничено".
+ *      По истечении срока прием прерывается, а в подключении
+ *      выставляется код ошибки -100004.
+ *
+ * \details В обычном режиме ответ сначала целиком принимается
+ * в `answer`, и только затем начинается его разбор.
+ *
+ * В потоковом режиме (см. `connection_execute_stream`) сокет
+ * остается открытым, а `response_get_line` и `response_eot`
+ * подкачивают данные по мере необходимости. Уже прочитанные
+ * строки при этом вытесняются из буфера, так что расход памяти
+ * не зависит от объема ответа, а разбор идет параллельно
+ * с передачей данных по сети. Платой за это является то,
+ * что строка, возвращенная `response_get_line`, остается
+ * действительной только до следующего чтения из ответа.
+ * Заголовок ответа (`command`, `serverVersion`) остается
+ * действительным всегда.
  */
 
 /*=========================================================*/
@@ -76,6 +109,9 @@ MAGNA_API void MAGNA_CALL response_init
 
 /**
  * Освобождение ресурсов, занятых ответом сервера.
+ * Буфер, не превышающий `Connection::scratchLimit`,
+ * возвращается подключению для следующего ответа,
+ * поэтому ответ должен быть уничтожен до подключения.
  *
  * @param response Ответ сервера.
  */
@@ -84,12 +120,200 @@ MAGNA_API void MAGNA_CALL response_destroy
         Response *response
     )
 {
+    Connection *connection;
+
     assert (response != NULL);
 
-    buffer_destroy (&response->answer);
+    if (response->streaming && response->socket >= 0) {
+        tcp4_disconnect (response->socket);
+    }
+
+    connection = response->connection;
+    if (connection != NULL
+        && buffer_capacity (&connection->scratchAnswer) == 0
+        && buffer_capacity (&response->answer) <= connection->scratchLimit) {
+        connection->scratchAnswer = response->answer;
+        buffer_init (&response->answer);
+    }
+    else {
+        buffer_destroy (&response->answer);
+    }
+
     mem_clear (response, sizeof (*response));
 }
 
+/*=========================================================*/
+
+/*
+ * Прием очередного блока данных с учетом срока `deadline`.
+ * Возвращает то же, что и `tcp4_receive_block`.
+ */
+static ssize_t response_receive_block
+    (
+        Response *response,
+        am_int32 handle
+    )
+{
+    Tcp4Poll item;
+    am_uint64 now;
+    int rc;
+
+    if (response->deadline != 0) {
+        now = magna_ticks ();
+        rc = 0;
+        if (now < response->deadline) {
+            item.handle = handle;
+            item.events = TCP4_READ;
+            rc = tcp4_poll (&item, 1, (am_int32) (response->deadline - now));
+        }
+
+        if (rc <= 0) {
+            if (rc == 0 && response->connection != NULL) {
+                response->connection->lastError = -100004;
+            }
+
+            return -1;
+        }
+    }
+
+    return tcp4_receive_block (handle, &response->answer, TCP4_RECEIVE_BLOCK);
+}
+
+/* Отметка обрыва связи, если раньше не истек срок. */
+static void response_network_failure
+    (
+        Response *response
+    )
+{
+    if (response->connection != NULL && response->connection->lastError == 0) {
+        response->connection->lastError = -100002;
+    }
+}
+
+/*=========================================================*/
+
+/* Потоковый режим */
+
+/* Перенос указателя из старого блока памяти в новый */
+static void response_rebase
+    (
+        Span *span,
+        const am_byte *oldStart,
+        am_byte *newStart
+    )
+{
+    size_t offset, length;
+
+    if (span->start != NULL) {
+        offset = (size_t) (span->start - oldStart);
+        length = (size_t) (span->end - span->start);
+        span->start = newStart + offset;
+        span->end = span->start + length;
+    }
+}
+
+/*
+ * Подкачка очередной порции данных из сокета.
+ * Уже прочитанные строки (кроме заголовка) при этом вытесняются.
+ * Возвращает AM_FALSE, если данных больше не будет.
+ */
+static am_bool response_pull
+    (
+        Response *response
+    )
+{
+    Buffer *answer = &response->answer;
+    Navigator *nav = &response->navigator;
+    const am_byte *oldStart;
+    size_t tail;
+    ssize_t rc;
+
+    if (!response->streaming || response->socket < 0) {
+        return AM_FALSE;
+    }
+
+    if (nav->position > response->pinned) {
+        tail = nav->length - nav->position;
+        memmove
+            (
+                answer->start + response->pinned,
+                answer->start + nav->position,
+                tail
+            );
+        answer->current = answer->start + response->pinned + tail;
+        nav->position = response->pinned;
+    }
+
+    oldStart = answer->start;
+    rc = response_receive_block (response, response->socket);
+    if (rc <= 0) {
+        tcp4_disconnect (response->socket);
+        response->socket = -1;
+        if (rc < 0) {
+            response->broken = AM_TRUE;
+        }
+    }
+
+    if (oldStart != NULL && answer->start != oldStart) {
+        response_rebase (&response->command, oldStart, answer->start);
+        response_rebase (&response->serverVersion, oldStart, answer->start);
+    }
+
+    nav->data = answer->start;
+    nav->length = buffer_length (answer);
+
+    return rc > 0;
+}
+
+/* В буфере имеется целая непрочитанная строка? */
+static am_bool response_has_line
+    (
+        const Response *response
+    )
+{
+    const Navigator *nav = &response->navigator;
+
+    return nav->position < nav->length
+        && memchr (nav->data + nav->position, '\n', nav->length - nav->position) != NULL;
+}
+
+/**
+ * Перевод ответа в потоковый режим: данные будут подкачиваться
+ * из указанного сокета по мере чтения. Считывает заголовок ответа.
+ *
+ * @param response Инициализированный пустой ответ.
+ * @param handle Сокет, из которого будет читаться ответ.
+ * Владение сокетом переходит к ответу, он будет закрыт
+ * по исчерпании данных или в `response_destroy`.
+ * @return Признак успешного получения заголовка.
+ */
+MAGNA_API am_bool MAGNA_CALL response_stream
+    (
+        Response *response,
+        am_int32 handle
+    )
+{
+    assert (response != NULL);
+    assert (handle >= 0);
+
+    response->streaming = AM_TRUE;
+    response->socket = handle;
+    response->broken = AM_FALSE;
+
+    /* Пока заголовок не прочитан, ничего не вытесняем */
+    response->pinned = (size_t) -1;
+    mem_clear (&response->navigator, sizeof (response->navigator));
+
+    if (!response_parse_header (response)) {
+        response_network_failure (response);
+        return AM_FALSE;
+    }
+
+    response->pinned = response->navigator.position;
+
+    return AM_TRUE;
+}
+
 /**
  * Достигнут конец ответа сервера?
  *
@@ -98,12 +322,18 @@ MAGNA_API void MAGNA_CALL response_destroy
  */
 MAGNA_API am_bool MAGNA_CALL response_eot
     (
-        const Response *response
+        Response *response
     )
 {
     assert (response != NULL);
 
-    return nav_eot (&response->navigator);
+    while (nav_eot (&response->navigator)) {
+        if (!response_pull (response)) {
+            return AM_TRUE;
+        }
+    }
+
+    return AM_FALSE;
 }
 
 MAGNA_API am_bool response_check
@@ -138,6 +368,157 @@ MAGNA_API am_bool response_check
     return result;
 }
 
+/**
+ * Резервирование памяти под ответ сервера, как только
+ * получен его заголовок. Если сервер сообщил размер ответа
+ * (`answerSize`), буфер увеличивается сразу до нужного размера,
+ * так что при дальнейшем приеме перераспределений памяти не будет.
+ *
+ * @param response Ответ сервера, принимаемый в `response-&gt;answer`.
+ * @return `AM_TRUE`, если заголовок уже получен целиком
+ * (повторно вызывать функцию не нужно), иначе `AM_FALSE`.
+ */
+MAGNA_API am_bool MAGNA_CALL response_presize
+    (
+        Response *response
+    )
+{
+    const am_byte *ptr, *end;
+    size_t headerLength;
+    am_uint32 answerSize = 0;
+    int lineCount = 0;
+
+    assert (response != NULL);
+
+    ptr = response->answer.start;
+    end = response->answer.current;
+    if (ptr == NULL) {
+        return AM_FALSE;
+    }
+
+    /* Заголовок ответа занимает 10 строк, размер ответа -- в четвертой */
+    while (ptr < end && lineCount < 10) {
+        if (*ptr == '\n') {
+            ++lineCount;
+        }
+        else if (lineCount == 3 && *ptr >= '0' && *ptr <= '9') {
+            answerSize = answerSize * 10 + (*ptr - '0');
+        }
+
+        ++ptr;
+    }
+
+    if (lineCount < 10) {
+        return AM_FALSE;
+    }
+
+    /* Запас в один блок нужен, чтобы последнее чтение из сокета
+     * (возвращающее 0) не потребовало нового увеличения буфера. */
+    headerLength = (size_t) (ptr - response->answer.start);
+    if (answerSize != 0) {
+        buffer_reserve
+            (
+                &response->answer,
+                headerLength + answerSize + TCP4_RECEIVE_BLOCK
+            );
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Прием ответа сервера из сокета до закрытия соединения.
+ * Данные читаются непосредственно в `response-&gt;answer`
+ * крупными блоками, память под ответ резервируется
+ * по размеру, указанному в заголовке (если он есть).
+ *
+ * @param response Ответ сервера.
+ * @param handle Дескриптор сокета.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL response_receive
+    (
+        Response *response,
+        am_int32 handle
+    )
+{
+    am_bool presized = AM_FALSE;
+    ssize_t rc;
+
+    assert (response != NULL);
+    assert (handle >= 0);
+
+    for (;;) {
+        rc = response_receive_block (response, handle);
+        if (rc < 0) {
+            response_network_failure (response);
+            return AM_FALSE;
+        }
+
+        if (rc == 0) {
+            break;
+        }
+
+        if (!presized) {
+            presized = response_presize (response);
+        }
+    }
+
+    /* Пустой ответ означает, что сервер закрыл соединение, ничего не прислав */
+    if (buffer_is_empty (&response->answer)) {
+        response_network_failure (response);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Разбор заголовка ответа, целиком полученного от сервера
+ * и помещенного в `response-&gt;answer`. После разбора навигатор
+ * указывает на начало полезных данных ответа.
+ *
+ * @param response Ответ сервера.
+ */
+MAGNA_API void MAGNA_CALL response_parse_answer
+    (
+        Response *response
+    )
+{
+    assert (response != NULL);
+
+    nav_from_buffer (&response->navigator, &response->answer);
+    response_parse_header (response);
+}
+
+/**
+ * Считывание заголовка ответа (первые 10 строк).
+ *
+ * @param response Ответ сервера.
+ * @return Признак успешного завершения операции
+ * (в потоковом режиме заголовок может не прийти из-за сбоя сети).
+ */
+MAGNA_API am_bool MAGNA_CALL response_parse_header
+    (
+        Response *response
+    )
+{
+    assert (response != NULL);
+
+    response->command = response_read_ansi (response);
+    response->clientId = response_read_int32 (response);
+    response->queryId = response_read_int32 (response);
+    response->answerSize = response_read_int32 (response);
+    response->serverVersion = response_read_ansi(response);
+    response_get_line (response);
+    response_get_line (response);
+    response_get_line (response);
+    response_get_line (response);
+    response_get_line (response);
+
+    return !response->broken && !span_is_empty (response->command);
+}
+
 MAGNA_API Span MAGNA_CALL response_get_line
     (
         Response *response
@@ -147,6 +528,14 @@ MAGNA_API Span MAGNA_CALL response_get_line
 
     assert (response != NULL);
 
+    if (response->streaming) {
+        while (!response_has_line (response)) {
+            if (!response_pull (response)) {
+                break;
+            }
+        }
+    }
+
     result = nav_read_line (&response->navigator);
 
     return result;
@@ -159,8 +548,20 @@ MAGNA_API am_int32 MAGNA_CALL response_get_return_code
 {
     assert (response != NULL);
 
-    response->connection->lastError
-        = response->returnCode = response_read_int32 (response);
+    response->returnCode = response_read_int32 (response);
+
+    /* Ответ, полученный через группу, с подключением не связан */
+    if (response->connection == NULL) {
+        return response->returnCode;
+    }
+
+    response->connection->lastError = response->returnCode;
+
+    /* Сервер сообщает о перегрузке */
+    if (response->connection->limiter != NULL
+        && irbis_is_overload (response->returnCode)) {
+        limiter_overload (response->connection->limiter);
+    }
 
     return response->returnCode;
 }
@@ -241,6 +642,16 @@ MAGNA_API Span MAGNA_CALL response_remaining_ansi_text
     return result;
 }
 
+/**
+ * Считывание всех оставшихся строк ответа (в кодировке UTF-8).
+ * В потоковом режиме ответ сначала дочитывается до конца,
+ * иначе подкачка данных сдвигала бы уже выданные строки.
+ *
+ * @param response Ответ сервера.
+ * @param array Массив, в который добавляются строки
+ * (указывают на данные ответа).
+ * @return Признак успешного завершения операции.
+ */
 MAGNA_API am_bool MAGNA_CALL response_remaining_utf_lines
     (
         Response *response,
@@ -250,7 +661,21 @@ MAGNA_API am_bool MAGNA_CALL response_remaining_utf_lines
     assert (response != NULL);
     assert (array != NULL);
 
-    return AM_FALSE;
+    while (response_pull (response)) {
+        /* nothing */
+    }
+
+    if (response->broken) {
+        return AM_FALSE;
+    }
+
+    while (!response_eot (response)) {
+        if (!span_array_push_back (array, response_get_line (response))) {
+            return AM_FALSE;
+        }
+    }
+
+    return AM_TRUE;
 }
 
 MAGNA_API Span MAGNA_CALL response_remaining_utf_text
@@ -262,6 +687,11 @@ MAGNA_API Span MAGNA_CALL response_remaining_utf_text
 
     assert (response != NULL);
 
+    /* В потоковом режиме сначала дочитываем ответ до конца */
+    while (response_pull (response)) {
+        /* nothing */
+    }
+
     result = nav_remaining (&response->navigator);
 
     return result;
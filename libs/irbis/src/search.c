@@ -350,11 +350,11 @@ MAGNA_API am_bool MAGNA_CALL found_decode_line
 
     assert (found != NULL);
 
+    buffer_clear (&found->description);
     if (!span_contains (line, '#')) {
         found->mfn = span_to_uint32 (line);
     }
     else {
-        buffer_clear (&found->description);
         if (span_split_n_by_char (line, parts, 2, '#') == 2) {
             if (!buffer_assign_span (&found->description, parts[1])) {
                 return AM_FALSE;
@@ -406,7 +406,7 @@ MAGNA_API am_bool MAGNA_CALL found_decode_response_mfn
         }
     }
 
-    return AM_TRUE;
+    return !response->broken;
 }
 
 /**
@@ -445,7 +445,59 @@ MAGNA_API am_bool MAGNA_CALL found_decode_response
         }
     }
 
-    return AM_TRUE;
+    return !response->broken;
+}
+
+/**
+ * Разбор ответа сервера без накопления результатов:
+ * каждая найденная строка передается обработчику,
+ * как только она получена (в потоковом режиме -- по мере
+ * поступления данных из сети).
+ *
+ * @param response Ответ сервера.
+ * @param handler Обработчик. Структура, передаваемая ему,
+ * действительна только на время вызова.
+ * Обработчик может вернуть `AM_FALSE`, чтобы прекратить разбор.
+ * @param data Произвольные данные для обработчика.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL found_decode_stream
+    (
+        Response *response,
+        FoundHandler handler,
+        void *data
+    )
+{
+    FoundLine found;
+    Span line;
+    am_bool result = AM_FALSE;
+
+    assert (response != NULL);
+    assert (handler != NULL);
+
+    found_init (&found);
+    while (!response_eot (response)) {
+        line = response_get_line (response);
+        if (span_is_empty (line)) {
+            break;
+        }
+
+        if (!found_decode_line (&found, line)) {
+            goto DONE;
+        }
+
+        if (!handler (&found, data)) {
+            result = AM_TRUE;
+            goto DONE;
+        }
+    }
+
+    result = !response->broken;
+
+    DONE:
+    found_destroy (&found);
+
+    return result;
 }
 
 /*=========================================================*/
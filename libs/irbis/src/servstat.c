@@ -20,11 +20,55 @@
 /**
  * \file servstat.c
  *
- * Статистика работы сервера.
+ * Статистика работы сервера (команда GET_SERVER_STAT).
+ * Разбирается только общая часть ответа, сведения
+ * о каждом из клиентов пропускаются.
  */
 
 /*=========================================================*/
 
+/**
+ * Инициализация структуры.
+ * Не выделяет память в куче.
+ *
+ * @param stat Структура, подлежащая инициализации.
+ */
+MAGNA_API void MAGNA_CALL server_stat_init
+    (
+        ServerStat *stat
+    )
+{
+    assert (stat != NULL);
+
+    mem_clear (stat, sizeof (*stat));
+}
+
+/**
+ * Разбор ответа сервера.
+ *
+ * @param stat Статистика сервера.
+ * @param response Ответ сервера (код возврата уже прочитан).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL server_stat_parse_response
+    (
+        ServerStat *stat,
+        Response *response
+    )
+{
+    assert (stat != NULL);
+    assert (response != NULL);
+
+    if (response_eot (response)) {
+        return AM_FALSE;
+    }
+
+    stat->totalCommandCount = response_read_int32 (response);
+    stat->clientCount = response_read_int32 (response);
+    stat->linesPerClient = response_read_int32 (response);
+
+    return AM_TRUE;
+}
 
 /*=========================================================*/
 
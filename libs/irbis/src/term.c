@@ -162,7 +162,59 @@ MAGNA_API am_bool MAGNA_CALL term_parse_response
         }
     }
 
-    return AM_TRUE;
+    return !response->broken;
+}
+
+/**
+ * Разбор ответа сервера без накопления результатов:
+ * каждый термин передается обработчику, как только
+ * он получен (в потоковом режиме -- по мере поступления
+ * данных из сети).
+ *
+ * @param response Ответ сервера.
+ * @param handler Обработчик. Структура, передаваемая ему,
+ * действительна только на время вызова.
+ * Обработчик может вернуть `AM_FALSE`, чтобы прекратить разбор.
+ * @param data Произвольные данные для обработчика.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL term_parse_stream
+    (
+        Response *response,
+        TermHandler handler,
+        void *data
+    )
+{
+    Term term;
+    Span line;
+    am_bool result = AM_FALSE;
+
+    assert (response != NULL);
+    assert (handler != NULL);
+
+    term_init (&term);
+    while (!response_eot (response)) {
+        line = response_get_line (response);
+        if (span_is_empty (line)) {
+            break;
+        }
+
+        if (!term_parse_line (&term, line)) {
+            goto DONE;
+        }
+
+        if (!handler (&term, data)) {
+            result = AM_TRUE;
+            goto DONE;
+        }
+    }
+
+    result = !response->broken;
+
+    DONE:
+    term_destroy (&term);
+
+    return result;
 }
 
 /**
@@ -620,6 +672,259 @@ MAGNA_API void MAGNA_CALL posting_array_to_console
 
 /*=========================================================*/
 
+/**
+ * \struct PostingList
+ *      \brief Компактный список постингов.
+ *
+ * \details Постинги хранятся не в виде отдельных структур
+ * `Posting` (каждая со своим буфером), а подряд в одном буфере:
+ * MFN -- как разность с предыдущим MFN (в зигзаг-кодировке,
+ * так что порядок MFN не важен), метка, повторение и позиция --
+ * как есть. Все числа упаковываются с помощью `fastpack_32`,
+ * так что типичный постинг занимает 4-6 байт.
+ * Текст постинга хранится (длина плюс байты) только если
+ * список создан с `withText == AM_TRUE`.
+ *
+ * Чтение списка -- строго последовательное, с помощью
+ * `posting_reader_init` и `posting_reader_next`.
+ */
+
+/* Добавление упакованного числа в буфер. */
+static am_bool posting_list_put
+    (
+        Buffer *buffer,
+        am_uint32 value
+    )
+{
+    am_byte temp [4];
+    int length;
+
+    /* fastpack_32 не справляется с большими числами */
+    if (value >= 0x3FFFFFFFu) {
+        return AM_FALSE;
+    }
+
+    length = fastpack_32 (value, temp);
+
+    return buffer_write (buffer, temp + 4 - length, (size_t) length);
+}
+
+/* Извлечение упакованного числа со сдвигом указателя. */
+static am_uint32 posting_list_get
+    (
+        const am_byte **ptr
+    )
+{
+    am_uint32 result = fastunpack_32 (*ptr);
+
+    *ptr += fastlength_32 (**ptr) + 1;
+
+    return result;
+}
+
+/**
+ * Простая инициализация списка.
+ * Не выделяет память в куче.
+ *
+ * @param list Указатель на неинициализированную структуру.
+ * @param withText Хранить ли текст постингов.
+ */
+MAGNA_API void MAGNA_CALL posting_list_init
+    (
+        PostingList *list,
+        am_bool withText
+    )
+{
+    assert (list != NULL);
+
+    mem_clear (list, sizeof (*list));
+    list->withText = withText;
+}
+
+/**
+ * Освобождение ресурсов, занятых списком.
+ *
+ * @param list Список, подлежащий освобождению.
+ */
+MAGNA_API void MAGNA_CALL posting_list_destroy
+    (
+        PostingList *list
+    )
+{
+    assert (list != NULL);
+
+    buffer_destroy (&list->data);
+    list->count = 0;
+    list->lastMfn = 0;
+}
+
+/**
+ * Добавление постинга в конец списка.
+ *
+ * @param list Список.
+ * @param posting Добавляемый постинг.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL posting_list_append
+    (
+        PostingList *list,
+        const Posting *posting
+    )
+{
+    am_uint32 delta;
+    size_t length;
+
+    assert (list != NULL);
+    assert (posting != NULL);
+
+    /* Зигзаг: 0, -1, 1, -2, 2... -> 0, 1, 2, 3, 4... */
+    if (posting->mfn >= list->lastMfn) {
+        delta = (posting->mfn - list->lastMfn) << 1u;
+    }
+    else {
+        delta = ((list->lastMfn - posting->mfn) << 1u) - 1u;
+    }
+
+    if (!posting_list_put (&list->data, delta)
+        || !posting_list_put (&list->data, posting->tag)
+        || !posting_list_put (&list->data, posting->occurrence)
+        || !posting_list_put (&list->data, posting->count)) {
+        return AM_FALSE;
+    }
+
+    if (list->withText) {
+        length = buffer_length (&posting->text);
+        if (!posting_list_put (&list->data, (am_uint32) length)
+            || !buffer_write (&list->data, posting->text.start, length)) {
+            return AM_FALSE;
+        }
+    }
+
+    list->lastMfn = posting->mfn;
+    ++list->count;
+
+    return AM_TRUE;
+}
+
+/**
+ * Разбор ответа сервера сразу в компактный список,
+ * без создания промежуточного массива постингов.
+ *
+ * @param list Список (инициализированный), подлежащий пополнению.
+ * @param response Ответ сервера.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL posting_list_parse_response
+    (
+        PostingList *list,
+        Response *response
+    )
+{
+    Span line;       /* текущая строка */
+    Posting posting; /* многократно используемый постинг */
+    am_bool result = AM_FALSE;
+
+    assert (list != NULL);
+    assert (response != NULL);
+
+    posting_init (&posting);
+    while (!response_eot (response)) {
+        line = response_get_line (response);
+        if (span_is_empty (line)) {
+            break;
+        }
+
+        buffer_clear (&posting.text);
+        if (!posting_parse_line (&posting, line)
+            || !posting_list_append (list, &posting)) {
+            goto DONE;
+        }
+    }
+
+    result = !response->broken;
+
+    DONE:
+    posting_destroy (&posting);
+
+    return result;
+}
+
+/**
+ * Подготовка к последовательному чтению списка.
+ *
+ * @param reader Указатель на неинициализированную структуру.
+ * @param list Список. Не должен изменяться в процессе чтения.
+ */
+MAGNA_API void MAGNA_CALL posting_reader_init
+    (
+        PostingReader *reader,
+        const PostingList *list
+    )
+{
+    assert (reader != NULL);
+    assert (list != NULL);
+
+    reader->list = list;
+    reader->current = list->data.start;
+    reader->index = 0;
+    reader->mfn = 0;
+}
+
+/**
+ * Чтение очередного постинга.
+ *
+ * @param reader Читатель.
+ * @param posting Инициализированный постинг для результата.
+ * Текст заполняется, только если список хранит текст.
+ * @return `AM_FALSE`, если постинги кончились
+ * (либо не удалось скопировать текст).
+ */
+MAGNA_API am_bool MAGNA_CALL posting_reader_next
+    (
+        PostingReader *reader,
+        Posting *posting
+    )
+{
+    am_uint32 delta;
+    size_t length;
+
+    assert (reader != NULL);
+    assert (posting != NULL);
+
+    if (reader->index >= reader->list->count) {
+        return AM_FALSE;
+    }
+
+    delta = posting_list_get (&reader->current);
+    if ((delta & 1u) == 0) {
+        reader->mfn += delta >> 1u;
+    }
+    else {
+        reader->mfn -= (delta + 1u) >> 1u;
+    }
+
+    posting->mfn = reader->mfn;
+    posting->tag = posting_list_get (&reader->current);
+    posting->occurrence = posting_list_get (&reader->current);
+    posting->count = posting_list_get (&reader->current);
+    buffer_clear (&posting->text);
+
+    if (reader->list->withText) {
+        length = posting_list_get (&reader->current);
+        if (!buffer_write (&posting->text, reader->current, length)) {
+            return AM_FALSE;
+        }
+
+        reader->current += length;
+    }
+
+    ++reader->index;
+
+    return AM_TRUE;
+}
+
+/*=========================================================*/
+
 /**
  * \struct PostingParameters
  *      \brief Параметры для запроса постингов с сервера.
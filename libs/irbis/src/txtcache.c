@@ -0,0 +1,271 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/irbis.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file txtcache.c
+ *
+ * Кэш текстовых файлов сервера (меню, рабочие листы, FST, форматы).
+ *
+ * \struct TextCache
+ *      \brief Ограниченный по объему кэш содержимого
+ *      текстовых файлов, прочитанных с сервера.
+ *
+ * \details Кэш подключается к соединению явно:
+ * `connection->textCache = &cache`. После этого
+ * `connection_read_text_file` сначала ищет файл в кэше
+ * и обращается к серверу только при промахе,
+ * а `connection_write_text_file` сбрасывает запись о файле.
+ *
+ * Ключом служат путь, имя базы данных и имя файла
+ * (без учета регистра). При превышении объема вытесняются
+ * файлы, к которым дольше всего не обращались.
+ * Если задано время жизни, устаревшие файлы перечитываются.
+ *
+ * Кэш защищен мьютексом, так что его можно разделять
+ * между подключениями разных потоков (например, в пуле).
+ *
+ * \code
+ * TextCache cache;
+ *
+ * text_cache_create (&cache, 1024 * 1024, 10 * 60 * 1000);
+ * connection.textCache = &cache;
+ * ...
+ * printf ("hits=%lu\n", (unsigned long) cache.cache.hits);
+ * connection.textCache = NULL;
+ * text_cache_destroy (&cache);
+ * \endcode
+ */
+
+/*=========================================================*/
+
+/* Построение ключа для спецификации. */
+static am_bool text_cache_key
+    (
+        const Specification *specification,
+        Buffer *key
+    )
+{
+    if (!buffer_put_uint32 (key, (am_uint32) specification->path)
+        || !buffer_putc (key, '.')
+        || !buffer_concat (key, &specification->database)
+        || !buffer_putc (key, '.')
+        || !buffer_concat (key, &specification->filename)) {
+        return AM_FALSE;
+    }
+
+    span_tolower (buffer_to_span (key));
+
+    return AM_TRUE;
+}
+
+static void MAGNA_CALL text_cache_free_buffer
+    (
+        void *value
+    )
+{
+    Buffer *buffer = (Buffer*) value;
+
+    buffer_destroy (buffer);
+    mem_free (buffer);
+}
+
+/*=========================================================*/
+
+/**
+ * Инициализация кэша.
+ *
+ * @param cache Указатель на неинициализированную структуру.
+ * @param capacity Предельный суммарный объем файлов в байтах.
+ * @param ttl Время жизни файла в кэше в миллисекундах (0 = бессрочно).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL text_cache_create
+    (
+        TextCache *cache,
+        size_t capacity,
+        am_uint32 ttl
+    )
+{
+    assert (cache != NULL);
+
+    mem_clear (cache, sizeof (*cache));
+    if (!lru_create (&cache->cache, capacity, 0, text_cache_free_buffer)) {
+        return AM_FALSE;
+    }
+
+    cache->cache.ttl = ttl;
+    if (!mutex_init (&cache->mutex)) {
+        lru_destroy (&cache->cache);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых кэшем.
+ *
+ * @param cache Кэш.
+ * @warning Ни одно подключение не должно ссылаться на кэш.
+ */
+MAGNA_API void MAGNA_CALL text_cache_destroy
+    (
+        TextCache *cache
+    )
+{
+    assert (cache != NULL);
+
+    lru_destroy (&cache->cache);
+    mutex_destroy (&cache->mutex);
+    mem_clear (cache, sizeof (*cache));
+}
+
+/**
+ * Поиск файла в кэше.
+ *
+ * @param cache Кэш.
+ * @param specification Спецификация файла.
+ * @param output Буфер, в конец которого дописывается
+ * содержимое файла в случае попадания.
+ * @return `AM_TRUE`, если файл найден в кэше.
+ */
+MAGNA_API am_bool MAGNA_CALL text_cache_get
+    (
+        TextCache *cache,
+        const Specification *specification,
+        Buffer *output
+    )
+{
+    Buffer key = BUFFER_INIT;
+    const Buffer *content;
+    am_bool result = AM_FALSE;
+
+    assert (cache != NULL);
+    assert (specification != NULL);
+    assert (output != NULL);
+
+    if (!text_cache_key (specification, &key)) {
+        buffer_destroy (&key);
+        return AM_FALSE;
+    }
+
+    mutex_lock (&cache->mutex);
+    content = (const Buffer*) lru_get (&cache->cache, buffer_to_span (&key));
+    if (content != NULL) {
+        result = buffer_concat (output, content);
+    }
+
+    mutex_unlock (&cache->mutex);
+    buffer_destroy (&key);
+
+    return result;
+}
+
+/**
+ * Помещение файла в кэш.
+ *
+ * @param cache Кэш.
+ * @param specification Спецификация файла.
+ * @param content Содержимое файла (копируется).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL text_cache_put
+    (
+        TextCache *cache,
+        const Specification *specification,
+        Span content
+    )
+{
+    Buffer key = BUFFER_INIT;
+    Buffer *copy;
+    am_bool result = AM_FALSE;
+
+    assert (cache != NULL);
+    assert (specification != NULL);
+
+    copy = (Buffer*) mem_alloc (sizeof (Buffer));
+    if (copy == NULL) {
+        return AM_FALSE;
+    }
+
+    buffer_init (copy);
+    if (!buffer_assign_span (copy, content)
+        || !text_cache_key (specification, &key)) {
+        text_cache_free_buffer (copy);
+        goto DONE;
+    }
+
+    mutex_lock (&cache->mutex);
+    result = lru_put (&cache->cache, buffer_to_span (&key), copy, span_length (content));
+    mutex_unlock (&cache->mutex);
+
+    DONE:
+    buffer_destroy (&key);
+
+    return result;
+}
+
+/**
+ * Удаление файла из кэша (например, после его изменения).
+ *
+ * @param cache Кэш.
+ * @param specification Спецификация файла.
+ */
+MAGNA_API void MAGNA_CALL text_cache_invalidate
+    (
+        TextCache *cache,
+        const Specification *specification
+    )
+{
+    Buffer key = BUFFER_INIT;
+
+    assert (cache != NULL);
+    assert (specification != NULL);
+
+    if (text_cache_key (specification, &key)) {
+        mutex_lock (&cache->mutex);
+        lru_remove (&cache->cache, buffer_to_span (&key));
+        mutex_unlock (&cache->mutex);
+    }
+
+    buffer_destroy (&key);
+}
+
+/**
+ * Удаление из кэша всех файлов.
+ *
+ * @param cache Кэш.
+ */
+MAGNA_API void MAGNA_CALL text_cache_clear
+    (
+        TextCache *cache
+    )
+{
+    assert (cache != NULL);
+
+    mutex_lock (&cache->mutex);
+    lru_clear (&cache->cache);
+    mutex_unlock (&cache->mutex);
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
@@ -26,6 +26,7 @@ objects = obj\array.obj     &
 	obj\koi8r.obj       &
 	obj\list.obj        &
 	obj\logging.obj     &
+	obj\lru.obj         &
 	obj\magna.obj       &
 	obj\map.obj         &
 	obj\mapfile.obj     &
@@ -120,6 +121,9 @@ obj\list.obj: src\list.c
 obj\logging.obj: src\logging.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
+obj\lru.obj: src\lru.c
+	$(CC) $(CFLAGS) -fo=$@ $<
+
 obj\magna.obj: src\magna.c
 	$(CC) $(CFLAGS) -fo=$@ $<
 
@@ -268,6 +268,41 @@ MAGNA_API am_bool MAGNA_CALL buffer_grow
     return AM_TRUE;
 }
 
+/**
+ * При необходимости увеличивает размер буфера ровно до указанного,
+ * без округления. Полезно, когда окончательный размер данных
+ * известен заранее.
+ *
+ * @param buffer Буфер.
+ * @param newSize Требуемая емкость буфера в байтах.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL buffer_reserve
+    (
+        Buffer *buffer,
+        size_t newSize
+    )
+{
+    size_t length;
+    am_byte *newStart;
+
+    assert (buffer != NULL);
+
+    if (newSize > buffer_capacity (buffer)) {
+        length = buffer_length (buffer);
+        newStart = mem_realloc (buffer->start, newSize);
+        if (newStart == NULL) {
+            return AM_FALSE;
+        }
+
+        buffer->start   = newStart;
+        buffer->current = newStart + length;
+        buffer->end     = newStart + newSize;
+    }
+
+    return AM_TRUE;
+}
+
 MAGNA_API am_bool MAGNA_CALL buffer_fit
     (
         Buffer *buffer,
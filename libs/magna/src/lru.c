@@ -0,0 +1,428 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/core.h"
+
+// ReSharper disable StringLiteralTypo
+// ReSharper disable IdentifierTypo
+// ReSharper disable CommentTypo
+
+/*=========================================================*/
+
+#include "warnpush.h"
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file lru.c
+ *
+ * Кэш с вытеснением давно не использованных элементов (LRU).
+ *
+ * \struct LruCache
+ *      \brief Ограниченное по размеру хранилище "ключ -- значение".
+ *
+ * \details Ключ -- произвольная последовательность байт
+ * (копируется в кэш). Значение -- указатель, которым кэш
+ * владеет: при вытеснении или удалении оно освобождается
+ * с помощью `liberator`.
+ *
+ * Каждый элемент имеет учетный размер (например, длину текста
+ * в байтах). Когда суммарный размер превышает `capacity`,
+ * вытесняются элементы, к которым дольше всего не обращались.
+ * Если задан `ttl`, элементы старше `ttl` миллисекунд
+ * считаются отсутствующими.
+ *
+ * Кэш не синхронизирован: при использовании из нескольких
+ * потоков его необходимо защищать мьютексом.
+ */
+
+/*=========================================================*/
+
+/* Хэш-функция FNV-1a */
+static size_t lru_hash
+    (
+        Span key
+    )
+{
+    am_uint32 result = 2166136261u;
+    const am_byte *ptr;
+
+    for (ptr = key.start; ptr < key.end; ++ptr) {
+        result ^= *ptr;
+        result *= 16777619u;
+    }
+
+    return (size_t) result;
+}
+
+/* Исключение элемента из списка давности. */
+static void lru_unlink
+    (
+        LruCache *cache,
+        LruEntry *entry
+    )
+{
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    }
+    else {
+        cache->newest = entry->older;
+    }
+
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    }
+    else {
+        cache->oldest = entry->newer;
+    }
+
+    entry->newer = entry->older = NULL;
+}
+
+/* Помещение элемента в голову списка давности. */
+static void lru_link_newest
+    (
+        LruCache *cache,
+        LruEntry *entry
+    )
+{
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    if (cache->newest != NULL) {
+        cache->newest->newer = entry;
+    }
+
+    cache->newest = entry;
+    if (cache->oldest == NULL) {
+        cache->oldest = entry;
+    }
+}
+
+/* Поиск элемента. Возвращает адрес указателя на него в цепочке. */
+static LruEntry** lru_find
+    (
+        const LruCache *cache,
+        Span key,
+        size_t hash
+    )
+{
+    LruEntry **place;
+    size_t length = span_length (key);
+
+    place = &cache->buckets [hash % cache->bucketCount];
+    while (*place != NULL) {
+        if ((*place)->hash == hash
+            && (*place)->keyLength == length
+            && span_compare (span_init ((*place)->key, length), key) == 0) {
+            break;
+        }
+
+        place = &(*place)->chain;
+    }
+
+    return place;
+}
+
+/* Удаление элемента, на который указывает `place`. */
+static void lru_drop
+    (
+        LruCache *cache,
+        LruEntry **place
+    )
+{
+    LruEntry *entry = *place;
+
+    *place = entry->chain;
+    lru_unlink (cache, entry);
+    cache->size -= entry->size;
+    --cache->count;
+
+    if (cache->liberator != NULL && entry->value != NULL) {
+        cache->liberator (entry->value);
+    }
+
+    mem_free (entry);
+}
+
+/* Вытеснение самых старых элементов до соблюдения ограничения. */
+static void lru_evict
+    (
+        LruCache *cache
+    )
+{
+    LruEntry *victim;
+    Span key;
+
+    while (cache->size > cache->capacity && cache->oldest != NULL) {
+        victim = cache->oldest;
+        key = span_init (victim->key, victim->keyLength);
+        lru_drop (cache, lru_find (cache, key, victim->hash));
+        ++cache->evictions;
+    }
+}
+
+/*=========================================================*/
+
+/**
+ * Инициализация кэша.
+ *
+ * @param cache Указатель на неинициализированную структуру.
+ * @param capacity Предельный суммарный учетный размер элементов.
+ * @param bucketCount Количество корзин хэш-таблицы
+ * (0 означает "определяется системой").
+ * @param liberator Освободитель значений (опционально).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL lru_create
+    (
+        LruCache *cache,
+        size_t capacity,
+        size_t bucketCount,
+        Liberator liberator
+    )
+{
+    assert (cache != NULL);
+
+    mem_clear (cache, sizeof (*cache));
+    if (bucketCount == 0) {
+        bucketCount = 257;
+    }
+
+    cache->buckets = (LruEntry**) mem_alloc (bucketCount * sizeof (LruEntry*));
+    if (cache->buckets == NULL) {
+        return AM_FALSE;
+    }
+
+    mem_clear (cache->buckets, bucketCount * sizeof (LruEntry*));
+    cache->bucketCount = bucketCount;
+    cache->capacity = capacity;
+    cache->liberator = liberator;
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых кэшем, включая все значения.
+ *
+ * @param cache Кэш.
+ */
+MAGNA_API void MAGNA_CALL lru_destroy
+    (
+        LruCache *cache
+    )
+{
+    assert (cache != NULL);
+
+    if (cache->buckets != NULL) {
+        lru_clear (cache);
+        mem_free (cache->buckets);
+    }
+
+    mem_clear (cache, sizeof (*cache));
+}
+
+/**
+ * Удаление из кэша всех элементов.
+ * Счетчики попаданий и промахов сохраняются.
+ *
+ * @param cache Кэш.
+ */
+MAGNA_API void MAGNA_CALL lru_clear
+    (
+        LruCache *cache
+    )
+{
+    size_t index;
+
+    assert (cache != NULL);
+
+    for (index = 0; index < cache->bucketCount; ++index) {
+        while (cache->buckets [index] != NULL) {
+            lru_drop (cache, &cache->buckets [index]);
+        }
+    }
+}
+
+/**
+ * Получение значения по ключу.
+ * Найденный элемент становится самым свежим.
+ *
+ * @param cache Кэш.
+ * @param key Ключ.
+ * @return Значение (остается во владении кэша)
+ * либо `NULL`, если элемент отсутствует или устарел.
+ */
+MAGNA_API void* MAGNA_CALL lru_get
+    (
+        LruCache *cache,
+        Span key
+    )
+{
+    LruEntry **place;
+    LruEntry *entry;
+
+    assert (cache != NULL);
+
+    place = lru_find (cache, key, lru_hash (key));
+    entry = *place;
+    if (entry != NULL
+        && entry->expires != 0
+        && magna_ticks () >= entry->expires) {
+        lru_drop (cache, place);
+        entry = NULL;
+    }
+
+    if (entry == NULL) {
+        ++cache->misses;
+        return NULL;
+    }
+
+    ++cache->hits;
+    if (cache->newest != entry) {
+        lru_unlink (cache, entry);
+        lru_link_newest (cache, entry);
+    }
+
+    return entry->value;
+}
+
+/**
+ * Получение значения по ключу без учета в статистике:
+ * ни счетчики попаданий и промахов, ни порядок вытеснения
+ * не меняются. Годится для служебных проверок.
+ *
+ * @param cache Кэш.
+ * @param key Ключ.
+ * @return Значение (остается во владении кэша)
+ * либо `NULL`, если элемент отсутствует или устарел.
+ */
+MAGNA_API void* MAGNA_CALL lru_peek
+    (
+        LruCache *cache,
+        Span key
+    )
+{
+    LruEntry *entry;
+
+    assert (cache != NULL);
+
+    entry = *lru_find (cache, key, lru_hash (key));
+    if (entry == NULL
+        || (entry->expires != 0 && magna_ticks () >= entry->expires)) {
+        return NULL;
+    }
+
+    return entry->value;
+}
+
+/**
+ * Помещение значения в кэш. Прежнее значение
+ * с тем же ключом освобождается. При необходимости
+ * вытесняются давно не использованные элементы.
+ *
+ * @param cache Кэш.
+ * @param key Ключ (копируется).
+ * @param value Значение (переходит во владение кэша,
+ * даже если операция не удалась).
+ * @param size Учетный размер значения.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL lru_put
+    (
+        LruCache *cache,
+        Span key,
+        void *value,
+        size_t size
+    )
+{
+    LruEntry **place;
+    LruEntry *entry;
+    size_t hash, length;
+
+    assert (cache != NULL);
+
+    hash = lru_hash (key);
+    place = lru_find (cache, key, hash);
+    if (*place != NULL) {
+        lru_drop (cache, place);
+    }
+
+    /* Элемент, не помещающийся в кэш целиком, не храним */
+    if (size > cache->capacity) {
+        if (cache->liberator != NULL && value != NULL) {
+            cache->liberator (value);
+        }
+
+        return AM_FALSE;
+    }
+
+    length = span_length (key);
+    entry = (LruEntry*) mem_alloc (sizeof (LruEntry) + length);
+    if (entry == NULL) {
+        if (cache->liberator != NULL && value != NULL) {
+            cache->liberator (value);
+        }
+
+        return AM_FALSE;
+    }
+
+    mem_clear (entry, sizeof (*entry));
+    if (length != 0) {
+        mem_copy (entry->key, key.start, length);
+    }
+
+    entry->keyLength = length;
+    entry->hash = hash;
+    entry->value = value;
+    entry->size = size;
+    if (cache->ttl != 0) {
+        entry->expires = magna_ticks () + cache->ttl;
+    }
+
+    entry->chain = cache->buckets [hash % cache->bucketCount];
+    cache->buckets [hash % cache->bucketCount] = entry;
+    lru_link_newest (cache, entry);
+    cache->size += size;
+    ++cache->count;
+
+    lru_evict (cache);
+
+    return AM_TRUE;
+}
+
+/**
+ * Удаление элемента из кэша.
+ *
+ * @param cache Кэш.
+ * @param key Ключ.
+ * @return `AM_TRUE`, если элемент был найден и удален.
+ */
+MAGNA_API am_bool MAGNA_CALL lru_remove
+    (
+        LruCache *cache,
+        Span key
+    )
+{
+    LruEntry **place;
+
+    assert (cache != NULL);
+
+    place = lru_find (cache, key, lru_hash (key));
+    if (*place == NULL) {
+        return AM_FALSE;
+    }
+
+    lru_drop (cache, place);
+
+    return AM_TRUE;
+}
+
+/*=========================================================*/
+
+#include "warnpop.h"
+
+/*=========================================================*/
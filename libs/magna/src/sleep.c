@@ -22,6 +22,12 @@
 #if defined(MAGNA_UNIX)
 
 #include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+
+#else
+
+#include <time.h>
 
 #endif
 
@@ -30,7 +36,7 @@
 /**
  * \file sleep.c
  *
- * Засыпание программы.
+ * Засыпание программы и отсчет времени.
  */
 
 /*=========================================================*/
@@ -58,6 +64,50 @@ MAGNA_API void MAGNA_CALL magna_sleep
 #endif
 }
 
+/**
+ * Монотонный счетчик миллисекунд.
+ * Годится только для измерения интервалов:
+ * точка отсчета не определена. При сборке под версии Windows
+ * до Vista значение переполняется каждые 49,7 суток.
+ *
+ * @return Количество миллисекунд от некоторого момента в прошлом.
+ */
+MAGNA_API am_uint64 magna_ticks (void)
+{
+#if defined(MAGNA_WINDOWS) && defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0600
+
+    /* GetTickCount64 появилась в Windows Vista */
+    return (am_uint64) GetTickCount64 ();
+
+#elif defined(MAGNA_WINDOWS)
+
+    /* До Windows Vista: счетчик переполняется каждые 49,7 суток */
+
+    return (am_uint64) GetTickCount ();
+
+#elif defined(MAGNA_UNIX) && defined(CLOCK_MONOTONIC)
+
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (am_uint64) now.tv_sec * 1000u + (am_uint64) (now.tv_nsec / 1000000L);
+
+#elif defined(MAGNA_UNIX)
+
+    struct timeval now;
+
+    gettimeofday (&now, NULL);
+
+    return (am_uint64) now.tv_sec * 1000u + (am_uint64) (now.tv_usec / 1000L);
+
+#else
+
+    return (am_uint64) clock () * 1000u / CLOCKS_PER_SEC;
+
+#endif
+}
+
 /*=========================================================*/
 
 #include "warnpop.h"
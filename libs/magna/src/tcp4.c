@@ -22,101 +22,803 @@
 
     #define _WINSOCK_DEPRECATED_NO_WARNINGS
     #include <winsock2.h>
+    #include <ws2tcpip.h>
     #include <windows.h>
 
     #ifdef _MSC_VER
     #pragma warning(pop)
     #endif
 
+    /* WSAPoll появилась в Windows Vista, до нее -- select */
+    #if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+    #define MAGNA_LEGACY_POLL
+    #endif
+
     static WSADATA wsaData;
 
     #pragma comment (lib, "ws2_32.lib")
 
 #elif defined(MAGNA_MSDOS)
 
-/* TODO: implement */
+/* TODO: implement */
+
+#else
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
+
+#define closesocket(__x) close(__x)
+
+/* Старые заголовки glibc не знают этой опции (Linux 4.11+) */
+#if defined(MAGNA_LINUX) && !defined(TCP_FASTOPEN_CONNECT)
+#define TCP_FASTOPEN_CONNECT 30
+#endif
+
+#endif
+
+/*=========================================================*/
+
+#include <assert.h>
+
+/*=========================================================*/
+
+/**
+ * \file tcp4.c
+ *
+ * Простая обертка над TCP/IP version 4.
+ *
+ * Помимо блокирующих операций, здесь есть низкоуровневые
+ * средства для неблокирующей работы: установка соединения
+ * без ожидания (`tcp4_connect_nonblocking`), перевод сокета
+ * в неблокирующий режим и опрос готовности набора сокетов
+ * (`tcp4_poll`, обертка над `poll`/`WSAPoll`, до Windows Vista -- `select`).
+ */
+
+/*=========================================================*/
+
+static am_bool initialized = AM_FALSE;
+
+/**
+ * Инициализация сетевой подсистемы.
+ * По факту нужна только в Windows.
+ *
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool tcp4_initialize (void)
+{
+#ifdef MAGNA_WINDOWS
+
+    if (!initialized) {
+        if (WSAStartup(0x0202, &wsaData)) {
+            return AM_FALSE;
+        }
+
+        initialized = AM_TRUE;
+    }
+
+#endif
+
+    return AM_TRUE;
+}
+
+/**
+ * Разрешение имени хоста в IPv4-адрес.
+ * Используется потокобезопасная `getaddrinfo`,
+ * поэтому функцию можно вызывать из разных потоков одновременно.
+ *
+ * @param hostname Имя хоста либо в виде "1.2.3.4", либо в виде "myserver.com"
+ * @param port Номер порта на сервере.
+ * @param address Адрес, подлежащий заполнению.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL tcp4_resolve
+    (
+        const am_byte *hostname,
+        am_uint16 port,
+        Tcp4Address *address
+    )
+{
+#ifdef MAGNA_MSDOS
+
+    /* TODO: implement */
+    (void) hostname;
+    (void) port;
+    (void) address;
+
+    return AM_FALSE;
+
+#else
+
+    unsigned long inaddr;
+    struct addrinfo hints, *info = NULL;
+
+    assert (hostname != NULL);
+    assert (address != NULL);
+
+    if (!tcp4_initialize ()) {
+        return AM_FALSE;
+    }
+
+    address->port = port;
+    inaddr = inet_addr ((const char*) hostname);
+    if (inaddr != INADDR_NONE) {
+        address->address = (am_uint32) inaddr;
+        return AM_TRUE;
+    }
+
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo ((const char*) hostname, NULL, &hints, &info) != 0) {
+        return AM_FALSE;
+    }
+
+    if (info == NULL || info->ai_addr == NULL) {
+        if (info != NULL) {
+            freeaddrinfo (info);
+        }
+
+        return AM_FALSE;
+    }
+
+    address->address = (am_uint32) ((const struct sockaddr_in*) info->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo (info);
+
+    return AM_TRUE;
+
+#endif
+}
+
+#ifndef MAGNA_MSDOS
+
+static void tcp4_fill_address
+    (
+        const Tcp4Address *address,
+        struct sockaddr_in *destination
+    )
+{
+    memset (destination, 0, sizeof (*destination));
+    destination->sin_family = AF_INET;
+    destination->sin_port = htons (address->port);
+    destination->sin_addr.s_addr = address->address;
+}
+
+#endif
+
+/* Создание сокета и подключение к серверу. */
+static am_int32 tcp4_open
+    (
+        const Tcp4Address *address,
+        am_bool fastOpen
+    )
+{
+#ifdef MAGNA_MSDOS
+
+    /* TODO: implement */
+    (void) address;
+    (void) fastOpen;
+
+    return -1;
+
+#else
+
+    am_int32 result;
+    struct sockaddr_in destinationAddress;
+
+    assert (address != NULL);
+
+    if (!tcp4_initialize ()) {
+        return -1;
+    }
+
+    result = (am_int32) socket (AF_INET, SOCK_STREAM, 0);
+    if (result < 0) {
+        return -1;
+    }
+
+#ifdef TCP_FASTOPEN_CONNECT
+
+    if (fastOpen) {
+        /* Если ядро или сервер не поддерживают TFO,
+         * подключение выполняется обычным образом. */
+        int enable = 1;
+        setsockopt
+            (
+                result,
+                IPPROTO_TCP,
+                TCP_FASTOPEN_CONNECT,
+                (const char*) &enable,
+                sizeof (enable)
+            );
+    }
+
+#else
+
+    (void) fastOpen;
+
+#endif
+
+    tcp4_fill_address (address, &destinationAddress);
+    if (connect
+        (
+            result,
+            (struct sockaddr*) &destinationAddress,
+            sizeof(destinationAddress)
+        ))
+    {
+        closesocket (result);
+
+        return -1;
+    }
+
+    return result;
+
+#endif
+}
+
+/**
+ * Подключение к серверу по заранее разрешенному адресу.
+ *
+ * @param address Адрес сервера.
+ * @return Дескриптор сокета либо -1.
+ */
+MAGNA_API am_int32 MAGNA_CALL tcp4_connect_address
+    (
+        const Tcp4Address *address
+    )
+{
+    return tcp4_open (address, AM_FALSE);
+}
+
+/**
+ * Подключение к серверу с использованием TCP Fast Open
+ * (если оно поддерживается ядром, сейчас только Linux 4.11+).
+ * SYN-пакет уходит на сервер вместе с первой порцией
+ * данных, что экономит один круг обмена при повторных
+ * подключениях к тому же серверу. Ошибка подключения
+ * в этом случае может обнаружиться только при отсылке данных.
+ *
+ * @param address Адрес сервера.
+ * @return Дескриптор сокета либо -1.
+ */
+MAGNA_API am_int32 MAGNA_CALL tcp4_connect_fast
+    (
+        const Tcp4Address *address
+    )
+{
+    return tcp4_open (address, AM_TRUE);
+}
+
+/**
+ * Подключение к указанному серверу.
+ *
+ * @param hostname Имя хоста либо в виде "1.2.3.4", либо в виде "myserver.com"
+ * @param port Номер порта на сервере.
+ * @return Дескриптор сокета либо -1.
+ */
+MAGNA_API am_int32 MAGNA_CALL tcp4_connect
+    (
+        const am_byte *hostname,
+        am_uint16 port
+    )
+{
+    Tcp4Address address;
+
+    assert (hostname != NULL);
+
+    if (!tcp4_resolve (hostname, port, &address)) {
+        return -1;
+    }
+
+    return tcp4_connect_address (&address);
+}
+
+/**
+ * Подключение к серверу с ограничением времени ожидания.
+ *
+ * @param address Адрес сервера.
+ * @param timeout Предельное время ожидания в миллисекундах,
+ * отрицательное значение означает "не ограничено".
+ * @return Дескриптор сокета (в блокирующем режиме) либо -1.
+ */
+MAGNA_API am_int32 MAGNA_CALL tcp4_connect_timeout
+    (
+        const Tcp4Address *address,
+        am_int32 timeout
+    )
+{
+    Tcp4Poll item;
+    am_int32 result;
+    am_bool inProgress;
+
+    assert (address != NULL);
+
+    if (timeout < 0) {
+        return tcp4_connect_address (address);
+    }
+
+    result = tcp4_connect_nonblocking (address, &inProgress);
+    if (result == -1) {
+        return -1;
+    }
+
+    if (inProgress) {
+        item.handle = result;
+        item.events = TCP4_WRITE;
+        if (tcp4_poll (&item, 1, timeout) <= 0
+            || tcp4_connect_error (result) != 0) {
+            tcp4_disconnect (result);
+            return -1;
+        }
+    }
+
+    if (!tcp4_set_nonblocking (result, AM_FALSE)) {
+        tcp4_disconnect (result);
+        return -1;
+    }
+
+    return result;
+}
+
+/**
+ * Ограничение времени, в течение которого блокирующая
+ * отсылка данных может ожидать освобождения буфера сокета.
+ *
+ * @param handle Дескриптор сокета.
+ * @param timeout Предельное время в миллисекундах (0 = не ограничено).
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL tcp4_set_send_timeout
+    (
+        am_int32 handle,
+        am_uint32 timeout
+    )
+{
+#ifdef MAGNA_WINDOWS
+
+    DWORD value = (DWORD) timeout;
+
+    return setsockopt
+        (
+            (SOCKET) handle,
+            SOL_SOCKET,
+            SO_SNDTIMEO,
+            (const char*) &value,
+            sizeof (value)
+        ) == 0;
+
+#elif defined(MAGNA_MSDOS)
+
+    /* TODO: implement */
+    (void) handle;
+    (void) timeout;
+
+    return AM_FALSE;
+
+#else
+
+    struct timeval value;
+
+    value.tv_sec = (long) (timeout / 1000u);
+    value.tv_usec = (long) (timeout % 1000u) * 1000l;
+
+    return setsockopt
+        (
+            handle,
+            SOL_SOCKET,
+            SO_SNDTIMEO,
+            &value,
+            sizeof (value)
+        ) == 0;
+
+#endif
+}
+
+/**
+ * Перевод сокета в неблокирующий режим и обратно.
+ *
+ * @param handle Дескриптор сокета.
+ * @param nonblocking Включить неблокирующий режим?
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL tcp4_set_nonblocking
+    (
+        am_int32 handle,
+        am_bool nonblocking
+    )
+{
+#ifdef MAGNA_WINDOWS
+
+    u_long mode = nonblocking ? 1 : 0;
+
+    assert (handle >= 0);
+
+    return ioctlsocket ((SOCKET) handle, FIONBIO, &mode) == 0;
+
+#elif defined(MAGNA_MSDOS)
+
+    /* TODO: implement */
+    (void) handle;
+    (void) nonblocking;
+
+    return AM_FALSE;
+
+#else
+
+    int flags;
+
+    assert (handle >= 0);
+
+    flags = fcntl (handle, F_GETFL, 0);
+    if (flags < 0) {
+        return AM_FALSE;
+    }
+
+    flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+
+    return fcntl (handle, F_SETFL, flags) == 0;
+
+#endif
+}
+
+/**
+ * Последняя сетевая операция не выполнена,
+ * потому что она заблокировала бы поток?
+ *
+ * @return Результат проверки.
+ */
+MAGNA_API am_bool tcp4_would_block (void)
+{
+#ifdef MAGNA_WINDOWS
+
+    int code = WSAGetLastError ();
+
+    return code == WSAEWOULDBLOCK || code == WSAEINPROGRESS;
+
+#elif defined(MAGNA_MSDOS)
+
+    return AM_FALSE;
+
+#else
+
+    return errno == EAGAIN || errno == EWOULDBLOCK
+        || errno == EINPROGRESS || errno == EINTR;
+
+#endif
+}
+
+/**
+ * Начало подключения к серверу без ожидания его завершения.
+ * Сокет остается в неблокирующем режиме.
+ * Когда подключение будет установлено (или не удастся),
+ * сокет станет готов к записи (`TCP4_WRITE` в `tcp4_poll`),
+ * после чего результат можно узнать с помощью `tcp4_connect_error`.
+ *
+ * @param address Адрес сервера.
+ * @param inProgress Сюда помещается признак того,
+ * что подключение еще не завершено.
+ * @return Дескриптор сокета либо -1.
+ */
+MAGNA_API am_int32 MAGNA_CALL tcp4_connect_nonblocking
+    (
+        const Tcp4Address *address,
+        am_bool *inProgress
+    )
+{
+#ifdef MAGNA_MSDOS
+
+    /* TODO: implement */
+    (void) address;
+    (void) inProgress;
+
+    return -1;
+
+#else
+
+    am_int32 result;
+    struct sockaddr_in destinationAddress;
+
+    assert (address != NULL);
+    assert (inProgress != NULL);
+
+    *inProgress = AM_FALSE;
+    if (!tcp4_initialize ()) {
+        return -1;
+    }
+
+    result = (am_int32) socket (AF_INET, SOCK_STREAM, 0);
+    if (result < 0) {
+        return -1;
+    }
+
+    if (!tcp4_set_nonblocking (result, AM_TRUE)) {
+        closesocket (result);
+        return -1;
+    }
+
+    tcp4_fill_address (address, &destinationAddress);
+    if (connect
+        (
+            result,
+            (struct sockaddr*) &destinationAddress,
+            sizeof(destinationAddress)
+        ))
+    {
+        if (!tcp4_would_block ()) {
+            closesocket (result);
+            return -1;
+        }
+
+        *inProgress = AM_TRUE;
+    }
+
+    return result;
+
+#endif
+}
+
+/**
+ * Результат неблокирующего подключения к серверу.
+ *
+ * @param handle Дескриптор сокета, ставшего готовым к записи.
+ * @return 0, если подключение установлено, иначе код ошибки.
+ */
+MAGNA_API am_int32 MAGNA_CALL tcp4_connect_error
+    (
+        am_int32 handle
+    )
+{
+#ifdef MAGNA_MSDOS
+
+    (void) handle;
+
+    return -1;
+
+#else
+
+    int error = 0;
+
+#ifdef MAGNA_WINDOWS
+
+    int length = sizeof (error);
+
+#else
+
+    socklen_t length = sizeof (error);
+
+#endif
+
+    assert (handle >= 0);
+
+    if (getsockopt (handle, SOL_SOCKET, SO_ERROR, (char*) &error, &length)) {
+        return -1;
+    }
+
+    return error;
+
+#endif
+}
+
+#ifdef MAGNA_LEGACY_POLL
+
+/* tcp4_poll для Windows до Vista: не более FD_SETSIZE сокетов. */
+static int tcp4_poll_select
+    (
+        Tcp4Poll *items,
+        size_t count,
+        am_int32 timeout
+    )
+{
+    fd_set readSet, writeSet, errorSet;
+    struct timeval limit;
+    am_int32 highest = -1;
+    size_t index;
+    int result;
+
+    assert (items != NULL || count == 0);
+
+    if (count > FD_SETSIZE) {
+        return -1;
+    }
+
+    FD_ZERO (&readSet);
+    FD_ZERO (&writeSet);
+    FD_ZERO (&errorSet);
+    for (index = 0; index < count; ++index) {
+        if (items[index].events & TCP4_READ) {
+            FD_SET ((SOCKET) items[index].handle, &readSet);
+        }
+
+        if (items[index].events & TCP4_WRITE) {
+            FD_SET ((SOCKET) items[index].handle, &writeSet);
+        }
+
+        FD_SET ((SOCKET) items[index].handle, &errorSet);
+        if (items[index].handle > highest) {
+            highest = items[index].handle;
+        }
+
+        items[index].ready = 0;
+    }
 
-#else
+    limit.tv_sec = timeout / 1000;
+    limit.tv_usec = (timeout % 1000) * 1000L;
+    /* Windows первый параметр не учитывает */
+    result = select
+        (
+            (int) (highest + 1),
+            &readSet,
+            &writeSet,
+            &errorSet,
+            timeout < 0 ? NULL : &limit
+        );
+    if (result <= 0) {
+        return result;
+    }
 
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
-#include <unistd.h>
+    /* select считает события, а не сокеты */
+    result = 0;
+    for (index = 0; index < count; ++index) {
+        if (FD_ISSET ((SOCKET) items[index].handle, &readSet)) {
+            items[index].ready |= TCP4_READ;
+        }
 
-#define HOSTENT struct hostent
-#define closesocket(__x) close(__x)
+        if (FD_ISSET ((SOCKET) items[index].handle, &writeSet)) {
+            items[index].ready |= TCP4_WRITE;
+        }
 
-#endif
+        if (FD_ISSET ((SOCKET) items[index].handle, &errorSet)) {
+            items[index].ready |= TCP4_ERROR;
+        }
 
-/*=========================================================*/
+        if (items[index].ready != 0) {
+            ++result;
+        }
+    }
 
-#include <assert.h>
+    return result;
+}
 
-/*=========================================================*/
+#endif
 
 /**
- * \file tcp4.c
+ * Ожидание готовности набора сокетов к чтению или записи.
  *
- * Простая обертка над TCP/IP version 4.
+ * @param items Опрашиваемые сокеты.
+ * @param count Количество сокетов.
+ * @param timeout Предельное время ожидания в миллисекундах,
+ * отрицательное значение означает бесконечное ожидание.
+ * @return Количество готовых сокетов, 0 по истечении времени
+ * ожидания, отрицательное значение в случае ошибки.
  */
+MAGNA_API int MAGNA_CALL tcp4_poll
+    (
+        Tcp4Poll *items,
+        size_t count,
+        am_int32 timeout
+    )
+{
+#ifdef MAGNA_MSDOS
 
-/*=========================================================*/
+    /* TODO: implement */
+    (void) items;
+    (void) count;
+    (void) timeout;
 
-static am_bool initialized = AM_FALSE;
+    return -1;
+
+#elif defined(MAGNA_LEGACY_POLL)
+
+    return tcp4_poll_select (items, count, timeout);
+
+#else
 
-/**
- * Инициализация сетевой подсистемы.
- * По факту нужна только в Windows.
- *
- * @return Признак успешного завершения операции.
- */
-MAGNA_API am_bool tcp4_initialize (void)
-{
 #ifdef MAGNA_WINDOWS
 
-    if (!initialized) {
-        if (WSAStartup(0x0202, &wsaData)) {
-            return AM_FALSE;
+    WSAPOLLFD *fds;
+
+#else
+
+    struct pollfd *fds;
+
+#endif
+
+    size_t index;
+    int result;
+
+    assert (items != NULL || count == 0);
+
+    fds = mem_alloc (count * sizeof (*fds) + 1);
+    if (fds == NULL) {
+        return -1;
+    }
+
+    for (index = 0; index < count; ++index) {
+        fds[index].fd = items[index].handle;
+        fds[index].events = 0;
+        fds[index].revents = 0;
+        if (items[index].events & TCP4_READ) {
+            fds[index].events |= POLLIN;
         }
 
-        initialized = AM_TRUE;
+        if (items[index].events & TCP4_WRITE) {
+            fds[index].events |= POLLOUT;
+        }
+
+        items[index].ready = 0;
     }
 
+#ifdef MAGNA_WINDOWS
+
+    result = WSAPoll (fds, (ULONG) count, timeout);
+
+#else
+
+    do {
+        result = poll (fds, (nfds_t) count, timeout);
+    } while (result < 0 && errno == EINTR);
+
 #endif
 
-    return AM_TRUE;
+    for (index = 0; result > 0 && index < count; ++index) {
+        if (fds[index].revents & (POLLIN | POLLHUP)) {
+            items[index].ready |= TCP4_READ;
+        }
+
+        if (fds[index].revents & POLLOUT) {
+            items[index].ready |= TCP4_WRITE;
+        }
+
+        if (fds[index].revents & (POLLERR | POLLNVAL)) {
+            items[index].ready |= TCP4_ERROR;
+        }
+    }
+
+    mem_free (fds);
+
+    return result;
+
+#endif
 }
 
 /**
- * Подключение к указанному серверу.
+ * Создание сокета, принимающего входящие подключения.
  *
- * @param hostname Имя хоста либо в виде "1.2.3.4", либо в виде "myserver.com"
- * @param port Номер порта на сервере.
+ * @param address Локальный адрес и порт. Нулевой порт
+ * означает "любой свободный" (см. `tcp4_local_port`).
+ * @param backlog Длина очереди ожидающих подключений.
  * @return Дескриптор сокета либо -1.
  */
-MAGNA_API am_int32 MAGNA_CALL tcp4_connect
+MAGNA_API am_int32 MAGNA_CALL tcp4_listen
     (
-        const am_byte *hostname,
-        am_uint16 port
+        const Tcp4Address *address,
+        int backlog
     )
 {
 #ifdef MAGNA_MSDOS
 
     /* TODO: implement */
-    (void) hostname;
-    (void) port;
+    (void) address;
+    (void) backlog;
 
     return -1;
 
 #else
 
     am_int32 result;
-    struct sockaddr_in destinationAddress;
-    unsigned long inaddr;
-    HOSTENT *hostentry;
+    struct sockaddr_in localAddress;
+    int enable = 1;
 
-    assert (hostname != NULL);
+    assert (address != NULL);
 
     if (!tcp4_initialize ()) {
         return -1;
@@ -124,34 +826,22 @@ MAGNA_API am_int32 MAGNA_CALL tcp4_connect
 
     result = (am_int32) socket (AF_INET, SOCK_STREAM, 0);
     if (result < 0) {
-        return result;
-    }
-
-    memset (&destinationAddress, 0, sizeof (destinationAddress));
-    destinationAddress.sin_family = AF_INET;
-    destinationAddress.sin_port = htons (port);
-    inaddr = inet_addr ((const char*) hostname);
-    if (inaddr != INADDR_NONE) {
-        destinationAddress.sin_addr.s_addr = inaddr;
-    }
-    else {
-        hostentry = gethostbyname ((const char*) hostname);
-        if (hostentry) {
-            ((unsigned long*)&destinationAddress.sin_addr)[0] =
-                    ((unsigned long **)hostentry->h_addr_list)[0][0];
-        }
-        else {
-            return -1;
-        }
+        return -1;
     }
 
-    if (connect
+    /* Перезапущенный сервер не должен ждать освобождения порта */
+    setsockopt
         (
             result,
-            (struct sockaddr*) &destinationAddress,
-            sizeof(destinationAddress)
-        ))
-    {
+            SOL_SOCKET,
+            SO_REUSEADDR,
+            (const char*) &enable,
+            sizeof (enable)
+        );
+
+    tcp4_fill_address (address, &localAddress);
+    if (bind (result, (struct sockaddr*) &localAddress, sizeof (localAddress))
+        || listen (result, backlog)) {
         closesocket (result);
 
         return -1;
@@ -162,6 +852,80 @@ MAGNA_API am_int32 MAGNA_CALL tcp4_connect
 #endif
 }
 
+/**
+ * Прием входящего подключения. Блокирует поток,
+ * пока подключение не поступит.
+ *
+ * @param handle Сокет, созданный `tcp4_listen`.
+ * @return Дескриптор сокета подключения либо -1.
+ */
+MAGNA_API am_int32 MAGNA_CALL tcp4_accept
+    (
+        am_int32 handle
+    )
+{
+    assert (handle >= 0);
+
+#ifdef MAGNA_MSDOS
+
+    /* TODO: implement */
+
+    return -1;
+
+#elif defined(MAGNA_WINDOWS)
+
+    return (am_int32) accept (handle, NULL, NULL);
+
+#else
+
+    {
+        am_int32 result;
+
+        do {
+            result = (am_int32) accept (handle, NULL, NULL);
+        } while (result < 0 && errno == EINTR);
+
+        return result;
+    }
+
+#endif
+}
+
+/**
+ * Получение номера локального порта сокета
+ * (например, выбранного системой при `tcp4_listen`).
+ *
+ * @param handle Дескриптор сокета.
+ * @return Номер порта либо 0 при ошибке.
+ */
+MAGNA_API am_uint16 MAGNA_CALL tcp4_local_port
+    (
+        am_int32 handle
+    )
+{
+#ifdef MAGNA_MSDOS
+
+    /* TODO: implement */
+    (void) handle;
+
+    return 0;
+
+#else
+
+    struct sockaddr_in localAddress;
+    socklen_t length = sizeof (localAddress);
+
+    assert (handle >= 0);
+
+    if (getsockname (handle, (struct sockaddr*) &localAddress, &length)) {
+        return 0;
+    }
+
+    return ntohs (localAddress.sin_port);
+
+#endif
+}
+
 /**
  * Отключение от сервера.
  *
@@ -270,35 +1034,77 @@ MAGNA_API ssize_t MAGNA_CALL tcp4_receive_with_limit
 }
 
 /**
- * Вычитывание всех доступных данных из сокета.
+ * Чтение данных из сокета непосредственно в свободную часть буфера.
+ * Если свободного места меньше `block` байт, буфер предварительно
+ * увеличивается (геометрически, см. `buffer_grow`).
+ * Вычитывается столько, сколько поместится в свободную часть.
  *
  * @param handle Дескриптор сокета.
  * @param buffer Буфер, в который должны быть помещены данные.
- * @return Количество прочитанных байт, отрицательное в случае ошибки.
+ * @param block Минимальный объем свободного места в байтах.
+ * @return Количество прочитанных байт, 0 при закрытии соединения,
+ * отрицательное в случае ошибки.
  */
-MAGNA_API ssize_t MAGNA_CALL tcp4_receive_all
+MAGNA_API ssize_t MAGNA_CALL tcp4_receive_block
     (
         am_int32 handle,
-        Buffer *buffer
+        Buffer *buffer,
+        size_t block
     )
 {
-    ssize_t result = 0, rc;
-    am_byte temp[1024];
+    ssize_t result;
+    size_t spare;
 
+    assert (handle >= 0);
     assert (buffer != NULL);
+    assert (block != 0);
+
+    if (!buffer_grow (buffer, buffer_length (buffer) + block)) {
+        return -1;
+    }
+
+    spare = (size_t) (buffer->end - buffer->current);
 
-    for (;;) {
 #ifdef MAGNA_MSDOS
 
-        /* TODO: implement */
-        rc = -1;
+    /* TODO: implement */
+    (void) spare;
+
+    result = -1;
 
 #else
 
-        rc = recv (handle, (char*) temp, sizeof (temp), 0);
+    result = recv (handle, (char*) (buffer->current), spare, 0);
 
 #endif
 
+    if (result > 0) {
+        buffer->current += result;
+    }
+
+    return result;
+}
+
+/**
+ * Вычитывание всех доступных данных из сокета.
+ * Данные читаются сразу в буфер крупными блоками.
+ *
+ * @param handle Дескриптор сокета.
+ * @param buffer Буфер, в который должны быть помещены данные.
+ * @return Количество прочитанных байт, отрицательное в случае ошибки.
+ */
+MAGNA_API ssize_t MAGNA_CALL tcp4_receive_all
+    (
+        am_int32 handle,
+        Buffer *buffer
+    )
+{
+    ssize_t result = 0, rc;
+
+    assert (buffer != NULL);
+
+    for (;;) {
+        rc = tcp4_receive_block (handle, buffer, TCP4_RECEIVE_BLOCK);
         if (rc < 0) {
             return -1;
         }
@@ -307,10 +1113,6 @@ MAGNA_API ssize_t MAGNA_CALL tcp4_receive_all
             break;
         }
 
-        if (!buffer_write (buffer, temp, rc)) {
-            return -1;
-        }
-
         result += rc;
     }
 
@@ -336,6 +1138,116 @@ MAGNA_API am_bool MAGNA_CALL tcp4_send_buffer
     return result == ((ssize_t) buffer_position (buffer));
 }
 
+/* Сколько фрагментов передается за один системный вызов */
+#define TCP4_SEND_VECTOR 16
+
+/**
+ * Отправка данных, составленных из нескольких фрагментов памяти,
+ * без их предварительного копирования в общий буфер.
+ * Фрагменты передаются пачками одним системным вызовом
+ * (`writev` либо `WSASend`). Частично отправленные данные
+ * досылаются.
+ *
+ * @param handle Дескриптор сокета.
+ * @param spans Фрагменты данных (пустые пропускаются).
+ * @param count Количество фрагментов.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL tcp4_send_spans
+    (
+        am_int32 handle,
+        const Span *spans,
+        size_t count
+    )
+{
+#ifdef MAGNA_MSDOS
+
+    /* TODO: implement */
+
+    (void) handle;
+    (void) spans;
+    (void) count;
+
+    return AM_FALSE;
+
+#else
+
+#ifdef MAGNA_WINDOWS
+    WSABUF vector[TCP4_SEND_VECTOR];
+    DWORD written;
+#else
+    struct iovec vector[TCP4_SEND_VECTOR];
+#endif
+    size_t index = 0;   /* первый неотправленный фрагмент */
+    size_t skip = 0;    /* уже отправлено байт этого фрагмента */
+    size_t current, filled, length;
+    ssize_t sent;
+
+    assert (handle >= 0);
+    assert (spans != NULL || count == 0);
+
+    while (index < count) {
+        filled = 0;
+        for (current = index; current < count && filled < TCP4_SEND_VECTOR; ++current) {
+            length = span_length (spans[current]);
+            if (current == index) {
+                length -= skip;
+            }
+
+            if (length == 0) {
+                continue;
+            }
+
+#ifdef MAGNA_WINDOWS
+            vector[filled].buf = (CHAR*) spans[current].end - length;
+            vector[filled].len = (ULONG) length;
+#else
+            vector[filled].iov_base = spans[current].end - length;
+            vector[filled].iov_len = length;
+#endif
+            ++filled;
+        }
+
+        if (filled == 0) {
+            break;
+        }
+
+#ifdef MAGNA_WINDOWS
+        if (WSASend ((SOCKET) handle, vector, (DWORD) filled, &written, 0, NULL, NULL) != 0) {
+            return AM_FALSE;
+        }
+
+        sent = (ssize_t) written;
+#else
+        sent = writev (handle, vector, (int) filled);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return AM_FALSE;
+        }
+#endif
+
+        /* Продвигаемся на отправленное количество байт */
+        while (index < count) {
+            length = span_length (spans[index]) - skip;
+            if ((size_t) sent < length) {
+                skip += (size_t) sent;
+                break;
+            }
+
+            sent -= (ssize_t) length;
+            skip = 0;
+            ++index;
+        }
+    }
+
+    return AM_TRUE;
+
+#endif
+}
+
 /*=========================================================*/
 
 /* Сетевой поток (TCP) */
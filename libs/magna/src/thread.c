@@ -17,6 +17,11 @@
 
 #include <windows.h>
 
+/* Условные переменные появились в Windows Vista, до нее -- эмуляция */
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+#define MAGNA_LEGACY_CONDITION
+#endif
+
 #elif defined(MAGNA_MSDOS)
 
 /* TODO: implement */
@@ -25,7 +30,10 @@
 
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
 
 #endif
 
@@ -37,10 +45,75 @@
  * \file thread.c
  *
  * Работа с потоками.
+ *
+ * Помимо собственно потоков, здесь находятся простейшие
+ * примитивы синхронизации: мьютекс, условная переменная
+ * и атомарные операции над 32-битными целыми.
+ *
+ * Мьютекс и условная переменная хранят указатель
+ * на платформенно-зависимую структуру, размещаемую в куче,
+ * поэтому перед использованием их необходимо
+ * проинициализировать, а после -- освободить.
+ *
+ * В MS-DOS потоков нет, поэтому все примитивы
+ * синхронизации там вырождаются в пустые операции.
+ *
+ * В Windows условная переменная -- системная (Vista и выше).
+ * При сборке под более ранние версии (`_WIN32_WINNT` меньше
+ * 0x0600 либо не задан) она эмулируется на двух семафорах.
  */
 
 /*=========================================================*/
 
+/* Данные, передаваемые в запускаемый поток */
+typedef struct
+{
+    ThreadRoutine routine;
+    void *data;
+
+#if defined(MAGNA_UNIX)
+
+    pthread_t thread;
+
+#endif
+
+} ThreadStart;
+
+#ifdef MAGNA_WINDOWS
+
+static DWORD WINAPI thread_trampoline
+    (
+        LPVOID parameter
+    )
+{
+    ThreadStart *start = (ThreadStart*) parameter;
+    ThreadRoutine routine = start->routine;
+    void *data = start->data;
+
+    mem_free (start);
+    routine (data);
+
+    return 0;
+}
+
+#elif defined(MAGNA_UNIX)
+
+static void* thread_trampoline
+    (
+        void *parameter
+    )
+{
+    ThreadStart *start = (ThreadStart*) parameter;
+
+    start->routine (start->data);
+
+    return NULL;
+}
+
+#endif
+
+/*=========================================================*/
+
 /**
  * Создание потока.
  *
@@ -111,6 +184,715 @@ MAGNA_API am_bool MAGNA_CALL thread_join
     return AM_FALSE;
 }
 
+/**
+ * Запуск потока, исполняющего указанную функцию.
+ * Поток обязательно должен быть дождан с помощью `thread_wait`,
+ * иначе произойдет утечка ресурсов.
+ *
+ * @param routine Функция, исполняемая в потоке.
+ * @param data Произвольные данные, передаваемые функции.
+ * @return Дескриптор потока либо `handle_get_bad ()` в случае неудачи.
+ */
+MAGNA_API am_handle MAGNA_CALL thread_start
+    (
+        ThreadRoutine routine,
+        void *data
+    )
+{
+    am_handle result = handle_get_bad ();
+
+#if defined(MAGNA_WINDOWS) || defined(MAGNA_UNIX)
+
+    ThreadStart *start;
+
+    assert (routine != NULL);
+
+    start = (ThreadStart*) mem_alloc (sizeof (ThreadStart));
+    if (start == NULL) {
+        return result;
+    }
+
+    start->routine = routine;
+    start->data = data;
+
+#endif
+
+#ifdef MAGNA_WINDOWS
+
+    result.pointer = CreateThread (NULL, 0, thread_trampoline, start, 0, NULL);
+    if (result.pointer == NULL) {
+        mem_free (start);
+        result = handle_get_bad ();
+    }
+
+#elif defined(MAGNA_UNIX)
+
+    if (pthread_create (&start->thread, NULL, thread_trampoline, start) != 0) {
+        mem_free (start);
+        return result;
+    }
+
+    result.pointer = start;
+
+#else
+
+    (void) routine;
+    (void) data;
+
+#endif
+
+    return result;
+}
+
+/**
+ * Ожидание завершения потока, запущенного с помощью `thread_start`,
+ * и освобождение связанных с ним ресурсов.
+ *
+ * @param handle Дескриптор потока.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL thread_wait
+    (
+        am_handle handle
+    )
+{
+#ifdef MAGNA_WINDOWS
+
+    assert (handle_is_good (handle));
+
+    if (WaitForSingleObject (handle.pointer, INFINITE) != WAIT_OBJECT_0) {
+        return AM_FALSE;
+    }
+
+    CloseHandle (handle.pointer);
+
+    return AM_TRUE;
+
+#elif defined(MAGNA_UNIX)
+
+    ThreadStart *start;
+    am_bool result;
+
+    start = (ThreadStart*) handle.pointer;
+    assert (start != NULL);
+
+    result = pthread_join (start->thread, NULL) == 0;
+    mem_free (start);
+
+    return result;
+
+#else
+
+    (void) handle;
+
+    return AM_FALSE;
+
+#endif
+}
+
+/*=========================================================*/
+
+/* Мьютекс */
+
+/**
+ * Инициализация мьютекса.
+ * Выделяет память в куче.
+ *
+ * @param mutex Указатель на неинициализированную структуру.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL mutex_init
+    (
+        Mutex *mutex
+    )
+{
+    assert (mutex != NULL);
+
+    mutex->impl = NULL;
+
+#ifdef MAGNA_WINDOWS
+
+    mutex->impl = mem_alloc (sizeof (CRITICAL_SECTION));
+    if (mutex->impl == NULL) {
+        return AM_FALSE;
+    }
+
+    InitializeCriticalSection ((CRITICAL_SECTION*) mutex->impl);
+
+#elif defined(MAGNA_UNIX)
+
+    mutex->impl = mem_alloc (sizeof (pthread_mutex_t));
+    if (mutex->impl == NULL) {
+        return AM_FALSE;
+    }
+
+    if (pthread_mutex_init ((pthread_mutex_t*) mutex->impl, NULL) != 0) {
+        mem_free (mutex->impl);
+        mutex->impl = NULL;
+        return AM_FALSE;
+    }
+
+#endif
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых мьютексом.
+ * Мьютекс не должен быть захвачен.
+ *
+ * @param mutex Мьютекс.
+ */
+MAGNA_API void MAGNA_CALL mutex_destroy
+    (
+        Mutex *mutex
+    )
+{
+    assert (mutex != NULL);
+
+    if (mutex->impl != NULL) {
+
+#ifdef MAGNA_WINDOWS
+
+        DeleteCriticalSection ((CRITICAL_SECTION*) mutex->impl);
+
+#elif defined(MAGNA_UNIX)
+
+        pthread_mutex_destroy ((pthread_mutex_t*) mutex->impl);
+
+#endif
+
+        mem_free (mutex->impl);
+        mutex->impl = NULL;
+    }
+}
+
+/**
+ * Захват мьютекса.
+ *
+ * @param mutex Проинициализированный мьютекс.
+ */
+MAGNA_API void MAGNA_CALL mutex_lock
+    (
+        Mutex *mutex
+    )
+{
+    assert (mutex != NULL);
+
+#ifdef MAGNA_WINDOWS
+
+    assert (mutex->impl != NULL);
+    EnterCriticalSection ((CRITICAL_SECTION*) mutex->impl);
+
+#elif defined(MAGNA_UNIX)
+
+    assert (mutex->impl != NULL);
+    pthread_mutex_lock ((pthread_mutex_t*) mutex->impl);
+
+#endif
+}
+
+/**
+ * Освобождение мьютекса.
+ *
+ * @param mutex Захваченный мьютекс.
+ */
+MAGNA_API void MAGNA_CALL mutex_unlock
+    (
+        Mutex *mutex
+    )
+{
+    assert (mutex != NULL);
+
+#ifdef MAGNA_WINDOWS
+
+    assert (mutex->impl != NULL);
+    LeaveCriticalSection ((CRITICAL_SECTION*) mutex->impl);
+
+#elif defined(MAGNA_UNIX)
+
+    assert (mutex->impl != NULL);
+    pthread_mutex_unlock ((pthread_mutex_t*) mutex->impl);
+
+#endif
+}
+
+/*=========================================================*/
+
+/* Условная переменная */
+
+#ifdef MAGNA_LEGACY_CONDITION
+
+/*
+ * Условная переменная для Windows до Vista. Ожидающие потоки
+ * спят на семафоре `wakeup`, а получив сигнал, подтверждают
+ * это семафором `done`. Подающий сигнал дожидается
+ * подтверждения, поэтому сигнал достается только тем потокам,
+ * которые уже ждали в момент его подачи.
+ */
+typedef struct
+{
+    CRITICAL_SECTION guard; /* Защищает счетчики. */
+    HANDLE wakeup;          /* Будит ожидающие потоки. */
+    HANDLE done;            /* Разбуженный поток принял сигнал. */
+    long waiting;           /* Количество ожидающих потоков. */
+    long signals;           /* Поданные, но еще не принятые сигналы. */
+
+} LegacyCondition;
+
+static LegacyCondition* legacy_condition_create (void)
+{
+    LegacyCondition *result;
+
+    result = (LegacyCondition*) mem_alloc (sizeof (LegacyCondition));
+    if (result == NULL) {
+        return NULL;
+    }
+
+    result->waiting = 0;
+    result->signals = 0;
+    result->wakeup = CreateSemaphore (NULL, 0, 0x7FFFFFFF, NULL);
+    result->done = CreateSemaphore (NULL, 0, 0x7FFFFFFF, NULL);
+    if (result->wakeup == NULL || result->done == NULL) {
+        if (result->wakeup != NULL) {
+            CloseHandle (result->wakeup);
+        }
+
+        if (result->done != NULL) {
+            CloseHandle (result->done);
+        }
+
+        mem_free (result);
+        return NULL;
+    }
+
+    InitializeCriticalSection (&result->guard);
+
+    return result;
+}
+
+static void legacy_condition_free
+    (
+        LegacyCondition *condition
+    )
+{
+    CloseHandle (condition->wakeup);
+    CloseHandle (condition->done);
+    DeleteCriticalSection (&condition->guard);
+    mem_free (condition);
+}
+
+static am_bool legacy_condition_wait
+    (
+        LegacyCondition *condition,
+        CRITICAL_SECTION *mutex,
+        DWORD timeout
+    )
+{
+    DWORD rc;
+
+    EnterCriticalSection (&condition->guard);
+    ++condition->waiting;
+    LeaveCriticalSection (&condition->guard);
+
+    LeaveCriticalSection (mutex);
+    rc = WaitForSingleObject (condition->wakeup, timeout);
+
+    EnterCriticalSection (&condition->guard);
+    if (condition->signals > 0) {
+        /* Сигнал подан, когда срок уже истек: забираем его */
+        if (rc != WAIT_OBJECT_0) {
+            WaitForSingleObject (condition->wakeup, INFINITE);
+        }
+
+        ReleaseSemaphore (condition->done, 1, NULL);
+        --condition->signals;
+    }
+
+    --condition->waiting;
+    LeaveCriticalSection (&condition->guard);
+    EnterCriticalSection (mutex);
+
+    return rc == WAIT_OBJECT_0;
+}
+
+static void legacy_condition_wake
+    (
+        LegacyCondition *condition,
+        am_bool all
+    )
+{
+    long count;
+
+    EnterCriticalSection (&condition->guard);
+    count = condition->waiting - condition->signals;
+    if (count <= 0) {
+        LeaveCriticalSection (&condition->guard);
+        return;
+    }
+
+    if (!all) {
+        count = 1;
+    }
+
+    condition->signals += count;
+    ReleaseSemaphore (condition->wakeup, count, NULL);
+    LeaveCriticalSection (&condition->guard);
+
+    while (count-- != 0) {
+        WaitForSingleObject (condition->done, INFINITE);
+    }
+}
+
+#endif
+
+/**
+ * Инициализация условной переменной.
+ * Выделяет память в куче.
+ *
+ * @param condition Указатель на неинициализированную структуру.
+ * @return Признак успешного завершения операции.
+ */
+MAGNA_API am_bool MAGNA_CALL condition_init
+    (
+        Condition *condition
+    )
+{
+    assert (condition != NULL);
+
+    condition->impl = NULL;
+
+#if defined(MAGNA_LEGACY_CONDITION)
+
+    condition->impl = legacy_condition_create ();
+    if (condition->impl == NULL) {
+        return AM_FALSE;
+    }
+
+#elif defined(MAGNA_WINDOWS)
+
+    condition->impl = mem_alloc (sizeof (CONDITION_VARIABLE));
+    if (condition->impl == NULL) {
+        return AM_FALSE;
+    }
+
+    InitializeConditionVariable ((CONDITION_VARIABLE*) condition->impl);
+
+#elif defined(MAGNA_UNIX)
+
+    condition->impl = mem_alloc (sizeof (pthread_cond_t));
+    if (condition->impl == NULL) {
+        return AM_FALSE;
+    }
+
+    if (pthread_cond_init ((pthread_cond_t*) condition->impl, NULL) != 0) {
+        mem_free (condition->impl);
+        condition->impl = NULL;
+        return AM_FALSE;
+    }
+
+#endif
+
+    return AM_TRUE;
+}
+
+/**
+ * Освобождение ресурсов, занятых условной переменной.
+ * Никто не должен ожидать на ней.
+ *
+ * @param condition Условная переменная.
+ */
+MAGNA_API void MAGNA_CALL condition_destroy
+    (
+        Condition *condition
+    )
+{
+    assert (condition != NULL);
+
+    if (condition->impl != NULL) {
+
+#if defined(MAGNA_LEGACY_CONDITION)
+
+        legacy_condition_free ((LegacyCondition*) condition->impl);
+        condition->impl = NULL;
+        return;
+
+#elif defined(MAGNA_UNIX)
+
+        pthread_cond_destroy ((pthread_cond_t*) condition->impl);
+
+#endif
+
+        mem_free (condition->impl);
+        condition->impl = NULL;
+    }
+}
+
+/**
+ * Ожидание сигнала на условной переменной.
+ * Мьютекс должен быть захвачен вызывающим потоком.
+ * На время ожидания он освобождается.
+ *
+ * @param condition Условная переменная.
+ * @param mutex Захваченный мьютекс.
+ */
+MAGNA_API void MAGNA_CALL condition_wait
+    (
+        Condition *condition,
+        Mutex *mutex
+    )
+{
+    assert (condition != NULL);
+    assert (mutex != NULL);
+
+#if defined(MAGNA_LEGACY_CONDITION)
+
+    legacy_condition_wait
+        (
+            (LegacyCondition*) condition->impl,
+            (CRITICAL_SECTION*) mutex->impl,
+            INFINITE
+        );
+
+#elif defined(MAGNA_WINDOWS)
+
+    SleepConditionVariableCS
+        (
+            (CONDITION_VARIABLE*) condition->impl,
+            (CRITICAL_SECTION*) mutex->impl,
+            INFINITE
+        );
+
+#elif defined(MAGNA_UNIX)
+
+    pthread_cond_wait
+        (
+            (pthread_cond_t*) condition->impl,
+            (pthread_mutex_t*) mutex->impl
+        );
+
+#endif
+}
+
+/**
+ * Ожидание сигнала на условной переменной с ограничением по времени.
+ * Мьютекс должен быть захвачен вызывающим потоком.
+ *
+ * @param condition Условная переменная.
+ * @param mutex Захваченный мьютекс.
+ * @param timeout Предельное время ожидания в миллисекундах.
+ * @return `AM_FALSE`, если время ожидания истекло.
+ */
+MAGNA_API am_bool MAGNA_CALL condition_wait_for
+    (
+        Condition *condition,
+        Mutex *mutex,
+        am_int32 timeout
+    )
+{
+#if defined(MAGNA_UNIX)
+
+    struct timeval now;
+    struct timespec deadline;
+    int rc;
+
+#endif
+
+    assert (condition != NULL);
+    assert (mutex != NULL);
+
+    if (timeout < 0) {
+        timeout = 0;
+    }
+
+#if defined(MAGNA_LEGACY_CONDITION)
+
+    return legacy_condition_wait
+        (
+            (LegacyCondition*) condition->impl,
+            (CRITICAL_SECTION*) mutex->impl,
+            (DWORD) timeout
+        );
+
+#elif defined(MAGNA_WINDOWS)
+
+    return SleepConditionVariableCS
+        (
+            (CONDITION_VARIABLE*) condition->impl,
+            (CRITICAL_SECTION*) mutex->impl,
+            (DWORD) timeout
+        ) != 0;
+
+#elif defined(MAGNA_UNIX)
+
+    gettimeofday (&now, NULL);
+    deadline.tv_sec = now.tv_sec + timeout / 1000;
+    deadline.tv_nsec = now.tv_usec * 1000L + (timeout % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    rc = pthread_cond_timedwait
+        (
+            (pthread_cond_t*) condition->impl,
+            (pthread_mutex_t*) mutex->impl,
+            &deadline
+        );
+
+    return rc != ETIMEDOUT;
+
+#else
+
+    (void) timeout;
+
+    return AM_FALSE;
+
+#endif
+}
+
+/**
+ * Пробуждение одного из потоков, ожидающих на условной переменной.
+ *
+ * @param condition Условная переменная.
+ */
+MAGNA_API void MAGNA_CALL condition_signal
+    (
+        Condition *condition
+    )
+{
+    assert (condition != NULL);
+
+#if defined(MAGNA_LEGACY_CONDITION)
+
+    legacy_condition_wake ((LegacyCondition*) condition->impl, AM_FALSE);
+
+#elif defined(MAGNA_WINDOWS)
+
+    WakeConditionVariable ((CONDITION_VARIABLE*) condition->impl);
+
+#elif defined(MAGNA_UNIX)
+
+    pthread_cond_signal ((pthread_cond_t*) condition->impl);
+
+#endif
+}
+
+/**
+ * Пробуждение всех потоков, ожидающих на условной переменной.
+ *
+ * @param condition Условная переменная.
+ */
+MAGNA_API void MAGNA_CALL condition_broadcast
+    (
+        Condition *condition
+    )
+{
+    assert (condition != NULL);
+
+#if defined(MAGNA_LEGACY_CONDITION)
+
+    legacy_condition_wake ((LegacyCondition*) condition->impl, AM_TRUE);
+
+#elif defined(MAGNA_WINDOWS)
+
+    WakeAllConditionVariable ((CONDITION_VARIABLE*) condition->impl);
+
+#elif defined(MAGNA_UNIX)
+
+    pthread_cond_broadcast ((pthread_cond_t*) condition->impl);
+
+#endif
+}
+
+/*=========================================================*/
+
+/* Атомарные операции */
+
+#if defined(MAGNA_UNIX) && !defined(__GNUC__)
+
+/* Компилятор без встроенных атомарных операций */
+static pthread_mutex_t atomicMutex = PTHREAD_MUTEX_INITIALIZER;
+
+#endif
+
+/**
+ * Атомарное прибавление к 32-битному целому.
+ *
+ * @param value Указатель на изменяемое значение.
+ * @param delta Прибавляемая величина.
+ * @return Новое значение.
+ */
+MAGNA_API am_int32 MAGNA_CALL atomic_add_int32
+    (
+        volatile am_int32 *value,
+        am_int32 delta
+    )
+{
+#if defined(MAGNA_UNIX) && !defined(__GNUC__)
+
+    am_int32 result;
+
+#endif
+
+    assert (value != NULL);
+
+#if defined(MAGNA_WINDOWS)
+
+    return InterlockedExchangeAdd ((volatile LONG*) value, delta) + delta;
+
+#elif defined(__GNUC__)
+
+    return __sync_add_and_fetch (value, delta);
+
+#elif defined(MAGNA_UNIX)
+
+    pthread_mutex_lock (&atomicMutex);
+    *value += delta;
+    result = *value;
+    pthread_mutex_unlock (&atomicMutex);
+
+    return result;
+
+#else
+
+    /* MSDOS: однопоточная среда */
+
+    *value += delta;
+
+    return *value;
+
+#endif
+}
+
+/**
+ * Атомарный инкремент 32-битного целого.
+ *
+ * @param value Указатель на изменяемое значение.
+ * @return Новое значение.
+ */
+MAGNA_API am_int32 MAGNA_CALL atomic_increment_int32
+    (
+        volatile am_int32 *value
+    )
+{
+    return atomic_add_int32 (value, 1);
+}
+
+/**
+ * Атомарный декремент 32-битного целого.
+ *
+ * @param value Указатель на изменяемое значение.
+ * @return Новое значение.
+ */
+MAGNA_API am_int32 MAGNA_CALL atomic_decrement_int32
+    (
+        volatile am_int32 *value
+    )
+{
+    return atomic_add_int32 (value, -1);
+}
+
 /*=========================================================*/
 
 #include "warnpop.h"
@@ -1,7 +1,13 @@
 #ifndef TESTS_OFFLINE_H
 #define TESTS_OFFLINE_H
 
+#include "magna/irbis.h"
+
 am_bool where_test_data (Buffer *path);
 
+/* Имитация сервера ИРБИС64 с двумя записями и подключение к ней */
+am_bool mock_connect    (MockServer *server, Connection *connection);
+void    mock_disconnect (MockServer *server, Connection *connection);
+
 #endif
 
@@ -0,0 +1,160 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+typedef struct
+{
+    int calls;
+    am_bool success;
+    am_bool answered; /* Получен ответ с кодом возврата 0 */
+
+} AsyncProbe;
+
+static void MAGNA_CALL async_probe_callback (Response *response, am_bool success, void *data)
+{
+    AsyncProbe *probe = (AsyncProbe*) data;
+
+    ++probe->calls;
+    probe->success = success;
+    probe->answered = success && response_check (response, 0);
+}
+
+TESTER(tcp4_resolve_1)
+{
+    Tcp4Address address;
+    const am_byte *bytes;
+
+    CHECK (tcp4_resolve (CBTEXT ("127.0.0.1"), 6666, &address));
+    bytes = (const am_byte*) &address.address;
+    CHECK (bytes[0] == 127);
+    CHECK (bytes[1] == 0);
+    CHECK (bytes[2] == 0);
+    CHECK (bytes[3] == 1);
+    CHECK (address.port == 6666);
+}
+
+TESTER(async_engine_create_1)
+{
+    AsyncEngine engine;
+
+    CHECK (async_engine_create (&engine));
+    CHECK (async_engine_pending (&engine) == 0);
+    CHECK (async_engine_run_once (&engine, 0) == 0);
+    CHECK (async_engine_run (&engine));
+
+    async_engine_destroy (&engine);
+}
+
+TESTER(connection_execute_async_1)
+{
+    Connection connection;
+    AsyncEngine engine;
+    Query query;
+    Response response;
+    AsyncProbe probe = { 0, AM_TRUE, AM_FALSE };
+
+    /* На этом порту заведомо никто не слушает */
+    CHECK (connection_create (&connection));
+    connection.port = 1;
+    CHECK (async_engine_create (&engine));
+    CHECK (query_create (&query, &connection, CBTEXT (NOP)));
+
+    if (connection_execute_async
+        (
+            &connection,
+            &engine,
+            &query,
+            &response,
+            async_probe_callback,
+            &probe
+        )) {
+        CHECK (async_engine_pending (&engine) == 1);
+        CHECK (async_engine_run (&engine));
+        CHECK (probe.calls == 1);
+        CHECK (!probe.success);
+    }
+    else {
+        CHECK (probe.calls == 0);
+    }
+
+    CHECK (async_engine_pending (&engine) == 0);
+
+    query_destroy (&query);
+    response_destroy (&response);
+    async_engine_destroy (&engine);
+    connection_destroy (&connection);
+}
+
+/* Один запрос NOP к имитации сервера через асинхронный движок */
+static void async_probe_nop
+    (
+        Connection *connection,
+        AsyncProbe *probe
+    )
+{
+    AsyncEngine engine;
+    Query query;
+    Response response;
+
+    probe->calls = 0;
+    probe->success = AM_FALSE;
+    if (!async_engine_create (&engine)) {
+        return;
+    }
+
+    if (query_create (&query, connection, CBTEXT (NOP))) {
+        if (connection_execute_async
+            (
+                connection,
+                &engine,
+                &query,
+                &response,
+                async_probe_callback,
+                probe
+            )) {
+            async_engine_run (&engine);
+        }
+
+        query_destroy (&query);
+        response_destroy (&response);
+    }
+
+    async_engine_destroy (&engine);
+}
+
+TESTER(connection_execute_async_2)
+{
+    MockServer server;
+    Connection connection;
+    AsyncProbe probe;
+
+    CHECK (mock_connect (&server, &connection));
+
+    async_probe_nop (&connection, &probe);
+    CHECK (probe.calls == 1);
+    CHECK (probe.success);
+    CHECK (probe.answered);
+
+    /* Сервер закрыл соединение, ничего не ответив */
+    server.dropEvery = 1;
+    async_probe_nop (&connection, &probe);
+    CHECK (probe.calls == 1);
+    CHECK (!probe.success);
+    CHECK (connection.lastError == -100002);
+    server.dropEvery = 0;
+
+    /* Сервер не уложился в срок */
+    server.latency = 500;
+    connection.timeout = 50;
+    async_probe_nop (&connection, &probe);
+    CHECK (probe.calls == 1);
+    CHECK (!probe.success);
+    CHECK (connection.lastError == -100004);
+    connection.timeout = 0;
+
+    mock_disconnect (&server, &connection);
+}
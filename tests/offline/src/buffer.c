@@ -295,3 +295,20 @@ TESTER(buffer_assign_text_1)
 
     buffer_destroy (&buffer);
 }
+
+TESTER(buffer_reserve_1)
+{
+    Buffer buffer = BUFFER_INIT;
+
+    CHECK (buffer_puts (&buffer, CBTEXT ("Hello")));
+    CHECK (buffer_reserve (&buffer, 1000));
+    CHECK (buffer_capacity (&buffer) == 1000);
+    CHECK (buffer_length (&buffer) == 5);
+    CHECK (buffer_compare_text (&buffer, CBTEXT ("Hello")) == 0);
+
+    /* Уменьшения не происходит */
+    CHECK (buffer_reserve (&buffer, 10));
+    CHECK (buffer_capacity (&buffer) == 1000);
+
+    buffer_destroy (&buffer);
+}
@@ -175,6 +175,106 @@ TESTER(connection_parse_string_5)
     connection_destroy (&connection);
 }
 
+TESTER(connection_resolve_1)
+{
+    Connection connection, copy;
+    Tcp4Address expected;
+    const am_byte *bytes;
+
+    CHECK (connection_create (&connection));
+    CHECK (connection_create (&copy));
+    CHECK (connection.addressExpires == 0);
+
+    CHECK (connection_resolve (&connection, AM_FALSE));
+    CHECK (connection.addressExpires != 0);
+    bytes = (const am_byte*) &connection.address.address;
+    CHECK (bytes[0] == 127 && bytes[1] == 0 && bytes[2] == 0 && bytes[3] == 1);
+    CHECK (connection.address.port == 6666);
+
+    /* Смена порта не требует повторного разрешения */
+    connection.port = 6667;
+    CHECK (connection_resolve (&connection, AM_FALSE));
+    CHECK (connection.address.port == 6667);
+
+    /* Разрешенный адрес переходит к копии */
+    CHECK (connection_copy_settings (&copy, &connection));
+    CHECK (copy.addressExpires == connection.addressExpires);
+
+    /* Смена хоста сбрасывает адрес */
+    CHECK (connection_set_host (&connection, CBTEXT ("localhost")));
+    CHECK (connection.addressExpires == 0);
+    CHECK (tcp4_resolve (CBTEXT ("localhost"), 6667, &expected));
+    CHECK (connection_resolve (&connection, AM_TRUE));
+    CHECK (connection.address.address == expected.address);
+
+    connection_destroy (&copy);
+    connection_destroy (&connection);
+}
+
+TESTER(connection_set_deadline_1)
+{
+    Connection connection;
+
+    CHECK (connection_create (&connection));
+    CHECK (connection.deadline == 0);
+
+    connection_set_deadline (&connection, 1000);
+    CHECK (connection.deadline > magna_ticks ());
+
+    connection_set_deadline (&connection, 0);
+    CHECK (connection.deadline == 0);
+
+    /* Просроченная команда даже не отправляется на сервер */
+    connection.connected = AM_TRUE;
+    connection.deadline = 1;
+    CHECK (connection_search_count (&connection, CBTEXT ("K=ALG$")) < 0);
+    CHECK (connection.lastError == -100004);
+    connection.connected = AM_FALSE;
+
+    connection_destroy (&connection);
+}
+
+TESTER(connection_get_deadline_1)
+{
+    Connection connection;
+    am_uint64 now;
+
+    CHECK (connection_create (&connection));
+    connection.timeout = 0;
+    CHECK (connection_get_deadline (&connection) == 0);
+
+    /* Из двух сроков выбирается более ранний */
+    now = magna_ticks ();
+    connection.timeout = 1000;
+    CHECK (connection_get_deadline (&connection) >= now + 1000);
+    CHECK (connection_get_deadline (&connection) < now + 2000);
+    connection.deadline = now + 100;
+    CHECK (connection_get_deadline (&connection) == now + 100);
+    connection.deadline = now + 60000;
+    CHECK (connection_get_deadline (&connection) < now + 2000);
+    connection.timeout = 0;
+    CHECK (connection_get_deadline (&connection) == now + 60000);
+
+    connection_destroy (&connection);
+}
+
+TESTER(connection_set_hedging_1)
+{
+    Connection connection;
+
+    CHECK (connection_create (&connection));
+    CHECK (connection.hedge.delay == 0);
+    CHECK (connection.hedge.percentile == 95);
+
+    connection.hedge.issued = 5;
+    connection_set_hedging (&connection, 50, 90);
+    CHECK (connection.hedge.delay == 50);
+    CHECK (connection.hedge.percentile == 90);
+    CHECK (connection.hedge.issued == 0);
+
+    connection_destroy (&connection);
+}
+
 TESTER(connection_to_string_1)
 {
     Connection connection;
@@ -204,3 +304,373 @@ TESTER(connection_to_string_2)
     connection_destroy (&connection);
     buffer_destroy (&output);
 }
+
+TESTER(query_create_1)
+{
+    Connection connection;
+    Query query;
+    const am_byte *first;
+
+    CHECK (connection_create (&connection));
+    CHECK (connection_set_username (&connection, CBTEXT ("ninja")));
+    CHECK (connection_set_password (&connection, CBTEXT ("invisible")));
+    connection.clientId = 123456;
+    connection.queryId = 1;
+
+    CHECK (query_create (&query, &connection, CBTEXT ("N")));
+    CHECK (buffer_compare_text (&query.buffer,
+        CBTEXT ("N\nC\nN\n123456\n1\ninvisible\nninja\n\n\n\n")) == 0);
+    first = query.buffer.start;
+    query_destroy (&query);
+
+    /* Буфер запроса возвращен подключению и используется повторно */
+    CHECK (query.buffer.start == NULL);
+    CHECK (connection.scratchQuery.start == first);
+    CHECK (query_create (&query, &connection, CBTEXT ("N")));
+    CHECK (query.buffer.start == first);
+    CHECK (connection.scratchQuery.start == NULL);
+    CHECK (buffer_compare_text (&query.buffer,
+        CBTEXT ("N\nC\nN\n123456\n2\ninvisible\nninja\n\n\n\n")) == 0);
+    query_destroy (&query);
+
+    /* Повторное использование можно отключить */
+    connection.scratchLimit = 0;
+    buffer_destroy (&connection.scratchQuery);
+    CHECK (query_create (&query, &connection, CBTEXT ("N")));
+    query_destroy (&query);
+    CHECK (connection.scratchQuery.start == NULL);
+
+    connection_destroy (&connection);
+}
+
+TESTER(connection_clone_1)
+{
+    Connection source, clone;
+    Query query;
+
+    CHECK (connection_create (&source));
+    CHECK (connection_create (&clone));
+    CHECK (connection_set_username (&source, CBTEXT ("ninja")));
+    CHECK (connection_set_password (&source, CBTEXT ("invisible")));
+
+    /* Неактивное подключение не копируется */
+    CHECK (!connection_clone (&clone, &source));
+    CHECK (!clone.connected);
+
+    source.connected = AM_TRUE;
+    source.clientId = 123456;
+    source.queryId = 5;
+    CHECK (connection_clone (&clone, &source));
+    CHECK (clone.connected);
+    CHECK (clone.clientId == 123456);
+    CHECK (clone.session == source.session);
+    CHECK (source.session->references == 2);
+
+    /* Номера запросов общие для обеих копий */
+    CHECK (query_create (&query, &clone, CBTEXT ("N")));
+    CHECK (buffer_compare_text (&query.buffer,
+        CBTEXT ("N\nC\nN\n123456\n5\ninvisible\nninja\n\n\n\n")) == 0);
+    query_destroy (&query);
+    CHECK (query_create (&query, &source, CBTEXT ("N")));
+    CHECK (buffer_compare_text (&query.buffer,
+        CBTEXT ("N\nC\nN\n123456\n6\ninvisible\nninja\n\n\n\n")) == 0);
+    query_destroy (&query);
+
+    /* Копия отключается, не снимая регистрацию */
+    CHECK (connection_disconnect (&clone));
+    CHECK (!clone.connected);
+    CHECK (clone.session == NULL);
+    CHECK (source.session->references == 1);
+
+    /* Не обращаемся к серверу */
+    mutex_destroy (&source.session->mutex);
+    mem_free (source.session);
+    source.session = NULL;
+    source.connected = AM_FALSE;
+
+    connection_destroy (&clone);
+    connection_destroy (&source);
+}
+
+TESTER(connection_resolve_2)
+{
+    Connection source, clone;
+    ConnectionSession *session;
+    am_uint32 moved;
+    am_byte *bytes;
+
+    CHECK (connection_create (&source));
+    CHECK (connection_create (&clone));
+    CHECK (connection_resolve (&source, AM_FALSE));
+    source.connected = AM_TRUE;
+    CHECK (connection_clone (&clone, &source));
+    session = source.session;
+    CHECK (session->addressExpires == source.addressExpires);
+    CHECK (session->address.address == source.address.address);
+
+    /* Устаревший адрес копия берет из регистрации, не разрешая имя */
+    bytes = (am_byte*) &moved;
+    bytes[0] = 127; bytes[1] = 0; bytes[2] = 0; bytes[3] = 2;
+    session->address.address = moved;
+    clone.addressExpires = 0;
+    CHECK (connection_resolve (&clone, AM_FALSE));
+    CHECK (clone.address.address == moved);
+    CHECK (clone.address.port == 6666);
+    CHECK (clone.addressExpires == session->addressExpires);
+
+    /* Адрес, уже обновленный другой копией, заново не разрешается */
+    CHECK (connection_resolve (&source, AM_TRUE));
+    CHECK (source.address.address == moved);
+
+    /* Иначе имя разрешается заново, и адрес получают все копии */
+    CHECK (connection_resolve (&source, AM_TRUE));
+    bytes = (am_byte*) &source.address.address;
+    CHECK (bytes[0] == 127 && bytes[1] == 0 && bytes[2] == 0 && bytes[3] == 1);
+    CHECK (session->address.address == source.address.address);
+    CHECK (connection_resolve (&clone, AM_TRUE));
+    CHECK (clone.address.address == source.address.address);
+
+    /* Не обращаемся к серверу */
+    CHECK (connection_disconnect (&clone));
+    mutex_destroy (&session->mutex);
+    mem_free (session);
+    source.session = NULL;
+    source.connected = AM_FALSE;
+
+    connection_destroy (&clone);
+    connection_destroy (&source);
+}
+
+TESTER(query_add_record_1)
+{
+    MarcRecord record;
+    MarcField *field;
+    Query query;
+    Buffer expected = BUFFER_INIT, actual = BUFFER_INIT;
+    am_byte text[QUERY_COPY_LIMIT + 10];
+
+    memset (text, 'x', sizeof (text));
+    text[sizeof (text) - 1] = 0;
+
+    record_init (&record);
+    record.mfn = 12;
+    record.version = 3;
+    CHECK (record_add (&record, 200, CBTEXT ("^aTitle^eSubtitle")) != NULL);
+    CHECK ((field = record_add (&record, 330, text)) != NULL);
+    CHECK (field_add (field, 'a', span_from_text (text)));
+
+    /* Длинные значения не копируются, но результат тот же */
+    query_init (&query);
+    CHECK (query_add_record (&query, &record));
+    CHECK (query.parts.len == 2);
+    CHECK (query_length (&query) > buffer_length (&query.buffer));
+    CHECK (query_to_buffer (&query, &actual));
+    CHECK (record_encode (&record, IRBIS_DELIMITER, &expected));
+    CHECK (buffer_compare (&actual, &expected) == 0);
+    CHECK (query_length (&query) == buffer_length (&expected));
+
+    query_destroy (&query);
+    record_destroy (&record);
+    buffer_destroy (&expected);
+    buffer_destroy (&actual);
+}
+
+/* Сервер с заданным поведением для проверки дублирования и сроков */
+typedef struct
+{
+    am_int32 listener;    /* Слушающий сокет. */
+    am_uint32 delay;      /* Задержка ответа на первый запрос, мс (0 = не отвечать). */
+    const char *answer;   /* Ответ на запрос. */
+    am_int32 queryIds[2]; /* Номера полученных запросов. */
+    size_t accepted;      /* Принято подключений. */
+
+} ScriptServer;
+
+/* Прием запроса целиком; возвращает его номер либо -1. */
+static am_int32 script_read_query
+    (
+        am_int32 handle
+    )
+{
+    Buffer request = BUFFER_INIT;
+    Span lines[6];
+    ssize_t newline;
+    am_int32 result = -1;
+
+    while ((newline = span_index_of (buffer_to_span (&request), '\n')) < 0
+        || buffer_length (&request) < (size_t) newline + 1
+            + span_to_uint32 (span_slice (buffer_to_span (&request), 0, newline))) {
+        if (tcp4_receive_block (handle, &request, 4096) <= 0) {
+            goto DONE;
+        }
+    }
+
+    /* Длина, команда, АРМ, команда, клиент, номер запроса */
+    if (span_split_n_by_char (buffer_to_span (&request), lines, 6, '\n') == 6) {
+        result = (am_int32) span_to_uint32 (lines[5]);
+    }
+
+    DONE:
+    buffer_destroy (&request);
+
+    return result;
+}
+
+static void MAGNA_CALL script_server_run
+    (
+        void *data
+    )
+{
+    ScriptServer *server = (ScriptServer*) data;
+    Tcp4Poll item;
+    Buffer rest = BUFFER_INIT;
+    am_int32 first, second;
+
+    first = tcp4_accept (server->listener);
+    if (first < 0) {
+        return;
+    }
+
+    server->queryIds[0] = script_read_query (first);
+    server->accepted = 1;
+
+    /* Дубликата не было: ответ на первый запрос с задержкой */
+    item.handle = server->listener;
+    item.events = TCP4_READ;
+    if (server->delay != 0
+        && tcp4_poll (&item, 1, (am_int32) server->delay) == 0) {
+        tcp4_send (first, CBTEXT (server->answer), (ssize_t) strlen (server->answer));
+        tcp4_disconnect (first);
+        return;
+    }
+
+    /* Дубликат отвечается сразу */
+    if (server->delay != 0) {
+        second = tcp4_accept (server->listener);
+        if (second >= 0) {
+            server->queryIds[1] = script_read_query (second);
+            server->accepted = 2;
+            tcp4_send (second, CBTEXT (server->answer), (ssize_t) strlen (server->answer));
+            tcp4_disconnect (second);
+        }
+    }
+
+    /* Первый запрос остается без ответа, пока клиент не отключится */
+    while (tcp4_receive_block (first, &rest, 4096) > 0) {
+    }
+
+    buffer_destroy (&rest);
+    tcp4_disconnect (first);
+}
+
+/* Запуск сервера и настройка подключения к нему. */
+static am_handle script_server_start
+    (
+        ScriptServer *server,
+        Connection *connection,
+        am_uint32 delay
+    )
+{
+    Tcp4Address address;
+
+    mem_clear (server, sizeof (*server));
+    server->delay = delay;
+    server->answer = "K\r\n0\r\n1\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n0\r\n5\r\n";
+    server->queryIds[0] = server->queryIds[1] = -1;
+    server->listener = -1;
+    if (!tcp4_resolve (CBTEXT ("127.0.0.1"), 0, &address)) {
+        return handle_get_bad ();
+    }
+
+    server->listener = tcp4_listen (&address, 4);
+    if (server->listener < 0
+        || !connection_create (connection)
+        || !connection_set_host (connection, CBTEXT ("127.0.0.1"))) {
+        return handle_get_bad ();
+    }
+
+    connection->port = tcp4_local_port (server->listener);
+    connection->connected = AM_TRUE;
+
+    return thread_start (script_server_run, server);
+}
+
+static void script_server_stop
+    (
+        ScriptServer *server,
+        Connection *connection,
+        am_handle thread
+    )
+{
+    thread_wait (thread);
+    tcp4_disconnect (server->listener);
+    connection->connected = AM_FALSE;
+    connection_destroy (connection);
+}
+
+TESTER(connection_hedge_1)
+{
+    ScriptServer server;
+    Connection connection;
+    am_handle thread;
+
+    /* Первый запрос застрял, дубликат отвечен сразу */
+    thread = script_server_start (&server, &connection, 2000);
+    CHECK (handle_is_good (thread));
+    connection_set_hedging (&connection, 50, 95);
+    CHECK (connection_search_count (&connection, CBTEXT ("K=ALG$")) == 5);
+    CHECK (connection.hedge.issued == 1);
+    CHECK (connection.hedge.won == 1);
+    script_server_stop (&server, &connection, thread);
+
+    /* У дубликата собственный номер запроса */
+    CHECK (server.accepted == 2);
+    CHECK (server.queryIds[0] >= 0);
+    CHECK (server.queryIds[1] >= 0);
+    CHECK (server.queryIds[0] != server.queryIds[1]);
+}
+
+TESTER(connection_hedge_2)
+{
+    ScriptServer server;
+    Connection connection;
+    Query query;
+    Response response;
+    am_handle thread;
+
+    /* Чтение с блокировкой записи не дублируется */
+    thread = script_server_start (&server, &connection, 200);
+    CHECK (handle_is_good (thread));
+    connection_set_hedging (&connection, 50, 95);
+    CHECK (query_create (&query, &connection, CBTEXT (READ_RECORD)));
+    CHECK (query_add_ansi (&query, CBTEXT ("IBIS")));
+    CHECK (query_add_int32 (&query, 1));
+    CHECK (query_add_int32 (&query, 1));
+    CHECK (connection_execute (&connection, &query, &response));
+    CHECK (connection.hedge.issued == 0);
+    response_destroy (&response);
+    query_destroy (&query);
+    script_server_stop (&server, &connection, thread);
+    CHECK (server.accepted == 1);
+}
+
+TESTER(connection_timeout_1)
+{
+    ScriptServer server;
+    Connection connection;
+    am_handle thread;
+    am_uint64 started, elapsed;
+
+    /* Сервер принял запрос и молчит: срок ожидания ответа */
+    thread = script_server_start (&server, &connection, 0);
+    CHECK (handle_is_good (thread));
+    connection.timeout = 100;
+    started = magna_ticks ();
+    CHECK (connection_search_count (&connection, CBTEXT ("K=ALG$")) < 0);
+    elapsed = magna_ticks () - started;
+    CHECK (connection.lastError == -100004);
+    CHECK (elapsed >= 90);
+    CHECK (elapsed < 1000);
+    script_server_stop (&server, &connection, thread);
+    CHECK (server.accepted == 1);
+}
@@ -0,0 +1,153 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+TESTER(search_cursor_create_1)
+{
+    Connection connection;
+    SearchParameters parameters;
+    SearchCursor cursor;
+    Enumerator enumerator;
+
+    connection_create (&connection);
+    CHECK (search_parameters_create (&parameters, CBTEXT ("K=ALG$")));
+
+    /* Подключение не установлено */
+    CHECK (!search_cursor_create (&cursor, &connection, &parameters));
+    CHECK (cursor.failed);
+
+    search_cursor_enumerator (&cursor, &enumerator);
+    CHECK (enum_next (&enumerator) == NULL);
+
+    search_cursor_destroy (&cursor);
+    search_parameters_destroy (&parameters);
+    connection_destroy (&connection);
+}
+
+TESTER(term_cursor_create_1)
+{
+    Connection connection;
+    TermParameters parameters;
+    TermCursor cursor;
+    Enumerator enumerator;
+
+    connection_create (&connection);
+    CHECK (term_parameters_create (&parameters, CBTEXT ("K=")));
+    parameters.reverseOrder = AM_TRUE;
+
+    /* Подключение не установлено */
+    CHECK (!term_cursor_create (&cursor, &connection, &parameters));
+    CHECK (cursor.failed);
+
+    term_cursor_enumerator (&cursor, &enumerator);
+    CHECK (enum_next (&enumerator) == NULL);
+
+    term_cursor_destroy (&cursor);
+    term_parameters_destroy (&parameters);
+    connection_destroy (&connection);
+}
+
+TESTER(search_cursor_next_1)
+{
+    MockServer server;
+    Connection connection;
+    SearchParameters parameters;
+    SearchCursor cursor;
+    const FoundLine *found;
+    am_int32 requests;
+
+    CHECK (mock_connect (&server, &connection));
+    CHECK (search_parameters_create (&parameters, CBTEXT ("K=ALGEBRA")));
+    parameters.number = 1;
+
+    /* Постранично, по одной записи; вторая страница -- в фоне */
+    requests = server.requests;
+    CHECK (search_cursor_create (&cursor, &connection, &parameters));
+    CHECK (cursor.total == 2);
+    CHECK (cursor.worker.clientId == connection.clientId);
+    found = search_cursor_next (&cursor);
+    CHECK (found != NULL);
+    CHECK (found->mfn == 1);
+    found = search_cursor_next (&cursor);
+    CHECK (found != NULL);
+    CHECK (found->mfn == 2);
+    CHECK (search_cursor_next (&cursor) == NULL);
+    CHECK (!cursor.failed);
+    search_cursor_destroy (&cursor);
+
+    /* Две страницы -- два запроса: ни регистрации, ни ее снятия */
+    CHECK (server.requests == requests + 2);
+    CHECK (connection_no_operation (&connection));
+
+    search_parameters_destroy (&parameters);
+    mock_disconnect (&server, &connection);
+}
+
+TESTER(term_cursor_next_1)
+{
+    MockServer server;
+    Connection connection;
+    TermParameters parameters;
+    TermCursor cursor;
+    const Term *term;
+    size_t count = 0;
+    am_int32 requests;
+
+    CHECK (mock_connect (&server, &connection));
+    CHECK (term_parameters_create (&parameters, CBTEXT ("K=")));
+    parameters.number = 2;
+
+    requests = server.requests;
+    CHECK (term_cursor_create (&cursor, &connection, &parameters));
+    CHECK (cursor.worker.clientId == connection.clientId);
+    while ((term = term_cursor_next (&cursor)) != NULL) {
+        CHECK (span_starts_with (buffer_to_span (&term->text), TEXT_SPAN ("K=")));
+        ++count;
+    }
+
+    /* ALGEBRA, BEGINNERS, FOR, LINEAR -- по два за раз,
+       каждая порция начинается с последнего термина предыдущей */
+    CHECK (!cursor.failed);
+    CHECK (count == 4);
+    term_cursor_destroy (&cursor);
+    CHECK (server.requests == requests + 4);
+    CHECK (connection_no_operation (&connection));
+
+    term_parameters_destroy (&parameters);
+    mock_disconnect (&server, &connection);
+}
+
+TESTER(term_cursor_next_2)
+{
+    MockServer server;
+    Connection connection;
+    TermParameters parameters;
+    TermCursor cursor;
+    const Term *term;
+    size_t count = 0;
+    am_int32 requests;
+
+    CHECK (mock_connect (&server, &connection));
+    CHECK (term_parameters_create (&parameters, CBTEXT ("K=")));
+
+    /* Сервер урезает порцию до трех терминов из запрошенных 1024 */
+    server.termLimit = 3;
+    requests = server.requests;
+    CHECK (term_cursor_create (&cursor, &connection, &parameters));
+    while ((term = term_cursor_next (&cursor)) != NULL) {
+        ++count;
+    }
+
+    /* ALGEBRA, BEGINNERS, FOR; FOR, LINEAR; LINEAR -- конец словаря */
+    CHECK (!cursor.failed);
+    CHECK (count == 4);
+    term_cursor_destroy (&cursor);
+    CHECK (server.requests == requests + 3);
+
+    term_parameters_destroy (&parameters);
+    mock_disconnect (&server, &connection);
+}
@@ -0,0 +1,95 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+TESTER(connection_search_federated_1)
+{
+    Connection connection;
+    FederatedSearch search;
+    SpanArray databases;
+    const FederatedResult *result;
+
+    CHECK (connection_create (&connection));
+    CHECK (span_array_create (&databases, 4));
+    CHECK (span_split_by_char (TEXT_SPAN ("IBIS,RDR,ISTU"), &databases, ','));
+    CHECK (federated_search_create (&search));
+
+    /* Без подключения поиск не выполняется,
+     * но результаты по базам данных заготовлены */
+    CHECK (!connection_search_federated (&connection, &databases, CBTEXT ("K=ALG$"), &search));
+    CHECK (search.results.len == 3);
+    CHECK (search.total == 0);
+    result = federated_search_get (&search, 1);
+    CHECK (buffer_compare_text (&result->database, CBTEXT ("RDR")) == 0);
+    CHECK (result->count == -1);
+    CHECK (result->found.len == 0);
+
+    /* Повторный вызов заменяет прежние результаты */
+    span_array_truncate (&databases, 1);
+    CHECK (!connection_search_federated (&connection, &databases, CBTEXT ("K=ALG$"), &search));
+    CHECK (search.results.len == 1);
+
+    federated_search_destroy (&search);
+    span_array_destroy (&databases);
+    connection_destroy (&connection);
+}
+
+TESTER(connection_search_federated_2)
+{
+    MockServer server;
+    Connection connection;
+    ConcurrencyLimiter limiter;
+    FederatedSearch search;
+    SpanArray databases;
+    const FederatedResult *result;
+    size_t index, failed = 0;
+
+    CHECK (mock_connect (&server, &connection));
+    CHECK (span_array_create (&databases, 4));
+    CHECK (span_split_by_char (TEXT_SPAN ("IBIS,RDR,ISTU"), &databases, ','));
+    CHECK (federated_search_create (&search));
+
+    CHECK (connection_search_federated (&connection, &databases, CBTEXT ("K=ALGEBRA"), &search));
+    CHECK (search.total == 6);
+    CHECK (search.failed == 0);
+    result = federated_search_get (&search, 2);
+    CHECK (result->count == 2);
+    CHECK (result->found.len == 2);
+    CHECK (result->found.ptr[0] == 1);
+    CHECK (result->found.ptr[1] == 2);
+
+    /* Оборванное соединение -- неудача, а не пустой результат */
+    server.dropEvery = 3;
+    CHECK (connection_search_federated (&connection, &databases, CBTEXT ("K=ALGEBRA"), &search));
+    server.dropEvery = 0;
+    CHECK (search.failed == 1);
+    CHECK (search.total == 4);
+    for (index = 0; index < search.results.len; ++index) {
+        result = federated_search_get (&search, index);
+        if (result->error != 0) {
+            CHECK (result->error == -100002);
+            CHECK (result->count == -1);
+            ++failed;
+        }
+    }
+
+    CHECK (failed == 1);
+
+    /* Мест у ограничителя меньше, чем баз данных */
+    CHECK (limiter_create (&limiter, 1, 1, 1));
+    connection.limiter = &limiter;
+    CHECK (connection_search_federated (&connection, &databases, CBTEXT ("K=LINEAR"), &search));
+    CHECK (search.total == 3);
+    CHECK (search.failed == 0);
+    CHECK (limiter.inFlight == 0);
+    connection.limiter = NULL;
+    limiter_destroy (&limiter);
+
+    federated_search_destroy (&search);
+    span_array_destroy (&databases);
+    mock_disconnect (&server, &connection);
+}
@@ -0,0 +1,60 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+static am_bool MAGNA_CALL fulltext_count_found (const FoundLine *found, void *data)
+{
+    (void) found;
+    ++*(int*) data;
+
+    return AM_TRUE;
+}
+
+TESTER(fulltext_parameters_encode_1)
+{
+    Connection connection;
+    FullTextParameters parameters;
+    Query query;
+
+    CHECK (connection_create (&connection));
+    CHECK (buffer_assign_text (&connection.database, CBTEXT ("IBIS")));
+    CHECK (fulltext_parameters_create (&parameters, CBTEXT ("дуга")));
+    CHECK (buffer_assign_text (&parameters.format, CBTEXT ("v200^a")));
+    parameters.number = 10;
+    CHECK (fulltext_parameters_verify (&parameters));
+
+    query_init (&query);
+    CHECK (fulltext_parameters_encode (&parameters, &connection, &query));
+    CHECK (buffer_compare_text
+        (
+            &query.buffer,
+            CBTEXT ("IBIS\n\n10\n1\n!v200^a\n0\n0\n\nдуга\n")
+        ) == 0);
+
+    query_destroy (&query);
+    fulltext_parameters_destroy (&parameters);
+    connection_destroy (&connection);
+}
+
+TESTER(connection_search_fulltext_1)
+{
+    Connection connection;
+    FullTextParameters parameters;
+    int count = 0;
+
+    CHECK (connection_create (&connection));
+
+    /* Пустой запрос не проходит проверку */
+    fulltext_parameters_init (&parameters);
+    CHECK (!fulltext_parameters_verify (&parameters));
+
+    /* Без подключения поиск не выполняется */
+    CHECK (fulltext_parameters_create (&parameters, CBTEXT ("дуга")));
+    CHECK (connection_search_fulltext (&connection, &parameters, fulltext_count_found, &count) < 0);
+    CHECK (count == 0);
+
+    fulltext_parameters_destroy (&parameters);
+    connection_destroy (&connection);
+}
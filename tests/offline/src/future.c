@@ -0,0 +1,80 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+static am_bool MAGNA_CALL future_double_mfn (Connection *connection, Future *future)
+{
+    (void) connection;
+    future->value = (am_int32) future->mfn * 2;
+
+    return future->mfn != 13;
+}
+
+static void MAGNA_CALL future_count_calls (Future *future, void *data)
+{
+    (void) future;
+    ++*(int*) data;
+}
+
+TESTER(future_submit_1)
+{
+    Connection connection;
+    FutureExecutor executor;
+    Future first, second, *all[2];
+    int calls = 0;
+
+    CHECK (connection_create (&connection));
+
+    /* Неактивное подключение не годится */
+    CHECK (!future_executor_create (&executor, &connection, 2));
+
+    connection.connected = AM_TRUE;
+    connection.clientId = 123456;
+    CHECK (future_executor_create (&executor, &connection, 2));
+    CHECK (executor.workerCount == 2);
+    CHECK (connection.session->references == 3);
+
+    future_init (&first);
+    future_init (&second);
+    first.mfn = 21;
+    second.mfn = 13;
+    CHECK (future_submit (&executor, &first, future_double_mfn));
+    CHECK (future_submit (&executor, &second, future_double_mfn));
+    future_then (&first, future_count_calls, &calls);
+
+    all[0] = &first;
+    all[1] = &second;
+    CHECK (future_wait_any (all, 2) < 2);
+    CHECK (!future_wait_all (all, 2));
+    CHECK (future_is_done (&first));
+    CHECK (first.success);
+    CHECK (first.value == 42);
+    CHECK (first.error == 0);
+    CHECK (!second.success);
+    CHECK (second.error != 0);
+    CHECK (calls == 1);
+
+    /* Продолжение к завершенной команде вызывается сразу */
+    future_then (&second, future_count_calls, &calls);
+    CHECK (calls == 2);
+
+    /* Отложенный результат можно использовать повторно */
+    first.mfn = 5;
+    CHECK (future_submit (&executor, &first, future_double_mfn));
+    CHECK (future_wait (&first));
+    CHECK (first.value == 10);
+
+    future_destroy (&first);
+    future_destroy (&second);
+    future_executor_destroy (&executor);
+    CHECK (connection.session->references == 1);
+
+    /* Не обращаемся к серверу */
+    mutex_destroy (&connection.session->mutex);
+    mem_free (connection.session);
+    connection.session = NULL;
+    connection.connected = AM_FALSE;
+    connection_destroy (&connection);
+}
@@ -0,0 +1,167 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+static am_bool gbl_add_statement (GblSettings *settings, const char *command, const char *field, const char *format)
+{
+    GblStatement *statement;
+
+    statement = (GblStatement*) array_emplace_back (&settings->statements);
+    if (statement == NULL) {
+        return AM_FALSE;
+    }
+
+    gbl_statement_init (statement);
+
+    return buffer_assign_text (&statement->command, CBTEXT (command))
+        && buffer_assign_text (&statement->parameter1, CBTEXT (field))
+        && buffer_assign_text (&statement->parameter2, CBTEXT ("*"))
+        && buffer_assign_text (&statement->format1, CBTEXT (format));
+}
+
+static void MAGNA_CALL gbl_count_progress (GblJob *job, const GblChunk *chunk, void *data)
+{
+    (void) job;
+    (void) chunk;
+    ++*(int*) data;
+}
+
+static void MAGNA_CALL gbl_stop_progress (GblJob *job, const GblChunk *chunk, void *data)
+{
+    (void) chunk;
+    ++*(int*) data;
+    gbl_job_stop (job);
+}
+
+TESTER(gbl_settings_encode_1)
+{
+    GblSettings settings;
+    Query query;
+
+    gbl_settings_init (&settings);
+    CHECK (buffer_assign_text (&settings.database, CBTEXT ("IBIS")));
+    CHECK (gbl_add_statement (&settings, "ADD", "920", "'PAZK'"));
+    CHECK (gbl_settings_verify (&settings));
+    settings.minMfn = 3;
+    settings.maxMfn = 5;
+
+    query_init (&query);
+    CHECK (gbl_settings_encode (&settings, &query));
+    CHECK (buffer_compare_text
+        (
+            &query.buffer,
+            CBTEXT ("IBIS\n0\n!0\x1F\x1E" "ADD\x1F\x1E" "920\x1F\x1E*\x1F\x1E'PAZK'\x1F\x1E\x1F\x1E\x1F\x1E\n"
+                    "\n0\n0\n\n3\n3\n4\n5\n*\n&\n")
+        ) == 0);
+
+    query_destroy (&query);
+    gbl_settings_destroy (&settings);
+}
+
+TESTER(gbl_result_decode_1)
+{
+    Connection connection;
+    Response response;
+    GblResult result, total;
+
+    CHECK (connection_create (&connection));
+    response_init (&response);
+    response.connection = &connection;
+    CHECK (buffer_puts (&response.answer, CBTEXT ("5\r\n123456\r\n7\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n0\r\n"
+        "DBN=IBIS#MFN=1#AUTOIN=#UPDUF=0#\r\nDBN=IBIS#MFN=2#ERR=-600#\r\n")));
+    response_parse_answer (&response);
+    CHECK (response_get_return_code (&response) == 0);
+
+    gbl_result_init (&result);
+    CHECK (gbl_result_decode (&result, &response));
+    CHECK (result.processed == 2);
+    CHECK (result.failed == 1);
+    CHECK (result.failedMfns.len == 1);
+    CHECK (result.failedMfns.ptr [0] == 2);
+
+    gbl_result_init (&total);
+    CHECK (gbl_result_merge (&total, &result));
+    CHECK (gbl_result_merge (&total, &result));
+    CHECK (total.processed == 4);
+    CHECK (total.failedMfns.len == 2);
+
+    gbl_result_destroy (&total);
+    gbl_result_destroy (&result);
+    response_destroy (&response);
+    connection_destroy (&connection);
+}
+
+TESTER(gbl_job_run_1)
+{
+    Connection connection;
+    ConnectionPool pool;
+    GblSettings settings;
+    GblJob job;
+    am_int32 mfn;
+    int calls = 0;
+
+    CHECK (connection_create (&connection));
+    gbl_settings_init (&settings);
+    CHECK (gbl_add_statement (&settings, "DEL", "300", ""));
+    for (mfn = 1; mfn <= 10; ++mfn) {
+        CHECK (int32_array_push_back (&settings.mfnList, mfn));
+    }
+
+    /* Явный список MFN делится на порции без обращения к серверу */
+    CHECK (gbl_job_create (&job, &connection, &settings, 4));
+    CHECK (job.chunks.len == 3);
+    CHECK (((GblChunk*) array_get (&job.chunks, 2))->count == 2);
+    CHECK (((GblChunk*) array_get (&job.chunks, 2))->firstMfn == 9);
+    CHECK (gbl_job_remaining (&job) == 3);
+
+    /* На этом порту заведомо никто не слушает */
+    connection.port = 1;
+    CHECK (pool_create (&pool, &connection, 2));
+    job.progress = gbl_count_progress;
+    job.progressData = &calls;
+    CHECK (!gbl_job_run (&job, &pool, 2));
+    CHECK (calls == 3);
+    CHECK (job.failed == 3);
+    CHECK (gbl_job_remaining (&job) == 3);
+
+    pool_destroy (&pool);
+    gbl_job_destroy (&job);
+    gbl_settings_destroy (&settings);
+    connection_destroy (&connection);
+}
+
+TESTER(gbl_job_stop_1)
+{
+    Connection connection;
+    ConnectionPool pool;
+    GblSettings settings;
+    GblJob job;
+    am_int32 mfn;
+    int calls = 0;
+
+    CHECK (connection_create (&connection));
+    gbl_settings_init (&settings);
+    CHECK (gbl_add_statement (&settings, "DEL", "300", ""));
+    for (mfn = 1; mfn <= 10; ++mfn) {
+        CHECK (int32_array_push_back (&settings.mfnList, mfn));
+    }
+
+    CHECK (gbl_job_create (&job, &connection, &settings, 4));
+
+    /* Остановка из функции progress: прочие порции не выдаются */
+    connection.port = 1;
+    CHECK (pool_create (&pool, &connection, 1));
+    job.progress = gbl_stop_progress;
+    job.progressData = &calls;
+    CHECK (!gbl_job_run (&job, &pool, 1));
+    CHECK (calls == 1);
+    CHECK (job.stop);
+    CHECK (job.next == 1);
+
+    pool_destroy (&pool);
+    gbl_job_destroy (&job);
+    gbl_settings_destroy (&settings);
+    connection_destroy (&connection);
+}
@@ -0,0 +1,272 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+static GroupEndpoint* group_endpoint (ConnectionGroup *group, size_t index)
+{
+    return (GroupEndpoint*) vector_get (&group->endpoints, index);
+}
+
+TESTER(group_choose_1)
+{
+    Connection settings;
+    ConnectionGroup group;
+    GroupEndpoint *first, *second, *third;
+
+    CHECK (connection_create (&settings));
+    CHECK (group_create (&group));
+    CHECK (group_choose (&group, AM_FALSE) == NULL);
+
+    CHECK (group_add (&group, &settings, 1, AM_FALSE));
+    CHECK (group_add (&group, &settings, 1, AM_TRUE));
+    CHECK (group_add (&group, &settings, 1, AM_FALSE));
+    connection_destroy (&settings);
+
+    first = group_endpoint (&group, 0);
+    second = group_endpoint (&group, 1);
+    third = group_endpoint (&group, 2);
+
+    /* Запись -- только на основной сервер */
+    CHECK (group_choose (&group, AM_TRUE) == second);
+
+    /* Сначала пробуем серверы без замеров */
+    first->latency = 10.0;
+    second->latency = 5.0;
+    CHECK (group_choose (&group, AM_FALSE) == third);
+
+    /* Затем -- самый быстрый */
+    third->latency = 20.0;
+    CHECK (group_choose (&group, AM_FALSE) == second);
+
+    /* Сервер на карантине пропускается */
+    second->errors = group.errorLimit;
+    second->retryAfter = magna_ticks () + 60000;
+    CHECK (group_choose (&group, AM_FALSE) == first);
+    CHECK (group_choose (&group, AM_TRUE) == second);
+
+    /* Если больны все, берем того, кто раньше поправится */
+    first->errors = third->errors = group.errorLimit;
+    first->retryAfter = second->retryAfter + 1000;
+    third->retryAfter = second->retryAfter - 1000;
+    CHECK (group_choose (&group, AM_FALSE) == third);
+
+    /* По истечении карантина -- пробное обращение */
+    second->retryAfter = 0;
+    CHECK (group_choose (&group, AM_FALSE) == second);
+
+    group_destroy (&group);
+}
+
+TESTER(group_acquire_1)
+{
+    Connection settings;
+    ConnectionGroup group;
+
+    /* На этом порту заведомо никто не слушает */
+    CHECK (connection_create (&settings));
+    settings.port = 1;
+    CHECK (group_create (&group));
+    CHECK (group_add (&group, &settings, 1, AM_TRUE));
+    CHECK (group_add (&group, &settings, 1, AM_FALSE));
+    connection_destroy (&settings);
+
+    /* Пробуются оба сервера */
+    CHECK (group_acquire (&group, AM_FALSE) == NULL);
+    CHECK (group_endpoint (&group, 0)->failures == 1);
+    CHECK (group_endpoint (&group, 1)->failures == 1);
+
+    /* Запись не уходит на реплику */
+    CHECK (group_acquire (&group, AM_TRUE) == NULL);
+    CHECK (group_endpoint (&group, 0)->failures == 2);
+    CHECK (group_endpoint (&group, 1)->failures == 1);
+    CHECK (group.loans.len == 0);
+
+    group_destroy (&group);
+}
+
+/* Запрос на чтение записи, возможно, с блокировкой */
+static am_bool group_read_query
+    (
+        Query *query,
+        Connection *settings,
+        am_mfn mfn,
+        am_bool lock
+    )
+{
+    return query_create (query, settings, CBTEXT (READ_RECORD))
+        && query_add_ansi (query, CBTEXT ("IBIS"))
+        && query_add_uint32 (query, mfn)
+        && query_add_uint32 (query, lock ? 1 : 0);
+}
+
+/* Выполнение команды через группу с проверкой, куда она ушла */
+static am_bool group_route
+    (
+        ConnectionGroup *group,
+        Query *query,
+        MockServer *expected,
+        MockServer *other
+    )
+{
+    Response response;
+    am_int32 expectedBefore, otherBefore;
+    am_bool result;
+
+    expectedBefore = expected->requests;
+    otherBefore = other->requests;
+    result = group_execute (group, query, &response)
+        && response_get_return_code (&response) == 0
+        && expected->requests > expectedBefore
+        && other->requests == otherBefore;
+    response_destroy (&response);
+
+    return result;
+}
+
+TESTER(group_execute_1)
+{
+    MockServer primaryServer, replicaServer;
+    Connection primarySettings, replicaSettings;
+    ConnectionGroup group;
+    GroupEndpoint *primary, *replica;
+    Connection *connection;
+    MarcRecord record;
+    Response response;
+    Query query;
+
+    CHECK (mock_connect (&primaryServer, &primarySettings));
+    CHECK (mock_connect (&replicaServer, &replicaSettings));
+    CHECK (group_create (&group));
+    CHECK (group_add (&group, &primarySettings, 2, AM_TRUE));
+    CHECK (group_add (&group, &replicaSettings, 2, AM_FALSE));
+    primary = group_endpoint (&group, 0);
+    replica = group_endpoint (&group, 1);
+    primary->latency = 50.0;
+    replica->latency = 5.0;
+
+    /* Чтение -- на быстрый сервер, изменение -- на основной */
+    CHECK (group_read_query (&query, &primarySettings, 1, AM_FALSE));
+    CHECK (query_is_read_only (&query));
+    CHECK (group_route (&group, &query, &replicaServer, &primaryServer));
+    query_destroy (&query);
+
+    CHECK (group_read_query (&query, &primarySettings, 1, AM_TRUE));
+    CHECK (!query_is_read_only (&query));
+    CHECK (group_route (&group, &query, &primaryServer, &replicaServer));
+    query_destroy (&query);
+
+    CHECK (query_create (&query, &primarySettings, CBTEXT (UNLOCK_RECORDS)));
+    CHECK (query_add_ansi (&query, CBTEXT ("IBIS")));
+    CHECK (!query_is_read_only (&query));
+    CHECK (group_execute (&group, &query, &response));
+    CHECK (response.connection == NULL);
+    CHECK (response_get_return_code (&response) == -2222);
+    response_destroy (&response);
+    query_destroy (&query);
+
+    /* Ошибка, о которой сообщил сервер, -- не сбой */
+    CHECK (group_read_query (&query, &primarySettings, 99, AM_FALSE));
+    CHECK (group_execute (&group, &query, &response));
+    CHECK (response_get_return_code (&response) == -140);
+    response_destroy (&response);
+    CHECK (replica->errors == 0);
+    CHECK (replica->failures == 0);
+
+    /* Учитывается время выполнения команды */
+    replica->latency = -1.0;
+    replicaServer.latency = 100;
+    CHECK (group_execute (&group, &query, &response));
+    response_destroy (&response);
+    CHECK (replica->latency >= 90.0);
+    CHECK (replica->latency < 1000.0);
+    replicaServer.latency = 0;
+    query_destroy (&query);
+
+    /* ...но не время, пока подключение просто занято */
+    primary->latency = 50.0;
+    connection = group_acquire (&group, AM_FALSE);
+    CHECK (connection != NULL);
+    record_init (&record);
+    CHECK (!connection_read_record (connection, 99, &record));
+    CHECK (connection->lastError == -140);
+    record_destroy (&record);
+    magna_sleep (200);
+    group_release (&group, connection);
+    CHECK (primary->latency == 50.0);
+    CHECK (primary->errors == 0);
+    CHECK (primary->failures == 0);
+
+    /* Сбой связи портит здоровье сервера */
+    replica->latency = 5.0;
+    replicaServer.dropEvery = 1;
+    CHECK (group_read_query (&query, &primarySettings, 1, AM_FALSE));
+    CHECK (!group_execute (&group, &query, &response));
+    CHECK (response.returnCode == -100002);
+    response_destroy (&response);
+    query_destroy (&query);
+    CHECK (replica->errors == 1);
+    CHECK (replica->failures == 1);
+    replicaServer.dropEvery = 0;
+
+    group_destroy (&group);
+    mock_disconnect (&replicaServer, &replicaSettings);
+    mock_disconnect (&primaryServer, &primarySettings);
+}
+
+TESTER(group_execute_2)
+{
+    MockServer primaryServer, replicaServer;
+    Connection primarySettings, replicaSettings;
+    ConnectionGroup group;
+    Specification spec;
+    Buffer text = BUFFER_INIT;
+    Response response;
+    Query query;
+    am_int32 requests, replicaRequests;
+
+    CHECK (mock_connect (&primaryServer, &primarySettings));
+    CHECK (mock_connect (&replicaServer, &replicaSettings));
+    CHECK (group_create (&group));
+    CHECK (group_add (&group, &primarySettings, 1, AM_TRUE));
+    CHECK (group_add (&group, &replicaSettings, 1, AM_FALSE));
+    group_endpoint (&group, 0)->latency = 50.0;
+    group_endpoint (&group, 1)->latency = 5.0;
+
+    /* Сохранение текстового файла -- только на основной сервер */
+    CHECK (spec_create (&spec, PATH_MASTER, CBTEXT ("IBIS"), CBTEXT ("brief.pft")));
+    CHECK (buffer_assign_text (&spec.content, CBTEXT ("v200^a")));
+    CHECK (query_create (&query, &primarySettings, CBTEXT (READ_DOCUMENT)));
+    CHECK (query_add_specification (&query, &spec));
+    CHECK (!query_is_read_only (&query));
+    CHECK (group_route (&group, &query, &primaryServer, &replicaServer));
+    query_destroy (&query);
+
+    buffer_clear (&spec.content);
+    CHECK (connection_read_text_file (&primarySettings, &spec, &text));
+    CHECK (buffer_compare_text (&text, CBTEXT ("v200^a")) == 0);
+    buffer_clear (&text);
+    CHECK (!connection_read_text_file (&replicaSettings, &spec, &text));
+
+    /* Чтение того же файла -- на быстрый сервер */
+    group_endpoint (&group, 0)->latency = 50.0;
+    CHECK (query_create (&query, &primarySettings, CBTEXT (READ_DOCUMENT)));
+    CHECK (query_add_specification (&query, &spec));
+    CHECK (query_is_read_only (&query));
+    requests = primaryServer.requests;
+    replicaRequests = replicaServer.requests;
+    CHECK (group_execute (&group, &query, &response));
+    CHECK (primaryServer.requests == requests);
+    CHECK (replicaServer.requests > replicaRequests);
+    response_destroy (&response);
+    query_destroy (&query);
+
+    spec_destroy (&spec);
+    buffer_destroy (&text);
+    group_destroy (&group);
+    mock_disconnect (&replicaServer, &replicaSettings);
+    mock_disconnect (&primaryServer, &primarySettings);
+}
@@ -0,0 +1,244 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+#include "gateway.h"
+
+/* Запрос к шлюзу из отдельного потока */
+typedef struct
+{
+    am_uint16 port;   /* Порт шлюза. */
+    const char *path; /* Путь с параметрами. */
+    Buffer answer;    /* Полученный ответ целиком. */
+
+} GatewayProbe;
+
+/* Отсылка GET-запроса шлюзу и прием ответа целиком. */
+static am_bool gateway_get
+    (
+        am_uint16 port,
+        const char *path,
+        Buffer *answer
+    )
+{
+    am_int32 handle;
+    Span spans[3];
+    am_bool result;
+
+    handle = tcp4_connect (CBTEXT ("127.0.0.1"), port);
+    if (handle < 0) {
+        return AM_FALSE;
+    }
+
+    spans[0] = TEXT_SPAN ("GET ");
+    spans[1] = TEXT_SPAN (path);
+    spans[2] = TEXT_SPAN (" HTTP/1.0\r\n\r\n");
+    buffer_clear (answer);
+    result = tcp4_send_spans (handle, spans, 3)
+        && tcp4_receive_all (handle, answer) > 0;
+    tcp4_disconnect (handle);
+
+    return result;
+}
+
+static void MAGNA_CALL gateway_probe_run
+    (
+        void *data
+    )
+{
+    GatewayProbe *probe = (GatewayProbe*) data;
+
+    gateway_get (probe->port, probe->path, &probe->answer);
+}
+
+static void MAGNA_CALL gateway_thread
+    (
+        void *data
+    )
+{
+    gateway_run ((Gateway*) data, 4);
+}
+
+TESTER(http_url_decode_1)
+{
+    Buffer output = BUFFER_INIT;
+
+    CHECK (http_url_decode (&output, TEXT_SPAN ("K%3DALG%24+x")));
+    CHECK (buffer_compare_text (&output, CBTEXT ("K=ALG$ x")) == 0);
+
+    /* Неправильные последовательности остаются как есть */
+    buffer_clear (&output);
+    CHECK (http_url_decode (&output, TEXT_SPAN ("%zz%4")));
+    CHECK (buffer_compare_text (&output, CBTEXT ("%zz%4")) == 0);
+
+    buffer_clear (&output);
+    CHECK (http_url_decode (&output, TEXT_SPAN ("%d0%90")));
+    CHECK (buffer_length (&output) == 2);
+    CHECK (output.start[0] == 0xD0);
+    CHECK (output.start[1] == 0x90);
+
+    buffer_destroy (&output);
+}
+
+TESTER(http_get_parameter_1)
+{
+    HttpRequest request;
+    Buffer value = BUFFER_INIT;
+
+    http_request_init (&request);
+    request.query = TEXT_SPAN ("q=K%3DALG%24&limit=5&flag&db=");
+
+    CHECK (http_get_parameter (&request, "q", &value));
+    CHECK (buffer_compare_text (&value, CBTEXT ("K=ALG$")) == 0);
+    CHECK (http_get_parameter (&request, "limit", &value));
+    CHECK (buffer_compare_text (&value, CBTEXT ("5")) == 0);
+    CHECK (http_get_parameter (&request, "db", &value));
+    CHECK (buffer_is_empty (&value));
+    CHECK (!http_get_parameter (&request, "flag", &value));
+    CHECK (!http_get_parameter (&request, "lim", &value));
+    CHECK (buffer_is_empty (&value));
+
+    buffer_destroy (&value);
+    http_request_destroy (&request);
+}
+
+TESTER(json_put_string_1)
+{
+    Buffer output = BUFFER_INIT;
+
+    CHECK (json_put_string (&output, TEXT_SPAN ("a\"b\\c\r\n\t\x01\xD0\x90")));
+    CHECK (buffer_compare_text (&output, CBTEXT ("\"a\\\"b\\\\c\\r\\n\\t\\u0001\xD0\x90\"")) == 0);
+
+    buffer_clear (&output);
+    CHECK (json_put_string (&output, TEXT_SPAN ("")));
+    CHECK (buffer_compare_text (&output, CBTEXT ("\"\"")) == 0);
+
+    buffer_destroy (&output);
+}
+
+TESTER(gateway_route_1)
+{
+    const GatewayRoute *route;
+
+    route = gateway_route (TEXT_SPAN ("/record"));
+    CHECK (route != NULL);
+    CHECK (route->flags == ROUTE_CACHEABLE);
+
+    route = gateway_route (TEXT_SPAN ("/stats"));
+    CHECK (route != NULL);
+    CHECK (route->flags == ROUTE_LOCAL);
+
+    route = gateway_route (TEXT_SPAN ("/search"));
+    CHECK (route != NULL);
+    CHECK (route->flags == 0);
+
+    CHECK (gateway_route (TEXT_SPAN ("/rec")) == NULL);
+    CHECK (gateway_route (TEXT_SPAN ("/record/")) == NULL);
+}
+
+TESTER(http_request_read_1)
+{
+    Tcp4Address address;
+    HttpRequest request;
+    am_int32 listener, client, server;
+
+    CHECK (tcp4_resolve (CBTEXT ("127.0.0.1"), 0, &address));
+    listener = tcp4_listen (&address, 4);
+    CHECK (listener >= 0);
+
+    /* Полный заголовок */
+    client = tcp4_connect (CBTEXT ("127.0.0.1"), tcp4_local_port (listener));
+    CHECK (client >= 0);
+    server = tcp4_accept (listener);
+    CHECK (server >= 0);
+    CHECK (tcp4_send (client, CBTEXT ("GET /record?mfn=1 HTTP/1.0\r\n\r\n"), 30) == 30);
+    http_request_init (&request);
+    CHECK (http_request_read (&request, server, 1000));
+    CHECK (span_compare (request.method, TEXT_SPAN ("GET")) == 0);
+    CHECK (span_compare (request.path, TEXT_SPAN ("/record")) == 0);
+    CHECK (span_compare (request.query, TEXT_SPAN ("mfn=1")) == 0);
+    CHECK (!request.expired);
+    http_request_destroy (&request);
+    tcp4_disconnect (server);
+    tcp4_disconnect (client);
+
+    /* Клиент не дописал заголовок */
+    client = tcp4_connect (CBTEXT ("127.0.0.1"), tcp4_local_port (listener));
+    CHECK (client >= 0);
+    server = tcp4_accept (listener);
+    CHECK (server >= 0);
+    CHECK (tcp4_send (client, CBTEXT ("GET /rec"), 8) == 8);
+    http_request_init (&request);
+    CHECK (!http_request_read (&request, server, 100));
+    CHECK (request.expired);
+    http_request_destroy (&request);
+    tcp4_disconnect (server);
+    tcp4_disconnect (client);
+
+    tcp4_disconnect (listener);
+}
+
+TESTER(gateway_fetch_1)
+{
+    MockServer server;
+    Connection settings;
+    Gateway gateway;
+    GatewayProbe probes[3];
+    Buffer answer = BUFFER_INIT;
+    am_handle thread, threads[3];
+    am_uint16 port;
+    size_t index;
+
+    CHECK (mock_connect (&server, &settings));
+    CHECK (gateway_create (&gateway, &settings, 2, 1024ul * 1024ul, 60000u));
+    CHECK (gateway_listen (&gateway, CBTEXT (GATEWAY_BIND), 0));
+    CHECK (gateway.address.address != 0);
+    port = tcp4_local_port (gateway.listener);
+    thread = thread_start (gateway_thread, &gateway);
+    CHECK (handle_is_good (thread));
+
+    /* Повторное чтение записи обслуживается кэшем */
+    CHECK (gateway_get (port, "/record?mfn=1", &answer));
+    CHECK (buffer_find_text (&answer, CBTEXT ("HTTP/1.0 200 OK")) == answer.start);
+    CHECK (buffer_find_text (&answer, CBTEXT ("Algebra for beginners")) != NULL);
+    CHECK (gateway_get (port, "/record?mfn=1", &answer));
+    CHECK (buffer_find_text (&answer, CBTEXT ("Algebra for beginners")) != NULL);
+    CHECK (gateway_get (port, "/stats", &answer));
+    CHECK (buffer_find_text (&answer, CBTEXT ("\"hits\":1,\"misses\":1,")) != NULL);
+
+    CHECK (gateway_get (port, "/record", &answer));
+    CHECK (buffer_find_text (&answer, CBTEXT ("HTTP/1.0 400 ")) == answer.start);
+    CHECK (gateway_get (port, "/unknown", &answer));
+    CHECK (buffer_find_text (&answer, CBTEXT ("HTTP/1.0 404 ")) == answer.start);
+
+    /* Одновременные одинаковые запросы уходят на сервер один раз */
+    server.latency = 300;
+    server.requests = 0;
+    for (index = 0; index < 3; ++index) {
+        probes[index].port = port;
+        probes[index].path = "/search?q=K%3DALGEBRA";
+        buffer_init (&probes[index].answer);
+        threads[index] = thread_start (gateway_probe_run, &probes[index]);
+        CHECK (handle_is_good (threads[index]));
+    }
+
+    for (index = 0; index < 3; ++index) {
+        thread_wait (threads[index]);
+        CHECK (buffer_find_text (&probes[index].answer, CBTEXT ("\"count\":2,")) != NULL);
+        buffer_destroy (&probes[index].answer);
+    }
+
+    CHECK (server.requests == 1);
+    server.latency = 0;
+    CHECK (gateway_get (port, "/stats", &answer));
+    CHECK (buffer_find_text (&answer, CBTEXT ("\"coalesced\":2,")) != NULL);
+
+    gateway_stop (&gateway);
+    thread_wait (thread);
+    gateway_destroy (&gateway);
+    buffer_destroy (&answer);
+    mock_disconnect (&server, &settings);
+}
@@ -0,0 +1,127 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+TESTER(limiter_release_1)
+{
+    ConcurrencyLimiter limiter;
+    am_uint64 started;
+    int i;
+
+    CHECK (limiter_create (&limiter, 2, 1, 3));
+    CHECK (limiter_get_limit (&limiter) == 2);
+
+    /* Быстрые успешные команды при полной загрузке поднимают предел */
+    for (i = 0; i < 10; ++i) {
+        started = limiter_acquire (&limiter);
+        (void) limiter_acquire (&limiter);
+        limiter_release (&limiter, started, AM_TRUE);
+        limiter_release (&limiter, started, AM_TRUE);
+    }
+
+    CHECK (limiter_get_limit (&limiter) == 3);
+    CHECK (limiter.increases != 0);
+    CHECK (limiter.inFlight == 0);
+
+    /* Сетевая ошибка снижает предел, но не ниже минимума */
+    started = limiter_acquire (&limiter);
+    limiter_release (&limiter, started, AM_FALSE);
+    CHECK (limiter_get_limit (&limiter) == 2);
+    CHECK (limiter.decreases == 1);
+
+    /* Повторная ошибка в том же окне не учитывается */
+    limiter_overload (&limiter);
+    CHECK (limiter.decreases == 1);
+
+    limiter.quietUntil = 0;
+    limiter_overload (&limiter);
+    limiter.quietUntil = 0;
+    limiter_overload (&limiter);
+    CHECK (limiter_get_limit (&limiter) == 1);
+
+    limiter_destroy (&limiter);
+}
+
+TESTER(limiter_observe_stat_1)
+{
+    ConcurrencyLimiter limiter;
+    ServerStat stat;
+
+    CHECK (limiter_create (&limiter, 8, 1, 16));
+    server_stat_init (&stat);
+    stat.clientCount = 100;
+
+    /* По умолчанию статистика сервера не учитывается */
+    limiter_observe_stat (&limiter, &stat);
+    CHECK (limiter.decreases == 0);
+
+    limiter.clientLimit = 50;
+    limiter_observe_stat (&limiter, &stat);
+    CHECK (limiter.decreases == 1);
+    CHECK (limiter_get_limit (&limiter) == 5);
+
+    limiter_destroy (&limiter);
+}
+
+TESTER(irbis_is_overload_1)
+{
+    CHECK (irbis_is_overload (-6666));
+    CHECK (irbis_is_overload (-100002));
+    CHECK (irbis_is_overload (-100004));
+    CHECK (!irbis_is_overload (0));
+    CHECK (!irbis_is_overload (-140));
+    CHECK (!irbis_is_overload (-3333));
+}
+
+TESTER(limiter_acquire_for_1)
+{
+    ConcurrencyLimiter limiter;
+    am_uint64 started, other, before;
+
+    CHECK (limiter_create (&limiter, 1, 1, 1));
+    CHECK (limiter_acquire_for (&limiter, 0, &started));
+
+    /* Места нет: отказ сразу либо по истечении времени */
+    CHECK (!limiter_acquire_for (&limiter, 0, &other));
+    before = magna_ticks ();
+    CHECK (!limiter_acquire_for (&limiter, 30, &other));
+    CHECK (magna_ticks () - before >= 25);
+    CHECK (limiter.inFlight == 1);
+
+    limiter_release (&limiter, started, AM_TRUE);
+    CHECK (limiter_acquire_for (&limiter, 0, &other));
+    limiter_release (&limiter, other, AM_TRUE);
+
+    limiter_destroy (&limiter);
+}
+
+TESTER(limiter_connection_timeout_1)
+{
+    ConcurrencyLimiter limiter;
+    Connection connection;
+    ServerStat stat;
+    am_uint64 started;
+
+    CHECK (connection_create (&connection));
+
+    /* Неактивное подключение: ответ не должен остаться мусором */
+    CHECK (!connection_get_server_stat (&connection, &stat));
+
+    /* Все места заняты: команда не ждет дольше своего срока */
+    CHECK (limiter_create (&limiter, 1, 1, 1));
+    started = limiter_acquire (&limiter);
+    connection.limiter = &limiter;
+    connection.timeout = 20;
+    connection.connected = AM_TRUE;
+    CHECK (!connection_no_operation (&connection));
+    CHECK (connection.lastError == -100004);
+    CHECK (limiter.inFlight == 1);
+
+    limiter_release (&limiter, started, AM_TRUE);
+    connection.connected = AM_FALSE;
+    connection.limiter = NULL;
+    connection_destroy (&connection);
+    limiter_destroy (&limiter);
+}
@@ -0,0 +1,75 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+static int lru_freed;
+
+static void MAGNA_CALL lru_test_liberator
+    (
+        void *value
+    )
+{
+    (void) value;
+    ++lru_freed;
+}
+
+TESTER(lru_put_1)
+{
+    LruCache cache;
+    static int one = 1, two = 2, three = 3;
+
+    lru_freed = 0;
+    CHECK (lru_create (&cache, 2, 3, lru_test_liberator));
+
+    CHECK (lru_put (&cache, TEXT_SPAN ("one"), &one, 1));
+    CHECK (lru_put (&cache, TEXT_SPAN ("two"), &two, 1));
+    CHECK (lru_get (&cache, TEXT_SPAN ("one")) == &one);
+
+    /* "two" дольше не использовался и будет вытеснен */
+    CHECK (lru_put (&cache, TEXT_SPAN ("three"), &three, 1));
+    CHECK (cache.count == 2);
+    CHECK (cache.evictions == 1);
+    CHECK (lru_freed == 1);
+    CHECK (lru_get (&cache, TEXT_SPAN ("two")) == NULL);
+    CHECK (lru_get (&cache, TEXT_SPAN ("one")) == &one);
+    CHECK (lru_get (&cache, TEXT_SPAN ("three")) == &three);
+    CHECK (cache.hits == 3);
+    CHECK (cache.misses == 1);
+
+    /* Подглядывание не учитывается и не освежает элемент */
+    CHECK (cache.oldest->value == &one);
+    CHECK (lru_peek (&cache, TEXT_SPAN ("one")) == &one);
+    CHECK (lru_peek (&cache, TEXT_SPAN ("two")) == NULL);
+    CHECK (cache.oldest->value == &one);
+    CHECK (cache.hits == 3);
+    CHECK (cache.misses == 1);
+
+    CHECK (lru_remove (&cache, TEXT_SPAN ("one")));
+    CHECK (!lru_remove (&cache, TEXT_SPAN ("one")));
+    CHECK (cache.size == 1);
+
+    lru_destroy (&cache);
+    CHECK (lru_freed == 3);
+}
+
+TESTER(lru_put_2)
+{
+    LruCache cache;
+    static int value = 1;
+
+    CHECK (lru_create (&cache, 100, 0, NULL));
+    cache.ttl = 1;
+
+    CHECK (lru_put (&cache, TEXT_SPAN ("key"), &value, 1));
+    magna_sleep (20);
+    CHECK (lru_get (&cache, TEXT_SPAN ("key")) == NULL);
+    CHECK (cache.count == 0);
+
+    /* Элемент больше всего кэша не сохраняется */
+    CHECK (!lru_put (&cache, TEXT_SPAN ("big"), &value, 101));
+    CHECK (cache.count == 0);
+
+    lru_destroy (&cache);
+}
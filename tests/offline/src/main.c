@@ -9,6 +9,10 @@
 
 #include <assert.h>
 
+#ifdef MAGNA_UNIX
+#include <signal.h>
+#endif
+
 #define STR(x)   #x
 #define SHOW_DEFINE(x) printf ("%s=%s\n", #x, STR(x))
 
@@ -95,6 +99,13 @@ int main (int argc, const char **argv)
     Buffer tdp = BUFFER_INIT;
     Buffer td = BUFFER_INIT;
 
+#ifdef MAGNA_UNIX
+
+    /* Имитация сервера пишет и в сокеты, брошенные клиентом */
+    signal (SIGPIPE, SIG_IGN);
+
+#endif
+
 #ifdef HAVE_CONFIG_H
     SHOW_DEFINE (CMAKE_C_COMPILER_ID);
     SHOW_DEFINE (CMAKE_SYSTEM_NAME);
@@ -0,0 +1,342 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+static void mock_fill (MockServer *server)
+{
+    MarcRecord record;
+
+    record_init (&record);
+    record_add (&record, 200, CBTEXT ("^aAlgebra for beginners"));
+    mock_server_add_record (server, &record);
+    record_clear (&record);
+    record_add (&record, 200, CBTEXT ("^aLinear algebra"));
+    mock_server_add_record (server, &record);
+    record_destroy (&record);
+}
+
+am_bool mock_connect
+    (
+        MockServer *server,
+        Connection *connection
+    )
+{
+    if (!mock_server_create (server)) {
+        return AM_FALSE;
+    }
+
+    mock_fill (server);
+    if (!mock_server_start (server, 0, MOCK_WORKERS)) {
+        mock_server_destroy (server);
+        return AM_FALSE;
+    }
+
+    if (!connection_create (connection)
+        || !connection_set_host (connection, CBTEXT ("127.0.0.1"))
+        || !connection_set_username (connection, CBTEXT ("librarian"))
+        || !connection_set_password (connection, CBTEXT ("secret"))) {
+        connection_destroy (connection);
+        mock_server_destroy (server);
+        return AM_FALSE;
+    }
+
+    connection->port = mock_server_port (server);
+    if (!connection_connect (connection)) {
+        connection_destroy (connection);
+        mock_server_destroy (server);
+        return AM_FALSE;
+    }
+
+    return AM_TRUE;
+}
+
+void mock_disconnect
+    (
+        MockServer *server,
+        Connection *connection
+    )
+{
+    server->errorEvery = 0;
+    server->dropEvery = 0;
+    server->termLimit = 0;
+    server->latency = 0;
+    server->bandwidth = 0;
+    connection_disconnect (connection);
+    connection_destroy (connection);
+    mock_server_destroy (server);
+}
+
+TESTER(mock_server_answer_1)
+{
+    MockServer server;
+    Buffer answer = BUFFER_INIT;
+
+    CHECK (mock_server_create (&server));
+    mock_fill (&server);
+    CHECK (server.records.len == 2);
+
+    /* Следующий MFN */
+    CHECK (mock_server_answer
+        (
+            &server,
+            TEXT_SPAN ("O\nC\nO\n123\n1\nsecret\nlibrarian\n\n\n\nIBIS\n"),
+            &answer
+        ));
+    CHECK (span_starts_with (buffer_to_span (&answer), TEXT_SPAN ("O\r\n123\r\n1\r\n")));
+    CHECK (span_ends_with (buffer_to_span (&answer), TEXT_SPAN ("\r\n3\r\n")));
+
+    /* Неизвестная команда */
+    buffer_clear (&answer);
+    CHECK (mock_server_answer
+        (
+            &server,
+            TEXT_SPAN ("?\nC\n?\n123\n2\nsecret\nlibrarian\n\n\n\n"),
+            &answer
+        ));
+    CHECK (span_ends_with (buffer_to_span (&answer), TEXT_SPAN ("\r\n-2222\r\n")));
+
+    buffer_destroy (&answer);
+    mock_server_destroy (&server);
+}
+
+TESTER(mock_server_start_1)
+{
+    MockServer server;
+    Connection connection;
+    MarcRecord record;
+    const MarcField *field;
+
+    CHECK (mock_server_create (&server));
+    mock_fill (&server);
+    CHECK (mock_server_start (&server, 0, 2));
+    CHECK (mock_server_port (&server) != 0);
+
+    CHECK (connection_create (&connection));
+    CHECK (connection_set_host (&connection, CBTEXT ("127.0.0.1")));
+    CHECK (connection_set_username (&connection, CBTEXT ("librarian")));
+    CHECK (connection_set_password (&connection, CBTEXT ("secret")));
+    connection.port = mock_server_port (&server);
+    CHECK (connection_connect (&connection));
+    CHECK (connection_get_max_mfn (&connection, NULL) == 3);
+    CHECK (connection_search_count (&connection, CBTEXT ("K=ALGEBRA")) == 2);
+    CHECK (connection_search_count (&connection, CBTEXT ("K=LIN$")) == 1);
+
+    record_init (&record);
+    CHECK (connection_read_record (&connection, 2, &record));
+    CHECK (record.mfn == 2);
+    field = record_get_field (&record, 200, 0);
+    CHECK (field != NULL);
+    CHECK (span_compare (field_get_first_subfield_value (field, 'a'), TEXT_SPAN ("Linear algebra")) == 0);
+
+    /* Новая запись попадает в словарь */
+    record_clear (&record);
+    record.mfn = 0;
+    record_add (&record, 200, CBTEXT ("^aAbstract algebra"));
+    CHECK (connection_write_record (&connection, &record, AM_TRUE) > 0);
+    CHECK (record.mfn == 3);
+    CHECK (connection_search_count (&connection, CBTEXT ("K=ALGEBRA")) == 3);
+
+    /* Каждый второй запрос завершается ошибкой */
+    server.errorEvery = 2;
+    server.requests = 0;
+    CHECK (connection_no_operation (&connection));
+    CHECK (!connection_no_operation (&connection));
+    CHECK (connection.lastError == server.errorCode);
+    server.errorEvery = 0;
+
+    CHECK (connection_disconnect (&connection));
+    record_destroy (&record);
+    connection_destroy (&connection);
+    mock_server_stop (&server);
+    mock_server_destroy (&server);
+}
+
+TESTER(mock_server_commands_1)
+{
+    MockServer server;
+    Connection connection;
+    TermParameters termParameters;
+    PostingParameters postingParameters;
+    Specification spec;
+    Array terms, postings, records;
+    Int32Array mfns = INT32_ARRAY_INIT;
+    Buffer text = BUFFER_INIT;
+    const Term *term;
+    const Posting *posting;
+    const MarcField *field;
+    size_t index;
+
+    CHECK (mock_connect (&server, &connection));
+
+    /* H: термины по порядку, с количеством постингов */
+    term_array_init (&terms);
+    CHECK (term_parameters_create (&termParameters, CBTEXT ("K=ALGEBRA")));
+    termParameters.number = 2;
+    CHECK (connection_read_terms (&connection, &termParameters, &terms));
+    CHECK (terms.len == 2);
+    term = (const Term*) array_get (&terms, 0);
+    CHECK (buffer_compare_text (&term->text, CBTEXT ("K=ALGEBRA")) == 0);
+    CHECK (term->count == 2);
+    term = (const Term*) array_get (&terms, 1);
+    CHECK (buffer_compare_text (&term->text, CBTEXT ("K=BEGINNERS")) == 0);
+    CHECK (term->count == 1);
+    term_parameters_destroy (&termParameters);
+    term_array_destroy (&terms);
+
+    /* I: постинги термина */
+    posting_array_init (&postings);
+    CHECK (posting_parameters_create (&postingParameters, CBTEXT ("K=ALGEBRA")));
+    CHECK (connection_read_postings (&connection, &postingParameters, &postings));
+    CHECK (postings.len == 2);
+    posting = (const Posting*) array_get (&postings, 0);
+    CHECK (posting->mfn == 1);
+    CHECK (posting->tag == 200);
+    CHECK (posting->count == 1);
+    posting = (const Posting*) array_get (&postings, 1);
+    CHECK (posting->mfn == 2);
+    CHECK (posting->count == 2);
+    posting_parameters_destroy (&postingParameters);
+    posting_array_destroy (&postings);
+
+    /* G: краткое описание одной записи */
+    CHECK (connection_format_mfn (&connection, CBTEXT ("@brief"), 2, &text));
+    CHECK (span_compare (span_trim (buffer_to_span (&text)), TEXT_SPAN ("Linear algebra")) == 0);
+    CHECK (!connection_format_mfn (&connection, CBTEXT ("@brief"), 99, &text));
+    CHECK (connection.lastError == -140);
+
+    /* G: записи целиком в формате ALL */
+    array_init (&records, sizeof (MarcRecord));
+    CHECK (int32_array_push_back (&mfns, 2));
+    CHECK (int32_array_push_back (&mfns, 1));
+    CHECK (connection_read_records (&connection, &mfns, &records));
+    CHECK (records.len == 2);
+    field = record_get_field ((const MarcRecord*) array_get (&records, 0), 200, 0);
+    CHECK (((const MarcRecord*) array_get (&records, 0))->mfn == 2);
+    CHECK (field != NULL);
+    CHECK (span_compare (field_get_first_subfield_value (field, 'a'), TEXT_SPAN ("Linear algebra")) == 0);
+    CHECK (((const MarcRecord*) array_get (&records, 1))->mfn == 1);
+    for (index = 0; index < records.len; ++index) {
+        record_destroy ((MarcRecord*) array_get (&records, index));
+    }
+
+    array_destroy (&records, NULL);
+    int32_array_destroy (&mfns);
+
+    /* L: текстовый файл; отсутствующий файл не читается */
+    CHECK (mock_server_add_file (&server, CBTEXT ("brief.pft"), TEXT_SPAN ("v200^a")));
+    CHECK (spec_create (&spec, PATH_MASTER, CBTEXT ("IBIS"), CBTEXT ("BRIEF.PFT")));
+    buffer_clear (&text);
+    CHECK (connection_read_text_file (&connection, &spec, &text));
+    CHECK (buffer_compare_text (&text, CBTEXT ("v200^a")) == 0);
+    spec_destroy (&spec);
+    CHECK (spec_create (&spec, PATH_MASTER, CBTEXT ("IBIS"), CBTEXT ("absent.pft")));
+    buffer_clear (&text);
+    CHECK (!connection_read_text_file (&connection, &spec, &text));
+    CHECK (buffer_is_empty (&text));
+    spec_destroy (&spec);
+
+    buffer_destroy (&text);
+    mock_disconnect (&server, &connection);
+}
+
+TESTER(mock_server_faults_1)
+{
+    MockServer server;
+    Connection connection;
+    Specification spec;
+    Buffer content = BUFFER_INIT, text = BUFFER_INIT;
+    am_uint64 started, elapsed;
+    size_t index;
+
+    CHECK (mock_connect (&server, &connection));
+
+    /* Задержка перед каждым ответом */
+    server.latency = 200;
+    started = magna_ticks ();
+    CHECK (connection_no_operation (&connection));
+    elapsed = magna_ticks () - started;
+    CHECK (elapsed >= 190);
+    server.latency = 0;
+
+    /* Ограничение скорости: 20000 байт при 100000 байт/с */
+    for (index = 0; index < 20000; ++index) {
+        CHECK (buffer_putc (&content, (am_byte) ('a' + index % 26)));
+    }
+
+    CHECK (mock_server_add_file (&server, CBTEXT ("big.txt"), buffer_to_span (&content)));
+    CHECK (spec_create (&spec, PATH_MASTER, CBTEXT ("IBIS"), CBTEXT ("big.txt")));
+    server.bandwidth = 100000;
+    started = magna_ticks ();
+    CHECK (connection_read_text_file (&connection, &spec, &text));
+    elapsed = magna_ticks () - started;
+    CHECK (buffer_compare (&text, &content) == 0);
+    CHECK (elapsed >= 150);
+    server.bandwidth = 0;
+    spec_destroy (&spec);
+
+    /* Каждый второй запрос остается без ответа */
+    server.dropEvery = 2;
+    server.requests = 0;
+    CHECK (connection_no_operation (&connection));
+    CHECK (!connection_no_operation (&connection));
+    CHECK (connection.lastError == -100002);
+    CHECK (connection_no_operation (&connection));
+    CHECK (server.requests == 3);
+    server.dropEvery = 0;
+
+    buffer_destroy (&text);
+    buffer_destroy (&content);
+    mock_disconnect (&server, &connection);
+}
+
+TESTER(connection_write_records_1)
+{
+    MockServer server;
+    Connection connection;
+    Array records;
+    MarcRecord *record;
+    am_mfn mfns[3] = { 0, 2, 99 };
+    size_t index;
+
+    CHECK (mock_connect (&server, &connection));
+
+    /* Новая запись, существующая и отсутствующая на сервере */
+    array_init (&records, sizeof (MarcRecord));
+    for (index = 0; index < 3; ++index) {
+        record = (MarcRecord*) array_emplace_back (&records);
+        CHECK (record != NULL);
+        record_init (record);
+        record->mfn = mfns[index];
+        CHECK (record_add (record, 200, CBTEXT ("^aAbstract algebra")) != NULL);
+    }
+
+    CHECK (!connection_write_records (&connection, &records));
+    CHECK (connection.lastError == -140);
+    record = (MarcRecord*) array_get (&records, 0);
+    CHECK (record->mfn == 3);
+    CHECK (record->version == 1);
+    record = (MarcRecord*) array_get (&records, 1);
+    CHECK (record->mfn == 2);
+    CHECK (record->version == 2);
+    record = (MarcRecord*) array_get (&records, 2);
+    CHECK (record->mfn == 99);
+    CHECK (record->version == 0);
+    CHECK (connection_get_max_mfn (&connection, NULL) == 4);
+
+    /* Без отвергнутой записи пакет сохраняется целиком */
+    record_destroy ((MarcRecord*) array_pop_back (&records));
+    CHECK (connection_write_records (&connection, &records));
+    CHECK (((MarcRecord*) array_get (&records, 0))->version == 2);
+    CHECK (((MarcRecord*) array_get (&records, 1))->version == 3);
+
+    for (index = 0; index < records.len; ++index) {
+        record_destroy ((MarcRecord*) array_get (&records, index));
+    }
+
+    array_destroy (&records, NULL);
+    mock_disconnect (&server, &connection);
+}
@@ -0,0 +1,211 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+#define POOL_THREADS 4
+#define POOL_ROUNDS  8
+
+/* Общие данные потоков, параллельно работающих через пул */
+typedef struct
+{
+    ConnectionPool *pool;
+    Mutex mutex;
+    am_int32 clients [POOL_THREADS * POOL_ROUNDS];
+    am_int32 queries [POOL_THREADS * POOL_ROUNDS];
+    size_t count;
+    size_t failures;
+
+} PoolProbe;
+
+static am_bool MAGNA_CALL pool_dummy_action (Connection *connection, void *data)
+{
+    (void) connection;
+    *(int*) data = 1;
+
+    return AM_TRUE;
+}
+
+/* Пустая команда с запоминанием идентификаторов клиента и запроса */
+static am_bool MAGNA_CALL pool_nop_action (Connection *connection, void *data)
+{
+    PoolProbe *probe = (PoolProbe*) data;
+    Query query;
+    Response response;
+    am_int32 queryId;
+    am_bool result;
+
+    if (!query_create (&query, connection, CBTEXT (NOP))) {
+        return AM_FALSE;
+    }
+
+    queryId = span_to_int32 (query_get_line (&query, 4));
+    result = connection_execute (connection, &query, &response)
+        && response_check (&response, 0);
+    response_destroy (&response);
+    query_destroy (&query);
+
+    mutex_lock (&probe->mutex);
+    probe->clients [probe->count] = connection->clientId;
+    probe->queries [probe->count] = queryId;
+    ++probe->count;
+    mutex_unlock (&probe->mutex);
+
+    return result;
+}
+
+static void MAGNA_CALL pool_probe_thread
+    (
+        void *data
+    )
+{
+    PoolProbe *probe = (PoolProbe*) data;
+    int round;
+
+    for (round = 0; round < POOL_ROUNDS; ++round) {
+        if (!pool_run (probe->pool, pool_nop_action, probe)) {
+            mutex_lock (&probe->mutex);
+            ++probe->failures;
+            mutex_unlock (&probe->mutex);
+        }
+    }
+}
+
+TESTER(connection_copy_settings_1)
+{
+    Connection source, target;
+
+    CHECK (connection_create (&source));
+    CHECK (connection_set_host (&source, CBTEXT ("irbis.local")));
+    CHECK (connection_set_username (&source, CBTEXT ("librarian")));
+    CHECK (connection_set_password (&source, CBTEXT ("secret")));
+    source.port = 6667;
+    source.workstation = READER;
+
+    CHECK (connection_create (&target));
+    CHECK (connection_copy_settings (&target, &source));
+    CHECK (buffer_compare_text (&target.host, CBTEXT ("irbis.local")) == 0);
+    CHECK (buffer_compare_text (&target.username, CBTEXT ("librarian")) == 0);
+    CHECK (buffer_compare_text (&target.password, CBTEXT ("secret")) == 0);
+    CHECK (buffer_compare_text (&target.database, CBTEXT ("IBIS")) == 0);
+    CHECK (target.port == 6667);
+    CHECK (target.workstation == READER);
+    CHECK (!target.connected);
+
+    connection_destroy (&target);
+    connection_destroy (&source);
+}
+
+TESTER(pool_create_1)
+{
+    Connection settings;
+    ConnectionPool pool;
+
+    CHECK (connection_create (&settings));
+    CHECK (pool_create (&pool, &settings, 3));
+    connection_destroy (&settings);
+
+    CHECK (pool.capacity == 3);
+    CHECK (pool.created == 0);
+    CHECK (pool_try_acquire (&pool) == NULL);
+
+    pool_destroy (&pool);
+}
+
+TESTER(pool_acquire_1)
+{
+    Connection settings;
+    ConnectionPool pool;
+    int flag = 0;
+
+    /* На этом порту заведомо никто не слушает */
+    CHECK (connection_create (&settings));
+    settings.port = 1;
+    CHECK (pool_create (&pool, &settings, 2));
+    connection_destroy (&settings);
+
+    CHECK (pool_acquire (&pool) == NULL);
+    CHECK (pool.created == 0);
+    CHECK (!pool_run (&pool, pool_dummy_action, &flag));
+    CHECK (flag == 0);
+
+    pool_close (&pool);
+    CHECK (pool_acquire (&pool) == NULL);
+
+    pool_destroy (&pool);
+}
+
+TESTER(pool_acquire_2)
+{
+    MockServer server;
+    Connection settings;
+    ConnectionPool pool;
+    PoolProbe probe;
+    Connection *first, *second, *again;
+    am_handle threads [POOL_THREADS];
+    am_int32 requests;
+    am_bool distinct = AM_TRUE;
+    size_t index, other;
+
+    CHECK (mock_connect (&server, &settings));
+    CHECK (pool_create (&pool, &settings, 2));
+
+    /* Каждое подключение регистрируется один раз */
+    requests = server.requests;
+    first = pool_acquire (&pool);
+    CHECK (first != NULL);
+    CHECK (first->connected);
+    second = pool_acquire (&pool);
+    CHECK (second != NULL);
+    CHECK (second != first);
+    CHECK (pool.created == 2);
+    CHECK (server.requests == requests + 2);
+    CHECK (pool_try_acquire (&pool) == NULL);
+
+    /* Возвращенное подключение выдается снова, без регистрации */
+    pool_release (&pool, first);
+    again = pool_acquire (&pool);
+    CHECK (again == first);
+    CHECK (pool.created == 2);
+    CHECK (server.requests == requests + 2);
+    pool_release (&pool, again);
+    pool_release (&pool, second);
+
+    /* Потоков больше, чем подключений */
+    mem_clear (&probe, sizeof (probe));
+    probe.pool = &pool;
+    CHECK (mutex_init (&probe.mutex));
+    for (index = 0; index < POOL_THREADS; ++index) {
+        threads [index] = thread_start (pool_probe_thread, &probe);
+        CHECK (handle_is_good (threads [index]));
+    }
+
+    for (index = 0; index < POOL_THREADS; ++index) {
+        thread_wait (threads [index]);
+    }
+
+    CHECK (probe.failures == 0);
+    CHECK (probe.count == POOL_THREADS * POOL_ROUNDS);
+    CHECK (pool.created == 2);
+    CHECK (pool.idle.len == 2);
+    CHECK (server.requests == requests + 2 + POOL_THREADS * POOL_ROUNDS);
+
+    /* Пара "клиент -- номер запроса" не повторяется */
+    for (index = 0; index < probe.count; ++index) {
+        for (other = 0; other < index; ++other) {
+            if (probe.clients [index] == probe.clients [other]
+                && probe.queries [index] == probe.queries [other]) {
+                distinct = AM_FALSE;
+            }
+        }
+    }
+
+    CHECK (distinct);
+    mutex_destroy (&probe.mutex);
+
+    pool_destroy (&pool);
+    mock_disconnect (&server, &settings);
+}
@@ -0,0 +1,123 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+TESTER(record_cache_get_1)
+{
+    RecordCache cache;
+    MarcRecord record, copy;
+    Buffer db1 = BUFFER_INIT, db2 = BUFFER_INIT;
+
+    CHECK (record_cache_create (&cache, 64 * 1024));
+    CHECK (buffer_assign_text (&db1, CBTEXT ("IBIS")));
+    CHECK (buffer_assign_text (&db2, CBTEXT ("ibis")));
+
+    record_init (&record);
+    record_init (&copy);
+    record.mfn = 123;
+    record.version = 5;
+    CHECK (record_add (&record, 200, CBTEXT ("^aTitle^eSubtitle")) != NULL);
+    CHECK (record_add (&record, 700, CBTEXT ("^aAuthor")) != NULL);
+
+    CHECK (!record_cache_get (&cache, &db1, 123, &copy));
+    CHECK (record_cache_put (&cache, &db1, &record));
+    CHECK (cache.cache.size != 0);
+
+    /* Регистр букв в имени базы данных не имеет значения */
+    CHECK (record_cache_get (&cache, &db2, 123, &copy));
+    CHECK (copy.mfn == 123);
+    CHECK (copy.version == 5);
+    CHECK (copy.fields.len == 2);
+    CHECK (buffer_compare_text (&record_get (&copy, 0)->value, CBTEXT ("^aTitle^eSubtitle")) == 0);
+    CHECK (cache.cache.hits == 1);
+    CHECK (cache.cache.misses == 1);
+
+    /* Повторное получение не накапливает поля */
+    CHECK (record_cache_get (&cache, &db1, 123, &copy));
+    CHECK (copy.fields.len == 2);
+
+    /* Устаревшая версия сбрасывается */
+    CHECK (record_cache_validate (&cache, &db1, 123, 5));
+    CHECK (!record_cache_validate (&cache, &db1, 123, 6));
+    CHECK (!record_cache_get (&cache, &db1, 123, &copy));
+    CHECK (cache.cache.size == 0);
+
+    CHECK (record_cache_put (&cache, &db1, &record));
+    record_cache_invalidate (&cache, &db2, 123);
+    CHECK (!record_cache_get (&cache, &db1, 123, &copy));
+
+    record_destroy (&record);
+    record_destroy (&copy);
+    buffer_destroy (&db1);
+    buffer_destroy (&db2);
+    record_cache_destroy (&cache);
+}
+
+TESTER(record_cache_connection_1)
+{
+    MockServer server;
+    Connection connection;
+    RecordCache cache;
+    MarcRecord record, *saved;
+    Array records;
+    am_int32 requests;
+    am_uint64 hits, misses;
+
+    CHECK (mock_connect (&server, &connection));
+    CHECK (record_cache_create (&cache, 64 * 1024));
+    connection.recordCache = &cache;
+
+    record_init (&record);
+    CHECK (connection_read_record (&connection, 1, &record));
+    requests = server.requests;
+    CHECK (connection_read_record (&connection, 1, &record));
+    CHECK (server.requests == requests);
+    CHECK (cache.cache.hits == 1);
+
+    /* Без подключения кэш не отвечает */
+    connection.connected = AM_FALSE;
+    CHECK (!connection_read_record (&connection, 1, &record));
+    CHECK (cache.cache.hits == 1);
+    connection.connected = AM_TRUE;
+
+    /* Пакетное сохранение сбрасывает устаревшую копию */
+    array_init (&records, sizeof (MarcRecord));
+    saved = (MarcRecord*) array_emplace_back (&records);
+    CHECK (saved != NULL);
+    record_init (saved);
+    CHECK (record_clone (saved, &record) != NULL);
+    CHECK (record_add (saved, 700, CBTEXT ("^aAuthor")) != NULL);
+    CHECK (connection_write_records (&connection, &records));
+    CHECK (saved->version == record.version + 1);
+    requests = server.requests;
+    CHECK (connection_read_record (&connection, 1, &record));
+    CHECK (server.requests == requests + 1);
+    CHECK (record.version == saved->version);
+    CHECK (record_get_field (&record, 700, 0) != NULL);
+
+    /* ...а копию новой версии оставляет */
+    record.version = saved->version + 1;
+    CHECK (record_cache_put (&cache, &connection.database, &record));
+    hits = cache.cache.hits;
+    misses = cache.cache.misses;
+    CHECK (connection_write_records (&connection, &records));
+    CHECK (saved->version == record.version);
+
+    /* Сверка не искажает статистику кэша */
+    CHECK (cache.cache.hits == hits);
+    CHECK (cache.cache.misses == misses);
+    requests = server.requests;
+    CHECK (connection_read_record (&connection, 1, &record));
+    CHECK (server.requests == requests);
+
+    record_destroy (saved);
+    array_destroy (&records, NULL);
+    record_destroy (&record);
+    connection.recordCache = NULL;
+    mock_disconnect (&server, &connection);
+    record_cache_destroy (&cache);
+}
@@ -0,0 +1,68 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+TESTER(record_parse_all_format_1)
+{
+    MarcRecord record;
+    MarcField *field;
+
+    record_init (&record);
+
+    CHECK (record_parse_all_format (&record, TEXT_SPAN (
+        "123#\x1F" "123#0\x1F" "0#5\x1F"
+        "200#^aTitle^eSubtitle\x1F\x1E" "700#^aAuthor\x1F")));
+    CHECK (record.mfn == 123);
+    CHECK (record.status == 0);
+    CHECK (record.version == 5);
+    CHECK (record.fields.len == 2);
+
+    field = record_get (&record, 0);
+    CHECK (field->tag == 200);
+    CHECK (field->subfields.len == 2);
+    field = record_get (&record, 1);
+    CHECK (field->tag == 700);
+
+    record_destroy (&record);
+}
+
+TESTER(record_parse_all_format_2)
+{
+    MarcRecord record;
+
+    record_init (&record);
+
+    CHECK (!record_parse_all_format (&record, TEXT_SPAN ("")));
+    CHECK (!record_parse_all_format (&record, TEXT_SPAN ("5#")));
+    CHECK (record.fields.len == 0);
+
+    record_destroy (&record);
+}
+
+TESTER(record_encode_1)
+{
+    MarcRecord record1, record2;
+    Buffer buffer = BUFFER_INIT;
+
+    record_init (&record1);
+    record_init (&record2);
+
+    record1.mfn = 12;
+    record1.status = 0;
+    record1.version = 3;
+    CHECK (record_add (&record1, 200, CBTEXT ("^aTitle^eSubtitle")) != NULL);
+    CHECK (record_add (&record1, 700, CBTEXT ("^aAuthor")) != NULL);
+
+    CHECK (record_encode (&record1, IRBIS_DELIMITER, &buffer));
+    CHECK (record_decode_text (&record2, buffer_to_span (&buffer)));
+    CHECK (record2.mfn == 12);
+    CHECK (record2.version == 3);
+    CHECK (record2.fields.len == 2);
+    CHECK (record_get (&record2, 1)->tag == 700);
+
+    buffer_destroy (&buffer);
+    record_destroy (&record1);
+    record_destroy (&record2);
+}
@@ -0,0 +1,154 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+/* Ожидание, пока фоновый поток наполнит запас. */
+static am_bool reserve_wait
+    (
+        SocketReserve *reserve
+    )
+{
+    size_t count = 0;
+    int attempt;
+
+    for (attempt = 0; attempt < 200; ++attempt) {
+        mutex_lock (&reserve->mutex);
+        count = reserve->count;
+        mutex_unlock (&reserve->mutex);
+        if (count == reserve->capacity) {
+            break;
+        }
+
+        magna_sleep (10);
+    }
+
+    return count == reserve->capacity;
+}
+
+TESTER(socket_reserve_take_1)
+{
+    SocketReserve reserve;
+    Connection connection;
+    am_uint64 started;
+
+    /* На этом порту никто не слушает */
+    CHECK (connection_create (&connection));
+    connection.port = 1;
+
+    CHECK (socket_reserve_create (&reserve, &connection, 2));
+    CHECK (reserve.capacity == 2);
+    CHECK (socket_reserve_take (&reserve, -1) == -1);
+    CHECK (reserve.taken == 0);
+    CHECK (reserve.missed == 1);
+
+    /* Фоновый поток останавливается, не дожидаясь паузы */
+    started = magna_ticks ();
+    socket_reserve_destroy (&reserve);
+    CHECK (magna_ticks () - started < 900);
+
+    connection_destroy (&connection);
+}
+
+TESTER(socket_reserve_take_2)
+{
+    MockServer first, second;
+    Connection connection;
+    SocketReserve reserve;
+    am_int32 requests;
+
+    CHECK (mock_connect (&first, &connection));
+    CHECK (socket_reserve_create (&reserve, &connection, 2));
+    CHECK (reserve_wait (&reserve));
+    connection.reserve = &reserve;
+
+    /* Запрос уходит по готовому соединению */
+    requests = first.requests;
+    CHECK (connection_no_operation (&connection));
+    CHECK (reserve.taken == 1);
+    CHECK (reserve.missed == 0);
+    CHECK (first.requests == requests + 1);
+
+    /* Сервер сменил адрес: старые соединения не используются */
+    CHECK (mock_server_create (&second));
+    CHECK (mock_server_start (&second, 0, MOCK_WORKERS));
+    connection.port = mock_server_port (&second);
+    requests = first.requests;
+    CHECK (connection_no_operation (&connection));
+    CHECK (first.requests == requests);
+    CHECK (second.requests == 1);
+    CHECK (reserve.missed == 1);
+
+    /* Запас пополняется соединениями с новым адресом */
+    CHECK (reserve_wait (&reserve));
+    CHECK (connection_no_operation (&connection));
+    CHECK (reserve.taken == 2);
+    CHECK (first.requests == requests);
+    CHECK (second.requests == 2);
+
+    connection.reserve = NULL;
+    socket_reserve_destroy (&reserve);
+    mock_server_destroy (&second);
+    connection.port = mock_server_port (&first);
+    mock_disconnect (&first, &connection);
+}
+
+TESTER(socket_reserve_take_3)
+{
+    SocketReserve reserve;
+    Connection connection;
+    Tcp4Address address;
+    am_int32 listener, handles[16];
+    am_uint64 started, elapsed;
+    size_t count;
+
+    CHECK (tcp4_resolve (CBTEXT ("127.0.0.1"), 0, &address));
+    listener = tcp4_listen (&address, 1);
+    CHECK (listener >= 0);
+    address.port = tcp4_local_port (listener);
+
+    /* Очередь слушающего сокета переполнена: сервер не отвечает */
+    for (count = 0; count < 16; ++count) {
+        handles[count] = tcp4_connect_timeout (&address, 200);
+        if (handles[count] < 0) {
+            break;
+        }
+    }
+
+    CHECK (count < 16);
+    CHECK (connection_create (&connection));
+    CHECK (connection_set_host (&connection, CBTEXT ("127.0.0.1")));
+    connection.port = address.port;
+    CHECK (socket_reserve_create (&reserve, &connection, 1));
+
+    /* Запас пуст: подключение ограничено сроком */
+    started = magna_ticks ();
+    CHECK (socket_reserve_take (&reserve, 200) == -1);
+    elapsed = magna_ticks () - started;
+    CHECK (elapsed >= 190);
+    CHECK (elapsed < 1000);
+
+    /* То же -- через подключение с ограничением времени */
+    connection.reserve = &reserve;
+    connection.connected = AM_TRUE;
+    connection.timeout = 200;
+    started = magna_ticks ();
+    CHECK (!connection_no_operation (&connection));
+    elapsed = magna_ticks () - started;
+    CHECK (connection.lastError == -100004);
+    CHECK (elapsed < 1000);
+    connection.connected = AM_FALSE;
+    connection.reserve = NULL;
+
+    /* Закрытие слушателя освобождает фоновый поток */
+    while (count != 0) {
+        tcp4_disconnect (handles[--count]);
+    }
+
+    tcp4_disconnect (listener);
+    socket_reserve_destroy (&reserve);
+    connection_destroy (&connection);
+}
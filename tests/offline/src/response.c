@@ -0,0 +1,293 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+TESTER(response_presize_1)
+{
+    Response response;
+    const am_byte *header = CBTEXT ("K\r\n123456\r\n1\r\n5000\r\n\r\n\r\n\r\n\r\n\r\n\r\n");
+
+    response_init (&response);
+    CHECK (buffer_puts (&response.answer, header));
+    CHECK (response_presize (&response));
+    CHECK (buffer_capacity (&response.answer) >= strlen ((const char*) header) + 5000);
+    CHECK (buffer_length (&response.answer) == strlen ((const char*) header));
+
+    response_destroy (&response);
+}
+
+TESTER(response_presize_2)
+{
+    Response response;
+
+    /* Заголовок получен не полностью */
+    response_init (&response);
+    CHECK (!response_presize (&response));
+    CHECK (buffer_puts (&response.answer, CBTEXT ("K\r\n123456\r\n1\r\n5000\r\n")));
+    CHECK (!response_presize (&response));
+    CHECK (buffer_capacity (&response.answer) < 5000);
+
+    response_destroy (&response);
+}
+
+TESTER(response_parse_answer_1)
+{
+    Connection connection;
+    Response response;
+
+    CHECK (connection_create (&connection));
+    response_init (&response);
+    response.connection = &connection;
+    CHECK (buffer_puts (&response.answer, CBTEXT ("K\r\n123456\r\n7\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n0\r\n42\r\n")));
+
+    response_parse_answer (&response);
+    CHECK (span_compare (response.command, span_from_text (CBTEXT ("K"))) == 0);
+    CHECK (response.clientId == 123456);
+    CHECK (response.queryId == 7);
+    CHECK (response_check (&response, 0));
+    CHECK (response_read_int32 (&response) == 42);
+
+    response_destroy (&response);
+    connection_destroy (&connection);
+}
+
+static am_bool MAGNA_CALL response_count_found (const FoundLine *found, void *data)
+{
+    am_mfn *total = (am_mfn*) data;
+
+    *total += found->mfn;
+
+    return AM_TRUE;
+}
+
+static am_bool MAGNA_CALL response_first_term (const Term *term, void *data)
+{
+    return buffer_copy ((Buffer*) data, &term->text) && AM_FALSE;
+}
+
+TESTER(found_decode_stream_1)
+{
+    Connection connection;
+    Response response;
+    am_mfn total = 0;
+
+    CHECK (connection_create (&connection));
+    response_init (&response);
+    response.connection = &connection;
+    CHECK (buffer_puts (&response.answer, CBTEXT ("K\r\n1\r\n1\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n0\r\n3\r\n1#First\r\n2\r\n4#Second\r\n")));
+
+    response_parse_answer (&response);
+    CHECK (response_check (&response, 0));
+    CHECK (response_read_int32 (&response) == 3);
+    CHECK (found_decode_stream (&response, response_count_found, &total));
+    CHECK (total == 7);
+    CHECK (response_eot (&response));
+
+    response_destroy (&response);
+    connection_destroy (&connection);
+}
+
+TESTER(term_parse_stream_1)
+{
+    Connection connection;
+    Response response;
+    Buffer text = BUFFER_INIT;
+
+    CHECK (connection_create (&connection));
+    response_init (&response);
+    response.connection = &connection;
+    CHECK (buffer_puts (&response.answer, CBTEXT ("H\r\n1\r\n1\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n0\r\n10#K=ALPHA\r\n20#K=BETA\r\n")));
+
+    response_parse_answer (&response);
+    CHECK (response_check (&response, 0));
+
+    /* Обработчик прерывает разбор после первого термина */
+    CHECK (term_parse_stream (&response, response_first_term, &text));
+    CHECK (buffer_compare_text (&text, CBTEXT ("K=ALPHA")) == 0);
+    CHECK (!response_eot (&response));
+
+    buffer_destroy (&text);
+    response_destroy (&response);
+    connection_destroy (&connection);
+}
+
+/* Записи, которые найдутся по запросу K=WORD (MFN 3 и далее) */
+#define STREAM_RECORDS 20000
+
+static void response_fill_mock (MockServer *server)
+{
+    MarcRecord record;
+    int index;
+
+    record_init (&record);
+    record_add (&record, 200, CBTEXT ("^aWord"));
+    for (index = 0; index < STREAM_RECORDS; ++index) {
+        mock_server_add_record (server, &record);
+    }
+
+    record_destroy (&record);
+}
+
+/* Поиск K=WORD с получением ответа в потоковом режиме. */
+static am_bool response_stream_search
+    (
+        Connection *connection,
+        Response *response
+    )
+{
+    SearchParameters parameters;
+    Query query;
+    am_bool result = AM_FALSE;
+
+    if (!search_parameters_create (&parameters, CBTEXT ("K=WORD"))) {
+        return AM_FALSE;
+    }
+
+    if (query_create (&query, connection, CBTEXT (SEARCH))) {
+        result = search_parameters_encode (&parameters, connection, &query)
+            && connection_execute_stream (connection, &query, response);
+        query_destroy (&query);
+    }
+
+    search_parameters_destroy (&parameters);
+
+    return result;
+}
+
+TESTER(response_remaining_utf_lines_1)
+{
+    MockServer server;
+    Connection connection;
+    Response response;
+    SpanArray lines;
+    size_t index, wrong = 0;
+
+    CHECK (mock_connect (&server, &connection));
+    response_fill_mock (&server);
+    CHECK (span_array_create (&lines, 16));
+
+    /* Ответ намного больше блока чтения, строки должны остаться целыми */
+    CHECK (response_stream_search (&connection, &response));
+    CHECK (response_get_return_code (&response) == 0);
+    CHECK (response_read_int32 (&response) == STREAM_RECORDS);
+    CHECK (response_remaining_utf_lines (&response, &lines));
+    CHECK (lines.len == STREAM_RECORDS);
+    for (index = 0; index < lines.len; ++index) {
+        if (span_to_uint32 (span_array_get (&lines, index)) != index + 3) {
+            ++wrong;
+        }
+    }
+
+    CHECK (wrong == 0);
+
+    response_destroy (&response);
+    span_array_destroy (&lines);
+    mock_disconnect (&server, &connection);
+}
+
+/* Короткие строки, заведомо превышающие блок чтения в сумме */
+#define STREAM_LINES 50000
+
+/* Длинная строка, не помещающаяся в блок чтения */
+#define STREAM_LONG_LINE (5 * TCP4_RECEIVE_BLOCK)
+
+/* Отсылка подготовленного ответа из отдельного потока */
+typedef struct
+{
+    am_int32 handle; /* Серверная сторона соединения. */
+    Buffer answer;   /* Ответ целиком. */
+
+} StreamWriter;
+
+static void MAGNA_CALL stream_writer_run
+    (
+        void *data
+    )
+{
+    StreamWriter *writer = (StreamWriter*) data;
+
+    tcp4_send_buffer (writer->handle, &writer->answer);
+    tcp4_disconnect (writer->handle);
+}
+
+TESTER(response_stream_eviction_1)
+{
+    Tcp4Address address;
+    StreamWriter writer;
+    Response response;
+    Span line;
+    char text[32];
+    am_handle thread;
+    am_int32 listener, client;
+    size_t index, wrong = 0, versionOffset;
+
+    /* Заголовок, много коротких строк, затем одна длинная */
+    buffer_init (&writer.answer);
+    CHECK (buffer_puts (&writer.answer, CBTEXT ("K\r\n123\r\n7\r\n\r\n64.2014\r\n\r\n\r\n\r\n\r\n\r\n")));
+    for (index = 0; index < STREAM_LINES; ++index) {
+        sprintf (text, "line %lu\r\n", (unsigned long) index);
+        CHECK (buffer_puts (&writer.answer, CBTEXT (text)));
+    }
+
+    for (index = 0; index < STREAM_LONG_LINE; ++index) {
+        CHECK (buffer_putc (&writer.answer, 'x'));
+    }
+
+    CHECK (buffer_puts (&writer.answer, CBTEXT ("\r\nend\r\n")));
+
+    CHECK (tcp4_resolve (CBTEXT ("127.0.0.1"), 0, &address));
+    listener = tcp4_listen (&address, 1);
+    CHECK (listener >= 0);
+    client = tcp4_connect (CBTEXT ("127.0.0.1"), tcp4_local_port (listener));
+    CHECK (client >= 0);
+    writer.handle = tcp4_accept (listener);
+    CHECK (writer.handle >= 0);
+    thread = thread_start (stream_writer_run, &writer);
+    CHECK (handle_is_good (thread));
+
+    response_init (&response);
+    CHECK (response_stream (&response, client));
+    CHECK (span_compare (response.command, TEXT_SPAN ("K")) == 0);
+    CHECK (span_compare (response.serverVersion, TEXT_SPAN ("64.2014")) == 0);
+    CHECK (response.pinned == 32);
+    versionOffset = (size_t) (response.serverVersion.start - response.answer.start);
+
+    /* Прочитанные строки вытесняются, буфер не растет */
+    for (index = 0; index < STREAM_LINES; ++index) {
+        sprintf (text, "line %lu", (unsigned long) index);
+        if (span_compare (response_get_line (&response), TEXT_SPAN (text)) != 0) {
+            ++wrong;
+        }
+    }
+
+    CHECK (wrong == 0);
+    CHECK (buffer_capacity (&response.answer) < 4 * TCP4_RECEIVE_BLOCK);
+
+    /* Заголовок закреплен в начале буфера */
+    CHECK (span_starts_with (buffer_to_span (&response.answer), TEXT_SPAN ("K\r\n123\r\n")));
+
+    /* Длинная строка требует перераспределения буфера,
+     * указатели заголовка должны следовать за ним */
+    line = response_get_line (&response);
+    CHECK (span_length (line) == STREAM_LONG_LINE);
+    CHECK (line.start[0] == 'x' && line.end[-1] == 'x');
+    CHECK (buffer_capacity (&response.answer) > STREAM_LONG_LINE);
+    CHECK (response.command.start == response.answer.start);
+    CHECK (span_compare (response.command, TEXT_SPAN ("K")) == 0);
+    CHECK (response.serverVersion.start == response.answer.start + versionOffset);
+    CHECK (span_compare (response.serverVersion, TEXT_SPAN ("64.2014")) == 0);
+
+    CHECK (span_compare (response_get_line (&response), TEXT_SPAN ("end")) == 0);
+    CHECK (span_is_empty (response_get_line (&response)));
+    CHECK (response_eot (&response));
+    CHECK (!response.broken);
+
+    thread_wait (thread);
+    response_destroy (&response);
+    buffer_destroy (&writer.answer);
+    tcp4_disconnect (listener);
+}
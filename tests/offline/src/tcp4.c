@@ -0,0 +1,67 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+#include "offline.h"
+
+/* Неудачное подключение должно уложиться в отведенное время */
+#define TCP4_TIMEOUT 200
+
+TESTER(tcp4_connect_timeout_1)
+{
+    Tcp4Address address;
+    am_int32 listener, handle;
+    am_uint64 started;
+
+    CHECK (tcp4_resolve (CBTEXT ("127.0.0.1"), 0, &address));
+    listener = tcp4_listen (&address, 4);
+    CHECK (listener >= 0);
+    address.port = tcp4_local_port (listener);
+
+    /* Сервер слушает: подключение в блокирующем режиме */
+    handle = tcp4_connect_timeout (&address, TCP4_TIMEOUT);
+    CHECK (handle >= 0);
+    CHECK (tcp4_send (handle, CBTEXT ("x"), 1) == 1);
+    tcp4_disconnect (handle);
+
+    /* Порт закрыт: отказ без ожидания */
+    tcp4_disconnect (listener);
+    started = magna_ticks ();
+    CHECK (tcp4_connect_timeout (&address, 5000) < 0);
+    CHECK (magna_ticks () - started < 1000);
+}
+
+TESTER(tcp4_connect_timeout_2)
+{
+    Tcp4Address address;
+    am_int32 listener, handles[16];
+    am_uint64 started, elapsed = 0;
+    size_t count;
+
+    CHECK (tcp4_resolve (CBTEXT ("127.0.0.1"), 0, &address));
+    listener = tcp4_listen (&address, 1);
+    CHECK (listener >= 0);
+    address.port = tcp4_local_port (listener);
+
+    /* Очередь слушающего сокета переполнена: сервер не отвечает */
+    for (count = 0; count < 16; ++count) {
+        started = magna_ticks ();
+        handles[count] = tcp4_connect_timeout (&address, TCP4_TIMEOUT);
+        if (handles[count] < 0) {
+            elapsed = magna_ticks () - started;
+            break;
+        }
+    }
+
+    CHECK (count < 16);
+    CHECK (elapsed >= TCP4_TIMEOUT - 10);
+    CHECK (elapsed < 5 * TCP4_TIMEOUT);
+
+    while (count != 0) {
+        tcp4_disconnect (handles[--count]);
+    }
+
+    tcp4_disconnect (listener);
+}
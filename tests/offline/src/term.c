@@ -0,0 +1,72 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+TESTER(posting_list_append_1)
+{
+    static const am_uint32 mfns[] = { 1, 5, 5, 100000, 3, 70000000 };
+    PostingList list;
+    PostingReader reader;
+    Posting posting;
+    size_t index;
+
+    posting_list_init (&list, AM_FALSE);
+    posting_init (&posting);
+
+    for (index = 0; index < sizeof (mfns) / sizeof (mfns[0]); ++index) {
+        posting.mfn = mfns[index];
+        posting.tag = 200 + (am_uint32) index;
+        posting.occurrence = 1;
+        posting.count = (am_uint32) index * 100;
+        CHECK (posting_list_append (&list, &posting));
+    }
+
+    CHECK (list.count == 6);
+    /* Гораздо меньше, чем шесть структур Posting */
+    CHECK (buffer_length (&list.data) < 6 * sizeof (Posting) / 4);
+
+    posting_reader_init (&reader, &list);
+    for (index = 0; index < sizeof (mfns) / sizeof (mfns[0]); ++index) {
+        CHECK (posting_reader_next (&reader, &posting));
+        CHECK (posting.mfn == mfns[index]);
+        CHECK (posting.tag == 200 + index);
+        CHECK (posting.occurrence == 1);
+        CHECK (posting.count == index * 100);
+    }
+
+    CHECK (!posting_reader_next (&reader, &posting));
+
+    posting_destroy (&posting);
+    posting_list_destroy (&list);
+}
+
+TESTER(posting_list_append_2)
+{
+    PostingList list;
+    PostingReader reader;
+    Posting posting;
+
+    posting_list_init (&list, AM_TRUE);
+    posting_init (&posting);
+
+    CHECK (posting_parse_line (&posting, TEXT_SPAN ("12#200#1#3#Some text")));
+    CHECK (posting_list_append (&list, &posting));
+    buffer_clear (&posting.text);
+    CHECK (posting_parse_line (&posting, TEXT_SPAN ("15#700#2#1")));
+    CHECK (posting_list_append (&list, &posting));
+
+    posting_reader_init (&reader, &list);
+    CHECK (posting_reader_next (&reader, &posting));
+    CHECK (posting.mfn == 12);
+    CHECK (buffer_compare_text (&posting.text, CBTEXT ("Some text")) == 0);
+    CHECK (posting_reader_next (&reader, &posting));
+    CHECK (posting.mfn == 15);
+    CHECK (posting.tag == 700);
+    CHECK (buffer_length (&posting.text) == 0);
+    CHECK (!posting_reader_next (&reader, &posting));
+
+    posting_destroy (&posting);
+    posting_list_destroy (&list);
+}
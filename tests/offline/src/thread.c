@@ -0,0 +1,90 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+
+typedef struct
+{
+    Mutex mutex;
+    volatile am_int32 atomic;
+    am_int32 plain;
+
+} Counters;
+
+static void MAGNA_CALL counting_routine (void *data)
+{
+    Counters *counters = (Counters*) data;
+    int i;
+
+    for (i = 0; i < 1000; ++i) {
+        atomic_increment_int32 (&counters->atomic);
+        mutex_lock (&counters->mutex);
+        ++counters->plain;
+        mutex_unlock (&counters->mutex);
+    }
+}
+
+TESTER(atomic_add_int32_1)
+{
+    volatile am_int32 value = 5;
+
+    CHECK (atomic_add_int32 (&value, 3) == 8);
+    CHECK (atomic_increment_int32 (&value) == 9);
+    CHECK (atomic_decrement_int32 (&value) == 8);
+    CHECK (value == 8);
+}
+
+TESTER(mutex_init_1)
+{
+    Mutex mutex;
+
+    CHECK (mutex_init (&mutex));
+    mutex_lock (&mutex);
+    mutex_unlock (&mutex);
+    mutex_destroy (&mutex);
+    CHECK (mutex.impl == NULL);
+}
+
+TESTER(condition_wait_for_1)
+{
+    Mutex mutex;
+    Condition condition;
+    am_uint64 start;
+
+    CHECK (mutex_init (&mutex));
+    CHECK (condition_init (&condition));
+
+    start = magna_ticks ();
+    mutex_lock (&mutex);
+    CHECK (!condition_wait_for (&condition, &mutex, 20));
+    mutex_unlock (&mutex);
+    CHECK (magna_ticks () - start >= 10);
+
+    condition_destroy (&condition);
+    mutex_destroy (&mutex);
+}
+
+TESTER(thread_start_1)
+{
+    Counters counters;
+    am_handle threads[4];
+    size_t i;
+
+    counters.atomic = 0;
+    counters.plain = 0;
+    CHECK (mutex_init (&counters.mutex));
+
+    for (i = 0; i < 4; ++i) {
+        threads[i] = thread_start (counting_routine, &counters);
+        CHECK (handle_is_good (threads[i]));
+    }
+
+    for (i = 0; i < 4; ++i) {
+        CHECK (thread_wait (threads[i]));
+    }
+
+    CHECK (counters.atomic == 4000);
+    CHECK (counters.plain == 4000);
+
+    mutex_destroy (&counters.mutex);
+}
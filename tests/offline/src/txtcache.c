@@ -0,0 +1,33 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+#include "magna/tester.h"
+#include "magna/irbis.h"
+
+TESTER(text_cache_get_1)
+{
+    TextCache cache;
+    Specification spec1, spec2;
+    Buffer output = BUFFER_INIT;
+
+    CHECK (text_cache_create (&cache, 1024, 0));
+    CHECK (spec_create (&spec1, 2, CBTEXT ("IBIS"), CBTEXT ("brief.pft")));
+    CHECK (spec_create (&spec2, 2, CBTEXT ("ibis"), CBTEXT ("BRIEF.PFT")));
+
+    CHECK (!text_cache_get (&cache, &spec1, &output));
+    CHECK (text_cache_put (&cache, &spec1, TEXT_SPAN ("v200^a")));
+
+    /* Регистр букв не имеет значения */
+    CHECK (text_cache_get (&cache, &spec2, &output));
+    CHECK (buffer_compare_text (&output, CBTEXT ("v200^a")) == 0);
+    CHECK (cache.cache.hits == 1);
+    CHECK (cache.cache.misses == 1);
+
+    text_cache_invalidate (&cache, &spec1);
+    CHECK (!text_cache_get (&cache, &spec2, &output));
+
+    buffer_destroy (&output);
+    spec_destroy (&spec1);
+    spec_destroy (&spec2);
+    text_cache_destroy (&cache);
+}